@@ -23,5 +23,6 @@
 #define PYBRICKS_STM32_OPT_COMPILER     (1)
 #define PYBRICKS_STM32_OPT_FLOAT        (1)
 #define PYBRICKS_STM32_OPT_TERSE_ERR    (0)
+#define PYBRICKS_STM32_OPT_PROGRAM_CACHE (0) // would take from the 16K heap
 
 #include "../stm32/configport.h"
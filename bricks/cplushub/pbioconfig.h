@@ -9,6 +9,11 @@
 
 #define PBIO_CONFIG_UARTDEV                 (1)
 #define PBIO_CONFIG_UARTDEV_NUM_DEV         (4)
+#define PBIO_CONFIG_UARTDEV_MAX_BAUD_RATE   (460800)
 
 #define PBIO_CONFIG_ENABLE_DEINIT           (1)
 #define PBIO_CONFIG_ENABLE_SYS              (1)
+
+#define PBIO_CONFIG_TRACE                   (1)
+
+#define PBIO_CONFIG_ATTITUDE                (1)
@@ -6,8 +6,21 @@
 //
 // Image manipulation on ev3dev using the GRX3 graphics library. This can be
 // used for both in-memory images and writing directly to the screen.
-
+//
+// Image files are decoded once and kept in a cache until they change, so
+// drawing the same file again is just a copy. Besides .png files, raw images made with
+// tools/ev3image.py can be used. These are mapped into memory without any
+// decoding.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <grx-3.0.h>
 
@@ -25,13 +38,34 @@
 #include "pbkwarg.h"
 #include "pbobj.h"
 
+// Raw image files, see tools/ev3image.py
+#define EV3DEV_IMAGE_RAW_EXT ".pbimg"
+#define EV3DEV_IMAGE_RAW_MAGIC "PBIM"
+#define EV3DEV_IMAGE_RAW_HEADER_SIZE (16)
+
+// Memory that decoded image files may use (about 20 full screen images). The
+// least recently used ones are removed from the cache to stay within it.
+#define EV3DEV_IMAGE_CACHE_BUDGET (2 * 1024 * 1024)
+
+// A rectangle in pixels, empty if x1 > x2
+typedef struct {
+    gint x1;
+    gint y1;
+    gint x2;
+    gint y2;
+} ev3dev_Image_area_t;
+
 typedef struct _ev3dev_Image_obj_t {
     mp_obj_base_t base;
     mp_obj_t width;
     mp_obj_t height;
     mp_obj_t buffer; // only used by _screen_
+    mp_obj_t frame; // only used by _screen_
+    GrxContext *screen; // only used by _screen_, between begin_frame() and end_frame()
     gboolean cleared; // only used by _screen_
     GrxContext *context;
+    // area that was drawn on since begin_frame()
+    ev3dev_Image_area_t dirty;
     void *mem; // don't touch - needed for GC pressure
     GrxTextOptions *text_options;
     gint print_x;
@@ -90,6 +124,274 @@ STATIC mp_obj_t ev3dev_Image_new(GrxContext *context) {
     return MP_OBJ_FROM_PTR(self);
 }
 
+// A decoded image file. The context is never drawn on.
+typedef struct {
+    GrxContext *context;
+    // Mapped raw image file that holds the pixels of context, or NULL
+    void *map;
+    size_t map_size;
+    // Memory used by the pixels
+    size_t size;
+    // The entry is only used while the file still has the same size and time
+    // of last modification.
+    off_t file_size;
+    struct timespec file_mtime;
+    uint32_t last_used;
+} file_cache_entry_t;
+
+// Decoded image files by resolved path
+STATIC GHashTable *file_cache;
+STATIC size_t file_cache_size;
+STATIC uint32_t file_cache_use_count;
+
+STATIC void file_cache_entry_free(gpointer data) {
+    file_cache_entry_t *entry = data;
+
+    grx_context_unref(entry->context);
+    if (entry->map) {
+        munmap(entry->map, entry->map_size);
+    }
+    file_cache_size -= entry->size;
+    g_free(entry);
+}
+
+STATIC GrxContext *copy_context(GrxContext *source) {
+    gint w = grx_context_get_width(source);
+    gint h = grx_context_get_height(source);
+    GrxFrameMemory mem;
+    mem.plane0 = m_malloc(grx_screen_get_context_size(w, h));
+    GrxContext *context = grx_context_new(w, h, &mem, NULL);
+    if (!context) {
+        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("failed to allocate context for image"));
+    }
+    grx_context_bit_blt(context, 0, 0, source, 0, 0, w - 1, h - 1, GRX_COLOR_MODE_WRITE);
+    return context;
+}
+
+STATIC GrxContext *load_png(const char *filename) {
+    gint w, h;
+    if (!grx_query_png_file(filename, &w, &h)) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_OSError,
+            "'%s' is not a .png file", filename));
+    }
+
+    // GRX allocates the memory, since this is kept in the cache
+    GrxContext *context = grx_context_new(w, h, NULL, NULL);
+    if (!context) {
+        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("failed to allocate context for image"));
+    }
+
+    GError *error = NULL;
+    if (!grx_context_load_from_png(context, filename, FALSE, &error)) {
+        mp_obj_t ex = mp_obj_new_exception_msg_varg(&mp_type_OSError,
+            "Failed to load '%s': %s", filename, error->message);
+        g_error_free(error);
+        grx_context_unref(context);
+        nlr_raise(ex);
+    }
+
+    return context;
+}
+
+STATIC uint32_t get_u32(const uint8_t *buf) {
+    return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+STATIC void load_raw(const char *filename, file_cache_entry_t *entry) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        mp_raise_OSError(errno);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        int err = errno;
+        close(fd);
+        mp_raise_OSError(err);
+    }
+
+    // Private mapping, so the file is never written and pages are only copied
+    // if the image is changed in memory.
+    uint8_t *map = MAP_FAILED;
+    if (st.st_size >= EV3DEV_IMAGE_RAW_HEADER_SIZE) {
+        map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+
+    gint w = 0, h = 0;
+    size_t line_size = 0;
+    if (map != MAP_FAILED && memcmp(map, EV3DEV_IMAGE_RAW_MAGIC, 4) == 0) {
+        w = map[4] | map[5] << 8;
+        h = map[6] | map[7] << 8;
+        line_size = get_u32(map + 8);
+    }
+    if (w == 0 || h == 0 || line_size < (size_t)w * 4 ||
+        (size_t)st.st_size < EV3DEV_IMAGE_RAW_HEADER_SIZE + line_size * h) {
+        if (map != MAP_FAILED) {
+            munmap(map, st.st_size);
+        }
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_OSError,
+            "'%s' is not a raw image file", filename));
+    }
+    const uint8_t *pixels = map + EV3DEV_IMAGE_RAW_HEADER_SIZE;
+
+    // If the screen uses the same pixel format, the mapped file is used as the
+    // image memory directly. The mapping is kept, since the image is cached.
+    if ((size_t)grx_screen_get_context_size(w, h) == line_size * h && line_size == (size_t)w * 4 &&
+        grx_color_get(0x12, 0x34, 0x56) == 0x123456) {
+        GrxFrameMemory mem;
+        mem.plane0 = (char *)pixels;
+        GrxContext *context = grx_context_new(w, h, &mem, NULL);
+        if (!context) {
+            munmap(map, st.st_size);
+            mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("failed to allocate context for image"));
+        }
+        entry->context = context;
+        entry->map = map;
+        entry->map_size = st.st_size;
+        return;
+    }
+
+    // Otherwise convert each pixel
+    GrxContext *context = grx_context_new(w, h, NULL, NULL);
+    if (!context) {
+        munmap(map, st.st_size);
+        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("failed to allocate context for image"));
+    }
+    grx_set_current_context(context);
+    for (gint y = 0; y < h; y++) {
+        for (gint x = 0; x < w; x++) {
+            uint32_t rgb = get_u32(pixels + y * line_size + x * 4);
+            grx_fast_draw_pixel(x, y, grx_color_get(rgb >> 16 & 0xFF, rgb >> 8 & 0xFF, rgb & 0xFF));
+        }
+    }
+    munmap(map, st.st_size);
+
+    entry->context = context;
+}
+
+// Removes the least recently used files until the rest fits in the budget.
+// The given entry is kept.
+STATIC void file_cache_trim(const file_cache_entry_t *keep) {
+    while (file_cache_size > EV3DEV_IMAGE_CACHE_BUDGET) {
+        GHashTableIter iter;
+        gpointer key, value;
+        gpointer oldest_key = NULL;
+        file_cache_entry_t *oldest = NULL;
+
+        g_hash_table_iter_init(&iter, file_cache);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            file_cache_entry_t *entry = value;
+            if (entry == keep) {
+                continue;
+            }
+            if (!oldest || file_cache_use_count - entry->last_used > file_cache_use_count - oldest->last_used) {
+                oldest = entry;
+                oldest_key = key;
+            }
+        }
+        if (!oldest) {
+            return;
+        }
+        g_hash_table_remove(file_cache, oldest_key);
+    }
+}
+
+// Removes a file from the cache, if it is there
+STATIC void file_cache_drop(const char *filename) {
+    if (!file_cache) {
+        return;
+    }
+    char *path = realpath(filename, NULL);
+    if (path) {
+        g_hash_table_remove(file_cache, path);
+        free(path);
+    }
+}
+
+// Gets a decoded image file from the cache, loading it on first use or when
+// the file has changed since. The result must not be drawn on.
+STATIC GrxContext *get_file_context(const char *filename) {
+    if (!file_cache) {
+        file_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, file_cache_entry_free);
+    }
+
+    // add file extension if missing
+    gboolean raw = g_str_has_suffix(filename, EV3DEV_IMAGE_RAW_EXT);
+    char *name = raw || g_str_has_suffix(filename, ".png") || g_str_has_suffix(filename, ".PNG") ?
+        g_strdup(filename) : g_strconcat(filename, ".png", NULL);
+
+    // Files are cached by their resolved path, so that all names of a file
+    // share one entry. If the file does not exist, loading it below raises
+    // the error.
+    char *resolved = realpath(name, NULL);
+    char *path = g_strdup(resolved ? resolved : name);
+    free(resolved);
+
+    struct stat st;
+    gboolean exists = stat(path, &st) == 0;
+    if (!exists) {
+        memset(&st, 0, sizeof(st));
+    }
+
+    file_cache_entry_t *entry = g_hash_table_lookup(file_cache, path);
+    if (entry && exists && entry->file_size == st.st_size && entry->file_mtime.tv_sec == st.st_mtim.tv_sec &&
+        entry->file_mtime.tv_nsec == st.st_mtim.tv_nsec) {
+        entry->last_used = ++file_cache_use_count;
+        g_free(path);
+        g_free(name);
+        return entry->context;
+    }
+
+    // The file has changed, so it is loaded again
+    if (entry) {
+        g_hash_table_remove(file_cache, path);
+    }
+
+    entry = g_new0(file_cache_entry_t, 1);
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        if (raw) {
+            load_raw(name, entry);
+        } else {
+            entry->context = load_png(name);
+        }
+        nlr_pop();
+    } else {
+        g_free(entry);
+        g_free(path);
+        g_free(name);
+        nlr_jump(nlr.ret_val);
+    }
+    g_free(name);
+
+    entry->size = grx_screen_get_context_size(grx_context_get_width(entry->context),
+        grx_context_get_height(entry->context));
+    entry->file_size = st.st_size;
+    entry->file_mtime = st.st_mtim;
+    entry->last_used = ++file_cache_use_count;
+    g_hash_table_insert(file_cache, path, entry);
+
+    // Make room for the new file, which is the most recently used
+    file_cache_size += entry->size;
+    file_cache_trim(entry);
+
+    return entry->context;
+}
+
+// Gets the context to draw from for a file name or Image, or NULL if it is
+// neither. Files come from the cache, so nothing is decoded or copied.
+STATIC GrxContext *get_source_context(mp_obj_t source) {
+    if (mp_obj_is_str(source)) {
+        return get_file_context(mp_obj_str_get_str(source));
+    }
+    if (mp_obj_is_type(source, &pb_type_ev3dev_Image)) {
+        ev3dev_Image_obj_t *image = MP_OBJ_TO_PTR(source);
+        return image->context;
+    }
+    return NULL;
+}
+
 STATIC mp_obj_t ev3dev_Image_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
     enum { ARG_source, ARG_sub, ARG_x1, ARG_y1, ARG_x2, ARG_y2 };
     static const mp_arg_t allowed_args[] = {
@@ -111,41 +413,8 @@ STATIC mp_obj_t ev3dev_Image_make_new(const mp_obj_type_t *type, size_t n_args,
         // special case '_screen_' creates image that draws directly to screen
         context = grx_context_ref(grx_get_screen_context());
     } else if (mp_obj_is_str(source_in)) {
-        const char *filename = mp_obj_str_get_str(source_in);
-
-        // add file extension if missing
-        char *filename_ext = NULL;
-        if (!g_str_has_suffix(filename, ".png") && !g_str_has_suffix(filename, ".PNG")) {
-            filename_ext = g_strconcat(filename, ".png", NULL);
-            filename = filename_ext;
-        }
-
-        gint w, h;
-        if (!grx_query_png_file(filename, &w, &h)) {
-            mp_obj_t ex = mp_obj_new_exception_msg_varg(&mp_type_OSError,
-                "'%s' is not a .png file", filename);
-            g_free(filename_ext);
-            nlr_raise(ex);
-        }
-
-        GrxFrameMemory mem;
-        mem.plane0 = m_malloc(grx_screen_get_context_size(w, h));
-        context = grx_context_new(w, h, &mem, NULL);
-        if (!context) {
-            g_free(filename_ext);
-            mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("failed to allocate context for image"));
-        }
-
-        GError *error = NULL;
-        if (!grx_context_load_from_png(context, filename, FALSE, &error)) {
-            mp_obj_t ex = mp_obj_new_exception_msg_varg(&mp_type_OSError,
-                "Failed to load '%s': %s", filename, error->message);
-            g_free(filename_ext);
-            g_error_free(error);
-            nlr_raise(ex);
-        }
-
-        g_free(filename_ext);
+        // copy, since the cached image must not be drawn on
+        context = copy_context(get_file_context(mp_obj_str_get_str(source_in)));
     } else if (mp_obj_is_type(source_in, &pb_type_ev3dev_Image)) {
         ev3dev_Image_obj_t *image = MP_OBJ_TO_PTR(source_in);
         if (arg_vals[ARG_sub].u_bool) {
@@ -155,13 +424,7 @@ STATIC mp_obj_t ev3dev_Image_make_new(const mp_obj_type_t *type, size_t n_args,
             mp_int_t y2 = pb_obj_get_int(arg_vals[ARG_y2].u_obj);
             context = grx_context_new_subcontext(x1, y1, x2, y2, image->context, NULL);
         } else {
-            gint w = grx_context_get_width(image->context);
-            gint h = grx_context_get_height(image->context);
-            GrxFrameMemory mem;
-            mem.plane0 = m_malloc(grx_screen_get_context_size(w, h));
-            context = grx_context_new(w, h, &mem, NULL);
-            grx_context_bit_blt(context, 0, 0, image->context, 0, 0,
-                w - 1, h - 1, GRX_COLOR_MODE_WRITE);
+            context = copy_context(image->context);
         }
     }
 
@@ -201,6 +464,10 @@ STATIC MP_DEFINE_CONST_STATICMETHOD_OBJ(ev3dev_Image_empty_obj, MP_ROM_PTR(&ev3d
 
 STATIC mp_obj_t ev3dev_Image___del__(mp_obj_t self_in) {
     ev3dev_Image_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->screen) {
+        // the frame context belongs to the frame image
+        self->context = self->screen;
+    }
     grx_text_options_unref(self->text_options);
     grx_context_unref(self->context);
     return mp_const_none;
@@ -213,13 +480,68 @@ STATIC void clear_once(ev3dev_Image_obj_t *self) {
         return;
     }
     grx_context_clear(self->context, GRX_COLOR_WHITE);
+    mark_all_dirty(self);
     self->cleared = TRUE;
 }
 
+// The screen image that ended the last frame. Its frame image is the same as
+// the screen, except for screen_changed.
+STATIC ev3dev_Image_obj_t *screen_frame_owner;
+// Area of the screen that was drawn on directly since the last end_frame()
+STATIC ev3dev_Image_area_t screen_changed = { 0, 0, -1, -1 };
+
+// Grows the area to include the given one. The corners may be given in any order.
+STATIC void area_add(ev3dev_Image_area_t *area, gint x1, gint y1, gint x2, gint y2) {
+    if (area->x1 > area->x2) {
+        area->x1 = area->y1 = G_MAXINT;
+        area->x2 = area->y2 = G_MININT;
+    }
+    area->x1 = MIN(area->x1, MIN(x1, x2));
+    area->y1 = MIN(area->y1, MIN(y1, y2));
+    area->x2 = MAX(area->x2, MAX(x1, x2));
+    area->y2 = MAX(area->y2, MAX(y1, y2));
+}
+
+// Copies the area from one context to another, clipped to the destination
+STATIC void area_copy(GrxContext *dst, GrxContext *src, const ev3dev_Image_area_t *area) {
+    gint x1 = MAX(area->x1, 0);
+    gint y1 = MAX(area->y1, 0);
+    gint x2 = MIN(area->x2, grx_context_get_max_x(dst));
+    gint y2 = MIN(area->y2, grx_context_get_max_y(dst));
+    if (x1 <= x2 && y1 <= y2) {
+        grx_context_bit_blt(dst, x1, y1, src, x1, y1, x2, y2, GRX_COLOR_MODE_WRITE);
+    }
+}
+
+// Keep track of the area that has to be copied to the screen at the end of
+// the frame, or from the screen at the start of the next frame if this was
+// drawn on the screen directly. The corners may be given in any order.
+STATIC void mark_dirty(ev3dev_Image_obj_t *self, gint x1, gint y1, gint x2, gint y2) {
+    if (self->screen) {
+        area_add(&self->dirty, x1, y1, x2, y2);
+        return;
+    }
+    if (!screen_frame_owner) {
+        return;
+    }
+    GrxContext *screen = grx_get_screen_context();
+    if (self->context == screen) {
+        area_add(&screen_changed, x1, y1, x2, y2);
+    } else if (self->mem == screen->frame.base_address.plane0) {
+        // a sub-image of the screen
+        area_add(&screen_changed, 0, 0, grx_context_get_max_x(screen), grx_context_get_max_y(screen));
+    }
+}
+
+STATIC void mark_all_dirty(ev3dev_Image_obj_t *self) {
+    mark_dirty(self, 0, 0, grx_context_get_max_x(self->context), grx_context_get_max_y(self->context));
+}
+
 STATIC mp_obj_t ev3dev_Image_clear(mp_obj_t self_in) {
     ev3dev_Image_obj_t *self = MP_OBJ_TO_PTR(self_in);
     clear_once(self);
     grx_context_clear(self->context, GRX_COLOR_WHITE);
+    mark_all_dirty(self);
     self->print_x = 0;
     self->print_y = 0;
     return mp_const_none;
@@ -240,6 +562,7 @@ STATIC mp_obj_t ev3dev_Image_draw_pixel(size_t n_args, const mp_obj_t *pos_args,
     clear_once(self);
     grx_set_current_context(self->context);
     grx_draw_pixel(x_, y_, color_);
+    mark_dirty(self, x_, y_, x_, y_);
 
     return mp_const_none;
 }
@@ -270,6 +593,8 @@ STATIC mp_obj_t ev3dev_Image_draw_line(size_t n_args, const mp_obj_t *pos_args,
         GrxLineOptions options = { .color = color_, .width = width_ };
         grx_draw_line_with_options(x1_, y1_, x2_, y2_, &options);
     }
+    mark_dirty(self, MIN(x1_, x2_) - width_, MIN(y1_, y2_) - width_,
+        MAX(x1_, x2_) + width_, MAX(y1_, y2_) + width_);
 
     return mp_const_none;
 }
@@ -308,6 +633,7 @@ STATIC mp_obj_t ev3dev_Image_draw_box(size_t n_args, const mp_obj_t *pos_args, m
             grx_draw_box(x1_, y1_, x2_, y2_, color_);
         }
     }
+    mark_dirty(self, x1_, y1_, x2_, y2_);
 
     return mp_const_none;
 }
@@ -335,6 +661,7 @@ STATIC mp_obj_t ev3dev_Image_draw_circle(size_t n_args, const mp_obj_t *pos_args
     } else {
         grx_draw_circle(x_, y_, r_, color_);
     }
+    mark_dirty(self, x_ - r_, y_ - r_, x_ + r_, y_ + r_);
 
     return mp_const_none;
 }
@@ -350,41 +677,77 @@ STATIC mp_obj_t ev3dev_Image_draw_image(size_t n_args, const mp_obj_t *pos_args,
 
     mp_int_t x_ = pb_obj_get_int(x);
     mp_int_t y_ = pb_obj_get_int(y);
-    if (mp_obj_is_str(source)) {
-        mp_obj_t args[1] = { source };
-        source = ev3dev_Image_make_new(&pb_type_ev3dev_Image, 1, 0, args);
-    }
-    if (!mp_obj_is_type(source, &pb_type_ev3dev_Image)) {
+    GrxContext *source_ = get_source_context(source);
+    if (!source_) {
         mp_raise_TypeError(MP_ERROR_TEXT("Image object is required"));
     }
-    ev3dev_Image_obj_t *source_ = MP_OBJ_TO_PTR(source);
     GrxColor transparent_ = map_color(transparent);
 
     clear_once(self);
-    grx_context_bit_blt(self->context, x_, y_, source_->context, 0, 0,
-        grx_context_get_max_x(source_->context), grx_context_get_max_y(source_->context),
+    grx_context_bit_blt(self->context, x_, y_, source_, 0, 0,
+        grx_context_get_max_x(source_), grx_context_get_max_y(source_),
         transparent_ == GRX_COLOR_NONE ? GRX_COLOR_MODE_WRITE : grx_color_to_image_mode(transparent_));
+    mark_dirty(self, x_, y_, x_ + grx_context_get_max_x(source_), y_ + grx_context_get_max_y(source_));
 
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Image_draw_image_obj, 1, ev3dev_Image_draw_image);
 
-STATIC mp_obj_t ev3dev_Image_load_image(mp_obj_t self_in, mp_obj_t source_in) {
-    ev3dev_Image_obj_t *self = MP_OBJ_TO_PTR(self_in);
+// Draws one frame of a sprite sheet. The frames all have the same size and are
+// numbered left to right, top to bottom.
+STATIC mp_obj_t ev3dev_Image_draw_sprite(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        ev3dev_Image_obj_t, self,
+        PB_ARG_REQUIRED(x),
+        PB_ARG_REQUIRED(y),
+        PB_ARG_REQUIRED(source),
+        PB_ARG_REQUIRED(index),
+        PB_ARG_REQUIRED(width),
+        PB_ARG_DEFAULT_NONE(height),
+        PB_ARG_DEFAULT_NONE(transparent));
 
-    if (mp_obj_is_str(source_in)) {
-        mp_obj_t args[1] = { source_in };
-        source_in = ev3dev_Image_make_new(&pb_type_ev3dev_Image, 1, 0, args);
+    mp_int_t x_ = pb_obj_get_int(x);
+    mp_int_t y_ = pb_obj_get_int(y);
+    GrxContext *source_ = get_source_context(source);
+    if (!source_) {
+        mp_raise_TypeError(MP_ERROR_TEXT("Image object is required"));
     }
+    mp_int_t index_ = pb_obj_get_int(index);
+    mp_int_t width_ = pb_obj_get_int(width);
+    // by default, the sprite sheet is a single row
+    mp_int_t height_ = height == mp_const_none ? grx_context_get_height(source_) : pb_obj_get_int(height);
+    GrxColor transparent_ = map_color(transparent);
 
-    if (!mp_obj_is_type(source_in, &pb_type_ev3dev_Image)) {
-        mp_raise_TypeError(MP_ERROR_TEXT("source must be Image or str"));
+    if (width_ <= 0 || height_ <= 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("width and height must be greater than 0"));
     }
+    mp_int_t columns = grx_context_get_width(source_) / width_;
+    mp_int_t rows = grx_context_get_height(source_) / height_;
+    if (index_ < 0 || index_ >= columns * rows) {
+        mp_raise_ValueError(MP_ERROR_TEXT("index out of range"));
+    }
+    mp_int_t sx = index_ % columns * width_;
+    mp_int_t sy = index_ / columns * height_;
+
+    clear_once(self);
+    grx_context_bit_blt(self->context, x_, y_, source_, sx, sy, sx + width_ - 1, sy + height_ - 1,
+        transparent_ == GRX_COLOR_NONE ? GRX_COLOR_MODE_WRITE : grx_color_to_image_mode(transparent_));
+    mark_dirty(self, x_, y_, x_ + width_ - 1, y_ + height_ - 1);
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Image_draw_sprite_obj, 1, ev3dev_Image_draw_sprite);
 
-    ev3dev_Image_obj_t *source = MP_OBJ_TO_PTR(source_in);
+STATIC mp_obj_t ev3dev_Image_load_image(mp_obj_t self_in, mp_obj_t source_in) {
+    ev3dev_Image_obj_t *self = MP_OBJ_TO_PTR(self_in);
 
-    mp_obj_t x = mp_obj_new_int((mp_obj_get_int(self->width) - mp_obj_get_int(source->width)) / 2);
-    mp_obj_t y = mp_obj_new_int((mp_obj_get_int(self->height) - mp_obj_get_int(source->height)) / 2);
+    GrxContext *source = get_source_context(source_in);
+    if (!source) {
+        mp_raise_TypeError(MP_ERROR_TEXT("source must be Image or str"));
+    }
+
+    mp_obj_t x = mp_obj_new_int((mp_obj_get_int(self->width) - grx_context_get_width(source)) / 2);
+    mp_obj_t y = mp_obj_new_int((mp_obj_get_int(self->height) - grx_context_get_height(source)) / 2);
 
     // if the destination is the screen, then we double-buffer to prevent flicker
     if (self->context == grx_get_screen_context()) {
@@ -444,11 +807,14 @@ STATIC mp_obj_t ev3dev_Image_draw_text(size_t n_args, const mp_obj_t *pos_args,
     grx_set_current_context(self->context);
     grx_text_options_set_fg_color(self->text_options, text_color_);
     grx_text_options_set_bg_color(self->text_options, background_color_);
-    if (background_color_ != GRX_COLOR_NONE) {
+    if (background_color_ != GRX_COLOR_NONE || self->screen) {
         GrxFont *font = grx_text_options_get_font(self->text_options);
         gint w = grx_font_get_text_width(font, text_);
         gint h = grx_font_get_text_height(font, text_);
-        grx_draw_filled_box(x_, y_, x_ + w - 1, y_ + h - 1, background_color_);
+        if (background_color_ != GRX_COLOR_NONE) {
+            grx_draw_filled_box(x_, y_, x_ + w - 1, y_ + h - 1, background_color_);
+        }
+        mark_dirty(self, x_, y_, x_ + w - 1, y_ + h - 1);
     }
     grx_draw_text(text_, x_, y_, self->text_options);
 
@@ -466,7 +832,86 @@ STATIC mp_obj_t ev3dev_Image_set_font(mp_obj_t self_in, mp_obj_t font_in) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(ev3dev_Image_set_font_obj, ev3dev_Image_set_font);
 
-// copy of mp_builtin_print modified to print to vstr
+// If printing the next line would run off of the bottom of the image, scroll
+// everything up enough to fit one more line
+STATIC void ev3dev_Image_print_scroll(ev3dev_Image_obj_t *self, gint font_height) {
+    gint height = grx_get_height();
+    gint over = self->print_y + font_height - height;
+    if (over <= 0) {
+        return;
+    }
+
+    gint max_x = grx_get_max_x();
+    gint max_y = grx_get_max_y();
+
+    // Move the rest of the image up in one go. The frame driver copies whole
+    // rows and handles the overlap, which is much faster than going through
+    // each scanline ourselves.
+    if (over < height) {
+        grx_context_bit_blt(self->context, 0, 0, self->context, 0, over, max_x, max_y, GRX_COLOR_MODE_WRITE);
+    }
+
+    // Only the part that scrolled into view has to be cleared
+    grx_draw_filled_box(0, MAX(height - over, 0), max_x, max_y, GRX_COLOR_WHITE);
+    mark_all_dirty(self);
+
+    self->print_y -= over;
+}
+
+// Draws printed text on the image, like a terminal. This is the print_strn
+// function of the mp_print_t used by print(), so text goes straight to the
+// image without building a string first.
+STATIC void ev3dev_Image_print_strn(void *data, const char *str, size_t len) {
+    ev3dev_Image_obj_t *self = data;
+    GrxFont *font = grx_text_options_get_font(self->text_options);
+    gint font_height = grx_font_get_height(font);
+
+    // grx_draw_text() needs null-terminated strings, so longer text is drawn
+    // in chunks
+    char buf[64];
+
+    while (len) {
+        if (*str == '\n') {
+            self->print_x = 0;
+            self->print_y += font_height;
+            ev3dev_Image_print_scroll(self, font_height);
+            str++;
+            len--;
+            continue;
+        }
+
+        size_t n = 0;
+        while (n < len && n < sizeof(buf) - 1 && str[n] != '\n') {
+            n++;
+        }
+        // don't split UTF-8 characters between chunks
+        if (n < len && str[n] != '\n') {
+            size_t end = n;
+            while (end > 0 && (str[end] & 0xC0) == 0x80) {
+                end--;
+            }
+            if (end > 0) {
+                n = end;
+            }
+        }
+        memcpy(buf, str, n);
+        buf[n] = '\0';
+
+        ev3dev_Image_print_scroll(self, font_height);
+        gint w = grx_font_get_text_width(font, buf);
+        gint h = grx_font_get_text_height(font, buf);
+        grx_draw_filled_box(self->print_x, self->print_y,
+            self->print_x + w - 1, self->print_y + h - 1, GRX_COLOR_WHITE);
+        grx_draw_text(buf, self->print_x, self->print_y, self->text_options);
+        mark_dirty(self, self->print_x, self->print_y, self->print_x + w - 1, self->print_y + h - 1);
+        self->print_x += w;
+
+        str += n;
+        len -= n;
+    }
+}
+
+// copy of mp_builtin_print modified to print to the image
 STATIC mp_obj_t ev3dev_Image_print(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     enum { ARG_sep, ARG_end };
     static const mp_arg_t allowed_args[] = {
@@ -489,9 +934,12 @@ STATIC mp_obj_t ev3dev_Image_print(size_t n_args, const mp_obj_t *pos_args, mp_m
     const char *sep_data = mp_obj_str_get_data(sep, &u.len[0]);
     const char *end_data = mp_obj_str_get_data(end, &u.len[1]);
 
-    vstr_t vstr;
-    mp_print_t print;
-    vstr_init_print(&vstr, 16, &print);
+    clear_once(self);
+    grx_set_current_context(self->context);
+    grx_text_options_set_fg_color(self->text_options, GRX_COLOR_BLACK);
+    grx_text_options_set_bg_color(self->text_options, GRX_COLOR_WHITE);
+
+    mp_print_t print = { .data = self, .print_strn = ev3dev_Image_print_strn };
 
     for (size_t i = 1; i < n_args; i++) {
         if (i > 1) {
@@ -501,44 +949,6 @@ STATIC mp_obj_t ev3dev_Image_print(size_t n_args, const mp_obj_t *pos_args, mp_m
     }
     mp_print_strn(&print, end_data, u.len[1], 0, 0, 0);
 
-    clear_once(self);
-    grx_set_current_context(self->context);
-    grx_text_options_set_fg_color(self->text_options, GRX_COLOR_BLACK);
-    grx_text_options_set_bg_color(self->text_options, GRX_COLOR_WHITE);
-    GrxFont *font = grx_text_options_get_font(self->text_options);
-    gint font_height = grx_font_get_height(font);
-    gchar **lines = g_strsplit(vstr_null_terminated_str(&vstr), "\n", -1);
-    for (gchar **l = lines; *l; l++) {
-        // if this is not the first line, then we had a newline and need to advance
-        if (l != lines) {
-            self->print_x = 0;
-            self->print_y += font_height;
-        }
-        // if printing would run off of the bottom of the screen, scroll
-        // everything on the screen up enough to fit one more line
-        gint screen_height = grx_get_height();
-        gint over = self->print_y + font_height - screen_height;
-        if (over > 0) {
-            gint max_x = grx_get_max_x();
-            for (int y = 0; y < screen_height; y++) {
-                const GrxColor *scan_line = grx_get_scanline(0, max_x, y + over, NULL);
-                if (scan_line) {
-                    grx_put_scanline(0, max_x, y, scan_line, GRX_COLOR_MODE_WRITE);
-                } else {
-                    grx_draw_hline(0, max_x, y, GRX_COLOR_WHITE);
-                }
-            }
-            self->print_y -= over;
-        }
-        gint w = grx_font_get_text_width(font, *l);
-        gint h = grx_font_get_text_height(font, *l);
-        grx_draw_filled_box(self->print_x, self->print_y,
-            self->print_x + w - 1, self->print_y + h - 1, GRX_COLOR_WHITE);
-        grx_draw_text(*l, self->print_x, self->print_y, self->text_options);
-        self->print_x += w;
-    }
-    g_strfreev(lines);
-
     return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Image_print_obj, 1, ev3dev_Image_print);
@@ -556,6 +966,9 @@ STATIC mp_obj_t ev3dev_Image_save(mp_obj_t self_in, mp_obj_t filename_in) {
 
     GError *error = NULL;
     gboolean ok = grx_context_save_to_png(self->context, filename, &error);
+
+    // The file may have been drawn from before, so it must be loaded again
+    file_cache_drop(filename);
     g_free(filename_ext);
     if (!ok) {
         mp_obj_t ex = mp_obj_new_exception_msg_varg(&mp_type_OSError,
@@ -568,6 +981,68 @@ STATIC mp_obj_t ev3dev_Image_save(mp_obj_t self_in, mp_obj_t filename_in) {
 }
 MP_DEFINE_CONST_FUN_OBJ_2(ev3dev_Image_save_obj, ev3dev_Image_save);
 
+// Until end_frame() is called, drawing on the screen goes to an image in
+// memory instead. Then only the area that changed is copied to the screen, all
+// at once. This does nothing for images that are not the screen.
+//
+// The frame image is kept in between frames. It only needs to be updated
+// where the screen was drawn on directly since the last frame.
+STATIC mp_obj_t ev3dev_Image_begin_frame(mp_obj_t self_in) {
+    ev3dev_Image_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    if (self->screen || self->context != grx_get_screen_context()) {
+        return mp_const_none;
+    }
+
+    clear_once(self);
+
+    // Start from what is on the screen now. Unless this image ended the last
+    // frame, the frame image could be anything.
+    if (self->frame == MP_OBJ_NULL || screen_frame_owner != self) {
+        if (self->frame == MP_OBJ_NULL) {
+            mp_obj_t args[2] = { self->width, self->height };
+            mp_map_t kw_args;
+            mp_map_init(&kw_args, 0);
+            self->frame = ev3dev_Image_empty(MP_ARRAY_SIZE(args), args, &kw_args);
+        }
+        screen_changed.x1 = screen_changed.y1 = 0;
+        screen_changed.x2 = grx_context_get_max_x(self->context);
+        screen_changed.y2 = grx_context_get_max_y(self->context);
+    }
+    ev3dev_Image_obj_t *frame = MP_OBJ_TO_PTR(self->frame);
+    area_copy(frame->context, self->context, &screen_changed);
+    screen_changed.x1 = 0;
+    screen_changed.x2 = -1;
+
+    self->screen = self->context;
+    self->context = frame->context;
+    self->dirty.x1 = 0;
+    self->dirty.x2 = -1;
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(ev3dev_Image_begin_frame_obj, ev3dev_Image_begin_frame);
+
+STATIC mp_obj_t ev3dev_Image_end_frame(mp_obj_t self_in) {
+    ev3dev_Image_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    if (!self->screen) {
+        return mp_const_none;
+    }
+
+    area_copy(self->screen, self->context, &self->dirty);
+
+    self->context = self->screen;
+    self->screen = NULL;
+
+    // The screen and the frame image are the same now, except where the
+    // screen was drawn on directly during the frame
+    screen_frame_owner = self;
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(ev3dev_Image_end_frame_obj, ev3dev_Image_end_frame);
+
 STATIC const mp_rom_map_elem_t ev3dev_Image_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_empty),       MP_ROM_PTR(&ev3dev_Image_empty_obj)                    },
     { MP_ROM_QSTR(MP_QSTR___del__),     MP_ROM_PTR(&ev3dev_Image___del___obj)                  },
@@ -577,11 +1052,14 @@ STATIC const mp_rom_map_elem_t ev3dev_Image_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_draw_box),    MP_ROM_PTR(&ev3dev_Image_draw_box_obj)                 },
     { MP_ROM_QSTR(MP_QSTR_draw_circle), MP_ROM_PTR(&ev3dev_Image_draw_circle_obj)              },
     { MP_ROM_QSTR(MP_QSTR_draw_image),  MP_ROM_PTR(&ev3dev_Image_draw_image_obj)               },
+    { MP_ROM_QSTR(MP_QSTR_draw_sprite), MP_ROM_PTR(&ev3dev_Image_draw_sprite_obj)              },
     { MP_ROM_QSTR(MP_QSTR_load_image),  MP_ROM_PTR(&ev3dev_Image_load_image_obj)               },
     { MP_ROM_QSTR(MP_QSTR_draw_text),   MP_ROM_PTR(&ev3dev_Image_draw_text_obj)                },
     { MP_ROM_QSTR(MP_QSTR_set_font),    MP_ROM_PTR(&ev3dev_Image_set_font_obj)                 },
     { MP_ROM_QSTR(MP_QSTR_print),       MP_ROM_PTR(&ev3dev_Image_print_obj)                    },
     { MP_ROM_QSTR(MP_QSTR_save),        MP_ROM_PTR(&ev3dev_Image_save_obj)                     },
+    { MP_ROM_QSTR(MP_QSTR_begin_frame), MP_ROM_PTR(&ev3dev_Image_begin_frame_obj)              },
+    { MP_ROM_QSTR(MP_QSTR_end_frame),   MP_ROM_PTR(&ev3dev_Image_end_frame_obj)                },
     { MP_ROM_QSTR(MP_QSTR_width),       MP_ROM_ATTRIBUTE_OFFSET(ev3dev_Image_obj_t, width)     },
     { MP_ROM_QSTR(MP_QSTR_height),      MP_ROM_ATTRIBUTE_OFFSET(ev3dev_Image_obj_t, height)    },
 };
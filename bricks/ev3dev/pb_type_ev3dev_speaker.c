@@ -8,14 +8,20 @@
 // There are two ways to create sounds. One is to use the "Beep" device to
 // create tones with a given frequency. This is done using the Linux input
 // device so that the sound is played on the EV3. The other is to use ALSA
-// for PCM playback of sampled sounds. To keep the code simple, we just
-// invoke `aplay` in a subprocess (same with espeak for text to speech).
+// for PCM playback of sampled sounds. WAV files are decoded once and played
+// from memory (see pbpcm.c), so that sound effects start right away and can
+// overlap. Other files are played by invoking `aplay` in a subprocess. Text
+// to speech runs espeak in a subprocess and keeps the result in the same
+// cache, so repeated phrases are only synthesized once.
 
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <linux/input.h>
 #include <sys/stat.h>
@@ -30,15 +36,43 @@
 #include "py/runtime.h"
 
 #include "pb_ev3dev_types.h"
+#include "pberror.h"
 #include "pbkwarg.h"
 #include "pbobj.h"
+#include "pbpcm.h"
 
 #define EV3DEV_EV3_INPUT_DEV_PATH "/dev/input/by-path/platform-sound-event"
 
+// One parsed note of a melody
+typedef struct {
+    uint16_t freq;
+    // Time that the note sounds, in milliseconds
+    uint32_t on_ms;
+    // Time of silence after the note (release), in milliseconds
+    uint32_t off_ms;
+} ev3dev_Speaker_note_t;
+
+// Note length that keeps the note playing until the melody is changed
+#define EV3DEV_SPEAKER_NOTE_HOLD UINT32_MAX
+
 typedef struct _ev3dev_Speaker_obj_t {
     mp_obj_base_t base;
     bool intialized;
     int beep_fd;
+    // Melody that is played by the sequencer thread. All of these are
+    // protected by seq_lock. The sequence is NULL when nothing is playing.
+    // Once the sequencer is started, it is the only thread that writes to
+    // beep_fd, so beeps are played as a melody of one note.
+    pthread_t seq_thread;
+    bool seq_started;
+    pthread_mutex_t seq_lock;
+    pthread_cond_t seq_changed;
+    ev3dev_Speaker_note_t *seq_notes;
+    size_t seq_len;
+    uint32_t seq_gen;
+    // The sequencer is playing or silencing a melody
+    bool seq_busy;
+    pthread_cond_t seq_idle;
     char language[10];
     char voice[10];
     char voice_setting[21];
@@ -50,6 +84,8 @@ typedef struct _ev3dev_Speaker_obj_t {
     gboolean espeak_busy;
     gboolean espeak_result;
     GError *espeak_error;
+    GBytes *espeak_stdout;
+    GBytes *espeak_stderr;
     gboolean splice_busy;
     gssize splice_result;
     GError *splice_error;
@@ -71,6 +107,15 @@ STATIC mp_obj_t ev3dev_Speaker_make_new(const mp_obj_type_t *type, size_t n_args
         strncpy(self->speed, "130", sizeof(self->speed));
         strncpy(self->pitch, "50", sizeof(self->pitch));
 
+        // The sequencer uses the monotonic clock for note timing
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&self->seq_changed, &attr);
+        pthread_cond_init(&self->seq_idle, &attr);
+        pthread_condattr_destroy(&attr);
+        pthread_mutex_init(&self->seq_lock, NULL);
+
         nlr_buf_t nlr;
         if (nlr_push(&nlr) == 0) {
             mp_obj_t dest[4];
@@ -103,10 +148,144 @@ static int set_beep_frequency(ev3dev_Speaker_obj_t *self, int32_t freq) {
     return ret;
 }
 
+// Replaces the melody that is playing. Takes ownership of notes, which must
+// be allocated with malloc(). Returns the generation of the new melody. If
+// len is 0, this just stops the melody.
+static uint32_t ev3dev_Speaker_seq_post(ev3dev_Speaker_obj_t *self, ev3dev_Speaker_note_t *notes, size_t len) {
+    if (len == 0) {
+        free(notes);
+        notes = NULL;
+    }
+
+    pthread_mutex_lock(&self->seq_lock);
+    ev3dev_Speaker_note_t *old = self->seq_notes;
+    self->seq_notes = notes;
+    self->seq_len = len;
+    uint32_t gen = ++self->seq_gen;
+    pthread_cond_signal(&self->seq_changed);
+    pthread_mutex_unlock(&self->seq_lock);
+
+    // The sequencer only reads notes with the lock held after checking the
+    // generation, so it is done with the old melody.
+    free(old);
+
+    return gen;
+}
+
+static bool ev3dev_Speaker_seq_playing(ev3dev_Speaker_obj_t *self, uint32_t gen) {
+    pthread_mutex_lock(&self->seq_lock);
+    bool playing = self->seq_notes && self->seq_gen == gen;
+    pthread_mutex_unlock(&self->seq_lock);
+    return playing;
+}
+
+// Waits with seq_lock held until the deadline, which is advanced by ms.
+// Returns false if the melody was changed in the mean time.
+static bool ev3dev_Speaker_seq_wait(ev3dev_Speaker_obj_t *self, struct timespec *deadline, uint32_t ms, uint32_t gen) {
+    if (ms == EV3DEV_SPEAKER_NOTE_HOLD) {
+        while (self->seq_gen == gen) {
+            pthread_cond_wait(&self->seq_changed, &self->seq_lock);
+        }
+        return false;
+    }
+
+    deadline->tv_sec += ms / 1000;
+    deadline->tv_nsec += (ms % 1000) * 1000000;
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+
+    while (self->seq_gen == gen) {
+        if (pthread_cond_timedwait(&self->seq_changed, &self->seq_lock, deadline) == ETIMEDOUT) {
+            return self->seq_gen == gen;
+        }
+    }
+    return false;
+}
+
+// Background thread that plays melodies. Note times are counted from the
+// start of the melody, so the tempo does not drift.
+static void *ev3dev_Speaker_sequencer(void *arg) {
+    ev3dev_Speaker_obj_t *self = arg;
+
+    pthread_mutex_lock(&self->seq_lock);
+
+    for (;;) {
+        while (!self->seq_notes) {
+            pthread_cond_wait(&self->seq_changed, &self->seq_lock);
+        }
+        self->seq_busy = true;
+
+        uint32_t gen = self->seq_gen;
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+        for (size_t i = 0; i < self->seq_len; i++) {
+            ev3dev_Speaker_note_t note = self->seq_notes[i];
+            set_beep_frequency(self, note.freq);
+            if (!ev3dev_Speaker_seq_wait(self, &deadline, note.on_ms, gen)) {
+                break;
+            }
+            // Normally, we want there to be a period of no sound (release) so that
+            // notes are distinct instead of running together.
+            if (note.off_ms) {
+                set_beep_frequency(self, 0);
+                if (!ev3dev_Speaker_seq_wait(self, &deadline, note.off_ms, gen)) {
+                    break;
+                }
+            }
+        }
+
+        // in case the last note has '_' or the melody was stopped
+        set_beep_frequency(self, 0);
+
+        if (self->seq_gen == gen) {
+            free(self->seq_notes);
+            self->seq_notes = NULL;
+            self->seq_len = 0;
+        }
+
+        // Unless there is a new melody, the beeper is silent now
+        if (!self->seq_notes) {
+            self->seq_busy = false;
+            pthread_cond_broadcast(&self->seq_idle);
+        }
+    }
+
+    return NULL;
+}
+
+static void ev3dev_Speaker_seq_start(ev3dev_Speaker_obj_t *self) {
+    if (!self->seq_started) {
+        if (pthread_create(&self->seq_thread, NULL, ev3dev_Speaker_sequencer, self) != 0) {
+            mp_raise_OSError(errno);
+        }
+        self->seq_started = true;
+    }
+}
+
+// Stops the melody and waits until the sequencer has turned off the beeper
+static void ev3dev_Speaker_seq_stop(ev3dev_Speaker_obj_t *self) {
+    if (!self->seq_started) {
+        return;
+    }
+
+    ev3dev_Speaker_seq_post(self, NULL, 0);
+
+    pthread_mutex_lock(&self->seq_lock);
+    while (self->seq_busy) {
+        pthread_cond_wait(&self->seq_idle, &self->seq_lock);
+    }
+    pthread_mutex_unlock(&self->seq_lock);
+}
+
 // This is used when there is an unhandled exception in a program to make sure
 // we stop beeping.
 void _pb_ev3dev_speaker_beep_off() {
-    set_beep_frequency(&ev3dev_speaker_singleton, 0);
+    if (ev3dev_speaker_singleton.intialized) {
+        ev3dev_Speaker_seq_stop(&ev3dev_speaker_singleton);
+    }
 }
 
 STATIC mp_obj_t ev3dev_Speaker_beep(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
@@ -118,10 +297,21 @@ STATIC mp_obj_t ev3dev_Speaker_beep(size_t n_args, const mp_obj_t *pos_args, mp_
     mp_int_t freq = pb_obj_get_int(frequency);
     mp_int_t ms = pb_obj_get_int(duration);
 
-    int ret = set_beep_frequency(self, freq);
-    if (ret == -1) {
-        mp_raise_OSError(errno);
+    if (self->beep_fd == -1) {
+        mp_raise_OSError(EBADF);
+    }
+    ev3dev_Speaker_seq_start(self);
+
+    ev3dev_Speaker_note_t *note = malloc(sizeof(*note));
+    if (!note) {
+        m_malloc_fail(sizeof(*note));
     }
+    note->freq = freq;
+    note->on_ms = ms < 0 ? EV3DEV_SPEAKER_NOTE_HOLD : ms;
+    note->off_ms = 0;
+
+    // A beep interrupts the melody, if any
+    uint32_t gen = ev3dev_Speaker_seq_post(self, note, 1);
 
     if (ms < 0) {
         return mp_const_none;
@@ -129,11 +319,12 @@ STATIC mp_obj_t ev3dev_Speaker_beep(size_t n_args, const mp_obj_t *pos_args, mp_
 
     nlr_buf_t nlr;
     if (nlr_push(&nlr) == 0) {
-        mp_hal_delay_ms(ms);
-        set_beep_frequency(self, 0);
+        while (ev3dev_Speaker_seq_playing(self, gen)) {
+            MICROPY_EVENT_POLL_HOOK
+        }
         nlr_pop();
     } else {
-        set_beep_frequency(self, 0);
+        ev3dev_Speaker_seq_stop(self);
         nlr_jump(nlr.ret_val);
     }
 
@@ -141,7 +332,7 @@ STATIC mp_obj_t ev3dev_Speaker_beep(size_t n_args, const mp_obj_t *pos_args, mp_
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Speaker_beep_obj, 1, ev3dev_Speaker_beep);
 
-STATIC void ev3dev_Speaker_play_note(ev3dev_Speaker_obj_t *self, mp_obj_t obj, int duration) {
+STATIC void ev3dev_Speaker_parse_note(mp_obj_t obj, int duration, ev3dev_Speaker_note_t *parsed) {
     const char *note = mp_obj_str_get_str(obj);
     int pos = 0;
     double freq;
@@ -301,17 +492,16 @@ STATIC void ev3dev_Speaker_play_note(ev3dev_Speaker_obj_t *self, mp_obj_t obj, i
         pos--;
     }
 
-    set_beep_frequency(self, (int)freq);
+    parsed->freq = (uint16_t)freq;
 
-    // Normally, we want there to be a period of no sound (release) so that
-    // notes are distinct instead of running together. To sound good, the
-    // release period is made proportional to duration of the note.
+    // To sound good, the release period is made proportional to duration of
+    // the note.
     if (release) {
-        mp_hal_delay_ms(7 * duration / 8);
-        set_beep_frequency(self, 0);
-        mp_hal_delay_ms(duration / 8);
+        parsed->on_ms = 7 * duration / 8;
+        parsed->off_ms = duration / 8;
     } else {
-        mp_hal_delay_ms(duration);
+        parsed->on_ms = duration;
+        parsed->off_ms = 0;
     }
 }
 
@@ -319,24 +509,61 @@ STATIC mp_obj_t ev3dev_Speaker_play_notes(size_t n_args, const mp_obj_t *pos_arg
     PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
         ev3dev_Speaker_obj_t, self,
         PB_ARG_REQUIRED(notes),
-        PB_ARG_DEFAULT_INT(tempo, 120));
+        PB_ARG_DEFAULT_INT(tempo, 120),
+        PB_ARG_DEFAULT_TRUE(wait));
 
     // length of whole note in milliseconds = 4 quarter/whole * 60 s/min * 1000 ms/s / tempo quarter/min
     int duration = 4 * 60 * 1000 / pb_obj_get_int(tempo);
 
+    // Parse the whole melody first, so that the sequencer thread does not
+    // have to touch any MicroPython objects.
+    ev3dev_Speaker_note_t *seq = NULL;
+    size_t len = 0;
+    size_t alloc = 0;
+
     nlr_buf_t nlr;
     mp_obj_t item;
     mp_obj_t iterable = mp_getiter(notes, NULL);
     if (nlr_push(&nlr) == 0) {
         while ((item = mp_iternext(iterable)) != MP_OBJ_STOP_ITERATION) {
-            ev3dev_Speaker_play_note(self, item, duration);
+            if (len == alloc) {
+                alloc = alloc ? alloc * 2 : 16;
+                ev3dev_Speaker_note_t *new_seq = realloc(seq, alloc * sizeof(*seq));
+                if (!new_seq) {
+                    m_malloc_fail(alloc * sizeof(*seq));
+                }
+                seq = new_seq;
+            }
+            ev3dev_Speaker_parse_note(item, duration, &seq[len++]);
+        }
+        nlr_pop();
+    } else {
+        free(seq);
+        nlr_jump(nlr.ret_val);
+    }
+
+    if (nlr_push(&nlr) == 0) {
+        ev3dev_Speaker_seq_start(self);
+        nlr_pop();
+    } else {
+        free(seq);
+        nlr_jump(nlr.ret_val);
+    }
+
+    uint32_t gen = ev3dev_Speaker_seq_post(self, seq, len);
+
+    if (!mp_obj_is_true(wait)) {
+        return mp_const_none;
+    }
+
+    if (nlr_push(&nlr) == 0) {
+        while (ev3dev_Speaker_seq_playing(self, gen)) {
+            MICROPY_EVENT_POLL_HOOK
         }
-        // in case the last note has '_'
-        set_beep_frequency(self, 0);
         nlr_pop();
     } else {
         // ensure that sound stops if an exception is raised
-        set_beep_frequency(self, 0);
+        ev3dev_Speaker_seq_stop(self);
         nlr_jump(nlr.ret_val);
     }
 
@@ -352,13 +579,7 @@ STATIC void ev3dev_Speaker_aplay_callback(GObject *source_object, GAsyncResult *
     self->aplay_busy = FALSE;
 }
 
-STATIC mp_obj_t ev3dev_Speaker_play_file(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
-    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
-        ev3dev_Speaker_obj_t, self,
-        PB_ARG_REQUIRED(file));
-
-    const char *path = mp_obj_str_get_str(file);
-
+STATIC void ev3dev_Speaker_aplay_file(ev3dev_Speaker_obj_t *self, const char *path) {
     // FIXME: This function needs to be protected agains re-entrancy to make it
     // thread-safe.
 
@@ -420,11 +641,81 @@ STATIC mp_obj_t ev3dev_Speaker_play_file(size_t n_args, const mp_obj_t *pos_args
     }
 
     g_object_unref(aplay);
+}
+
+STATIC void ev3dev_Speaker_raise_pcm_error(const char *path, pbio_error_t err) {
+    if (err == PBIO_ERROR_IO) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_RuntimeError,
+            "Playing file failed: %s: %s", path, strerror(errno)));
+    }
+    pb_assert(err);
+}
+
+STATIC void ev3dev_Speaker_pcm_wait(uint32_t id) {
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        while (pb_pcm_is_playing(id)) {
+            MICROPY_EVENT_POLL_HOOK
+        }
+        nlr_pop();
+    } else {
+        // ensure that sound stops if an exception is raised
+        pb_pcm_stop(id);
+        nlr_jump(nlr.ret_val);
+    }
+}
+
+STATIC mp_obj_t ev3dev_Speaker_play_file(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        ev3dev_Speaker_obj_t, self,
+        PB_ARG_REQUIRED(file),
+        PB_ARG_DEFAULT_TRUE(wait));
+
+    const char *path = mp_obj_str_get_str(file);
+
+    pb_pcm_sound_t *sound;
+    uint32_t id;
+    pbio_error_t err = pb_pcm_load(path, &sound);
+    if (err == PBIO_SUCCESS) {
+        err = pb_pcm_play(sound, &id);
+    }
+    if (err == PBIO_ERROR_IO) {
+        ev3dev_Speaker_raise_pcm_error(path, err);
+    }
+    if (err != PBIO_SUCCESS) {
+        // Not a format that we decode ourselves or no sound device, so leave
+        // it to aplay. This always waits until the sound is done.
+        ev3dev_Speaker_aplay_file(self, path);
+        return mp_const_none;
+    }
+
+    if (mp_obj_is_true(wait)) {
+        ev3dev_Speaker_pcm_wait(id);
+    }
 
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Speaker_play_file_obj, 1, ev3dev_Speaker_play_file);
 
+STATIC mp_obj_t ev3dev_Speaker_preload(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        ev3dev_Speaker_obj_t, self,
+        PB_ARG_REQUIRED(file));
+
+    (void)self; // unused
+
+    // Decode the file now, so that play_file() can start right away
+    const char *path = mp_obj_str_get_str(file);
+    pb_pcm_sound_t *sound;
+    pbio_error_t err = pb_pcm_load(path, &sound);
+    if (err != PBIO_SUCCESS) {
+        ev3dev_Speaker_raise_pcm_error(path, err);
+    }
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Speaker_preload_obj, 1, ev3dev_Speaker_preload);
+
 STATIC void ev3dev_Speaker_espeak_callback(GObject *source_object, GAsyncResult *res, gpointer user_data) {
     GSubprocess *subprocess = G_SUBPROCESS(source_object);
     ev3dev_Speaker_obj_t *self = user_data;
@@ -441,13 +732,7 @@ STATIC void ev3dev_Speaker_splice_callback(GObject *source_object, GAsyncResult
     self->splice_busy = FALSE;
 }
 
-STATIC mp_obj_t ev3dev_Speaker_say(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
-    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
-        ev3dev_Speaker_obj_t, self,
-        PB_ARG_REQUIRED(text));
-
-    const char *text_ = mp_obj_str_get_str(text);
-
+STATIC void ev3dev_Speaker_aplay_say(ev3dev_Speaker_obj_t *self, const char *text_) {
     // FIXME: This function needs to be protected agains re-entrancy to make it
     // thread-safe.
 
@@ -555,11 +840,145 @@ STATIC mp_obj_t ev3dev_Speaker_say(size_t n_args, const mp_obj_t *pos_args, mp_m
 
     g_object_unref(aplay);
     g_object_unref(espeak);
+}
+
+STATIC void ev3dev_Speaker_communicate_callback(GObject *source_object, GAsyncResult *res, gpointer user_data) {
+    GSubprocess *subprocess = G_SUBPROCESS(source_object);
+    ev3dev_Speaker_obj_t *self = user_data;
+    g_clear_error(&self->espeak_error);
+    self->espeak_result = g_subprocess_communicate_finish(subprocess, res,
+        &self->espeak_stdout, &self->espeak_stderr, &self->espeak_error);
+    self->espeak_busy = FALSE;
+}
+
+// Gets the synthesized speech for the text with the current speech options,
+// running espeak only if it is not in the cache already.
+STATIC pb_pcm_sound_t *ev3dev_Speaker_render(ev3dev_Speaker_obj_t *self, const char *text_) {
+    // The options are never empty and have no spaces, so this is unique
+    vstr_t key;
+    vstr_init(&key, 32);
+    vstr_printf(&key, "%s %s %s %s", self->voice_setting, self->speed, self->pitch, text_);
+
+    pb_pcm_sound_t *sound;
+    if (pb_pcm_find_rendered(vstr_null_terminated_str(&key), &sound)) {
+        vstr_clear(&key);
+        return sound;
+    }
+
+    GError *error = NULL;
+    GSubprocess *espeak = g_subprocess_new(
+        G_SUBPROCESS_FLAGS_STDOUT_PIPE | G_SUBPROCESS_FLAGS_STDERR_PIPE,
+        &error, "espeak", "-a", "200", "-v", self->voice_setting, "-s", self->speed,
+        "-p", self->pitch, "--stdout", text_, NULL);
+    if (!espeak) {
+        // This error is unexpected, so doesn't need to be "user-friendly"
+        mp_obj_t ex = mp_obj_new_exception_msg_varg(&mp_type_RuntimeError,
+            "Failed to spawn espeak: %s", error->message);
+        g_error_free(error);
+        nlr_raise(ex);
+    }
+
+    self->espeak_busy = TRUE;
+    g_subprocess_communicate_async(espeak, NULL, NULL, ev3dev_Speaker_communicate_callback, self);
+
+    // Same as with playing, we have to keep running the event loop until
+    // espeak is done, even if there is an exception.
+    mp_obj_t exception = MP_OBJ_NULL;
+    nlr_buf_t nlr;
+    do {
+        if (nlr_push(&nlr) == 0) {
+            MICROPY_EVENT_POLL_HOOK
+            nlr_pop();
+        } else {
+            g_subprocess_force_exit(espeak);
+            exception = MP_OBJ_FROM_PTR(nlr.ret_val);
+        }
+    } while (self->espeak_busy);
+
+    GBytes *out = self->espeak_stdout;
+    GBytes *err = self->espeak_stderr;
+    self->espeak_stdout = NULL;
+    self->espeak_stderr = NULL;
+
+    if (exception == MP_OBJ_NULL && (!self->espeak_result || !g_subprocess_get_successful(espeak))) {
+        gchar *err_msg = self->espeak_result ? g_strdup("espeak failed") : g_strdup(self->espeak_error->message);
+
+        // If there is something in stderr, use that as the error message instead
+        gsize err_size = 0;
+        const gchar *err_data = err ? g_bytes_get_data(err, &err_size) : NULL;
+        if (err_size) {
+            g_free(err_msg);
+            err_msg = g_strndup(err_data, err_size);
+        }
+
+        exception = mp_obj_new_exception_msg_varg(&mp_type_RuntimeError,
+            "Saying text failed: %s", err_msg);
+        g_free(err_msg);
+    }
+
+    pbio_error_t pb_err = PBIO_SUCCESS;
+    if (exception == MP_OBJ_NULL) {
+        gsize size;
+        const guint8 *data = g_bytes_get_data(out, &size);
+        pb_err = pb_pcm_add_rendered(vstr_null_terminated_str(&key), data, size, &sound);
+    }
+
+    if (out) {
+        g_bytes_unref(out);
+    }
+    if (err) {
+        g_bytes_unref(err);
+    }
+    g_object_unref(espeak);
+    vstr_clear(&key);
+
+    if (exception != MP_OBJ_NULL) {
+        nlr_raise(exception);
+    }
+    pb_assert(pb_err);
+
+    return sound;
+}
+
+STATIC mp_obj_t ev3dev_Speaker_say(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        ev3dev_Speaker_obj_t, self,
+        PB_ARG_REQUIRED(text),
+        PB_ARG_DEFAULT_TRUE(wait));
+
+    const char *text_ = mp_obj_str_get_str(text);
+
+    uint32_t id;
+    pb_pcm_sound_t *sound = ev3dev_Speaker_render(self, text_);
+    if (pb_pcm_play(sound, &id) != PBIO_SUCCESS) {
+        // No sound device, so leave it to aplay. This always waits until
+        // the text has been said.
+        ev3dev_Speaker_aplay_say(self, text_);
+        return mp_const_none;
+    }
+
+    if (mp_obj_is_true(wait)) {
+        ev3dev_Speaker_pcm_wait(id);
+    }
 
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Speaker_say_obj, 1, ev3dev_Speaker_say);
 
+STATIC mp_obj_t ev3dev_Speaker_prerender(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        ev3dev_Speaker_obj_t, self,
+        PB_ARG_REQUIRED(text));
+
+    // Synthesize the text now, so that say() can start right away. This
+    // must be called after set_speech_options(), since the options are part
+    // of what is cached.
+    ev3dev_Speaker_render(self, mp_obj_str_get_str(text));
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Speaker_prerender_obj, 1, ev3dev_Speaker_prerender);
+
 STATIC mp_obj_t ev3dev_Speaker_set_speech_options(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
         ev3dev_Speaker_obj_t, self,
@@ -653,13 +1072,38 @@ STATIC mp_obj_t ev3dev_Speaker_set_volume(size_t n_args, const mp_obj_t *pos_arg
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(ev3dev_Speaker_set_volume_obj, 1, ev3dev_Speaker_set_volume);
 
+STATIC mp_obj_t ev3dev_Speaker_busy(mp_obj_t self_in) {
+    ev3dev_Speaker_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    pthread_mutex_lock(&self->seq_lock);
+    bool busy = self->seq_notes != NULL;
+    pthread_mutex_unlock(&self->seq_lock);
+
+    return mp_obj_new_bool(busy || pb_pcm_is_busy());
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(ev3dev_Speaker_busy_obj, ev3dev_Speaker_busy);
+
+STATIC mp_obj_t ev3dev_Speaker_stop(mp_obj_t self_in) {
+    ev3dev_Speaker_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    ev3dev_Speaker_seq_stop(self);
+    pb_pcm_stop_all();
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(ev3dev_Speaker_stop_obj, ev3dev_Speaker_stop);
+
 STATIC const mp_rom_map_elem_t ev3dev_Speaker_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_beep),                MP_ROM_PTR(&ev3dev_Speaker_beep_obj)                },
+    { MP_ROM_QSTR(MP_QSTR_busy),                MP_ROM_PTR(&ev3dev_Speaker_busy_obj)                },
     { MP_ROM_QSTR(MP_QSTR_play_notes),          MP_ROM_PTR(&ev3dev_Speaker_play_notes_obj)          },
     { MP_ROM_QSTR(MP_QSTR_play_file),           MP_ROM_PTR(&ev3dev_Speaker_play_file_obj)           },
+    { MP_ROM_QSTR(MP_QSTR_preload),             MP_ROM_PTR(&ev3dev_Speaker_preload_obj)             },
+    { MP_ROM_QSTR(MP_QSTR_prerender),           MP_ROM_PTR(&ev3dev_Speaker_prerender_obj)           },
     { MP_ROM_QSTR(MP_QSTR_say),                 MP_ROM_PTR(&ev3dev_Speaker_say_obj)                 },
     { MP_ROM_QSTR(MP_QSTR_set_speech_options),  MP_ROM_PTR(&ev3dev_Speaker_set_speech_options_obj)  },
     { MP_ROM_QSTR(MP_QSTR_set_volume),          MP_ROM_PTR(&ev3dev_Speaker_set_volume_obj)          },
+    { MP_ROM_QSTR(MP_QSTR_stop),                MP_ROM_PTR(&ev3dev_Speaker_stop_obj)                },
 };
 STATIC MP_DEFINE_CONST_DICT(ev3dev_Speaker_locals_dict, ev3dev_Speaker_locals_dict_table);
 
@@ -13,12 +13,45 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <contiki.h>
+
 #include <pbio/port.h>
 #include <pbio/iodev.h>
+#include <pbio/util.h>
 
 #include <ev3dev_stretch/lego_sensor.h>
 #include <ev3dev_stretch/nxtcolor.h>
 
+// How often the background process checks on the scheduled modes
+#define PBDEVICE_SCHED_POLL_MS (5)
+
+typedef struct _sched_entry_t {
+    /**
+     * The requested mode and sampling period.
+     */
+    pbdevice_schedule_t schedule;
+    /**
+     * Whether the mode is being read, so that it is sampled in the background.
+     */
+    bool active;
+    /**
+     * Whether data holds a sample taken since the mode became active.
+     */
+    bool valid;
+    /**
+     * Time (ms) at which the sample was taken.
+     */
+    uint32_t time;
+    /**
+     * Time (ms) at which the mode was last read.
+     */
+    uint32_t read_time;
+    /**
+     * Most recent raw data in this mode.
+     */
+    uint8_t data[PBIO_IODEV_MAX_DATA_SIZE];
+} sched_entry_t;
+
 struct _pbdevice_t {
     /**
      * The device ID
@@ -33,21 +66,60 @@ struct _pbdevice_t {
      */
     uint8_t mode;
     /**
-     * The number of values for current mode.
+     * The number of values for each mode, if the mode bit in info_cached is set.
+     */
+    uint8_t data_len[PBIO_IODEV_MAX_NUM_MODES];
+    /**
+     * Data type for each mode, if the mode bit in info_cached is set.
      */
-    uint8_t data_len;
+    lego_sensor_data_type_t data_type[PBIO_IODEV_MAX_NUM_MODES];
     /**
-     * Data type for current mode
+     * Bit flags for the modes whose data info has been read from sysfs.
      */
-    lego_sensor_data_type_t data_type;
+    uint16_t info_cached;
     /**
      * Platform specific low-level device abstraction
      */
     lego_sensor_t *sensor;
+    /**
+     * Whether a mode switch was started but fresh data has not been seen yet.
+     */
+    bool mode_switch_pending;
+    /**
+     * Time (ms) at which the current mode switch was started.
+     */
+    uint32_t mode_switch_time;
+    /**
+     * Raw data as it was just before the mode switch. Fresh data in the new
+     * mode is detected by comparing against it.
+     */
+    uint8_t mode_switch_data[PBIO_IODEV_MAX_DATA_SIZE];
+    /**
+     * Scheduled modes and their most recent samples.
+     */
+    sched_entry_t sched[PBDEVICE_MAX_SCHEDULED_MODES];
+    /**
+     * Number of scheduled modes.
+     */
+    uint8_t num_sched;
+    /**
+     * Scheduled mode that is being sampled or was sampled last.
+     */
+    uint8_t sched_index;
+    /**
+     * Whether the background process is waiting for a sample of sched_index.
+     */
+    bool sched_pending;
+    /**
+     * Time (ms) at which the program last used the device directly.
+     */
+    uint32_t hold_time;
 };
 
 pbdevice_t iodevices[4];
 
+PROCESS(pbdevice_sched_process, "pbdevice");
+
 // Get an ev3dev sensor
 static pbio_error_t get_device(pbdevice_t **pbdev, pbio_iodev_type_id_t valid_id, pbio_port_t port) {
     if (port < PBIO_PORT_1 || port > PBIO_PORT_4) {
@@ -66,6 +138,10 @@ static pbio_error_t get_device(pbdevice_t **pbdev, pbio_iodev_type_id_t valid_id
         return err;
     }
     _pbdev->type_id = valid_id;
+    _pbdev->mode_switch_pending = false;
+    _pbdev->info_cached = 0;
+    _pbdev->num_sched = 0;
+    _pbdev->sched_pending = false;
 
     // For special sensor classes we are done. No need to read mode.
     if (valid_id == PBIO_IODEV_TYPE_ID_CUSTOM_I2C ||
@@ -80,11 +156,15 @@ static pbio_error_t get_device(pbdevice_t **pbdev, pbio_iodev_type_id_t valid_id
     if (err != PBIO_SUCCESS) {
         return err;
     }
+    if (_pbdev->mode >= PBIO_IODEV_MAX_NUM_MODES) {
+        return PBIO_ERROR_IO;
+    }
     // Get corresponding data info
-    err = lego_sensor_get_info(_pbdev->sensor, &_pbdev->data_len, &_pbdev->data_type);
+    err = lego_sensor_get_info(_pbdev->sensor, &_pbdev->data_len[_pbdev->mode], &_pbdev->data_type[_pbdev->mode]);
     if (err != PBIO_SUCCESS) {
         return err;
     }
+    _pbdev->info_cached = 1 << _pbdev->mode;
 
     // Return pointer to device on success
     *pbdev = _pbdev;
@@ -92,8 +172,11 @@ static pbio_error_t get_device(pbdevice_t **pbdev, pbio_iodev_type_id_t valid_id
     return PBIO_SUCCESS;
 }
 
-// Get the required mode switch time delay for a given sensor type and/or mode
-static uint32_t get_mode_switch_delay(pbio_iodev_type_id_t id, uint8_t mode) {
+// Get the maximum time to wait for fresh data after a mode switch for a given
+// sensor type and/or mode. Most sensors produce new data much sooner, which is
+// detected in is_ready(). This is only the fallback for when the data in the
+// new mode happens to be identical to the data in the previous mode.
+static uint32_t get_mode_switch_timeout(pbio_iodev_type_id_t id, uint8_t mode) {
     switch (id) {
         case PBIO_IODEV_TYPE_ID_EV3_COLOR_SENSOR:
             return 30;
@@ -105,53 +188,106 @@ static uint32_t get_mode_switch_delay(pbio_iodev_type_id_t id, uint8_t mode) {
             return 300;
         case PBIO_IODEV_TYPE_ID_NXT_ENERGY_METER:
             return 200;
-        // Default delay for other sensors and modes:
+        // Default timeout for other sensors and modes:
         default:
             return 0;
     }
 }
 
-static pbio_error_t get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
+// Start a mode switch without waiting for it to take effect
+static pbio_error_t set_mode(pbdevice_t *pbdev, uint8_t mode) {
 
-    // The NXT Color Sensor is a special case, so deal with it accordingly
-    if (pbdev->type_id == PBIO_IODEV_TYPE_ID_NXT_COLOR_SENSOR) {
-        return nxtcolor_get_values_at_mode(pbdev->port, mode, values);
+    if (mode >= PBIO_IODEV_MAX_NUM_MODES) {
+        return PBIO_ERROR_INVALID_ARG;
+    }
+
+    // Nothing to do if already in this mode, except for sensors/modes that
+    // require setting it every time to trigger a new measurement.
+    if (pbdev->mode == mode && (pbdev->mode_switch_pending ||
+                                pbdev->type_id != PBIO_IODEV_TYPE_ID_EV3_ULTRASONIC_SENSOR ||
+                                mode < PBIO_IODEV_MODE_EV3_ULTRASONIC_SENSOR__SI_CM)) {
+        return PBIO_SUCCESS;
     }
 
     pbio_error_t err;
-    // Set the mode if not already set
-    if (pbdev->mode != mode || (
-        // and also if this sensor/mode requires setting it every time:
-        pbdev->type_id == PBIO_IODEV_TYPE_ID_EV3_ULTRASONIC_SENSOR && mode >= PBIO_IODEV_MODE_EV3_ULTRASONIC_SENSOR__SI_CM
-        )) {
-        err = lego_sensor_set_mode(pbdev->sensor, mode);
+    uint32_t timeout = get_mode_switch_timeout(pbdev->type_id, mode);
+
+    // Save the data in the current mode so we can tell when it changes
+    if (timeout > 0) {
+        uint8_t *data;
+        err = lego_sensor_get_bin_data(pbdev->sensor, &data);
         if (err != PBIO_SUCCESS) {
             return err;
         }
-        // Set the new mode and corresponding data info
-        pbdev->mode = mode;
-        err = lego_sensor_get_info(pbdev->sensor, &pbdev->data_len, &pbdev->data_type);
+        memcpy(pbdev->mode_switch_data, data, sizeof(pbdev->mode_switch_data));
+    }
+
+    err = lego_sensor_set_mode(pbdev->sensor, mode);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    pbdev->mode = mode;
+
+    // The data info of a mode does not change, so only read it from sysfs
+    // the first time. This saves a lot of file I/O on sensors that need the
+    // mode to be set for every measurement, like the ultrasonic SI modes.
+    if (!(pbdev->info_cached & (1 << mode))) {
+        err = lego_sensor_get_info(pbdev->sensor, &pbdev->data_len[mode], &pbdev->data_type[mode]);
         if (err != PBIO_SUCCESS) {
             return err;
         }
+        pbdev->info_cached |= 1 << mode;
+    }
 
-        // Give some time for the mode to take effect and discard stale data
-        uint32_t delay = get_mode_switch_delay(pbdev->type_id, mode);
-        if (delay > 0) {
-            mp_hal_delay_ms(delay);
-        }
+    pbdev->mode_switch_time = mp_hal_ticks_ms();
+    pbdev->mode_switch_pending = timeout > 0;
+    return PBIO_SUCCESS;
+}
+
+// Check whether the sensor has produced fresh data since the last mode switch
+static pbio_error_t is_ready(pbdevice_t *pbdev, bool *ready) {
+
+    *ready = true;
+
+    if (!pbdev->mode_switch_pending) {
+        return PBIO_SUCCESS;
     }
 
-    // Read raw data from device
-    uint8_t *data;
+    // Give up waiting for a change once the mode-specific timeout expires
+    if (mp_hal_ticks_ms() - pbdev->mode_switch_time >= get_mode_switch_timeout(pbdev->type_id, pbdev->mode)) {
+        pbdev->mode_switch_pending = false;
+        return PBIO_SUCCESS;
+    }
 
-    err = lego_sensor_get_bin_data(pbdev->sensor, &data);
+    // The sensor must echo the new mode before its data can be used
+    uint8_t mode;
+    pbio_error_t err = lego_sensor_get_mode(pbdev->sensor, &mode);
     if (err != PBIO_SUCCESS) {
         return err;
     }
 
-    for (uint8_t i = 0; i < pbdev->data_len; i++) {
-        switch (pbdev->data_type) {
+    // Data that differs from the data in the old mode is fresh
+    if (mode == pbdev->mode) {
+        uint8_t *data;
+        err = lego_sensor_get_bin_data(pbdev->sensor, &data);
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+        if (memcmp(data, pbdev->mode_switch_data, sizeof(pbdev->mode_switch_data))) {
+            pbdev->mode_switch_pending = false;
+            return PBIO_SUCCESS;
+        }
+    }
+
+    *ready = false;
+    return PBIO_SUCCESS;
+}
+
+// Convert raw data of the given mode to values
+static pbio_error_t decode_values(pbdevice_t *pbdev, uint8_t mode, uint8_t *data, int32_t *values) {
+
+    for (uint8_t i = 0; i < pbdev->data_len[mode]; i++) {
+        switch (pbdev->data_type[mode]) {
             case LEGO_SENSOR_DATA_TYPE_UINT8:
                 values[i] = *((uint8_t *)(data + i * 1));
                 break;
@@ -184,6 +320,189 @@ static pbio_error_t get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values)
     return PBIO_SUCCESS;
 }
 
+// Get the schedule entry for a mode, or NULL if the mode is not scheduled
+static sched_entry_t *get_sched_entry(pbdevice_t *pbdev, uint8_t mode) {
+    for (uint8_t i = 0; i < pbdev->num_sched; i++) {
+        if (pbdev->sched[i].schedule.mode == mode) {
+            return &pbdev->sched[i];
+        }
+    }
+    return NULL;
+}
+
+// Whether the latest sample of a scheduled mode can be returned instead of
+// reading the mode now. Samples are not refreshed while the program holds the
+// device or when the background process falls behind, so old ones are not used.
+static bool sched_is_fresh(pbdevice_t *pbdev, sched_entry_t *entry, uint32_t now) {
+    if (!entry->active || !entry->valid) {
+        return false;
+    }
+    uint32_t max_age = entry->schedule.period;
+    if (now - pbdev->hold_time >= PBDEVICE_SCHED_HOLD_MS) {
+        max_age *= PBDEVICE_SCHED_MAX_AGE_PERIODS;
+    }
+    return now - entry->time <= max_age;
+}
+
+// Stop sampling modes that are no longer read
+static void sched_update(pbdevice_t *pbdev, uint32_t now) {
+    for (uint8_t i = 0; i < pbdev->num_sched; i++) {
+        sched_entry_t *entry = &pbdev->sched[i];
+        if (entry->active && now - entry->read_time >= PBDEVICE_SCHED_TIMEOUT_MS) {
+            entry->active = false;
+            entry->valid = false;
+        }
+    }
+}
+
+// Get the next active mode after the current one that is due for a sample,
+// so that all modes that are being read take turns.
+static sched_entry_t *sched_next(pbdevice_t *pbdev, uint32_t now) {
+    for (uint8_t i = 1; i <= pbdev->num_sched; i++) {
+        uint8_t index = (pbdev->sched_index + i) % pbdev->num_sched;
+        sched_entry_t *entry = &pbdev->sched[index];
+        if (entry->active && (!entry->valid || now - entry->time >= entry->schedule.period)) {
+            pbdev->sched_index = index;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Take the next step in sampling the scheduled modes of a device
+static void sched_poll(pbdevice_t *pbdev) {
+    uint32_t now = mp_hal_ticks_ms();
+    pbio_error_t err;
+
+    // Leave the device alone while the program uses it directly
+    if (now - pbdev->hold_time < PBDEVICE_SCHED_HOLD_MS) {
+        return;
+    }
+
+    // Switch to the next mode that is due
+    if (!pbdev->sched_pending) {
+        sched_update(pbdev, now);
+        if (!sched_next(pbdev, now)) {
+            return;
+        }
+        pbdev->sched_pending = true;
+        err = set_mode(pbdev, pbdev->sched[pbdev->sched_index].schedule.mode);
+        if (err != PBIO_SUCCESS) {
+            goto error;
+        }
+    }
+
+    bool ready;
+    err = is_ready(pbdev, &ready);
+    if (err != PBIO_SUCCESS) {
+        goto error;
+    }
+    if (!ready) {
+        return;
+    }
+
+    uint8_t *data;
+    err = lego_sensor_get_bin_data(pbdev->sensor, &data);
+    if (err != PBIO_SUCCESS) {
+        goto error;
+    }
+
+    sched_entry_t *entry = &pbdev->sched[pbdev->sched_index];
+    memcpy(entry->data, data, sizeof(entry->data));
+    entry->time = now;
+    entry->valid = true;
+    pbdev->sched_pending = false;
+    return;
+
+error:
+    // The next read of this mode is done directly and raises the error
+    pbdev->sched[pbdev->sched_index].active = false;
+    pbdev->sched[pbdev->sched_index].valid = false;
+    pbdev->sched_pending = false;
+}
+
+// Samples the scheduled modes of all devices in the background
+PROCESS_THREAD(pbdevice_sched_process, ev, data) {
+    static struct etimer timer;
+
+    PROCESS_BEGIN();
+
+    etimer_set(&timer, clock_from_msec(PBDEVICE_SCHED_POLL_MS));
+
+    while (true) {
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER && etimer_expired(&timer));
+        etimer_reset(&timer);
+
+        for (uint8_t i = 0; i < PBIO_ARRAY_SIZE(iodevices); i++) {
+            if (iodevices[i].num_sched > 0) {
+                sched_poll(&iodevices[i]);
+            }
+        }
+    }
+
+    PROCESS_END();
+}
+
+static pbio_error_t get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
+
+    // The NXT Color Sensor is a special case, so deal with it accordingly
+    if (pbdev->type_id == PBIO_IODEV_TYPE_ID_NXT_COLOR_SENSOR) {
+        return nxtcolor_get_values_at_mode(pbdev->port, mode, values);
+    }
+
+    pbio_error_t err;
+    uint8_t *data;
+
+    // Modes that are being sampled in the background are read right away
+    uint32_t now = mp_hal_ticks_ms();
+    sched_entry_t *entry = get_sched_entry(pbdev, mode);
+    if (entry && entry->active) {
+        entry->read_time = now;
+    }
+    if (entry && sched_is_fresh(pbdev, entry, now)) {
+        return decode_values(pbdev, mode, entry->data, values);
+    }
+
+    // Otherwise read the mode now, and take over from the background process
+    // if it was busy with another mode.
+    pbdev->hold_time = mp_hal_ticks_ms();
+    pbdev->sched_pending = false;
+
+    // Set the mode if not already set
+    err = set_mode(pbdev, mode);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    // Wait for fresh data in the new mode
+    bool ready;
+    err = is_ready(pbdev, &ready);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    if (!ready) {
+        return PBIO_ERROR_AGAIN;
+    }
+
+    // Read raw data from device
+    err = lego_sensor_get_bin_data(pbdev->sensor, &data);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    // Keep sampling a scheduled mode in the background from now on. Since
+    // the read is done, the background process may carry on right away.
+    if (entry) {
+        memcpy(entry->data, data, sizeof(entry->data));
+        entry->time = entry->read_time = mp_hal_ticks_ms();
+        entry->active = true;
+        entry->valid = true;
+        pbdev->hold_time = entry->time - PBDEVICE_SCHED_HOLD_MS;
+    }
+
+    return decode_values(pbdev, mode, data, values);
+}
+
 pbdevice_t *pbdevice_get_device(pbio_port_t port, pbio_iodev_type_id_t valid_id) {
     pbdevice_t *pbdev = NULL;
     pbio_error_t err;
@@ -214,6 +533,40 @@ void pbdevice_get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
     pb_assert(err);
 }
 
+void pbdevice_set_mode(pbdevice_t *pbdev, uint8_t mode) {
+    if (pbdev->type_id == PBIO_IODEV_TYPE_ID_NXT_COLOR_SENSOR) {
+        pb_assert(PBIO_ERROR_NOT_SUPPORTED);
+    }
+    pbdev->hold_time = mp_hal_ticks_ms();
+    pbdev->sched_pending = false;
+    pb_assert(set_mode(pbdev, mode));
+}
+
+bool pbdevice_is_ready(pbdevice_t *pbdev) {
+    bool ready;
+    pbdev->hold_time = mp_hal_ticks_ms();
+    pb_assert(is_ready(pbdev, &ready));
+    return ready;
+}
+
+void pbdevice_set_schedule(pbdevice_t *pbdev, const pbdevice_schedule_t *schedule, uint8_t num_modes) {
+    if (num_modes > PBDEVICE_MAX_SCHEDULED_MODES) {
+        pb_assert(PBIO_ERROR_INVALID_ARG);
+    }
+    for (uint8_t i = 0; i < num_modes; i++) {
+        pbdev->sched[i].schedule = schedule[i];
+        pbdev->sched[i].active = false;
+        pbdev->sched[i].valid = false;
+    }
+    pbdev->num_sched = num_modes;
+    pbdev->sched_index = 0;
+    pbdev->sched_pending = false;
+
+    if (!process_is_running(&pbdevice_sched_process)) {
+        process_start(&pbdevice_sched_process, NULL);
+    }
+}
+
 void pbdevice_set_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values, uint8_t num_values) {
     pb_assert(PBIO_ERROR_NOT_SUPPORTED);
 }
@@ -226,7 +579,7 @@ void pbdevice_get_info(pbdevice_t *pbdev, pbio_port_t *port, pbio_iodev_type_id_
     *port = pbdev->port;
     *id = pbdev->type_id;
     *mode = pbdev->mode;
-    *num_values = pbdev->data_len;
+    *num_values = pbdev->data_len[pbdev->mode];
 }
 
 int8_t pbdevice_get_mode_id_from_str(pbdevice_t *pbdev, const char *mode_str) {
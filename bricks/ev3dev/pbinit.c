@@ -23,6 +23,7 @@
 #include "py/mpthread.h"
 
 #include "pbinit.h"
+#include "pbpcm.h"
 
 // Flag that indicates whether we are busy stopping the thread
 static volatile bool stopping_thread = false;
@@ -110,4 +111,5 @@ void pybricks_unhandled_exception() {
     _pbio_motorpoll_reset_all();
     extern void _pb_ev3dev_speaker_beep_off();
     _pb_ev3dev_speaker_beep_off();
+    pb_pcm_stop_all();
 }
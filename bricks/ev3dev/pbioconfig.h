@@ -8,3 +8,5 @@
 #define PBIO_CONFIG_SERIAL                  (1)
 
 #define PBIO_CONFIG_TACHO                   (1)
+
+#define PBIO_CONFIG_STATS                   (1)
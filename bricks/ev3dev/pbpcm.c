@@ -0,0 +1,504 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <alsa/asoundlib.h>
+
+#include <pbio/error.h>
+
+#include "pbpcm.h"
+
+#define PB_PCM_DEVICE "default"
+
+// Frames that are mixed and written at once (about 12 ms)
+#define PB_PCM_PERIOD (256)
+
+// Requested ALSA buffer length. This is the delay between mixing a sound and
+// hearing it, so it sets how fast new sounds start.
+#define PB_PCM_LATENCY_US (50000)
+
+#define WAVE_FORMAT_PCM (1)
+
+struct _pb_pcm_sound_t {
+    pb_pcm_sound_t *next;
+    // Resolved file path, or a key chosen by the caller for rendered sounds
+    char *key;
+    int16_t *samples;
+    size_t frames;
+    bool rendered;
+    // A sound file is only used while it has the same size and time of last
+    // modification. Otherwise it is stale and removed once it stops playing.
+    off_t file_size;
+    struct timespec file_mtime;
+    bool stale;
+    uint32_t last_used;
+};
+
+typedef struct {
+    const pb_pcm_sound_t *sound;
+    size_t pos;
+    // Zero if this voice is not playing
+    uint32_t id;
+} pb_pcm_voice_t;
+
+// Cache of decoded sounds. This is only used from the MicroPython thread.
+static pb_pcm_sound_t *cache;
+static size_t cache_size;
+static uint32_t use_count;
+
+// The voices are shared with the mixer thread, so they are protected by lock.
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t voice_started = PTHREAD_COND_INITIALIZER;
+static pb_pcm_voice_t voices[PB_PCM_VOICES];
+static uint32_t last_id;
+
+static snd_pcm_t *pcm;
+static pthread_t mixer_thread;
+
+static uint16_t get_u16(const uint8_t *buf) {
+    return buf[0] | buf[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *buf) {
+    return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+// Gets one frame as a 16-bit mono sample, averaging all channels
+static int32_t get_frame(const uint8_t *data, size_t frame, uint16_t channels, uint16_t bits) {
+    int32_t sum = 0;
+
+    if (bits == 8) {
+        data += frame * channels;
+        for (uint16_t c = 0; c < channels; c++) {
+            sum += (data[c] - 128) << 8;
+        }
+    } else {
+        data += frame * channels * 2;
+        for (uint16_t c = 0; c < channels; c++) {
+            sum += (int16_t)get_u16(data + c * 2);
+        }
+    }
+
+    return sum / channels;
+}
+
+// Decodes PCM WAV data, converting it to mono at PB_PCM_RATE
+static pbio_error_t decode_wav(const uint8_t *data, size_t size, pb_pcm_sound_t *sound) {
+
+    if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+        return PBIO_ERROR_NOT_SUPPORTED;
+    }
+
+    const uint8_t *fmt = NULL;
+    const uint8_t *samples = NULL;
+    size_t samples_size = 0;
+
+    for (size_t pos = 12; pos + 8 <= size;) {
+        size_t chunk_size = get_u32(data + pos + 4);
+        const uint8_t *chunk = data + pos + 8;
+
+        // Streamed files (e.g. from a pipe) don't know their own size, so
+        // just take what we have.
+        if (chunk_size > size - pos - 8) {
+            chunk_size = size - pos - 8;
+        }
+
+        if (memcmp(data + pos, "fmt ", 4) == 0 && chunk_size >= 16) {
+            fmt = chunk;
+        } else if (memcmp(data + pos, "data", 4) == 0) {
+            samples = chunk;
+            samples_size = chunk_size;
+        }
+
+        // Chunks are padded to an even size
+        pos += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    if (!fmt || !samples) {
+        return PBIO_ERROR_NOT_SUPPORTED;
+    }
+
+    uint16_t format = get_u16(fmt);
+    uint16_t channels = get_u16(fmt + 2);
+    uint32_t rate = get_u32(fmt + 4);
+    uint16_t bits = get_u16(fmt + 14);
+
+    if (format != WAVE_FORMAT_PCM || channels == 0 || rate == 0 || (bits != 8 && bits != 16)) {
+        return PBIO_ERROR_NOT_SUPPORTED;
+    }
+
+    size_t in_frames = samples_size / (channels * bits / 8);
+
+    // Resample by linear interpolation. Positions in the input are 16.16
+    // fixed point.
+    uint64_t step = ((uint64_t)rate << 16) / PB_PCM_RATE;
+    if (step == 0) {
+        return PBIO_ERROR_NOT_SUPPORTED;
+    }
+    size_t out_frames = in_frames ? (((uint64_t)(in_frames - 1) << 16) / step + 1) : 0;
+
+    // Allocate at least one sample so that we don't depend on malloc(0)
+    sound->samples = malloc((out_frames ? out_frames : 1) * sizeof(int16_t));
+    if (!sound->samples) {
+        return PBIO_ERROR_FAILED;
+    }
+    sound->frames = out_frames;
+
+    for (size_t i = 0; i < out_frames; i++) {
+        uint64_t t = i * step;
+        size_t n = t >> 16;
+        int64_t frac = t & 0xFFFF;
+        int32_t a = get_frame(samples, n, channels, bits);
+        int32_t b = n + 1 < in_frames ? get_frame(samples, n + 1, channels, bits) : a;
+        sound->samples[i] = a + (((b - a) * frac) >> 16);
+    }
+
+    return PBIO_SUCCESS;
+}
+
+static pb_pcm_sound_t *cache_find(const char *key, bool rendered) {
+    for (pb_pcm_sound_t *s = cache; s; s = s->next) {
+        if (s->rendered == rendered && !s->stale && strcmp(s->key, key) == 0) {
+            s->last_used = ++use_count;
+            return s;
+        }
+    }
+    return NULL;
+}
+
+static bool is_sound_playing(const pb_pcm_sound_t *sound) {
+    bool playing = false;
+
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < PB_PCM_VOICES; i++) {
+        if (voices[i].id && voices[i].sound == sound) {
+            playing = true;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+
+    return playing;
+}
+
+// Removes stale sounds, and the least recently used sounds until the rest
+// fits in the budget. Sounds that are playing are kept, and so is the given one.
+static void cache_trim(const pb_pcm_sound_t *keep) {
+    for (;;) {
+        pb_pcm_sound_t **victim = NULL;
+        for (pb_pcm_sound_t **s = &cache; *s; s = &(*s)->next) {
+            if (*s == keep || is_sound_playing(*s)) {
+                continue;
+            }
+            if ((*s)->stale) {
+                victim = s;
+                break;
+            }
+            if (cache_size > PB_PCM_CACHE_BUDGET &&
+                (!victim || use_count - (*s)->last_used > use_count - (*victim)->last_used)) {
+                victim = s;
+            }
+        }
+        if (!victim) {
+            return;
+        }
+
+        pb_pcm_sound_t *removed = *victim;
+        *victim = removed->next;
+        cache_size -= removed->frames * sizeof(int16_t);
+        free(removed->samples);
+        free(removed->key);
+        free(removed);
+    }
+}
+
+static pbio_error_t cache_add(const char *key, const uint8_t *data, size_t size, const struct stat *st, pb_pcm_sound_t **sound) {
+
+    pb_pcm_sound_t *s = calloc(1, sizeof(*s));
+    if (!s) {
+        return PBIO_ERROR_FAILED;
+    }
+
+    pbio_error_t err = decode_wav(data, size, s);
+    if (err != PBIO_SUCCESS) {
+        free(s);
+        return err;
+    }
+
+    s->key = strdup(key);
+    if (!s->key) {
+        free(s->samples);
+        free(s);
+        return PBIO_ERROR_FAILED;
+    }
+
+    s->rendered = !st;
+    if (st) {
+        s->file_size = st->st_size;
+        s->file_mtime = st->st_mtim;
+    }
+    s->last_used = ++use_count;
+    s->next = cache;
+    cache = s;
+
+    // Make room for the new sound, which is the most recently used
+    cache_size += s->frames * sizeof(int16_t);
+    cache_trim(s);
+
+    *sound = s;
+
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pb_pcm_load(const char *path, pb_pcm_sound_t **sound) {
+
+    // Files are cached by their resolved path, so that all names of a file
+    // share one entry. If the file does not exist, opening it below fails.
+    char *key = realpath(path, NULL);
+    if (!key) {
+        key = strdup(path);
+        if (!key) {
+            return PBIO_ERROR_FAILED;
+        }
+    }
+
+    struct stat st;
+    if (stat(key, &st) != 0) {
+        memset(&st, 0, sizeof(st));
+    }
+
+    *sound = cache_find(key, false);
+    if (*sound) {
+        if ((*sound)->file_size == st.st_size && (*sound)->file_mtime.tv_sec == st.st_mtim.tv_sec &&
+            (*sound)->file_mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            free(key);
+            return PBIO_SUCCESS;
+        }
+        // The file has changed, so it is loaded again
+        (*sound)->stale = true;
+        *sound = NULL;
+        cache_trim(NULL);
+    }
+
+    FILE *f = fopen(key, "rb");
+    if (!f) {
+        int saved = errno;
+        free(key);
+        errno = saved;
+        return PBIO_ERROR_IO;
+    }
+
+    uint8_t *data = NULL;
+    long size = -1;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        size = ftell(f);
+    }
+    if (size >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+        data = malloc(size ? size : 1);
+    }
+    if (!data || fread(data, 1, size, f) != (size_t)size) {
+        int saved = ferror(f) ? errno : EIO;
+        free(data);
+        fclose(f);
+        free(key);
+        errno = saved;
+        return PBIO_ERROR_IO;
+    }
+    fclose(f);
+
+    pbio_error_t err = cache_add(key, data, size, &st, sound);
+    free(data);
+    free(key);
+
+    return err;
+}
+
+bool pb_pcm_find_rendered(const char *key, pb_pcm_sound_t **sound) {
+    *sound = cache_find(key, true);
+    return *sound != NULL;
+}
+
+pbio_error_t pb_pcm_add_rendered(const char *key, const uint8_t *data, size_t size, pb_pcm_sound_t **sound) {
+    return cache_add(key, data, size, NULL, sound);
+}
+
+static bool any_voice_playing(void) {
+    for (int i = 0; i < PB_PCM_VOICES; i++) {
+        if (voices[i].id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Mixes all voices and writes them to the sound device, or sleeps while
+// there is nothing to play.
+static void *mixer(void *arg) {
+    int32_t mix[PB_PCM_PERIOD];
+    int16_t buf[PB_PCM_PERIOD];
+
+    pthread_mutex_lock(&lock);
+
+    for (;;) {
+        if (!any_voice_playing()) {
+            // Let the device play what is left, then wait for the next sound.
+            // The device has to be prepared again after draining.
+            pthread_mutex_unlock(&lock);
+            snd_pcm_drain(pcm);
+            snd_pcm_prepare(pcm);
+            pthread_mutex_lock(&lock);
+
+            while (!any_voice_playing()) {
+                pthread_cond_wait(&voice_started, &lock);
+            }
+        }
+
+        memset(mix, 0, sizeof(mix));
+
+        for (int i = 0; i < PB_PCM_VOICES; i++) {
+            pb_pcm_voice_t *voice = &voices[i];
+            if (!voice->id) {
+                continue;
+            }
+            size_t n = voice->sound->frames - voice->pos;
+            if (n > PB_PCM_PERIOD) {
+                n = PB_PCM_PERIOD;
+            }
+            const int16_t *samples = voice->sound->samples + voice->pos;
+            for (size_t j = 0; j < n; j++) {
+                mix[j] += samples[j];
+            }
+            voice->pos += n;
+            if (voice->pos == voice->sound->frames) {
+                voice->id = 0;
+            }
+        }
+
+        pthread_mutex_unlock(&lock);
+
+        for (int j = 0; j < PB_PCM_PERIOD; j++) {
+            buf[j] = mix[j] > INT16_MAX ? INT16_MAX : mix[j] < INT16_MIN ? INT16_MIN : mix[j];
+        }
+
+        // This blocks until there is room in the device buffer
+        snd_pcm_sframes_t ret = snd_pcm_writei(pcm, buf, PB_PCM_PERIOD);
+        if (ret < 0) {
+            snd_pcm_recover(pcm, ret, 1);
+        }
+
+        pthread_mutex_lock(&lock);
+    }
+
+    return NULL;
+}
+
+// Opens the sound device and starts the mixer on first use
+static pbio_error_t pb_pcm_open(void) {
+    if (pcm) {
+        return PBIO_SUCCESS;
+    }
+
+    if (snd_pcm_open(&pcm, PB_PCM_DEVICE, SND_PCM_STREAM_PLAYBACK, 0) < 0) {
+        pcm = NULL;
+        return PBIO_ERROR_NO_DEV;
+    }
+
+    if (snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16, SND_PCM_ACCESS_RW_INTERLEAVED,
+        1, PB_PCM_RATE, 1, PB_PCM_LATENCY_US) < 0) {
+        snd_pcm_close(pcm);
+        pcm = NULL;
+        return PBIO_ERROR_NO_DEV;
+    }
+
+    if (pthread_create(&mixer_thread, NULL, mixer, NULL) != 0) {
+        snd_pcm_close(pcm);
+        pcm = NULL;
+        return PBIO_ERROR_FAILED;
+    }
+
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pb_pcm_play(pb_pcm_sound_t *sound, uint32_t *id) {
+
+    pbio_error_t err = pb_pcm_open();
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    // Use a free voice, or else the one that was started first
+    pb_pcm_voice_t *voice = &voices[0];
+    for (int i = 0; i < PB_PCM_VOICES; i++) {
+        if (!voices[i].id) {
+            voice = &voices[i];
+            break;
+        }
+        if (last_id - voices[i].id > last_id - voice->id) {
+            voice = &voices[i];
+        }
+    }
+
+    // Id 0 means not playing, so skip it when wrapping around
+    if (++last_id == 0) {
+        last_id = 1;
+    }
+
+    voice->sound = sound;
+    voice->pos = 0;
+    voice->id = sound->frames ? last_id : 0;
+    *id = voice->id;
+
+    pthread_cond_signal(&voice_started);
+    pthread_mutex_unlock(&lock);
+
+    return PBIO_SUCCESS;
+}
+
+bool pb_pcm_is_playing(uint32_t id) {
+    bool playing = false;
+
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < PB_PCM_VOICES; i++) {
+        if (id && voices[i].id == id) {
+            playing = true;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+
+    return playing;
+}
+
+bool pb_pcm_is_busy(void) {
+    pthread_mutex_lock(&lock);
+    bool busy = any_voice_playing();
+    pthread_mutex_unlock(&lock);
+
+    return busy;
+}
+
+void pb_pcm_stop(uint32_t id) {
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < PB_PCM_VOICES; i++) {
+        if (id && voices[i].id == id) {
+            voices[i].id = 0;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void pb_pcm_stop_all(void) {
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < PB_PCM_VOICES; i++) {
+        voices[i].id = 0;
+    }
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+// In-process PCM sound playback using ALSA.
+//
+// Sound files are decoded once into a cache of 16-bit mono samples at
+// PB_PCM_RATE, and decoded again when they change. Sounds that are rendered
+// in memory, such as speech, are kept in the same cache, which has a memory
+// budget. A background thread mixes up to
+// PB_PCM_VOICES sounds at a time and writes them to the sound device, so
+// playback starts without delay and sounds may overlap.
+
+#ifndef _PBPCM_H_
+#define _PBPCM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pbio/error.h>
+
+// Sample rate of decoded sounds and of the mixer
+#define PB_PCM_RATE (22050)
+
+// Maximum number of sounds that play at the same time
+#define PB_PCM_VOICES (4)
+
+// Memory for cached sounds, in bytes. This is about 45 seconds of sound.
+#define PB_PCM_CACHE_BUDGET (2 * 1024 * 1024)
+
+typedef struct _pb_pcm_sound_t pb_pcm_sound_t;
+
+// Gets a sound file from the cache, decoding it first if needed. Returns
+// PBIO_ERROR_IO with errno set if the file can't be read, or
+// PBIO_ERROR_NOT_SUPPORTED if it is not a PCM WAV file. The least recently
+// used sounds are removed to stay within PB_PCM_CACHE_BUDGET, so the sound is
+// only valid until the next call to this function or pb_pcm_add_rendered().
+pbio_error_t pb_pcm_load(const char *path, pb_pcm_sound_t **sound);
+
+// Finds a sound that was rendered in memory, such as synthesized speech.
+bool pb_pcm_find_rendered(const char *key, pb_pcm_sound_t **sound);
+
+// Decodes rendered WAV data and adds it to the cache. Like pb_pcm_load(), the
+// sound is only valid until the next call to either function.
+pbio_error_t pb_pcm_add_rendered(const char *key, const uint8_t *data, size_t size, pb_pcm_sound_t **sound);
+
+// Starts playing a sound. The id can be used to check if it is still playing.
+// If all voices are busy, the one that was started first is replaced.
+pbio_error_t pb_pcm_play(pb_pcm_sound_t *sound, uint32_t *id);
+
+bool pb_pcm_is_playing(uint32_t id);
+
+// Checks if any sound is playing
+bool pb_pcm_is_busy(void);
+
+void pb_pcm_stop(uint32_t id);
+
+void pb_pcm_stop_all(void);
+
+#endif /* _PBPCM_H_ */
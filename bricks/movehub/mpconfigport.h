@@ -22,5 +22,6 @@
 #define PYBRICKS_STM32_OPT_COMPILER     (0)
 #define PYBRICKS_STM32_OPT_FLOAT        (0)
 #define PYBRICKS_STM32_OPT_TERSE_ERR    (1)
+#define PYBRICKS_STM32_OPT_PROGRAM_CACHE (0) // would take from the 8K heap
 
 #include "../stm32/configport.h"
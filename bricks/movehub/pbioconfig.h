@@ -9,6 +9,7 @@
 
 #define PBIO_CONFIG_UARTDEV                 (1)
 #define PBIO_CONFIG_UARTDEV_NUM_DEV         (2)
+#define PBIO_CONFIG_UARTDEV_MAX_BAUD_RATE   (460800)
 
 #define PBIO_CONFIG_ENABLE_DEINIT           (0)
 #define PBIO_CONFIG_ENABLE_SYS              (1)
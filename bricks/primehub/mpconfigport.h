@@ -22,5 +22,6 @@
 #define PYBRICKS_STM32_OPT_COMPILER     (1)
 #define PYBRICKS_STM32_OPT_FLOAT        (1)
 #define PYBRICKS_STM32_OPT_TERSE_ERR    (0)
+#define PYBRICKS_STM32_OPT_PROGRAM_CACHE (1)
 
 #include "../stm32/configport.h"
@@ -10,6 +10,11 @@
 #define PBIO_CONFIG_UARTDEV                 (1)
 #define PBIO_CONFIG_UARTDEV_NUM_DEV         (5)
 // #define PBIO_CONFIG_UARTDEV_NUM_DEV         (6)
+#define PBIO_CONFIG_UARTDEV_MAX_BAUD_RATE   (460800)
 
 #define PBIO_CONFIG_ENABLE_DEINIT           (1)
 #define PBIO_CONFIG_ENABLE_SYS              (1)
+
+#define PBIO_CONFIG_STATS                   (1)
+
+#define PBIO_CONFIG_TRACE                   (1)
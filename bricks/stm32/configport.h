@@ -197,15 +197,20 @@ static inline mp_uint_t disable_irq(void) {
         pbio_do_one_event(); \
     } while (0);
 
-#define MICROPY_EVENT_POLL_HOOK \
+// Runs pending events, then sleeps until an interrupt occurs, the next pbio
+// background task is due or timeout (in milliseconds) has passed.
+#define PYBRICKS_EVENT_POLL_HOOK_TIMEOUT(timeout) \
     do { \
         extern void mp_handle_pending(bool); \
         mp_handle_pending(true); \
         extern int pbio_do_one_event(void); \
         while (pbio_do_one_event()) { } \
-        __WFI(); \
+        extern void pbio_idle(uint32_t); \
+        pbio_idle(timeout); \
     } while (0);
 
+#define MICROPY_EVENT_POLL_HOOK PYBRICKS_EVENT_POLL_HOOK_TIMEOUT(UINT32_MAX)
+
 // We need to provide a declaration/definition of alloca()
 #include <alloca.h>
 
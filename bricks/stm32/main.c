@@ -33,6 +33,26 @@ static char heap[PYBRICKS_HEAP_KB * 1024];
 // TODO: need to verify that loaded code can never be bigger that .mpy file.
 #define MPY_MAX_BYTES (PYBRICKS_HEAP_KB * 1024 / 2)
 
+// Defined in linker script
+extern uint32_t _pb_user_mpy_size;
+extern uint8_t _pb_user_mpy_data;
+
+#if PYBRICKS_STM32_OPT_PROGRAM_CACHE
+// The last downloaded program is kept at the start of the heap, below the
+// memory managed by the garbage collector, so that it survives a soft reset.
+static uint32_t cache_len;
+static uint32_t cache_hash;
+static bool cache_compressed;
+#endif
+
+static void heap_init(void) {
+    #if PYBRICKS_STM32_OPT_PROGRAM_CACHE
+    gc_init(heap + cache_len, heap + sizeof(heap));
+    #elif MICROPY_ENABLE_GC
+    gc_init(heap, heap + sizeof(heap));
+    #endif
+}
+
 static pbio_error_t wait_for_button_release() {
     pbio_error_t err;
     pbio_button_flags_t btn = PBIO_BUTTON_CENTER;
@@ -46,6 +66,30 @@ static pbio_error_t wait_for_button_release() {
     return PBIO_SUCCESS;
 }
 
+// Returns PBIO_ERROR_CANCELED if the button was pressed (and released) to
+// cancel waiting for data from an IDE
+static pbio_error_t check_button_cancel(void) {
+    pbio_error_t err;
+    pbio_button_flags_t btn;
+
+    // Check if button is pressed
+    err = pbio_button_is_pressed(&btn);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    if (btn & PBIO_BUTTON_CENTER) {
+        // If so, wait for release
+        err = wait_for_button_release();
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+        // Cancel waiting for message
+        return PBIO_ERROR_CANCELED;
+    }
+
+    return PBIO_SUCCESS;
+}
+
 // Wait for data from an IDE
 static pbio_error_t get_message(uint8_t *buf, uint32_t rx_len, int32_t time_out) {
     // Maximum time between two bytes/chunks
@@ -61,24 +105,13 @@ static pbio_error_t get_message(uint8_t *buf, uint32_t rx_len, int32_t time_out)
     uint32_t rx_count = 0;
     mp_uint_t time_start = mp_hal_ticks_ms();
     mp_uint_t time_now;
-    pbio_button_flags_t btn;
 
     while (true) {
 
-        // Check if button is pressed
-        err = pbio_button_is_pressed(&btn);
+        err = check_button_cancel();
         if (err != PBIO_SUCCESS) {
             return err;
         }
-        if (btn & PBIO_BUTTON_CENTER) {
-            // If so, wait for release
-            err = wait_for_button_release();
-            if (err != PBIO_SUCCESS) {
-                return err;
-            }
-            // Cancel waiting for message
-            return PBIO_ERROR_CANCELED;
-        }
 
         // Current time
         time_now = mp_hal_ticks_ms();
@@ -126,9 +159,473 @@ static pbio_error_t get_message(uint8_t *buf, uint32_t rx_len, int32_t time_out)
     }
 }
 
-// Defined in linker script
-extern uint32_t _pb_user_mpy_size;
-extern uint8_t _pb_user_mpy_data;
+// Version 2 of the download protocol. Instead of acknowledging every 100
+// bytes with an XOR checksum, the program is sent in chunks of a negotiated
+// size. Each chunk has its own CRC32 and is acknowledged on its own, so the
+// IDE can keep a window of several chunks in flight and only needs to send
+// the chunks again that were lost or corrupted.
+//
+// IDE sends: DOWNLOAD_V2_LEN in place of the program length, as in version 1
+// IDE sends: program length (u32), chunk size (u16), window (u8), flags (u8),
+//            [program hash (u32)], CRC32 of the preceding header bytes (u32).
+//            If flags has DOWNLOAD_FLAG_COMPRESSED, the program is compressed
+//            and the length is the compressed length. The program hash is
+//            only there if flags has DOWNLOAD_FLAG_HASH. It is the CRC32 of
+//            the uncompressed program.
+// Hub sends: ACK, chunk size (u16), window (u8) - or just NAK if the length
+//            or chunk size is not allowed - or CACHED, chunk size (u16),
+//            window (u8) if the hub already has a program with this hash, in
+//            which case it runs that program and nothing else is sent
+// IDE sends: chunk index (u16), chunk data, CRC32 of index and data (u32)
+// Hub sends: ACK, chunk index (u16) for each good chunk or NAK, chunk index
+//            (u16) for a chunk that should be sent again
+//
+// All numbers are little-endian. All chunks have the negotiated size, except
+// for the last one, which has the remaining bytes. Hubs that do not have this
+// protocol reply ">>>> ERROR" to DOWNLOAD_V2_LEN, so IDEs can fall back to
+// version 1.
+
+// 'PBv2' as bytes
+#define DOWNLOAD_V2_LEN 0x32764250
+
+#define DOWNLOAD_ACK 0x06
+#define DOWNLOAD_NAK 0x15
+#define DOWNLOAD_CACHED 0x11
+
+#define DOWNLOAD_FLAG_COMPRESSED 0x01
+#define DOWNLOAD_FLAG_HASH 0x02
+
+// Limits for the negotiated chunk size and number of unacknowledged chunks
+#define DOWNLOAD_MIN_CHUNK_SIZE 16
+#define DOWNLOAD_MAX_CHUNK_SIZE 512
+#define DOWNLOAD_MAX_WINDOW 8
+
+// Size of chunk index and CRC32 around the chunk data
+#define DOWNLOAD_FRAME_OVERHEAD 6
+
+// Time without data after which a lost chunk is requested again
+#define DOWNLOAD_RETRY_TIME 500
+// Number of consecutive retries before giving up
+#define DOWNLOAD_MAX_RETRIES 5
+// Time without data after which a bad frame is considered to have ended
+#define DOWNLOAD_RESYNC_TIME 20
+
+// CRC32 as used by zlib (polynomial 0xEDB88320), computed per nibble to keep
+// the table small
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t size) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+
+    crc = ~crc;
+    for (uint32_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0x0f] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0f] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+static uint16_t get_u16(const uint8_t *data) {
+    return data[0] | data[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *data) {
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+// Reads exactly size bytes from stdin, with at most time_out ms between bytes
+static pbio_error_t read_bytes(uint8_t *buf, uint32_t size, int32_t time_out) {
+    pbio_error_t err;
+    uint32_t rx_count = 0;
+    uint32_t count;
+    mp_uint_t time_start = mp_hal_ticks_ms();
+
+    while (true) {
+        err = check_button_cancel();
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+
+        // Get as many bytes as are available
+        if (pbsys_stdin_read(&buf[rx_count], size - rx_count, &count) == PBIO_SUCCESS) {
+            time_start = mp_hal_ticks_ms();
+            rx_count += count;
+            if (rx_count == size) {
+                return PBIO_SUCCESS;
+            }
+        }
+
+        if (mp_hal_ticks_ms() - time_start > time_out) {
+            return PBIO_ERROR_TIMEDOUT;
+        }
+
+        MICROPY_EVENT_POLL_HOOK
+    }
+}
+
+static pbio_error_t write_bytes(const uint8_t *data, uint32_t size) {
+    pbio_error_t err;
+    uint32_t count;
+
+    while (size) {
+        while ((err = pbsys_stdout_write(data, size, &count)) == PBIO_ERROR_AGAIN) {
+            MICROPY_EVENT_POLL_HOOK
+        }
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+        data += count;
+        size -= count;
+    }
+
+    return PBIO_SUCCESS;
+}
+
+static pbio_error_t send_chunk_reply(uint8_t reply, uint16_t index) {
+    uint8_t msg[] = { reply, index & 0xff, index >> 8 };
+    return write_bytes(msg, sizeof(msg));
+}
+
+#define CHUNK_RECEIVED(received, index) ((received)[(index) / 8] & (1 << ((index) % 8)))
+
+// Asks for all chunks the IDE may have sent but that we don't have yet
+static pbio_error_t request_missing_chunks(const uint8_t *received, uint32_t first_missing, uint32_t num_chunks, uint32_t window) {
+    for (uint32_t index = first_missing; index < num_chunks && index < first_missing + window; index++) {
+        if (!CHUNK_RECEIVED(received, index)) {
+            pbio_error_t err = send_chunk_reply(DOWNLOAD_NAK, index);
+            if (err != PBIO_SUCCESS) {
+                return err;
+            }
+        }
+    }
+    return PBIO_SUCCESS;
+}
+
+// Discards data until the IDE stops sending, so the next byte is the start
+// of a new chunk
+static pbio_error_t resync(void) {
+    uint8_t c;
+    mp_uint_t time_start = mp_hal_ticks_ms();
+
+    while (mp_hal_ticks_ms() - time_start <= DOWNLOAD_RESYNC_TIME) {
+        pbio_error_t err = check_button_cancel();
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+        if (pbsys_stdin_get_char(&c) == PBIO_SUCCESS) {
+            time_start = mp_hal_ticks_ms();
+        }
+        MICROPY_EVENT_POLL_HOOK
+    }
+
+    return PBIO_SUCCESS;
+}
+
+// Gets all chunks of the program after the parameters have been agreed on
+static pbio_error_t get_chunks(uint8_t *buf, uint32_t len, uint32_t chunk_size, uint32_t window) {
+    pbio_error_t err = PBIO_SUCCESS;
+    uint32_t num_chunks = (len + chunk_size - 1) / chunk_size;
+    uint32_t num_received = 0;
+    uint32_t first_missing = 0;
+    uint32_t retries = 0;
+
+    // Bit for each chunk that has been received, so duplicates are ignored
+    uint8_t *received = m_malloc0((num_chunks + 7) / 8);
+    // Index, data and CRC32 of the chunk being received
+    uint8_t *frame = m_malloc(chunk_size + DOWNLOAD_FRAME_OVERHEAD);
+
+    while (num_received < num_chunks) {
+        err = read_bytes(frame, 2, DOWNLOAD_RETRY_TIME);
+        if (err == PBIO_ERROR_TIMEDOUT && ++retries <= DOWNLOAD_MAX_RETRIES) {
+            // Chunks were lost, so ask for them again
+            err = request_missing_chunks(received, first_missing, num_chunks, window);
+            if (err != PBIO_SUCCESS) {
+                break;
+            }
+            continue;
+        }
+        if (err != PBIO_SUCCESS) {
+            break;
+        }
+
+        uint32_t index = get_u16(frame);
+        uint32_t size = index + 1 == num_chunks ? len - index * chunk_size : chunk_size;
+
+        if (index < num_chunks) {
+            err = read_bytes(&frame[2], size + 4, DOWNLOAD_RETRY_TIME);
+            if (err != PBIO_SUCCESS && err != PBIO_ERROR_TIMEDOUT) {
+                break;
+            }
+        }
+
+        if (index >= num_chunks || err == PBIO_ERROR_TIMEDOUT ||
+            crc32_update(0, frame, size + 2) != get_u32(&frame[size + 2])) {
+            // Bytes were lost or corrupted, so we can't trust the index
+            err = resync();
+            if (err != PBIO_SUCCESS) {
+                break;
+            }
+            err = request_missing_chunks(received, first_missing, num_chunks, window);
+            if (err != PBIO_SUCCESS) {
+                break;
+            }
+            continue;
+        }
+
+        retries = 0;
+
+        if (!CHUNK_RECEIVED(received, index)) {
+            memcpy(&buf[index * chunk_size], &frame[2], size);
+            received[index / 8] |= 1 << (index % 8);
+            num_received++;
+
+            while (first_missing < num_chunks && CHUNK_RECEIVED(received, first_missing)) {
+                first_missing++;
+            }
+        }
+
+        err = send_chunk_reply(DOWNLOAD_ACK, index);
+        if (err != PBIO_SUCCESS) {
+            break;
+        }
+    }
+
+    m_free(frame);
+    m_free(received);
+
+    return err;
+}
+
+// Drops the cached program to make room for a new one
+static void program_cache_clear(void) {
+    #if PYBRICKS_STM32_OPT_PROGRAM_CACHE
+    if (cache_len) {
+        cache_len = 0;
+        heap_init();
+    }
+    #endif
+}
+
+// Moves a freshly downloaded program from the heap into the cache. Nothing
+// else may be allocated on the heap at this point.
+static uint8_t *program_cache_store(uint8_t *buf, uint32_t len, uint32_t hash, bool compressed) {
+    #if PYBRICKS_STM32_OPT_PROGRAM_CACHE
+    memmove(heap, buf, len);
+    cache_len = len;
+    cache_hash = hash;
+    cache_compressed = compressed;
+    heap_init();
+    return (uint8_t *)heap;
+    #else
+    return buf;
+    #endif
+}
+
+// Looks for a program with the given hash that is already on the hub
+static uint32_t program_cache_find(uint32_t hash, uint8_t **buf, bool *compressed) {
+    static uint32_t flash_hash;
+    static bool flash_hash_valid;
+
+    #if PYBRICKS_STM32_OPT_PROGRAM_CACHE
+    if (cache_len && cache_hash == hash) {
+        *buf = (uint8_t *)heap;
+        *compressed = cache_compressed;
+        return cache_len;
+    }
+    #endif
+
+    // The program in flash does not change, so it only needs to be hashed once
+    if (!flash_hash_valid) {
+        flash_hash = crc32_update(0, &_pb_user_mpy_data, _pb_user_mpy_size);
+        flash_hash_valid = true;
+    }
+    if (_pb_user_mpy_size && flash_hash == hash) {
+        *buf = &_pb_user_mpy_data;
+        *compressed = false;
+        return _pb_user_mpy_size;
+    }
+
+    return 0;
+}
+
+// Get user program using version 2 of the download protocol
+static uint32_t get_user_program_v2(uint8_t **buf, uint32_t *free_len, bool *compressed) {
+    pbio_error_t err;
+    uint8_t header[16];
+    uint32_t header_len = 8;
+
+    err = read_bytes(header, header_len, DOWNLOAD_RETRY_TIME);
+    if (err != PBIO_SUCCESS) {
+        return 0;
+    }
+
+    // The program hash is optional
+    uint8_t flags = header[7];
+    if (flags & DOWNLOAD_FLAG_HASH) {
+        header_len += 4;
+    }
+    err = read_bytes(&header[8], header_len - 4, DOWNLOAD_RETRY_TIME);
+    if (err != PBIO_SUCCESS) {
+        return 0;
+    }
+
+    uint32_t len = get_u32(&header[0]);
+    uint32_t chunk_size = MIN(get_u16(&header[4]), DOWNLOAD_MAX_CHUNK_SIZE);
+    uint8_t window = MIN(header[6], DOWNLOAD_MAX_WINDOW);
+    uint32_t hash = get_u32(&header[8]);
+    *compressed = flags & DOWNLOAD_FLAG_COMPRESSED;
+
+    if (crc32_update(0, header, header_len) != get_u32(&header[header_len]) || len == 0 ||
+        len > MPY_MAX_BYTES || chunk_size < DOWNLOAD_MIN_CHUNK_SIZE || window == 0) {
+        write_bytes((const uint8_t[]) { DOWNLOAD_NAK }, 1);
+        return 0;
+    }
+
+    // Run the program right away if we already have it
+    if (flags & DOWNLOAD_FLAG_HASH) {
+        uint32_t cached_len = program_cache_find(hash, buf, compressed);
+        if (cached_len) {
+            uint8_t reply[] = { DOWNLOAD_CACHED, chunk_size & 0xff, chunk_size >> 8, window };
+            write_bytes(reply, sizeof(reply));
+            return cached_len;
+        }
+    }
+
+    // Make room for the new program
+    program_cache_clear();
+
+    // Allocate buffer for MPY file with known length
+    *buf = m_malloc(len);
+
+    // Tell the IDE what we agreed on
+    uint8_t reply[] = { DOWNLOAD_ACK, chunk_size & 0xff, chunk_size >> 8, window };
+    err = write_bytes(reply, sizeof(reply));
+    if (err == PBIO_SUCCESS) {
+        err = get_chunks(*buf, len, chunk_size, window);
+    }
+
+    // Did not receive a whole program, so discard it
+    if (err != PBIO_SUCCESS) {
+        m_free(*buf);
+        *buf = NULL;
+        return 0;
+    }
+
+    // Keep the program so it does not have to be downloaded again next time
+    if (flags & DOWNLOAD_FLAG_HASH) {
+        *buf = program_cache_store(*buf, len, hash, *compressed);
+        return len;
+    }
+
+    *free_len = len;
+    return len;
+}
+
+// Compressed programs use the LZ4 block format, except that match offsets are
+// limited to LZ4_WINDOW_SIZE (see tools/mpybytes.py). This way, the program
+// can be decompressed while it is being loaded, keeping only the last few
+// bytes instead of the whole decompressed .mpy file in memory.
+
+#define LZ4_WINDOW_SIZE 1024 // must be a power of 2!
+
+typedef struct _lz4_reader_t {
+    const uint8_t *src;
+    const uint8_t *src_end;
+    uint8_t *buf;
+    uint32_t free_len;
+    uint8_t *window;
+    uint32_t pos;
+    uint32_t literals;
+    uint32_t match;
+    uint32_t offset;
+    uint8_t token;
+} lz4_reader_t;
+
+// Lengths of 15 are continued in the following bytes
+static uint32_t lz4_read_length(lz4_reader_t *r, uint32_t len) {
+    if (len == 15) {
+        uint8_t b;
+        do {
+            b = r->src < r->src_end ? *r->src++ : 0;
+            len += b;
+        } while (b == 255);
+    }
+    return len;
+}
+
+// Starts the match that follows the literals, unless this was the last
+// sequence, which has literals only
+static void lz4_begin_match(lz4_reader_t *r) {
+    if (r->src_end - r->src < 2) {
+        r->src = r->src_end;
+        return;
+    }
+    r->offset = r->src[0] | r->src[1] << 8;
+    r->src += 2;
+    r->match = lz4_read_length(r, r->token & 0x0f) + 4;
+    if (r->offset == 0 || r->offset > MIN(r->pos, LZ4_WINDOW_SIZE)) {
+        // corrupt data, so stop here and let the loader raise an error
+        r->match = 0;
+        r->src = r->src_end;
+    }
+}
+
+static mp_uint_t lz4_readbyte(void *data) {
+    lz4_reader_t *r = data;
+    uint8_t c;
+
+    // Get the next sequence
+    while (!r->literals && !r->match) {
+        if (r->src >= r->src_end) {
+            return MP_READER_EOF;
+        }
+        r->token = *r->src++;
+        r->literals = lz4_read_length(r, r->token >> 4);
+        if (!r->literals) {
+            lz4_begin_match(r);
+        }
+    }
+
+    if (r->literals) {
+        if (r->src >= r->src_end) {
+            r->literals = 0;
+            return MP_READER_EOF;
+        }
+        c = *r->src++;
+        r->window[r->pos++ & (LZ4_WINDOW_SIZE - 1)] = c;
+        if (!--r->literals) {
+            lz4_begin_match(r);
+        }
+    } else {
+        c = r->window[(r->pos - r->offset) & (LZ4_WINDOW_SIZE - 1)];
+        r->window[r->pos++ & (LZ4_WINDOW_SIZE - 1)] = c;
+        r->match--;
+    }
+
+    return c;
+}
+
+static void lz4_close(void *data) {
+    lz4_reader_t *r = data;
+    m_del(uint8_t, r->window, LZ4_WINDOW_SIZE);
+    if (r->free_len > 0) {
+        m_del(uint8_t, r->buf, r->free_len);
+    }
+    m_del_obj(lz4_reader_t, r);
+}
+
+static void mp_reader_new_lz4(mp_reader_t *reader, uint8_t *buf, uint32_t len, uint32_t free_len) {
+    lz4_reader_t *r = m_new0(lz4_reader_t, 1);
+    r->src = buf;
+    r->src_end = buf + len;
+    r->buf = buf;
+    r->free_len = free_len;
+    r->window = m_new(uint8_t, LZ4_WINDOW_SIZE);
+    reader->data = r;
+    reader->readbyte = lz4_readbyte;
+    reader->close = lz4_close;
+}
 
 // If user says they want to send an MPY file this big (19 MB),
 // assume they want REPL. This lets users get REPL by pressing
@@ -136,10 +633,11 @@ extern uint8_t _pb_user_mpy_data;
 static const uint32_t REPL_LEN = 0x20202020;
 
 // Get user program via serial/bluetooth
-static uint32_t get_user_program(uint8_t **buf, uint32_t *free_len) {
+static uint32_t get_user_program(uint8_t **buf, uint32_t *free_len, bool *compressed) {
     pbio_error_t err;
     *buf = NULL;
     *free_len = 0;
+    *compressed = false;
 
     // flush any buffered bytes from stdin
     uint8_t c;
@@ -152,6 +650,7 @@ static uint32_t get_user_program(uint8_t **buf, uint32_t *free_len) {
 
     // If button was pressed, return code to run script in flash
     if (err == PBIO_ERROR_CANCELED) {
+        program_cache_clear();
         *buf = &_pb_user_mpy_data;
         return _pb_user_mpy_size;
     }
@@ -161,6 +660,14 @@ static uint32_t get_user_program(uint8_t **buf, uint32_t *free_len) {
         return 0;
     }
 
+    // IDE wants to use the faster protocol
+    if (len == DOWNLOAD_V2_LEN) {
+        return get_user_program_v2(buf, free_len, compressed);
+    }
+
+    // Anything else replaces the cached program
+    program_cache_clear();
+
     // Four spaces triggers REPL
     if (len == REPL_LEN) {
         return REPL_LEN;
@@ -190,7 +697,7 @@ static uint32_t get_user_program(uint8_t **buf, uint32_t *free_len) {
     return len;
 }
 
-static void run_user_program(uint32_t len, uint8_t *buf, uint32_t free_len) {
+static void run_user_program(uint32_t len, uint8_t *buf, uint32_t free_len, bool compressed) {
 
     if (len == 0) {
         mp_print_str(&mp_plat_print, ">>>> ERROR\n");
@@ -221,7 +728,11 @@ static void run_user_program(uint32_t len, uint8_t *buf, uint32_t free_len) {
     nlr_buf_t nlr;
     if (nlr_push(&nlr) == 0) {
         mp_reader_t reader;
-        mp_reader_new_mem(&reader, buf, len, free_len);
+        if (compressed) {
+            mp_reader_new_lz4(&reader, buf, len, free_len);
+        } else {
+            mp_reader_new_mem(&reader, buf, len, free_len);
+        }
         mp_raw_code_t *raw_code = mp_raw_code_load(&reader);
         mp_obj_t module_fun = mp_make_function_from_raw_code(raw_code, MP_OBJ_NULL, MP_OBJ_NULL);
         mp_call_function_0(module_fun);
@@ -265,9 +776,7 @@ int main(int argc, char **argv) {
 
 soft_reset:
 
-    #if MICROPY_ENABLE_GC
-    gc_init(heap, heap + sizeof(heap));
-    #endif
+    heap_init();
 
     wait_for_button_release();
 
@@ -277,7 +786,8 @@ soft_reset:
     // Receive an mpy-cross compiled Python script
     uint8_t *program;
     uint32_t free_len;
-    uint32_t len = get_user_program(&program, &free_len);
+    bool compressed;
+    uint32_t len = get_user_program(&program, &free_len, &compressed);
 
     // FIXME: The WEB IDE currently confuses last checksum byte(s) with the
     // status messaging sent when program begins. So for now, add a brief
@@ -289,7 +799,7 @@ soft_reset:
     mp_init();
 
     // Execute the user script
-    run_user_program(len, program, free_len);
+    run_user_program(len, program, free_len, compressed);
 
     // Uninitialize MicroPython and the system hardware
     mp_deinit();
@@ -1,12 +1,16 @@
 // SPDX-License-Identifier: MIT
 // Copyright (c) 2018-2020 The Pybricks Authors
 
+#include <stdbool.h>
 #include <string.h>
 
+#include <contiki.h>
+
 #include <pbdrv/ioport.h>
 #include <pbdrv/motor.h>
 
 #include <pbio/iodev.h>
+#include <pbio/util.h>
 
 #include "py/mphal.h"
 #include "py/runtime.h"
@@ -17,10 +21,81 @@
 #include "pberror.h"
 #include "pbdevice.h"
 
+// How often the background process checks on the scheduled modes
+#define PBDEVICE_SCHED_POLL_MS (5)
+
+typedef struct _sched_entry_t {
+    /**
+     * The requested mode and sampling period.
+     */
+    pbdevice_schedule_t schedule;
+    /**
+     * Whether the mode is being read, so that it is sampled in the background.
+     */
+    bool active;
+    /**
+     * Whether data holds a sample taken since the mode became active.
+     */
+    bool valid;
+    /**
+     * Time (ms) at which the sample was taken.
+     */
+    uint32_t time;
+    /**
+     * Time (ms) at which the mode was last read.
+     */
+    uint32_t read_time;
+    /**
+     * Most recent raw data in this mode.
+     */
+    uint8_t data[PBIO_IODEV_MAX_DATA_SIZE];
+} sched_entry_t;
+
 struct _pbdevice_t {
-    pbio_iodev_t iodev;
+    /**
+     * The I/O device currently attached to the port.
+     */
+    pbio_iodev_t *iodev;
+    /**
+     * Whether a mode switch was started but the first fresh sample in the new
+     * mode has not been received yet.
+     */
+    bool mode_switch_pending;
+    /**
+     * Scheduled modes and their most recent samples.
+     */
+    sched_entry_t sched[PBDEVICE_MAX_SCHEDULED_MODES];
+    /**
+     * Number of scheduled modes.
+     */
+    uint8_t num_sched;
+    /**
+     * Scheduled mode that is being sampled or was sampled last.
+     */
+    uint8_t sched_index;
+    /**
+     * Whether the pending mode switch was started by the background process.
+     */
+    bool sched_pending;
+    /**
+     * Modes of the pending combined mode started by the background process,
+     * or 0 if it is a single mode.
+     */
+    uint16_t sched_combo;
+    /**
+     * Modes that the device could not combine.
+     */
+    uint16_t combo_rejected;
+    /**
+     * Time (ms) at which the program last used the device directly.
+     */
+    uint32_t hold_time;
 };
 
+static pbdevice_t pbdevices[PBDRV_CONFIG_NUM_IO_PORT];
+
+PROCESS(pbdevice_sched_process, "pbdevice");
+
 static void wait(pbio_error_t (*end)(pbio_iodev_t *), void (*cancel)(pbio_iodev_t *), pbio_iodev_t *iodev) {
     nlr_buf_t nlr;
     pbio_error_t err;
@@ -40,37 +115,262 @@ static void wait(pbio_error_t (*end)(pbio_iodev_t *), void (*cancel)(pbio_iodev_
     }
 }
 
-
-// Get the required mode switch time delay for a given sensor type and/or mode
-static uint32_t get_mode_switch_delay(pbio_iodev_type_id_t id, uint8_t mode) {
-    switch (id) {
-        case PBIO_IODEV_TYPE_ID_SPIKE_COLOR_SENSOR:
-            return 30;
-        case PBIO_IODEV_TYPE_ID_SPIKE_ULTRASONIC_SENSOR:
-            return 50;
-        // Default delay for other sensors and modes:
-        default:
-            return 0;
+// Wait for a pending mode switch to complete, if any
+static void wait_mode_switch(pbdevice_t *pbdev) {
+    if (!pbdev->mode_switch_pending) {
+        return;
     }
+    pbdev->mode_switch_pending = false;
+    pbdev->sched_pending = false;
+    wait(pbio_iodev_set_mode_end, pbio_iodev_set_mode_cancel, pbdev->iodev);
 }
 
-static void set_mode(pbio_iodev_t *iodev, uint8_t new_mode) {
+void pbdevice_set_mode(pbdevice_t *pbdev, uint8_t new_mode) {
     pbio_error_t err;
 
-    if (iodev->mode == new_mode) {
+    // Keep the background process from switching modes for a while
+    pbdev->hold_time = mp_hal_ticks_ms();
+
+    // Finish the previous mode switch first, since there can only be one
+    // mode change message in flight.
+    wait_mode_switch(pbdev);
+
+    // Selecting a mode also ends a combined mode, if any
+    if (pbdev->iodev->mode == new_mode && !pbdev->iodev->combo_modes) {
         return;
     }
 
-    while ((err = pbio_iodev_set_mode_begin(iodev, new_mode)) == PBIO_ERROR_AGAIN) {
+    while ((err = pbio_iodev_set_mode_begin(pbdev->iodev, new_mode)) == PBIO_ERROR_AGAIN) {
         ;
     }
     pb_assert(err);
-    wait(pbio_iodev_set_mode_end, pbio_iodev_set_mode_cancel, iodev);
+    pbdev->mode_switch_pending = true;
+}
+
+bool pbdevice_is_ready(pbdevice_t *pbdev) {
+    pbdev->hold_time = mp_hal_ticks_ms();
+
+    if (!pbdev->mode_switch_pending) {
+        return true;
+    }
+
+    // The mode switch is complete once the device has sent fresh data in
+    // the new mode, so there is no need for a fixed delay.
+    pbio_error_t err = pbio_iodev_set_mode_end(pbdev->iodev);
+    if (err == PBIO_ERROR_AGAIN) {
+        return false;
+    }
+    pbdev->mode_switch_pending = false;
+    pbdev->sched_pending = false;
+    pb_assert(err);
+    return true;
+}
+
+static void set_mode(pbdevice_t *pbdev, uint8_t new_mode) {
+    pbdevice_set_mode(pbdev, new_mode);
+    wait_mode_switch(pbdev);
+}
+
+// Get the schedule entry for a mode, or NULL if the mode is not scheduled
+static sched_entry_t *get_sched_entry(pbdevice_t *pbdev, uint8_t mode) {
+    for (uint8_t i = 0; i < pbdev->num_sched; i++) {
+        if (pbdev->sched[i].schedule.mode == mode) {
+            return &pbdev->sched[i];
+        }
+    }
+    return NULL;
+}
+
+// Store a copy of the latest data in a schedule entry
+static void save_sample(sched_entry_t *entry, pbio_iodev_t *iodev) {
+    memcpy(entry->data, iodev->bin_data, sizeof(entry->data));
+    entry->time = mp_hal_ticks_ms();
+    entry->valid = true;
+}
+
+// Whether the latest sample of a scheduled mode can be returned instead of
+// reading the mode now. Samples are not refreshed while the program holds the
+// device or when the background process falls behind, so old ones are not used.
+static bool sched_is_fresh(pbdevice_t *pbdev, sched_entry_t *entry, uint32_t now) {
+    if (!entry->active || !entry->valid) {
+        return false;
+    }
+    uint32_t max_age = entry->schedule.period;
+    if (now - pbdev->hold_time >= PBDEVICE_SCHED_HOLD_MS) {
+        max_age *= PBDEVICE_SCHED_MAX_AGE_PERIODS;
+    }
+    return now - entry->time <= max_age;
+}
+
+// Stop sampling modes that are no longer read and get the modes that are
+static uint16_t sched_update(pbdevice_t *pbdev, uint32_t now) {
+    uint16_t active = 0;
+    for (uint8_t i = 0; i < pbdev->num_sched; i++) {
+        sched_entry_t *entry = &pbdev->sched[i];
+        if (entry->active && now - entry->read_time >= PBDEVICE_SCHED_TIMEOUT_MS) {
+            entry->active = false;
+            entry->valid = false;
+        }
+        if (entry->active) {
+            active |= 1 << entry->schedule.mode;
+        }
+    }
+    return active;
+}
 
-    // Give some time for the mode to take effect and discard stale data
-    uint32_t delay = get_mode_switch_delay(iodev->info->type_id, new_mode);
-    if (delay > 0) {
-        mp_hal_delay_ms(delay);
+// Get the next active mode after the current one that is due for a sample,
+// so that all modes that are being read take turns.
+static sched_entry_t *sched_next(pbdevice_t *pbdev, uint32_t now) {
+    for (uint8_t i = 1; i <= pbdev->num_sched; i++) {
+        uint8_t index = (pbdev->sched_index + i) % pbdev->num_sched;
+        sched_entry_t *entry = &pbdev->sched[index];
+        if (entry->active && (!entry->valid || now - entry->time >= entry->schedule.period)) {
+            pbdev->sched_index = index;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Take the next step in sampling the scheduled modes of a device
+static void sched_poll(pbdevice_t *pbdev) {
+    pbio_iodev_t *iodev = pbdev->iodev;
+    uint32_t now = mp_hal_ticks_ms();
+    pbio_error_t err;
+
+    // Leave the device alone while the program uses it directly
+    if (now - pbdev->hold_time < PBDEVICE_SCHED_HOLD_MS ||
+        (pbdev->mode_switch_pending && !pbdev->sched_pending)) {
+        return;
+    }
+
+    // Finish the mode switch that was started below
+    if (pbdev->sched_pending) {
+        err = pbio_iodev_set_mode_end(iodev);
+        if (err == PBIO_ERROR_AGAIN) {
+            return;
+        }
+        pbdev->mode_switch_pending = false;
+        pbdev->sched_pending = false;
+        if (pbdev->sched_combo) {
+            // Take turns instead if the modes could not be combined
+            if (err != PBIO_SUCCESS) {
+                pbdev->combo_rejected = pbdev->sched_combo;
+            }
+            return;
+        }
+        sched_entry_t *entry = &pbdev->sched[pbdev->sched_index];
+        if (err != PBIO_SUCCESS) {
+            // The next read of this mode is done directly and raises the error
+            entry->active = false;
+            entry->valid = false;
+            return;
+        }
+        save_sample(entry, iodev);
+        return;
+    }
+
+    // If the device can stream all modes that are being read at once, do
+    // that instead of switching between them.
+    uint16_t active = sched_update(pbdev, now);
+    if (__builtin_popcount(active) >= 2 && active != pbdev->combo_rejected) {
+        if (iodev->combo_modes == active) {
+            return;
+        }
+        uint8_t modes[PBDEVICE_MAX_SCHEDULED_MODES];
+        uint8_t num_modes = 0;
+        for (uint8_t i = 0; i < pbdev->num_sched; i++) {
+            if (pbdev->sched[i].active) {
+                modes[num_modes++] = pbdev->sched[i].schedule.mode;
+            }
+        }
+        err = pbio_iodev_set_mode_combo_begin(iodev, modes, num_modes);
+        if (err == PBIO_ERROR_AGAIN) {
+            return;
+        }
+        if (err == PBIO_SUCCESS) {
+            pbdev->mode_switch_pending = true;
+            pbdev->sched_pending = true;
+            pbdev->sched_combo = active;
+            return;
+        }
+        pbdev->combo_rejected = active;
+    }
+
+    // Otherwise switch to the next mode that is due
+    sched_entry_t *entry = sched_next(pbdev, now);
+    if (!entry) {
+        return;
+    }
+
+    // Devices keep sending data in the current mode, so no switch is needed
+    if (iodev->mode == entry->schedule.mode && !iodev->combo_modes) {
+        save_sample(entry, iodev);
+        return;
+    }
+
+    err = pbio_iodev_set_mode_begin(iodev, entry->schedule.mode);
+    if (err == PBIO_ERROR_AGAIN) {
+        return;
+    }
+    if (err != PBIO_SUCCESS) {
+        entry->active = false;
+        entry->valid = false;
+        return;
+    }
+    pbdev->mode_switch_pending = true;
+    pbdev->sched_pending = true;
+    pbdev->sched_combo = 0;
+}
+
+// Samples the scheduled modes of all devices in the background
+PROCESS_THREAD(pbdevice_sched_process, ev, data) {
+    static struct etimer timer;
+
+    PROCESS_BEGIN();
+
+    etimer_set(&timer, clock_from_msec(PBDEVICE_SCHED_POLL_MS));
+
+    while (true) {
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER && etimer_expired(&timer));
+        etimer_reset(&timer);
+
+        for (uint8_t i = 0; i < PBIO_ARRAY_SIZE(pbdevices); i++) {
+            if (pbdevices[i].num_sched > 0) {
+                sched_poll(&pbdevices[i]);
+            }
+        }
+    }
+
+    PROCESS_END();
+}
+
+void pbdevice_set_schedule(pbdevice_t *pbdev, const pbdevice_schedule_t *schedule, uint8_t num_modes) {
+    if (num_modes > PBDEVICE_MAX_SCHEDULED_MODES) {
+        pb_assert(PBIO_ERROR_INVALID_ARG);
+    }
+    for (uint8_t i = 0; i < num_modes; i++) {
+        if (schedule[i].mode >= PBIO_IODEV_MAX_NUM_MODES) {
+            pb_assert(PBIO_ERROR_INVALID_ARG);
+        }
+    }
+
+    // Let a mode switch of the old schedule finish first
+    if (pbdev->sched_pending) {
+        wait_mode_switch(pbdev);
+    }
+
+    for (uint8_t i = 0; i < num_modes; i++) {
+        pbdev->sched[i].schedule = schedule[i];
+        pbdev->sched[i].active = false;
+        pbdev->sched[i].valid = false;
+    }
+    pbdev->num_sched = num_modes;
+    pbdev->sched_index = 0;
+    pbdev->combo_rejected = 0;
+
+    if (!process_is_running(&pbdevice_sched_process)) {
+        process_start(&pbdevice_sched_process, NULL);
     }
 }
 
@@ -92,21 +392,48 @@ pbdevice_t *pbdevice_get_device(pbio_port_t port, pbio_iodev_type_id_t valid_id)
 
     // Return pointer to device
     iodev->port = port;
-    return (pbdevice_t *)iodev;
+    pbdevice_t *pbdev = &pbdevices[port - PBDRV_CONFIG_FIRST_IO_PORT];
+    pbdev->iodev = iodev;
+    pbdev->mode_switch_pending = false;
+    pbdev->sched_pending = false;
+    pbdev->num_sched = 0;
+    return pbdev;
 }
 
 void pbdevice_get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
 
-    pbio_iodev_t *iodev = &pbdev->iodev;
+    pbio_iodev_t *iodev = pbdev->iodev;
 
     uint8_t *data;
     uint8_t len;
     pbio_iodev_data_type_t type;
 
-    set_mode(iodev, mode);
+    // Modes that are being sampled in the background are read right away.
+    // Modes in an active combined mode are always up to date.
+    uint32_t now = mp_hal_ticks_ms();
+    sched_entry_t *entry = get_sched_entry(pbdev, mode);
+    if (entry && entry->active) {
+        entry->read_time = now;
+    }
+    if (mode < PBIO_IODEV_MAX_NUM_MODES && (iodev->combo_modes & (1 << mode))) {
+        pb_assert(pbio_iodev_get_mode_data(iodev, mode, &data));
+    } else if (entry && sched_is_fresh(pbdev, entry, now)) {
+        data = entry->data;
+    } else {
+        // Otherwise read the mode now. A scheduled mode is sampled in the
+        // background from now on, and since the read is done, the background
+        // process may carry on right away.
+        set_mode(pbdev, mode);
+        pb_assert(pbio_iodev_get_data(iodev, &data));
+        if (entry) {
+            save_sample(entry, iodev);
+            entry->read_time = entry->time;
+            entry->active = true;
+            pbdev->hold_time = entry->time - PBDEVICE_SCHED_HOLD_MS;
+        }
+    }
 
-    pb_assert(pbio_iodev_get_data(iodev, &data));
-    pb_assert(pbio_iodev_get_data_format(iodev, iodev->mode, &len, &type));
+    pb_assert(pbio_iodev_get_data_format(iodev, mode, &len, &type));
 
     if (len == 0) {
         pb_assert(PBIO_ERROR_IO);
@@ -136,13 +463,13 @@ void pbdevice_get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values) {
 
 void pbdevice_set_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values, uint8_t num_values) {
 
-    pbio_iodev_t *iodev = &pbdev->iodev;
+    pbio_iodev_t *iodev = pbdev->iodev;
 
     uint8_t data[PBIO_IODEV_MAX_DATA_SIZE];
     uint8_t len;
     pbio_iodev_data_type_t type;
 
-    set_mode(iodev, mode);
+    set_mode(pbdev, mode);
 
     pb_assert(pbio_iodev_get_data_format(iodev, iodev->mode, &len, &type));
 
@@ -186,14 +513,14 @@ void pbdevice_set_power_supply(pbdevice_t *pbdev, int32_t duty) {
         duty = 100;
     }
     // Apply duty cycle in reverse to activate power
-    pb_assert(pbdrv_motor_set_duty_cycle(pbdev->iodev.port, -100 * duty));
+    pb_assert(pbdrv_motor_set_duty_cycle(pbdev->iodev->port, -100 * duty));
 }
 
 void pbdevice_get_info(pbdevice_t *pbdev, pbio_port_t *port, pbio_iodev_type_id_t *id, uint8_t *mode, uint8_t *num_values) {
-    *port = pbdev->iodev.port;
-    *id = pbdev->iodev.info->type_id;
-    *mode = pbdev->iodev.mode;
-    *num_values = pbdev->iodev.info->mode_info[*mode].num_values;
+    *port = pbdev->iodev->port;
+    *id = pbdev->iodev->info->type_id;
+    *mode = pbdev->iodev->mode;
+    *num_values = pbdev->iodev->info->mode_info[*mode].num_values;
 }
 
 int8_t pbdevice_get_mode_id_from_str(pbdevice_t *pbdev, const char *mode_str) {
@@ -204,7 +531,7 @@ int8_t pbdevice_get_mode_id_from_str(pbdevice_t *pbdev, const char *mode_str) {
 void pbdevice_color_light_on(pbdevice_t *pbdev, pbio_light_color_t color) {
     // Turn on the light through device specific mode
     uint8_t mode;
-    switch (pbdev->iodev.info->type_id) {
+    switch (pbdev->iodev->info->type_id) {
         case PBIO_IODEV_TYPE_ID_COLOR_DIST_SENSOR:
             switch (color) {
                 case PBIO_LIGHT_COLOR_GREEN:
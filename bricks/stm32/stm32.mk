@@ -78,9 +78,6 @@ endif
 ifeq ($(PB_LIB_BLE5STACK),1)
 INC += -I$(PBTOP)/lib/ble5stack/central
 endif
-ifeq ($(PB_USE_LSM6DS3TR_C),1)
-INC += -I$(PBTOP)/lib/lsm6ds3tr_c_STdC/driver
-endif
 INC += -I$(PBTOP)/extmod
 INC += -I$(PBTOP)/py
 INC += -I$(BUILD)
@@ -181,6 +178,7 @@ PYBRICKS_EXTMOD_SRC_C = $(addprefix extmod/,\
 PYBRICKS_PY_SRC_C = $(addprefix py/,\
 	pb_type_enum.c \
 	pberror.c \
+	pbkwarg.c \
 	pbobj.c \
 	)
 
@@ -268,11 +266,15 @@ PBIO_SRC_C = $(addprefix lib/pbio/,\
 	drv/battery/battery_adc.c \
 	drv/button/button_adc.c \
 	drv/button/button_gpio.c \
+	drv/clock/clock_stm32_tickless.c \
 	drv/counter/counter_core.c \
 	drv/counter/counter_stm32f0_gpio_quad_enc.c \
 	drv/gpio/gpio_stm32f0.c \
 	drv/gpio/gpio_stm32f4.c \
 	drv/gpio/gpio_stm32l4.c \
+	drv/i2c/i2c_stm32_hal.c \
+	drv/imu/imu_core.c \
+	drv/imu/imu_lsm6ds3tr_c.c \
 	drv/ioport/ioport_lpf2.c \
 	drv/uart/uart_stm32_hal.c \
 	drv/uart/uart_stm32f0.c \
@@ -280,6 +282,7 @@ PBIO_SRC_C = $(addprefix lib/pbio/,\
 	platform/$(PBIO_PLATFORM)/clock.c \
 	platform/$(PBIO_PLATFORM)/platform.c \
 	platform/$(PBIO_PLATFORM)/sys.c \
+	src/attitude.c \
 	src/control.c \
 	src/dcmotor.c \
 	src/drivebase.c \
@@ -291,17 +294,17 @@ PBIO_SRC_C = $(addprefix lib/pbio/,\
 	src/main.c \
 	src/math.c \
 	src/motorpoll.c \
+	src/ringbuf.c \
 	src/servo.c \
+	src/stats.c \
 	src/tacho.c \
+	src/trace.c \
 	src/trajectory_ext.c \
 	src/trajectory.c \
+	src/txbuf.c \
 	src/uartdev.c \
 	)
 
-# STM32 IMU Library
-
-LSM6DS3TR_C_SRC_C = lib/lsm6ds3tr_c_STdC/driver/lsm6ds3tr_c_reg.c
-
 # MicroPython math library
 
 SRC_LIBM = $(addprefix micropython/lib/libm/,\
@@ -345,9 +348,6 @@ endif
 ifeq ($(PB_USE_HAL),1)
 OBJ += $(addprefix $(BUILD)/, $(HAL_SRC_C:.c=.o))
 endif
-ifeq ($(PB_USE_LSM6DS3TR_C),1)
-OBJ += $(addprefix $(BUILD)/, $(LSM6DS3TR_C_SRC_C:.c=.o))
-endif
 OBJ += $(addprefix $(BUILD)/, $(CONTIKI_SRC_C:.c=.o))
 OBJ += $(addprefix $(BUILD)/, $(LIBFIXMATH_SRC_C:.c=.o))
 OBJ += $(addprefix $(BUILD)/, $(PBIO_SRC_C:.c=.o))
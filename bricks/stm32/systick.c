@@ -18,12 +18,13 @@ void mp_hal_delay_ms(mp_uint_t Delay) {
     if (__get_PRIMASK() == 0) {
         // IRQs enabled, so can use systick counter to do the delay
         uint32_t start = clock_time_ticks;
+        uint32_t elapsed;
         // Wraparound of tick is taken care of by 2's complement arithmetic.
-        while (clock_time_ticks - start < Delay) {
+        while ((elapsed = clock_time_ticks - start) < Delay) {
             // This macro will execute the necessary idle behaviour.  It may
-            // raise an exception, switch threads or enter sleep mode (waiting for
-            // (at least) the SysTick interrupt).
-            MICROPY_EVENT_POLL_HOOK
+            // raise an exception, switch threads or enter sleep mode until
+            // the remaining time has passed or an interrupt occurs.
+            PYBRICKS_EVENT_POLL_HOOK_TIMEOUT(Delay - elapsed)
         }
     } else {
         // IRQs disabled, so need to use a busy loop for the delay.
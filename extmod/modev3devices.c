@@ -81,6 +81,16 @@ STATIC mp_obj_t ev3devices_InfraredSensor_make_new(const mp_obj_type_t *type, si
 
     self->pbdev = pbdevice_get_device(port_num, PBIO_IODEV_TYPE_ID_EV3_IR_SENSOR);
 
+    // Sample the modes that are being read in turns in the background, so
+    // that reading distance and beacon alternately does not wait for a mode
+    // switch every time.
+    static const pbdevice_schedule_t schedule[] = {
+        { .mode = PBIO_IODEV_MODE_EV3_INFRARED_SENSOR__PROX, .period = 10 },
+        { .mode = PBIO_IODEV_MODE_EV3_INFRARED_SENSOR__SEEK, .period = 10 },
+        { .mode = PBIO_IODEV_MODE_EV3_INFRARED_SENSOR__REMOTE, .period = 10 },
+    };
+    pbdevice_set_schedule(self->pbdev, schedule, MP_ARRAY_SIZE(schedule));
+
     return MP_OBJ_FROM_PTR(self);
 }
 
@@ -261,6 +271,15 @@ STATIC mp_obj_t ev3devices_ColorSensor_make_new(const mp_obj_type_t *type, size_
 
     self->pbdev = pbdevice_get_device(port_num, PBIO_IODEV_TYPE_ID_EV3_COLOR_SENSOR);
 
+    // Sample the modes that are being read in turns in the background
+    static const pbdevice_schedule_t schedule[] = {
+        { .mode = PBIO_IODEV_MODE_EV3_COLOR_SENSOR__REFLECT, .period = 10 },
+        { .mode = PBIO_IODEV_MODE_EV3_COLOR_SENSOR__AMBIENT, .period = 10 },
+        { .mode = PBIO_IODEV_MODE_EV3_COLOR_SENSOR__COLOR, .period = 10 },
+        { .mode = PBIO_IODEV_MODE_EV3_COLOR_SENSOR__RGB_RAW, .period = 10 },
+    };
+    pbdevice_set_schedule(self->pbdev, schedule, MP_ARRAY_SIZE(schedule));
+
     return MP_OBJ_FROM_PTR(self);
 }
 
@@ -365,6 +384,14 @@ STATIC mp_obj_t ev3devices_UltrasonicSensor_make_new(const mp_obj_type_t *type,
 
     self->pbdev = pbdevice_get_device(port_num, PBIO_IODEV_TYPE_ID_EV3_ULTRASONIC_SENSOR);
 
+    // Sample the modes that are being read in turns in the background. The
+    // silent mode is not scheduled, since every sample would be a new ping.
+    static const pbdevice_schedule_t schedule[] = {
+        { .mode = PBIO_IODEV_MODE_EV3_ULTRASONIC_SENSOR__DIST_CM, .period = 10 },
+        { .mode = PBIO_IODEV_MODE_EV3_ULTRASONIC_SENSOR__LISTEN, .period = 10 },
+    };
+    pbdevice_set_schedule(self->pbdev, schedule, MP_ARRAY_SIZE(schedule));
+
     return MP_OBJ_FROM_PTR(self);
 }
 
@@ -13,158 +13,143 @@
 
 #if PYBRICKS_HUB_CPLUSHUB
 
-#include <lsm6ds3tr_c_reg.h>
-#include <stm32l4xx_hal.h>
-#include <stm32l4xx_ll_i2c.h>
+#include <fixmath.h>
+
+#include <pbdrv/imu.h>
+#include <pbio/attitude.h>
+
+#include "pberror.h"
+#include "pbkwarg.h"
+#include "pbobj.h"
+
+// The IMU is sampled in the background by the pbdrv IMU driver. accel() and
+// gyro() only return the most recent sample. Every sample also goes through
+// the attitude filter in pbio, which gives the angles and rates.
 
 typedef struct {
     mp_obj_base_t base;
-    stmdev_ctx_t ctx;
+    pbdrv_imu_info_t info;
 } mod_experimental_IMU_obj_t;
 
-STATIC I2C_HandleTypeDef hi2c;
+STATIC mp_obj_t mod_experimental_IMU_make_new(const mp_obj_type_t *otype, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    mod_experimental_IMU_obj_t *self = m_new_obj(mod_experimental_IMU_obj_t);
+
+    self->base.type = (mp_obj_type_t *)otype;
 
-void mod_experimental_IMU_handle_i2c_er_irq() {
-    HAL_I2C_ER_IRQHandler(&hi2c);
+    // wait for the driver to finish initializing the IMU
+    pbio_error_t err;
+    while ((err = pbdrv_imu_get_info(&self->info)) == PBIO_ERROR_AGAIN) {
+        MICROPY_EVENT_POLL_HOOK
+    }
+    pb_assert(err);
+
+    return MP_OBJ_FROM_PTR(self);
 }
 
-void mod_experimental_IMU_handle_i2c_ev_irq() {
-    HAL_I2C_EV_IRQHandler(&hi2c);
+STATIC void mod_experimental_IMU_get_latest(pbdrv_imu_sample_t *sample) {
+    pbio_error_t err;
+    while ((err = pbdrv_imu_get_latest(sample)) == PBIO_ERROR_AGAIN) {
+        MICROPY_EVENT_POLL_HOOK
+    }
+    pb_assert(err);
 }
 
-STATIC int32_t mod_experimental_IMU_write_reg(void *handle, uint8_t reg, uint8_t *data, uint16_t len) {
-    HAL_StatusTypeDef ret;
+STATIC mp_obj_t mod_experimental_IMU_accel(mp_obj_t self_in) {
+    mod_experimental_IMU_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    pbdrv_imu_sample_t sample;
+
+    mod_experimental_IMU_get_latest(&sample);
 
-    ret = HAL_I2C_Mem_Write(&hi2c, LSM6DS3TR_C_I2C_ADD_L, reg, I2C_MEMADD_SIZE_8BIT, data, len, 500);
+    mp_obj_t values[3];
+    for (int i = 0; i < 3; i++) {
+        values[i] = mp_obj_new_float_from_f(sample.accel[i] * (self->info.accel_scale / 1000000.0f));
+    }
 
-    return ret;
+    return mp_obj_new_tuple(3, values);
 }
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_experimental_IMU_accel_obj, mod_experimental_IMU_accel);
 
-STATIC int32_t mod_experimental_IMU_read_reg(void *handle, uint8_t reg, uint8_t *data, uint16_t len) {
-    HAL_StatusTypeDef ret;
+STATIC mp_obj_t mod_experimental_IMU_gyro(mp_obj_t self_in) {
+    mod_experimental_IMU_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    pbdrv_imu_sample_t sample;
 
-    ret = HAL_I2C_Mem_Read(&hi2c, LSM6DS3TR_C_I2C_ADD_L, reg, I2C_MEMADD_SIZE_8BIT, data, len, 500);
+    mod_experimental_IMU_get_latest(&sample);
 
-    return ret;
-}
+    mp_obj_t values[3];
+    for (int i = 0; i < 3; i++) {
+        values[i] = mp_obj_new_float_from_f(sample.gyro[i] * (self->info.gyro_scale / 1000.0f));
+    }
 
-STATIC mp_obj_t mod_experimental_IMU_make_new(const mp_obj_type_t *otype, size_t n_args, size_t n_kw, const mp_obj_t *args) {
-    mod_experimental_IMU_obj_t *self = m_new_obj(mod_experimental_IMU_obj_t);
+    return mp_obj_new_tuple(3, values);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_experimental_IMU_gyro_obj, mod_experimental_IMU_gyro);
 
-    self->base.type = (mp_obj_type_t *)otype;
-    self->ctx.write_reg = mod_experimental_IMU_write_reg;
-    self->ctx.read_reg = mod_experimental_IMU_read_reg;
-
-    if (hi2c.Instance == NULL) {
-        hi2c.Instance = I2C1;
-        // Clock is 5MHz, so these timing come out to 1 usec. When combined with
-        // internal delays, this is slightly slower than 400kHz
-        hi2c.Init.Timing = __LL_I2C_CONVERT_TIMINGS(0, 0, 0, 4, 4);
-        hi2c.Init.OwnAddress1 = 0;
-        hi2c.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
-        hi2c.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
-        hi2c.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
-        hi2c.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
-        HAL_StatusTypeDef ret = HAL_I2C_Init(&hi2c);
-        if (ret != HAL_OK) {
-            hi2c.Instance = NULL;
-            mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("failed to init I2C"));
-        }
+STATIC void mod_experimental_IMU_get_attitude(pbio_attitude_t *attitude) {
+    pbio_error_t err;
+    while ((err = pbio_attitude_get(attitude)) == PBIO_ERROR_AGAIN) {
+        MICROPY_EVENT_POLL_HOOK
     }
+    pb_assert(err);
+}
 
-    uint8_t id;
-    if (lsm6ds3tr_c_device_id_get(&self->ctx, &id) != 0) {
-        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("failed to get device id"));
-    }
+STATIC mp_obj_t mod_experimental_IMU_angles(mp_obj_t self_in) {
+    pbio_attitude_t attitude;
 
-    if (id != LSM6DS3TR_C_ID) {
-        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("incorrect device id"));
-    }
+    mod_experimental_IMU_get_attitude(&attitude);
 
-    // Init based on data polling example
-
-    /*
-     *  Restore default configuration
-     */
-    uint8_t rst;
-    lsm6ds3tr_c_reset_set(&self->ctx, PROPERTY_ENABLE);
-    do {
-        lsm6ds3tr_c_reset_get(&self->ctx, &rst);
-    } while (rst);
-    /*
-     *  Enable Block Data Update
-     */
-    lsm6ds3tr_c_block_data_update_set(&self->ctx, PROPERTY_ENABLE);
-    /*
-     * Set Output Data Rate
-     */
-    lsm6ds3tr_c_xl_data_rate_set(&self->ctx, LSM6DS3TR_C_XL_ODR_12Hz5);
-    lsm6ds3tr_c_gy_data_rate_set(&self->ctx, LSM6DS3TR_C_GY_ODR_12Hz5);
-    /*
-     * Set full scale
-     */
-    lsm6ds3tr_c_xl_full_scale_set(&self->ctx, LSM6DS3TR_C_2g);
-    lsm6ds3tr_c_gy_full_scale_set(&self->ctx, LSM6DS3TR_C_2000dps);
-
-    /*
-     * Configure filtering chain(No aux interface)
-     */
-    /* Accelerometer - analog filter */
-    lsm6ds3tr_c_xl_filter_analog_set(&self->ctx, LSM6DS3TR_C_XL_ANA_BW_400Hz);
-
-    /* Accelerometer - LPF1 path ( LPF2 not used )*/
-    // lsm6ds3tr_c_xl_lp1_bandwidth_set(&self->ctx, LSM6DS3TR_C_XL_LP1_ODR_DIV_4);
-
-    /* Accelerometer - LPF1 + LPF2 path */
-    lsm6ds3tr_c_xl_lp2_bandwidth_set(&self->ctx, LSM6DS3TR_C_XL_LOW_NOISE_LP_ODR_DIV_100);
-
-    /* Accelerometer - High Pass / Slope path */
-    // lsm6ds3tr_c_xl_reference_mode_set(&self->ctx, PROPERTY_DISABLE);
-    // lsm6ds3tr_c_xl_hp_bandwidth_set(&self->ctx, LSM6DS3TR_C_XL_HP_ODR_DIV_100);
-
-    /* Gyroscope - filtering chain */
-    lsm6ds3tr_c_gy_band_pass_set(&self->ctx, LSM6DS3TR_C_HP_260mHz_LP1_STRONG);
+    mp_obj_t values[3];
+    values[0] = mp_obj_new_float_from_f(fix16_to_float(attitude.roll));
+    values[1] = mp_obj_new_float_from_f(fix16_to_float(attitude.pitch));
+    values[2] = mp_obj_new_float_from_f(fix16_to_float(attitude.heading));
 
-    return MP_OBJ_FROM_PTR(self);
+    return mp_obj_new_tuple(3, values);
 }
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_experimental_IMU_angles_obj, mod_experimental_IMU_angles);
 
-STATIC mp_obj_t mod_experimental_IMU_accel(mp_obj_t self_in) {
-    mod_experimental_IMU_obj_t *self = MP_OBJ_TO_PTR(self_in);
-    int16_t data[3];
+STATIC mp_obj_t mod_experimental_IMU_rates(mp_obj_t self_in) {
+    pbio_attitude_t attitude;
 
-    if (lsm6ds3tr_c_acceleration_raw_get(&self->ctx, (uint8_t *)data) != 0) {
-        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("failed to read data"));
-    }
+    mod_experimental_IMU_get_attitude(&attitude);
 
     mp_obj_t values[3];
-    values[0] = mp_obj_new_float_from_f(lsm6ds3tr_c_from_fs2g_to_mg(data[0]) / 1000.0f);
-    values[1] = mp_obj_new_float_from_f(lsm6ds3tr_c_from_fs2g_to_mg(data[1]) / 1000.0f);
-    values[2] = mp_obj_new_float_from_f(lsm6ds3tr_c_from_fs2g_to_mg(data[2]) / 1000.0f);
+    for (int i = 0; i < 3; i++) {
+        values[i] = mp_obj_new_float_from_f(fix16_to_float(attitude.rate[i]));
+    }
 
     return mp_obj_new_tuple(3, values);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_experimental_IMU_accel_obj, mod_experimental_IMU_accel);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_experimental_IMU_rates_obj, mod_experimental_IMU_rates);
 
-STATIC mp_obj_t mod_experimental_IMU_gyro(mp_obj_t self_in) {
-    mod_experimental_IMU_obj_t *self = MP_OBJ_TO_PTR(self_in);
-    int16_t data[3];
+STATIC mp_obj_t mod_experimental_IMU_calibrated(mp_obj_t self_in) {
+    pbio_attitude_t attitude;
 
-    if (lsm6ds3tr_c_angular_rate_raw_get(&self->ctx, (uint8_t *)data) != 0) {
-        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("failed to read data"));
-    }
+    mod_experimental_IMU_get_attitude(&attitude);
 
-    mp_obj_t values[3];
-    values[0] = mp_obj_new_float_from_f(lsm6ds3tr_c_from_fs2000dps_to_mdps(data[0]) / 1000.0f);
-    values[1] = mp_obj_new_float_from_f(lsm6ds3tr_c_from_fs2000dps_to_mdps(data[1]) / 1000.0f);
-    values[2] = mp_obj_new_float_from_f(lsm6ds3tr_c_from_fs2000dps_to_mdps(data[2]) / 1000.0f);
+    return mp_obj_new_bool(attitude.calibrated);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_experimental_IMU_calibrated_obj, mod_experimental_IMU_calibrated);
 
-    return mp_obj_new_tuple(3, values);
+STATIC mp_obj_t mod_experimental_IMU_reset_heading(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD_SKIP_SELF(n_args, pos_args, kw_args,
+        PB_ARG_DEFAULT_INT(angle, 0));
+
+    // wait for the first sample, so the new heading is not overwritten
+    pbio_attitude_t attitude;
+    mod_experimental_IMU_get_attitude(&attitude);
+
+    pb_assert(pbio_attitude_reset_heading(pb_obj_get_fix16(angle)));
+
+    return mp_const_none;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_experimental_IMU_gyro_obj, mod_experimental_IMU_gyro);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_experimental_IMU_reset_heading_obj, 1, mod_experimental_IMU_reset_heading);
 
 STATIC const mp_rom_map_elem_t mod_experimental_IMU_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_accel), MP_ROM_PTR(&mod_experimental_IMU_accel_obj) },
     { MP_ROM_QSTR(MP_QSTR_gyro), MP_ROM_PTR(&mod_experimental_IMU_gyro_obj) },
+    { MP_ROM_QSTR(MP_QSTR_angles), MP_ROM_PTR(&mod_experimental_IMU_angles_obj) },
+    { MP_ROM_QSTR(MP_QSTR_rates), MP_ROM_PTR(&mod_experimental_IMU_rates_obj) },
+    { MP_ROM_QSTR(MP_QSTR_calibrated), MP_ROM_PTR(&mod_experimental_IMU_calibrated_obj) },
+    { MP_ROM_QSTR(MP_QSTR_reset_heading), MP_ROM_PTR(&mod_experimental_IMU_reset_heading_obj) },
 };
 STATIC MP_DEFINE_CONST_DICT(mod_experimental_IMU_locals_dict, mod_experimental_IMU_locals_dict_table);
 
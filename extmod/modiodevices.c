@@ -84,6 +84,58 @@ STATIC mp_obj_t iodevices_LUMPDevice_read(size_t n_args, const mp_obj_t *pos_arg
 }
 MP_DEFINE_CONST_FUN_OBJ_KW(iodevices_LUMPDevice_read_obj, 1, iodevices_LUMPDevice_read);
 
+// pybricks.iodevices.LUMPDevice.set_mode
+STATIC mp_obj_t iodevices_LUMPDevice_set_mode(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        iodevices_LUMPDevice_obj_t, self,
+        PB_ARG_REQUIRED(mode));
+
+    // Start the mode switch, but don't wait for fresh data
+    pbdevice_set_mode(self->pbdev, mp_obj_get_int(mode));
+
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(iodevices_LUMPDevice_set_mode_obj, 1, iodevices_LUMPDevice_set_mode);
+
+// pybricks.iodevices.LUMPDevice.ready
+STATIC mp_obj_t iodevices_LUMPDevice_ready(mp_obj_t self_in) {
+    iodevices_LUMPDevice_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    return mp_obj_new_bool(pbdevice_is_ready(self->pbdev));
+}
+MP_DEFINE_CONST_FUN_OBJ_1(iodevices_LUMPDevice_ready_obj, iodevices_LUMPDevice_ready);
+
+// pybricks.iodevices.LUMPDevice.schedule
+STATIC mp_obj_t iodevices_LUMPDevice_schedule(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        iodevices_LUMPDevice_obj_t, self,
+        PB_ARG_REQUIRED(modes));
+
+    // Unpack the (mode, rate) pairs
+    mp_obj_t *objs;
+    size_t num_modes;
+    mp_obj_get_array(modes, &num_modes, &objs);
+    if (num_modes > PBDEVICE_MAX_SCHEDULED_MODES) {
+        pb_assert(PBIO_ERROR_INVALID_ARG);
+    }
+
+    pbdevice_schedule_t schedule[PBDEVICE_MAX_SCHEDULED_MODES];
+    for (uint8_t i = 0; i < num_modes; i++) {
+        mp_obj_t *pair;
+        mp_obj_get_array_fixed_n(objs[i], 2, &pair);
+        mp_int_t rate = mp_obj_get_int(pair[1]);
+        if (rate <= 0) {
+            pb_assert(PBIO_ERROR_INVALID_ARG);
+        }
+        schedule[i].mode = mp_obj_get_int(pair[0]);
+        schedule[i].period = 1000 / rate;
+    }
+
+    pbdevice_set_schedule(self->pbdev, schedule, num_modes);
+
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(iodevices_LUMPDevice_schedule_obj, 1, iodevices_LUMPDevice_schedule);
+
 // pybricks.iodevices.LUMPDevice.write
 STATIC mp_obj_t iodevices_LUMPDevice_write(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
@@ -116,6 +168,9 @@ MP_DEFINE_CONST_FUN_OBJ_KW(iodevices_LUMPDevice_write_obj, 1, iodevices_LUMPDevi
 STATIC const mp_rom_map_elem_t iodevices_LUMPDevice_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_read),       MP_ROM_PTR(&iodevices_LUMPDevice_read_obj) },
     { MP_ROM_QSTR(MP_QSTR_write),      MP_ROM_PTR(&iodevices_LUMPDevice_write_obj)},
+    { MP_ROM_QSTR(MP_QSTR_set_mode),   MP_ROM_PTR(&iodevices_LUMPDevice_set_mode_obj)},
+    { MP_ROM_QSTR(MP_QSTR_ready),      MP_ROM_PTR(&iodevices_LUMPDevice_ready_obj)},
+    { MP_ROM_QSTR(MP_QSTR_schedule),   MP_ROM_PTR(&iodevices_LUMPDevice_schedule_obj)},
     { MP_ROM_QSTR(MP_QSTR_ID),         MP_ROM_ATTRIBUTE_OFFSET(iodevices_LUMPDevice_obj_t, id) },
 };
 STATIC MP_DEFINE_CONST_DICT(iodevices_LUMPDevice_locals_dict, iodevices_LUMPDevice_locals_dict_table);
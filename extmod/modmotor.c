@@ -279,6 +279,45 @@ STATIC mp_obj_t motor_Motor_speed(mp_obj_t self_in) {
 }
 MP_DEFINE_CONST_FUN_OBJ_1(motor_Motor_speed_obj, motor_Motor_speed);
 
+// pybricks.builtins.Motor.state
+STATIC mp_obj_t motor_Motor_state(mp_obj_t self_in) {
+    motor_Motor_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    int32_t angle, speed, duty;
+
+    // Angle, speed and duty cycle are read from the same sample
+    pb_assert(pbio_servo_get_state_user(self->srv, &angle, &speed, &duty));
+
+    mp_obj_t ret[5];
+    ret[0] = mp_obj_new_int(angle);
+    ret[1] = mp_obj_new_int(speed);
+    ret[2] = mp_obj_new_int(duty);
+    ret[3] = mp_obj_new_bool(pbio_control_is_done(&self->srv->control));
+    ret[4] = mp_obj_new_bool(pbio_control_is_stalled(&self->srv->control));
+    return mp_obj_new_tuple(5, ret);
+}
+MP_DEFINE_CONST_FUN_OBJ_1(motor_Motor_state_obj, motor_Motor_state);
+
+// pybricks.builtins.Motor.read_into
+STATIC mp_obj_t motor_Motor_read_into(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
+        motor_Motor_obj_t, self,
+        PB_ARG_REQUIRED(buf));
+
+    int32_t angle, speed, duty;
+    pb_assert(pbio_servo_get_state_user(self->srv, &angle, &speed, &duty));
+
+    // Same values as Motor.state, but stored in place into a list or array so
+    // that nothing is allocated. Done and stalled are stored as 0 or 1.
+    mp_obj_subscr(buf, MP_OBJ_NEW_SMALL_INT(0), mp_obj_new_int(angle));
+    mp_obj_subscr(buf, MP_OBJ_NEW_SMALL_INT(1), mp_obj_new_int(speed));
+    mp_obj_subscr(buf, MP_OBJ_NEW_SMALL_INT(2), mp_obj_new_int(duty));
+    mp_obj_subscr(buf, MP_OBJ_NEW_SMALL_INT(3), MP_OBJ_NEW_SMALL_INT(pbio_control_is_done(&self->srv->control)));
+    mp_obj_subscr(buf, MP_OBJ_NEW_SMALL_INT(4), MP_OBJ_NEW_SMALL_INT(pbio_control_is_stalled(&self->srv->control)));
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(motor_Motor_read_into_obj, 1, motor_Motor_read_into);
+
 // pybricks.builtins.Motor.run
 STATIC mp_obj_t motor_Motor_run(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     PB_PARSE_ARGS_METHOD(n_args, pos_args, kw_args,
@@ -466,6 +505,8 @@ STATIC const mp_rom_map_elem_t motor_Motor_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_hold), MP_ROM_PTR(&motor_Motor_hold_obj) },
     { MP_ROM_QSTR(MP_QSTR_angle), MP_ROM_PTR(&motor_Motor_angle_obj) },
     { MP_ROM_QSTR(MP_QSTR_speed), MP_ROM_PTR(&motor_Motor_speed_obj) },
+    { MP_ROM_QSTR(MP_QSTR_state), MP_ROM_PTR(&motor_Motor_state_obj) },
+    { MP_ROM_QSTR(MP_QSTR_read_into), MP_ROM_PTR(&motor_Motor_read_into_obj) },
     { MP_ROM_QSTR(MP_QSTR_reset_angle), MP_ROM_PTR(&motor_Motor_reset_angle_obj) },
     { MP_ROM_QSTR(MP_QSTR_run), MP_ROM_PTR(&motor_Motor_run_obj) },
     { MP_ROM_QSTR(MP_QSTR_run_time), MP_ROM_PTR(&motor_Motor_run_time_obj) },
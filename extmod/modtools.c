@@ -1,6 +1,14 @@
 // SPDX-License-Identifier: MIT
 // Copyright (c) 2018-2020 The Pybricks Authors
 
+#include <string.h>
+
+#include <contiki.h>
+
+#include <pbio/config.h>
+#include <pbio/stats.h>
+#include <pbio/trace.h>
+
 #include "py/mphal.h"
 #include "py/runtime.h"
 #include "pberror.h"
@@ -19,6 +27,77 @@ STATIC mp_obj_t tools_wait(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(tools_wait_obj, 0, tools_wait);
 
+#if PBIO_CONFIG_STATS
+
+// Converts statistics to (count, average, min, max, histogram)
+STATIC mp_obj_t tools_stats_tuple(const pbio_stats_t *s) {
+    mp_obj_t histogram[PBIO_STATS_HISTOGRAM_SIZE];
+    for (uint32_t i = 0; i < PBIO_STATS_HISTOGRAM_SIZE; i++) {
+        histogram[i] = mp_obj_new_int_from_uint(s->histogram[i]);
+    }
+    mp_obj_t ret[5];
+    ret[0] = mp_obj_new_int_from_uint(s->count);
+    ret[1] = mp_obj_new_int_from_uint(s->count ? (uint32_t)(s->total / s->count) : 0);
+    ret[2] = mp_obj_new_int_from_uint(s->min);
+    ret[3] = mp_obj_new_int_from_uint(s->max);
+    ret[4] = mp_obj_new_tuple(PBIO_STATS_HISTOGRAM_SIZE, histogram);
+    return mp_obj_new_tuple(5, ret);
+}
+
+STATIC mp_obj_t tools_stats(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_FUNCTION(n_args, pos_args, kw_args,
+        PB_ARG_DEFAULT_FALSE(reset));
+
+    mp_obj_t dict = mp_obj_new_dict(0);
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_motorpoll), tools_stats_tuple(pbio_stats_get(PBIO_STATS_MOTORPOLL)));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_lightpoll), tools_stats_tuple(pbio_stats_get(PBIO_STATS_LIGHTPOLL)));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_servo_period), tools_stats_tuple(pbio_stats_get(PBIO_STATS_SERVO_PERIOD)));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_servo_jitter), tools_stats_tuple(pbio_stats_get(PBIO_STATS_SERVO_JITTER)));
+
+    #if PROCESS_CONF_STATS
+    // Each process maps to (calls, total time, longest call)
+    mp_obj_t processes = mp_obj_new_dict(0);
+    for (struct process *p = PROCESS_LIST(); p; p = p->next) {
+        mp_obj_t ret[3];
+        ret[0] = mp_obj_new_int_from_uint(p->stats_calls);
+        ret[1] = mp_obj_new_int_from_uint(p->stats_usecs);
+        ret[2] = mp_obj_new_int_from_uint(p->stats_max_usecs);
+        const char *name = PROCESS_NAME_STRING(p);
+        mp_obj_dict_store(processes, mp_obj_new_str(name, strlen(name)), mp_obj_new_tuple(3, ret));
+    }
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_processes), processes);
+    #endif
+
+    if (mp_obj_is_true(reset)) {
+        pbio_stats_reset();
+    }
+    return dict;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(tools_stats_obj, 0, tools_stats);
+
+#endif // PBIO_CONFIG_STATS
+
+#if PBIO_CONFIG_TRACE
+
+// Gets the raw event trace, to be decoded with tools/pbtrace.py
+STATIC mp_obj_t tools_trace(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    PB_PARSE_ARGS_FUNCTION(n_args, pos_args, kw_args,
+        PB_ARG_DEFAULT_FALSE(clear));
+
+    pbio_trace_entry_t *entries = m_new(pbio_trace_entry_t, PBIO_CONFIG_TRACE_SIZE);
+    uint32_t n = pbio_trace_read(entries);
+    mp_obj_t ret = mp_obj_new_bytes((const byte *)entries, n * sizeof(pbio_trace_entry_t));
+    m_del(pbio_trace_entry_t, entries, PBIO_CONFIG_TRACE_SIZE);
+
+    if (mp_obj_is_true(clear)) {
+        pbio_trace_clear();
+    }
+    return ret;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(tools_trace_obj, 0, tools_trace);
+
+#endif // PBIO_CONFIG_TRACE
+
 // Class structure for StopWatch
 typedef struct _tools_StopWatch_obj_t {
     mp_obj_base_t base;
@@ -101,6 +180,12 @@ STATIC const mp_rom_map_elem_t tools_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__),    MP_ROM_QSTR(MP_QSTR_tools)         },
     { MP_ROM_QSTR(MP_QSTR_wait),        MP_ROM_PTR(&tools_wait_obj)  },
     { MP_ROM_QSTR(MP_QSTR_StopWatch),   MP_ROM_PTR(&tools_StopWatch_type)  },
+    #if PBIO_CONFIG_STATS
+    { MP_ROM_QSTR(MP_QSTR_stats),       MP_ROM_PTR(&tools_stats_obj)       },
+    #endif
+    #if PBIO_CONFIG_TRACE
+    { MP_ROM_QSTR(MP_QSTR_trace),       MP_ROM_PTR(&tools_trace_obj)       },
+    #endif
 };
 STATIC MP_DEFINE_CONST_DICT(pb_module_tools_globals, tools_globals_table);
 
@@ -4,6 +4,7 @@
 #ifndef _PBDEVICE_H_
 #define _PBDEVICE_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include <pbio/error.h>
@@ -12,10 +13,57 @@
 
 typedef struct _pbdevice_t pbdevice_t;
 
+/**
+ * Maximum number of modes that can be scheduled on one device.
+ */
+#define PBDEVICE_MAX_SCHEDULED_MODES (4)
+
+/**
+ * A scheduled mode is sampled in the background for this long (ms) after it
+ * was last read.
+ */
+#define PBDEVICE_SCHED_TIMEOUT_MS (1000)
+
+/**
+ * The background sampling leaves a device alone for this long (ms) after the
+ * program set a mode or read a mode that is not scheduled.
+ */
+#define PBDEVICE_SCHED_HOLD_MS (100)
+
+/**
+ * A scheduled sample older than this many periods is not used. The mode is
+ * read directly instead.
+ */
+#define PBDEVICE_SCHED_MAX_AGE_PERIODS (4)
+
+/**
+ * Wanted sampling rate for one mode of a device.
+ *
+ * The modes of a device that are being read are sampled in turn in the
+ * background, so reads return the latest sample right away, even when the
+ * program alternates between modes.
+ */
+typedef struct _pbdevice_schedule_t {
+    /**
+     * The mode to sample.
+     */
+    uint8_t mode;
+    /**
+     * Time (ms) between two samples of this mode.
+     */
+    uint32_t period;
+} pbdevice_schedule_t;
+
 pbdevice_t *pbdevice_get_device(pbio_port_t port, pbio_iodev_type_id_t valid_id);
 
 void pbdevice_get_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values);
 
+void pbdevice_set_mode(pbdevice_t *pbdev, uint8_t mode);
+
+bool pbdevice_is_ready(pbdevice_t *pbdev);
+
+void pbdevice_set_schedule(pbdevice_t *pbdev, const pbdevice_schedule_t *schedule, uint8_t num_modes);
+
 void pbdevice_set_values(pbdevice_t *pbdev, uint8_t mode, int32_t *values, uint8_t num_values);
 
 void pbdevice_set_power_supply(pbdevice_t *pbdev, int32_t duty);
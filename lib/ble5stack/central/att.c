@@ -72,7 +72,12 @@ bStatus_t ATT_WriteRsp(uint16_t connHandle) {
 }
 
 bStatus_t ATT_HandleValueNoti(uint16_t connHandle, attHandleValueNoti_t *pNoti) {
-    uint8_t buf[32];
+    // large enough for notifications with the largest ATT MTU the hub accepts
+    uint8_t buf[5 + 158 - 3];
+
+    if (pNoti->len > sizeof(buf) - 5) {
+        return bleInvalidRange;
+    }
 
     buf[0] = connHandle & 0xFF;
     buf[1] = (connHandle >> 8) & 0xFF;
@@ -47,6 +47,7 @@
 #include <stdio.h>
 
 #include "sys/process.h"
+#include "sys/clock.h"
 #include "sys/arg.h"
 
 /*
@@ -188,7 +189,18 @@ call_process(struct process *p, process_event_t ev, process_data_t data)
     PRINTF("process: calling process '%s' with event 0x%02X\n", PROCESS_NAME_STRING(p), ev);
     process_current = p;
     p->state = PROCESS_STATE_CALLED;
+#if PROCESS_CONF_STATS
+    unsigned long start = clock_usecs();
+#endif /* PROCESS_CONF_STATS */
     ret = p->thread(&p->pt, ev, data);
+#if PROCESS_CONF_STATS
+    unsigned long usecs = clock_usecs() - start;
+    p->stats_calls++;
+    p->stats_usecs += usecs;
+    if(usecs > p->stats_max_usecs) {
+      p->stats_max_usecs = usecs;
+    }
+#endif /* PROCESS_CONF_STATS */
     if(ret == PT_EXITED ||
        ret == PT_ENDED ||
        ev == PROCESS_EVENT_EXIT) {
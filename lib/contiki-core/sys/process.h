@@ -89,6 +89,11 @@ typedef unsigned char process_num_events_t;
 #define PROCESS_CONF_NUMEVENTS 32
 #endif /* PROCESS_CONF_NUMEVENTS */
 
+/* Measure how long each process runs, using clock_usecs() */
+#ifndef PROCESS_CONF_STATS
+#define PROCESS_CONF_STATS 0
+#endif /* PROCESS_CONF_STATS */
+
 #define PROCESS_EVENT_NONE            0x80
 #define PROCESS_EVENT_INIT            0x81
 #define PROCESS_EVENT_POLL            0x82
@@ -324,6 +329,12 @@ struct process {
   PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
   struct pt pt;
   unsigned char state, needspoll;
+#if PROCESS_CONF_STATS
+  /* Number of times the process was called and the total and longest time
+     it took in microseconds. Synchronous events posted by the process are
+     counted in both processes. */
+  unsigned long stats_calls, stats_usecs, stats_max_usecs;
+#endif /* PROCESS_CONF_STATS */
 };
 
 /**
@@ -2,9 +2,15 @@
 // Copyright (c) 2019-2020 The Pybricks Authors
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+#include <linux/gpio.h>
+#include <sys/ioctl.h>
 
 #include <contiki.h>
 
@@ -14,6 +20,7 @@
 #include <pbio/port.h>
 #include <pbio/iodev.h>
 #include <pbio/light.h>
+#include <pbio/util.h>
 
 #define IN (0)
 #define OUT (1)
@@ -21,6 +28,13 @@
 #define min(a, b) ((a) < (b) ? (a) : (b))
 #define max(a, b) ((a) > (b) ? (a) : (b))
 
+// How often the background process measures one lamp color while the color
+// is being read. A full sample takes one step for each of the four lamp colors.
+#define NXTCOLOR_SAMPLE_PERIOD_MS (10)
+
+// Stop measuring in the background if the color has not been read for this long
+#define NXTCOLOR_SAMPLE_TIMEOUT_MS (500)
+
 typedef struct {
     const int digi0; // GPIO on wire 5
     const int digi1; // GPIO on wire 6
@@ -62,10 +76,26 @@ static const pbio_light_color_t lamp_colors[] = {
     PBIO_LIGHT_COLOR_NONE,
 };
 
+// A GPIO line. This uses a line handle on the GPIO character device, which
+// takes one ioctl per read or write. The kernel does not hand out lines that
+// are exported to sysfs, so the line is unexported first. If the kernel still
+// does not give us the line, it is exported again and the sysfs files are used
+// from then on.
+typedef struct {
+    int chip_fd; // GPIO chip, or -1 when using sysfs
+    uint32_t offset; // Line offset on the GPIO chip
+    int fd; // Line handle, or sysfs value file
+    int dir_fd; // sysfs direction file, or -1 when using a line handle
+    bool dir;
+    bool use_sysfs; // The line handle could not be used
+} nxtcolor_gpio_t;
+
 typedef struct _nxtcolor_t {
     bool ready;
     bool fs_initialized;
     bool waiting;
+    bool sampling;
+    bool sample_valid;
     pbio_light_color_t state;
     pbio_light_color_t lamp;
     uint32_t calibration[3][4];
@@ -74,18 +104,21 @@ typedef struct _nxtcolor_t {
     uint32_t raw_max;
     uint16_t crc;
     uint32_t wait_start;
+    clock_time_t read_time;
+    int32_t sample[5];
+    uint32_t sample_raw[4];
+    uint8_t sample_lamp;
     const nxtcolor_pininfo_t *pins;
-    FILE *f_digi0_val;
-    FILE *f_digi0_dir;
-    FILE *f_digi1_val;
-    FILE *f_digi1_dir;
-    bool digi1_dir;
-    FILE *f_adc_val;
+    nxtcolor_gpio_t digi0;
+    nxtcolor_gpio_t digi1;
+    int fd_adc_val;
     FILE *f_adc_con;
 } nxtcolor_t;
 
 nxtcolor_t nxtcolorsensors[4];
 
+PROCESS(nxtcolor_process, "NXT color sensor");
+
 // Simplistic nonbusy wait. May be called only once per blocking operation.
 pbio_error_t nxtcolor_wait(nxtcolor_t *nxtcolor, uint32_t ms) {
 
@@ -109,62 +142,238 @@ pbio_error_t nxtcolor_wait(nxtcolor_t *nxtcolor, uint32_t ms) {
     }
 }
 
+// Open the character device of the GPIO chip that has the given sysfs GPIO
+static pbio_error_t gpio_open_chip(nxtcolor_gpio_t *gpio, int number) {
+    DIR *d_gpio = opendir("/sys/class/gpio");
+    if (!d_gpio) {
+        return PBIO_ERROR_NO_DEV;
+    }
+
+    struct dirent *entry;
+    char path[64];
+    int base = -1;
+    int ngpio = 0;
+
+    // Find the chip by its range of GPIO numbers
+    while ((entry = readdir(d_gpio))) {
+        if (sscanf(entry->d_name, "gpiochip%d", &base) < 1) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/sys/class/gpio/gpiochip%d/ngpio", base);
+        FILE *f_ngpio = fopen(path, "r");
+        if (!f_ngpio) {
+            continue;
+        }
+        if (fscanf(f_ngpio, "%d", &ngpio) < 1) {
+            ngpio = 0;
+        }
+        fclose(f_ngpio);
+        if (number >= base && number < base + ngpio) {
+            break;
+        }
+    }
+    closedir(d_gpio);
+
+    if (!entry) {
+        return PBIO_ERROR_NO_DEV;
+    }
+
+    // The device of the chip has the name of its character device
+    snprintf(path, sizeof(path), "/sys/class/gpio/gpiochip%d/device", base);
+    DIR *d_device = opendir(path);
+    if (!d_device) {
+        return PBIO_ERROR_NO_DEV;
+    }
+    int chip = -1;
+    while ((entry = readdir(d_device))) {
+        if (sscanf(entry->d_name, "gpiochip%d", &chip) == 1) {
+            break;
+        }
+    }
+    closedir(d_device);
+
+    if (!entry) {
+        return PBIO_ERROR_NO_DEV;
+    }
+
+    snprintf(path, sizeof(path), "/dev/gpiochip%d", chip);
+    gpio->chip_fd = open(path, O_RDWR | O_CLOEXEC);
+    if (gpio->chip_fd < 0) {
+        return PBIO_ERROR_IO;
+    }
+    gpio->offset = number - base;
+    return PBIO_SUCCESS;
+}
+
+// Get a line handle for the given direction, releasing the previous one
+static pbio_error_t gpio_request(nxtcolor_gpio_t *gpio, bool dir) {
+    struct gpiohandle_request req = {
+        .lineoffsets = { gpio->offset },
+        .flags = dir == OUT ? GPIOHANDLE_REQUEST_OUTPUT : GPIOHANDLE_REQUEST_INPUT,
+        .consumer_label = "pybricks-nxtcolor",
+        .lines = 1,
+    };
+
+    if (gpio->fd >= 0) {
+        close(gpio->fd);
+        gpio->fd = -1;
+    }
+    if (ioctl(gpio->chip_fd, GPIO_GET_LINEHANDLE_IOCTL, &req) < 0) {
+        return PBIO_ERROR_IO;
+    }
+    gpio->fd = req.fd;
+    gpio->dir = dir;
+    return PBIO_SUCCESS;
+}
+
+// Export or unexport a GPIO in sysfs. Errors are ignored, since they only
+// mean that the GPIO was already in the requested state.
+static void gpio_sysfs_export(int number, bool export) {
+    char path[32];
+    snprintf(path, sizeof(path), "/sys/class/gpio/%s", export ? "export" : "unexport");
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    dprintf(fd, "%d", number);
+    close(fd);
+}
+
+static pbio_error_t gpio_set_dir(nxtcolor_gpio_t *gpio, bool dir) {
+    if (gpio->dir == dir) {
+        return PBIO_SUCCESS;
+    }
+    if (gpio->dir_fd < 0) {
+        return gpio_request(gpio, dir);
+    }
+    const char *str = dir == OUT ? "out" : "in";
+    if (pwrite(gpio->dir_fd, str, strlen(str), 0) < 0) {
+        return PBIO_ERROR_IO;
+    }
+    gpio->dir = dir;
+    return PBIO_SUCCESS;
+}
+
+static void gpio_close(nxtcolor_gpio_t *gpio) {
+    if (gpio->fd >= 0) {
+        close(gpio->fd);
+        gpio->fd = -1;
+    }
+    if (gpio->dir_fd >= 0) {
+        close(gpio->dir_fd);
+        gpio->dir_fd = -1;
+    }
+    if (gpio->chip_fd >= 0) {
+        close(gpio->chip_fd);
+        gpio->chip_fd = -1;
+    }
+}
+
+// Opens the GPIO. On failure, nothing is left open so that it can be retried.
+static pbio_error_t gpio_open(nxtcolor_gpio_t *gpio, int number, bool dir) {
+    gpio->chip_fd = -1;
+    gpio->fd = -1;
+    gpio->dir_fd = -1;
+
+    // Try the character device first, unless it did not work before
+    if (!gpio->use_sysfs) {
+        if (gpio_open_chip(gpio, number) == PBIO_SUCCESS) {
+            gpio_sysfs_export(number, false);
+            if (gpio_request(gpio, dir) == PBIO_SUCCESS) {
+                return PBIO_SUCCESS;
+            }
+            gpio_close(gpio);
+            gpio_sysfs_export(number, true);
+        }
+        gpio->use_sysfs = true;
+    }
+
+    // Otherwise use sysfs. The files appear some time after exporting, so
+    // they may not be there yet. The caller tries again later.
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/value", number);
+    gpio->fd = open(path, O_RDWR | O_CLOEXEC);
+    snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/direction", number);
+    gpio->dir_fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (gpio->fd < 0 || gpio->dir_fd < 0) {
+        gpio_close(gpio);
+        return PBIO_ERROR_AGAIN;
+    }
+    gpio->dir = !dir;
+    pbio_error_t err = gpio_set_dir(gpio, dir);
+    if (err != PBIO_SUCCESS) {
+        gpio_close(gpio);
+    }
+    return err;
+}
+
+static pbio_error_t gpio_set(nxtcolor_gpio_t *gpio, bool val) {
+    if (gpio->dir_fd < 0) {
+        struct gpiohandle_data data = { .values = { val } };
+        return ioctl(gpio->fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) < 0 ? PBIO_ERROR_IO : PBIO_SUCCESS;
+    }
+    return pwrite(gpio->fd, val ? "1" : "0", 1, 0) == 1 ? PBIO_SUCCESS : PBIO_ERROR_IO;
+}
+
+static pbio_error_t gpio_get(nxtcolor_gpio_t *gpio, bool *val) {
+    if (gpio->dir_fd < 0) {
+        struct gpiohandle_data data;
+        if (ioctl(gpio->fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0) {
+            return PBIO_ERROR_IO;
+        }
+        *val = data.values[0];
+        return PBIO_SUCCESS;
+    }
+    char c;
+    if (pread(gpio->fd, &c, 1, 0) != 1) {
+        return PBIO_ERROR_IO;
+    }
+    *val = c == '1';
+    return PBIO_SUCCESS;
+}
+
 static pbio_error_t nxtcolor_set_digi0(nxtcolor_t *nxtcolor, bool val) {
-    return sysfs_write_int(nxtcolor->f_digi0_val, val);
+    return gpio_set(&nxtcolor->digi0, val);
 }
 
 static pbio_error_t nxtcolor_set_digi1(nxtcolor_t *nxtcolor, bool val) {
 
-    pbio_error_t err;
-
     // First, ensure it is set as a digital out
-    if (nxtcolor->digi1_dir == IN) {
-        err = sysfs_write_str(nxtcolor->f_digi1_dir, "out");
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-        nxtcolor->digi1_dir = OUT;
+    pbio_error_t err = gpio_set_dir(&nxtcolor->digi1, OUT);
+    if (err != PBIO_SUCCESS) {
+        return err;
     }
     // Set the requested state
-    return sysfs_write_int(nxtcolor->f_digi1_val, val);
+    return gpio_set(&nxtcolor->digi1, val);
 }
 
 static pbio_error_t nxtcolor_get_digi1(nxtcolor_t *nxtcolor, bool *val) {
 
-    pbio_error_t err;
-
     // First, ensure it is set as a digital in
-    if (nxtcolor->digi1_dir == OUT) {
-        err = sysfs_write_str(nxtcolor->f_digi1_dir, "in");
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-        nxtcolor->digi1_dir = IN;
-    }
-    // Get the state
-    int bit;
-    err = sysfs_read_int(nxtcolor->f_digi1_val, &bit);
+    pbio_error_t err = gpio_set_dir(&nxtcolor->digi1, IN);
     if (err != PBIO_SUCCESS) {
         return err;
     }
-    *val = bit == 1;
-    return PBIO_SUCCESS;
+    // Get the state
+    return gpio_get(&nxtcolor->digi1, val);
 }
 
 static pbio_error_t nxtcolor_get_adc(nxtcolor_t *nxtcolor, uint32_t *analog) {
 
-    pbio_error_t err;
-
     // First, ensure it is set as an input
-    if (nxtcolor->digi1_dir == OUT) {
-        err = sysfs_write_str(nxtcolor->f_digi1_dir, "in");
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-        nxtcolor->digi1_dir = IN;
+    pbio_error_t err = gpio_set_dir(&nxtcolor->digi1, IN);
+    if (err != PBIO_SUCCESS) {
+        return err;
     }
     // Get the state
-    return sysfs_read_int(nxtcolor->f_adc_val, (int *)analog);
+    char buf[16];
+    ssize_t len = pread(nxtcolor->fd_adc_val, buf, sizeof(buf) - 1, 0);
+    if (len <= 0) {
+        return PBIO_ERROR_IO;
+    }
+    buf[len] = '\0';
+    *analog = strtoul(buf, NULL, 10);
+    return PBIO_SUCCESS;
 }
 
 static pbio_error_t nxtcolor_reset(nxtcolor_t *nxtcolor)
@@ -275,48 +484,48 @@ static pbio_error_t nxtcolor_send_byte(nxtcolor_t *nxtcolor, uint8_t msg)
     return PBIO_SUCCESS;
 }
 
-static pbio_error_t nxtcolor_init_fs(nxtcolor_t *nxtcolor, pbio_port_t port) {
+// Closes everything that nxtcolor_init_fs opened
+static void nxtcolor_close_fs(nxtcolor_t *nxtcolor) {
+    gpio_close(&nxtcolor->digi0);
+    gpio_close(&nxtcolor->digi1);
+    if (nxtcolor->fd_adc_val >= 0) {
+        close(nxtcolor->fd_adc_val);
+        nxtcolor->fd_adc_val = -1;
+    }
+    if (nxtcolor->f_adc_con) {
+        fclose(nxtcolor->f_adc_con);
+        nxtcolor->f_adc_con = NULL;
+    }
+}
 
-    pbio_error_t err;
+static pbio_error_t nxtcolor_open_fs(nxtcolor_t *nxtcolor) {
 
-    // Get the pin info for this port
-    nxtcolor->pins = &pininfo[port-PBIO_PORT_1];
+    pbio_error_t err;
 
-    // Open the sysfs files for this sensor
-    err = sysfs_open(&nxtcolor->f_digi0_val, "/sys/class/gpio/gpio%d/%s", nxtcolor->pins->digi0, "value", "w");
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-    err = sysfs_open(&nxtcolor->f_digi0_dir, "/sys/class/gpio/gpio%d/%s", nxtcolor->pins->digi0, "direction", "w");
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-    err = sysfs_open(&nxtcolor->f_digi1_val, "/sys/class/gpio/gpio%d/%s", nxtcolor->pins->digi1, "value", "r+");
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
-    err = sysfs_open(&nxtcolor->f_digi1_dir, "/sys/class/gpio/gpio%d/%s", nxtcolor->pins->digi1, "direction", "w");
-    if (err != PBIO_SUCCESS) {
-        return err;
-    }
+    // Open the ADC files for this sensor
     err = sysfs_open(&nxtcolor->f_adc_con, "/sys/bus/iio/devices/iio:device0/in_voltage%d_raw%s", nxtcolor->pins->adc_con, "", "r");
     if (err != PBIO_SUCCESS) {
         return err;
     }
-    err = sysfs_open(&nxtcolor->f_adc_val, "/sys/bus/iio/devices/iio:device0/in_voltage%d_raw%s", nxtcolor->pins->adc_val, "", "r");
-    if (err != PBIO_SUCCESS) {
-        return err;
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/bus/iio/devices/iio:device0/in_voltage%d_raw", nxtcolor->pins->adc_val);
+    nxtcolor->fd_adc_val = open(path, O_RDONLY | O_CLOEXEC);
+    if (nxtcolor->fd_adc_val < 0) {
+        return PBIO_ERROR_IO;
     }
 
     // Verify that the sensor is indeed attached
     int32_t adc_con;
     err = sysfs_read_int(nxtcolor->f_adc_con, &adc_con);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
     if (adc_con > 50) {
         return PBIO_ERROR_NO_DEV;
     }
 
     // Digi0 is always an output pin. Init as low
-    err = sysfs_write_str(nxtcolor->f_digi0_dir, "out");
+    err = gpio_open(&nxtcolor->digi0, nxtcolor->pins->digi0, OUT);
     if (err != PBIO_SUCCESS) {
         return err;
     }
@@ -325,12 +534,29 @@ static pbio_error_t nxtcolor_init_fs(nxtcolor_t *nxtcolor, pbio_port_t port) {
         return err;
     }
     // Digi1 can be set as output, or read as digital, and analog. Init as low.
-    err = nxtcolor_set_digi1(nxtcolor, 0);
+    err = gpio_open(&nxtcolor->digi1, nxtcolor->pins->digi1, OUT);
     if (err != PBIO_SUCCESS) {
         return err;
     }
+    return nxtcolor_set_digi1(nxtcolor, 0);
+}
 
-    return PBIO_SUCCESS;
+static pbio_error_t nxtcolor_init_fs(nxtcolor_t *nxtcolor, pbio_port_t port) {
+
+    // Get the pin info for this port
+    nxtcolor->pins = &pininfo[port-PBIO_PORT_1];
+
+    // Nothing is open yet, since failed attempts close everything
+    nxtcolor->f_adc_con = NULL;
+    nxtcolor->fd_adc_val = -1;
+    nxtcolor->digi0.chip_fd = nxtcolor->digi0.fd = nxtcolor->digi0.dir_fd = -1;
+    nxtcolor->digi1.chip_fd = nxtcolor->digi1.fd = nxtcolor->digi1.dir_fd = -1;
+
+    pbio_error_t err = nxtcolor_open_fs(nxtcolor);
+    if (err != PBIO_SUCCESS) {
+        nxtcolor_close_fs(nxtcolor);
+    }
+    return err;
 }
 
 static pbio_error_t nxtcolor_init(nxtcolor_t *nxtcolor, pbio_port_t port) {
@@ -441,61 +667,17 @@ pbio_error_t nxtcolor_set_light(nxtcolor_t *nxtcolor, pbio_light_color_t color)
     return PBIO_SUCCESS;
 }
 
-pbio_error_t nxtcolor_get_values_at_mode(pbio_port_t port, uint8_t mode, int32_t *values) {
-
-    pbio_error_t err;
-
-    if (port < PBIO_PORT_1 || port > PBIO_PORT_4) {
-        return PBIO_ERROR_INVALID_PORT;
-    }
-
-    nxtcolor_t *nxtcolor = &nxtcolorsensors[port-PBIO_PORT_1];
-
-    // We don't have a formal "get" function since the higher level code
-    // does not know about the color sensor being a special case. So instead
-    // initialize the first time the sensor is called.
-    if (!nxtcolor->ready) {
-        err = nxtcolor_init(nxtcolor, port);
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-        nxtcolor->ready = true;
-    }
-
-    // In one of the lamp modes, just set the right color
-    if (mode > 0) {
-        switch(mode) {
-            case 1:
-                nxtcolor->lamp = PBIO_LIGHT_COLOR_RED;
-                break;
-            case 2:
-                nxtcolor->lamp = PBIO_LIGHT_COLOR_GREEN;
-                break;
-            case 3:
-                nxtcolor->lamp = PBIO_LIGHT_COLOR_BLUE;
-                break;
-            default:
-                nxtcolor->lamp = PBIO_LIGHT_COLOR_NONE;
-                break;
-        }
-        return nxtcolor_set_light(nxtcolor, nxtcolor->lamp);
+// Turn on one of the lamp colors and read the analog value
+static pbio_error_t nxtcolor_measure_lamp(nxtcolor_t *nxtcolor, uint8_t lamp, uint32_t *analog) {
+    pbio_error_t err = nxtcolor_set_light(nxtcolor, lamp_colors[lamp]);
+    if (err != PBIO_SUCCESS) {
+        return err;
     }
+    return nxtcolor_get_adc(nxtcolor, analog);
+}
 
-    // In measure mode, cycle through the colors and calculate color id
-    uint32_t rgba[4];
-
-    // Read analog for each color
-    for (uint8_t i = 0; i < 4; i++) {
-        // Set the light
-        err = nxtcolor_set_light(nxtcolor, lamp_colors[i]);
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-        err = nxtcolor_get_adc(nxtcolor, &rgba[i]);
-        if (err != PBIO_SUCCESS) {
-            return err;
-        }
-    }
+// Calculate the color id from the analog value for each lamp color
+static void nxtcolor_calc(nxtcolor_t *nxtcolor, const uint32_t *rgba, int32_t *values) {
 
     // Select calibration row based on ambient light
     uint8_t row = 0;
@@ -580,7 +762,135 @@ pbio_error_t nxtcolor_get_values_at_mode(pbio_port_t port, uint8_t mode, int32_t
 
     // Return RGB and Color data
     values[4] = color;
+}
+
+// Cycle through the colors and calculate the color id
+static pbio_error_t nxtcolor_measure(nxtcolor_t *nxtcolor, int32_t *values) {
+
+    pbio_error_t err;
+    uint32_t rgba[4];
+
+    // Read analog for each color
+    for (uint8_t i = 0; i < 4; i++) {
+        err = nxtcolor_measure_lamp(nxtcolor, i, &rgba[i]);
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+    }
+
+    nxtcolor_calc(nxtcolor, rgba, values);
 
     // Set the light back to the configured lamp status
     return nxtcolor_set_light(nxtcolor, nxtcolor->lamp);
 }
+
+pbio_error_t nxtcolor_get_values_at_mode(pbio_port_t port, uint8_t mode, int32_t *values) {
+
+    pbio_error_t err;
+
+    if (port < PBIO_PORT_1 || port > PBIO_PORT_4) {
+        return PBIO_ERROR_INVALID_PORT;
+    }
+
+    nxtcolor_t *nxtcolor = &nxtcolorsensors[port-PBIO_PORT_1];
+
+    // We don't have a formal "get" function since the higher level code
+    // does not know about the color sensor being a special case. So instead
+    // initialize the first time the sensor is called.
+    if (!nxtcolor->ready) {
+        err = nxtcolor_init(nxtcolor, port);
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+        nxtcolor->ready = true;
+    }
+
+    // In one of the lamp modes, just set the right color
+    if (mode > 0) {
+        nxtcolor->sampling = false;
+        switch(mode) {
+            case 1:
+                nxtcolor->lamp = PBIO_LIGHT_COLOR_RED;
+                break;
+            case 2:
+                nxtcolor->lamp = PBIO_LIGHT_COLOR_GREEN;
+                break;
+            case 3:
+                nxtcolor->lamp = PBIO_LIGHT_COLOR_BLUE;
+                break;
+            default:
+                nxtcolor->lamp = PBIO_LIGHT_COLOR_NONE;
+                break;
+        }
+        return nxtcolor_set_light(nxtcolor, nxtcolor->lamp);
+    }
+
+    nxtcolor->read_time = clock_time();
+
+    // Return the latest sample if the background process is measuring
+    if (nxtcolor->sampling && nxtcolor->sample_valid) {
+        memcpy(values, nxtcolor->sample, sizeof(nxtcolor->sample));
+        return PBIO_SUCCESS;
+    }
+
+    // Otherwise measure now, and keep measuring in the background so the
+    // next reads are instant.
+    err = nxtcolor_measure(nxtcolor, values);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+    memcpy(nxtcolor->sample, values, sizeof(nxtcolor->sample));
+    nxtcolor->sample_valid = true;
+    nxtcolor->sample_lamp = 0;
+    nxtcolor->sampling = true;
+    if (!process_is_running(&nxtcolor_process)) {
+        process_start(&nxtcolor_process, NULL);
+    }
+    return PBIO_SUCCESS;
+}
+
+// Measures the color of all sensors that are being read, so that reading
+// takes no time and measurements are evenly spaced. This runs in the same
+// thread as the motor control loop, so each step measures only one lamp color.
+PROCESS_THREAD(nxtcolor_process, ev, data) {
+    static struct etimer timer;
+
+    PROCESS_BEGIN();
+
+    etimer_set(&timer, clock_from_msec(NXTCOLOR_SAMPLE_PERIOD_MS));
+
+    while (true) {
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER && etimer_expired(&timer));
+        etimer_reset(&timer);
+
+        for (size_t i = 0; i < PBIO_ARRAY_SIZE(nxtcolorsensors); i++) {
+            nxtcolor_t *nxtcolor = &nxtcolorsensors[i];
+            if (!nxtcolor->sampling) {
+                continue;
+            }
+
+            // Stop when the color is no longer read, so the lamp stops flashing
+            if (clock_time() - nxtcolor->read_time > clock_from_msec(NXTCOLOR_SAMPLE_TIMEOUT_MS)) {
+                nxtcolor->sampling = false;
+                nxtcolor_set_light(nxtcolor, nxtcolor->lamp);
+                continue;
+            }
+
+            // On errors, the next read measures again and reports the error
+            uint8_t lamp = nxtcolor->sample_lamp;
+            if (nxtcolor_measure_lamp(nxtcolor, lamp, &nxtcolor->sample_raw[lamp]) != PBIO_SUCCESS) {
+                nxtcolor->sample_valid = false;
+                nxtcolor->sampling = false;
+                continue;
+            }
+
+            // Update the sample once all lamp colors have been measured
+            if (++nxtcolor->sample_lamp == PBIO_ARRAY_SIZE(nxtcolor->sample_raw)) {
+                nxtcolor->sample_lamp = 0;
+                nxtcolor_calc(nxtcolor, nxtcolor->sample_raw, nxtcolor->sample);
+            }
+        }
+    }
+
+    PROCESS_END();
+}
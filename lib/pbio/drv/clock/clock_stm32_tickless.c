@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+// Tickless idle for STM32 MCUs. Normally, the SysTick interrupt wakes up the
+// CPU every millisecond. When nothing needs to be done for several ticks,
+// SysTick is instead set up to expire once at the end of that time, and the
+// ticks that were skipped are added to the clock afterwards. This is the same
+// approach as in FreeRTOS.
+
+#include "pbdrv/config.h"
+
+#if PBDRV_CONFIG_CLOCK_TICKLESS_STM32
+
+#include <stdint.h>
+
+#include <contiki.h>
+
+#include <pbdrv/clock.h>
+
+#include STM32_HAL_H
+
+// using private platform clock variable
+extern volatile clock_time_t clock_time_ticks;
+
+// SysTick is a 24-bit down counter
+#define SYSTICK_MAX_LOAD 0xFFFFFF
+
+void pbdrv_clock_idle(uint32_t ticks) {
+    // SysTick->LOAD always has the value for one tick outside of this function
+    uint32_t counts_per_tick = SysTick->LOAD + 1;
+    uint32_t max_ticks = SYSTICK_MAX_LOAD / counts_per_tick;
+
+    if (ticks > max_ticks) {
+        ticks = max_ticks;
+    }
+
+    // Interrupts are disabled so that none can sneak in between checking for
+    // pending events and going to sleep. WFI still wakes up on pending
+    // interrupts and they run as soon as interrupts are enabled again.
+    __disable_irq();
+
+    if (process_nevents()) {
+        __enable_irq();
+        return;
+    }
+
+    // Waking up on the next tick anyway, so no need to change anything
+    if (ticks < 2) {
+        __DSB();
+        __WFI();
+        __enable_irq();
+        return;
+    }
+
+    // Stop SysTick while it is being reconfigured
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+
+    // A tick just happened, so resume without sleeping
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+        __enable_irq();
+        return;
+    }
+
+    // Expire at the end of the last tick, counting the rest of the current one
+    uint32_t reload = SysTick->VAL + counts_per_tick * (ticks - 1);
+    SysTick->LOAD = reload;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    __DSB();
+    __WFI();
+    __ISB();
+
+    // Reading CTRL clears COUNTFLAG, so it must only be read once
+    uint32_t ctrl = SysTick->CTRL;
+    SysTick->CTRL = ctrl & ~SysTick_CTRL_ENABLE_Msk;
+
+    uint32_t skipped;
+
+    if (ctrl & SysTick_CTRL_COUNTFLAG_Msk) {
+        // Slept the whole time. The pending SysTick interrupt counts the last
+        // tick, so the next one is counted from when SysTick expired.
+        skipped = ticks - 1;
+        uint32_t counts = counts_per_tick - 1 - (reload - SysTick->VAL);
+        if (counts >= counts_per_tick) {
+            counts = counts_per_tick - 1;
+        }
+        SysTick->LOAD = counts;
+    } else {
+        // Woken up early by another interrupt. Count the ticks that have
+        // passed and let SysTick run until the end of the current one.
+        uint32_t counts = counts_per_tick * ticks - SysTick->VAL;
+        skipped = counts / counts_per_tick;
+        SysTick->LOAD = (skipped + 1) * counts_per_tick - counts;
+    }
+
+    // Restart with the remainder of the current tick, then go back to
+    // normal ticks after that
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = counts_per_tick - 1;
+
+    clock_time_ticks += skipped;
+
+    __enable_irq();
+
+    if (skipped) {
+        etimer_request_poll();
+    }
+}
+
+#endif // PBDRV_CONFIG_CLOCK_TICKLESS_STM32
@@ -15,6 +15,8 @@ struct _pbdrv_counter_dev_t {
     pbio_error_t (*get_count)(pbdrv_counter_dev_t *dev, int32_t *count);
     pbio_error_t (*get_abs_count)(pbdrv_counter_dev_t *dev, int32_t *count);
     pbio_error_t (*get_rate)(pbdrv_counter_dev_t *dev, int32_t *rate);
+    // optional, for counters that are updated in an interrupt
+    pbio_error_t (*get_state)(pbdrv_counter_dev_t *dev, int32_t *count, int32_t *rate);
     bool initalized;
 };
 
@@ -95,6 +95,31 @@ pbio_error_t pbdrv_counter_get_rate(pbdrv_counter_dev_t *dev, int32_t *rate) {
     return dev->get_rate(dev, rate);
 }
 
+/**
+ * Gets the count and the rate from the same sample.
+ * @param [in]  dev     Pointer to the counter device
+ * @param [out] count   Returns the count on success
+ * @param [out] rate    Returns the rate on success
+ * @return              ::PBIO_SUCCESS on success or ::PBIO_ERROR_NO_DEV if the
+ *                      counter has not been initialized.
+ */
+pbio_error_t pbdrv_counter_get_state(pbdrv_counter_dev_t *dev, int32_t *count, int32_t *rate) {
+    if (!dev->initalized) {
+        return PBIO_ERROR_NO_DEV;
+    }
+
+    // Counters that are not updated in an interrupt can't change in between
+    if (!dev->get_state) {
+        pbio_error_t err = dev->get_count(dev, count);
+        if (err != PBIO_SUCCESS) {
+            return err;
+        }
+        return dev->get_rate(dev, rate);
+    }
+
+    return dev->get_state(dev, count, rate);
+}
+
 static void pbdrv_counter_process_exit() {
     #if PBDRV_CONFIG_COUNTER_NXT
     pbdrv_counter_nxt_drv.exit();
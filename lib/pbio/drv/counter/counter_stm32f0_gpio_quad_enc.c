@@ -45,14 +45,12 @@ static pbio_error_t pbdrv_counter_stm32f0_gpio_quad_enc_get_count(pbdrv_counter_
     return PBIO_SUCCESS;
 }
 
-static pbio_error_t pbdrv_counter_stm32f0_gpio_quad_enc_get_rate(pbdrv_counter_dev_t *dev, int32_t *rate) {
-    private_data_t *data = PBIO_CONTAINER_OF(dev, private_data_t, dev);
+// Gets the rate from the ring buffer entries up to and including head
+static int32_t get_rate_at(private_data_t *data, uint8_t head) {
     int32_t head_count, tail_count = 0;
     uint16_t now, head_time, tail_time = 0;
-    uint8_t head, tail, x = 0;
+    uint8_t tail, x = 0;
 
-    // head can be updated in interrupt, so only read it once
-    head = data->head;
     head_count = data->counts[head];
     head_time = data->timestamps[head];
 
@@ -60,8 +58,7 @@ static pbio_error_t pbdrv_counter_stm32f0_gpio_quad_enc_get_rate(pbdrv_counter_d
 
     // if it has been more than 50ms since last timestamp, we are not moving.
     if ((uint16_t)(now - head_time) > 50 * 100) {
-        *rate = 0;
-        return PBIO_SUCCESS;
+        return 0;
     }
 
     while (x++ < RING_BUF_SIZE) {
@@ -72,8 +69,7 @@ static pbio_error_t pbdrv_counter_stm32f0_gpio_quad_enc_get_rate(pbdrv_counter_d
 
         // if count hasn't changed, then we are not moving
         if (head_count == tail_count) {
-            *rate = 0;
-            return PBIO_SUCCESS;
+            return 0;
         }
 
         /*
@@ -87,12 +83,34 @@ static pbio_error_t pbdrv_counter_stm32f0_gpio_quad_enc_get_rate(pbdrv_counter_d
 
     /* avoid divide by 0 - motor probably hasn't moved yet */
     if (head_time == tail_time) {
-        *rate = 0;
-        return PBIO_SUCCESS;
+        return 0;
     }
 
     /* timer is 100000kHz */
-    *rate = (head_count - tail_count) * 100000 / (uint16_t)(head_time - tail_time);
+    return (head_count - tail_count) * 100000 / (uint16_t)(head_time - tail_time);
+}
+
+static pbio_error_t pbdrv_counter_stm32f0_gpio_quad_enc_get_rate(pbdrv_counter_dev_t *dev, int32_t *rate) {
+    private_data_t *data = PBIO_CONTAINER_OF(dev, private_data_t, dev);
+
+    // head can be updated in interrupt, so only read it once
+    *rate = get_rate_at(data, data->head);
+
+    return PBIO_SUCCESS;
+}
+
+static pbio_error_t pbdrv_counter_stm32f0_gpio_quad_enc_get_state(pbdrv_counter_dev_t *dev, int32_t *count, int32_t *rate) {
+    private_data_t *data = PBIO_CONTAINER_OF(dev, private_data_t, dev);
+
+    // count and head are updated in interrupts, so read them together
+    uint32_t irq_state = __get_PRIMASK();
+    __disable_irq();
+    *count = data->count;
+    uint8_t head = data->head;
+    __set_PRIMASK(irq_state);
+
+    *rate = get_rate_at(data, head);
+
     return PBIO_SUCCESS;
 }
 
@@ -170,6 +188,7 @@ static pbio_error_t counter_stm32f0_gpio_quad_enc_init() {
         pbdrv_gpio_input(data->gpio_dir);
         data->dev.get_count = pbdrv_counter_stm32f0_gpio_quad_enc_get_count;
         data->dev.get_rate = pbdrv_counter_stm32f0_gpio_quad_enc_get_rate;
+        data->dev.get_state = pbdrv_counter_stm32f0_gpio_quad_enc_get_state;
         data->dev.initalized = true;
         pbdrv_counter_register(pdata->counter_id, &data->dev);
     }
@@ -14,6 +14,8 @@
 #include <pbio/config.h>
 #include <pbio/error.h>
 #include <pbio/event.h>
+#include <pbio/trace.h>
+#include <pbio/txbuf.h>
 #include <pbio/util.h>
 #include <pbsys/sys.h>
 
@@ -58,8 +60,12 @@
 
 #define NO_CONNECTION           0xFFFF
 
-// max data size for nRF UART characteristics
-#define NRF_CHAR_SIZE 20
+// largest ATT MTU that we accept from the client
+#define MAX_ATT_MTU 158
+// size of ATT notification header (opcode + handle)
+#define ATT_NOTI_HEADER_SIZE 3
+// max data size for nRF UART tx notifications
+#define UART_TX_BUF_SIZE (MAX_ATT_MTU - ATT_NOTI_HEADER_SIZE)
 
 
 // Tx buffer for SPI writes
@@ -95,12 +101,14 @@ static uint16_t pybricks_service_handle, pybricks_service_end_handle, pybricks_c
 static uint16_t uart_service_handle, uart_service_end_handle, uart_rx_char_handle, uart_tx_char_handle;
 // nRF UART tx notifications enabled
 static bool uart_tx_notify_en;
-// nRF UART tx is in progress
-static bool uart_tx_busy;
-// buffer to queue UART tx data
-static uint8_t uart_tx_buf[NRF_CHAR_SIZE];
-// bytes used in uart_tx_buf
-static uint8_t uart_tx_buf_size;
+// ATT MTU negotiated with the connected device
+static uint16_t att_mtu = ATT_MTU_SIZE;
+// double buffer to queue UART tx data - one is filled while the other is sent
+static uint8_t uart_tx_data[2 * UART_TX_BUF_SIZE];
+static pbio_txbuf_t uart_tx_buf;
+// notification that is being sent
+static const uint8_t *uart_tx_packet;
+static uint16_t uart_tx_packet_size;
 
 // 6e400001-b5a3-f393-e0a-9e50e24dcca9e
 static const uint8_t pybricks_service_uuid[] = {
@@ -161,6 +169,8 @@ static void bluetooth_reset(reset_state_t reset) {
 
 static void bluetooth_init() {
     bluetooth_reset(RESET_STATE_OUT_LOW);
+    pbio_txbuf_init(&uart_tx_buf, uart_tx_data, UART_TX_BUF_SIZE);
+    pbio_txbuf_set_packet_size(&uart_tx_buf, att_mtu - ATT_NOTI_HEADER_SIZE);
 }
 
 static void spi_init() {
@@ -369,9 +379,18 @@ static void handle_event(uint8_t *packet) {
             switch (event_code) {
                 case ATT_EVENT_EXCHANGE_MTU_REQ: {
                     attExchangeMTURsp_t rsp;
+                    uint16_t client_mtu = (data[7] << 8) | data[6];
 
-                    rsp.serverRxMTU = 158;
+                    rsp.serverRxMTU = MAX_ATT_MTU;
                     ATT_ExchangeMTURsp(connection_handle, &rsp);
+
+                    // both sides use the smaller of the two values
+                    att_mtu = client_mtu < MAX_ATT_MTU ? client_mtu : MAX_ATT_MTU;
+                    if (att_mtu < ATT_MTU_SIZE) {
+                        att_mtu = ATT_MTU_SIZE;
+                    }
+                    pbio_txbuf_set_packet_size(&uart_tx_buf, att_mtu - ATT_NOTI_HEADER_SIZE);
+                    DBG("mtu: %d", att_mtu);
                 }
                 break;
                 case ATT_EVENT_READ_BY_TYPE_REQ: {
@@ -573,13 +592,18 @@ static void handle_event(uint8_t *packet) {
                 case GAP_LINK_ESTABLISHED:
                     conn_handle = (data[11] << 8) | data[10];
                     DBG("link: %04x", conn_handle);
+                    pbio_trace(PBIO_TRACE_BLE_CONNECT, PBIO_PORT_NONE, conn_handle);
                     break;
 
                 case GAP_LINK_TERMINATED: {
                     DBG("bye: %04x", connection_handle);
                     if (conn_handle == connection_handle) {
+                        pbio_trace(PBIO_TRACE_BLE_DISCONNECT, PBIO_PORT_NONE, conn_handle);
                         conn_handle = NO_CONNECTION;
                         uart_tx_notify_en = false;
+                        att_mtu = ATT_MTU_SIZE;
+                        pbio_txbuf_clear(&uart_tx_buf);
+                        pbio_txbuf_set_packet_size(&uart_tx_buf, att_mtu - ATT_NOTI_HEADER_SIZE);
                     }
                 }
                 break;
@@ -1094,30 +1118,32 @@ static PT_THREAD(set_discoverable(struct pt *pt)) {
     PT_END(pt);
 }
 
-pbio_error_t pbdrv_bluetooth_tx(uint8_t c) {
+pbio_error_t pbdrv_bluetooth_tx_buf(const uint8_t *data, uint32_t size, uint32_t *count) {
     // make sure we have a Bluetooth connection
     if (!uart_tx_notify_en) {
         return PBIO_ERROR_INVALID_OP;
     }
 
-    // can't add the the buffer if tx is in progress or buffer is full
-    if (uart_tx_busy || uart_tx_buf_size == NRF_CHAR_SIZE) {
+    // data is added to the buffer that is not currently being sent, up to
+    // the size of one notification
+    *count = pbio_txbuf_write(&uart_tx_buf, data, size);
+    if (*count == 0) {
         return PBIO_ERROR_AGAIN;
     }
 
-    // append the char
-    uart_tx_buf[uart_tx_buf_size] = c;
-    uart_tx_buf_size++;
-
-    // poke the process to start tx soon-ish. This way, we can accumulate up to
-    // NRF_CHAR_SIZE bytes before actually transmitting
-    // TODO: it probably would be better to poll here instead of using events
-    // so that we don't fill up the event queue with 20 events
-    process_post(&pbdrv_bluetooth_hci_process, PROCESS_EVENT_MSG, NULL);
+    // poke the process to start tx soon-ish. This way, we can accumulate more
+    // data while the previous notification is still being sent.
+    process_poll(&pbdrv_bluetooth_hci_process);
 
     return PBIO_SUCCESS;
 }
 
+pbio_error_t pbdrv_bluetooth_tx(uint8_t c) {
+    uint32_t count;
+
+    return pbdrv_bluetooth_tx_buf(&c, 1, &count);
+}
+
 static PT_THREAD(uart_service_send_data(struct pt *pt))
 {
     PT_BEGIN(pt);
@@ -1133,8 +1159,8 @@ retry:
         attHandleValueNoti_t req;
 
         req.handle = uart_tx_char_handle;
-        req.len = uart_tx_buf_size;
-        req.pValue = uart_tx_buf;
+        req.len = uart_tx_packet_size;
+        req.pValue = (uint8_t *)uart_tx_packet;
         ATT_HandleValueNoti(conn_handle, &req);
     }
     PT_WAIT_UNTIL(pt, hci_command_status);
@@ -1213,11 +1239,10 @@ PROCESS_THREAD(pbdrv_bluetooth_hci_process, ev, data) {
                 // just occasionally checking to see if we are still connected
                 continue;
             }
-            if (ev == PROCESS_EVENT_MSG && uart_tx_buf_size) {
-                uart_tx_busy = true;
+            // swap buffers so that new data can be queued while sending
+            while (pbio_txbuf_send_begin(&uart_tx_buf, &uart_tx_packet, &uart_tx_packet_size)) {
                 PROCESS_PT_SPAWN(&child_pt, uart_service_send_data(&child_pt));
-                uart_tx_busy = false;
-                uart_tx_buf_size = 0;
+                pbio_txbuf_send_end(&uart_tx_buf);
             }
         }
 
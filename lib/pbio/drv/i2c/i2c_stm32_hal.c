@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+// Interrupt-driven I2C register access using the STM32 HAL
+
+#include "pbdrv/config.h"
+
+#if PBDRV_CONFIG_I2C_STM32_HAL
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <contiki.h>
+
+#include <pbdrv/i2c.h>
+#include <pbio/error.h>
+#include <pbio/util.h>
+
+#include "../../src/processes.h"
+
+#include STM32_HAL_H
+#include "i2c_stm32_hal.h"
+
+// Longest transfer is well below this at 400 kHz
+#define I2C_TIMEOUT_MS 50
+
+typedef struct {
+    pbdrv_i2c_dev_t i2c_dev;
+    I2C_HandleTypeDef hi2c;
+    struct etimer timer;
+    volatile pbio_error_t result;
+    bool initialized;
+} pbdrv_i2c_t;
+
+static pbdrv_i2c_t pbdrv_i2c[PBDRV_CONFIG_I2C_STM32_HAL_NUM_I2C];
+
+PROCESS(pbdrv_i2c_process, "I2C");
+
+pbio_error_t pbdrv_i2c_get(uint8_t id, pbdrv_i2c_dev_t **i2c_dev) {
+    if (id >= PBDRV_CONFIG_I2C_STM32_HAL_NUM_I2C) {
+        return PBIO_ERROR_INVALID_ARG;
+    }
+
+    if (!pbdrv_i2c[id].initialized) {
+        return PBIO_ERROR_AGAIN;
+    }
+
+    *i2c_dev = &pbdrv_i2c[id].i2c_dev;
+
+    return PBIO_SUCCESS;
+}
+
+static pbio_error_t pbdrv_i2c_begin(pbdrv_i2c_t *i2c, HAL_StatusTypeDef ret) {
+    if (ret == HAL_BUSY) {
+        return PBIO_ERROR_AGAIN;
+    }
+    if (ret != HAL_OK) {
+        return PBIO_ERROR_INVALID_ARG;
+    }
+
+    i2c->result = PBIO_ERROR_AGAIN;
+    etimer_set(&i2c->timer, clock_from_msec(I2C_TIMEOUT_MS));
+
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbdrv_i2c_read_begin(pbdrv_i2c_dev_t *i2c_dev, uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t length) {
+    pbdrv_i2c_t *i2c = PBIO_CONTAINER_OF(i2c_dev, pbdrv_i2c_t, i2c_dev);
+
+    if (i2c->result == PBIO_ERROR_AGAIN) {
+        return PBIO_ERROR_AGAIN;
+    }
+
+    return pbdrv_i2c_begin(i2c, HAL_I2C_Mem_Read_IT(&i2c->hi2c, addr << 1, reg, I2C_MEMADD_SIZE_8BIT, buf, length));
+}
+
+pbio_error_t pbdrv_i2c_write_begin(pbdrv_i2c_dev_t *i2c_dev, uint8_t addr, uint8_t reg, const uint8_t *buf, uint16_t length) {
+    pbdrv_i2c_t *i2c = PBIO_CONTAINER_OF(i2c_dev, pbdrv_i2c_t, i2c_dev);
+
+    if (i2c->result == PBIO_ERROR_AGAIN) {
+        return PBIO_ERROR_AGAIN;
+    }
+
+    return pbdrv_i2c_begin(i2c, HAL_I2C_Mem_Write_IT(&i2c->hi2c, addr << 1, reg, I2C_MEMADD_SIZE_8BIT, (uint8_t *)buf, length));
+}
+
+pbio_error_t pbdrv_i2c_end(pbdrv_i2c_dev_t *i2c_dev) {
+    pbdrv_i2c_t *i2c = PBIO_CONTAINER_OF(i2c_dev, pbdrv_i2c_t, i2c_dev);
+    pbio_error_t err = i2c->result; // read once since interrupt can modify it
+
+    if (err != PBIO_ERROR_AGAIN) {
+        etimer_stop(&i2c->timer);
+    } else if (etimer_expired(&i2c->timer)) {
+        // Bus is stuck, so start over. This is blocking, but should not
+        // happen in normal operation.
+        HAL_I2C_DeInit(&i2c->hi2c);
+        HAL_I2C_Init(&i2c->hi2c);
+        err = i2c->result = PBIO_ERROR_TIMEDOUT;
+    }
+
+    return err;
+}
+
+static void pbdrv_i2c_complete(I2C_HandleTypeDef *hi2c, pbio_error_t result) {
+    pbdrv_i2c_t *i2c = PBIO_CONTAINER_OF(hi2c, pbdrv_i2c_t, hi2c);
+
+    i2c->result = result;
+    process_poll(&pbdrv_i2c_process);
+}
+
+// overrides weak function in stm32l4xx_hal_i2c.c
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c) {
+    pbdrv_i2c_complete(hi2c, PBIO_SUCCESS);
+}
+
+// overrides weak function in stm32l4xx_hal_i2c.c
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c) {
+    pbdrv_i2c_complete(hi2c, PBIO_SUCCESS);
+}
+
+// overrides weak function in stm32l4xx_hal_i2c.c
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
+    pbdrv_i2c_complete(hi2c, PBIO_ERROR_IO);
+}
+
+void pbdrv_i2c_stm32_hal_handle_ev_irq(uint8_t id) {
+    HAL_I2C_EV_IRQHandler(&pbdrv_i2c[id].hi2c);
+}
+
+void pbdrv_i2c_stm32_hal_handle_er_irq(uint8_t id) {
+    HAL_I2C_ER_IRQHandler(&pbdrv_i2c[id].hi2c);
+}
+
+static void handle_poll() {
+    process_post(PROCESS_BROADCAST, PROCESS_EVENT_COM, NULL);
+}
+
+static void handle_exit() {
+    for (int i = 0; i < PBDRV_CONFIG_I2C_STM32_HAL_NUM_I2C; i++) {
+        pbdrv_i2c[i].initialized = false;
+        HAL_I2C_DeInit(&pbdrv_i2c[i].hi2c);
+    }
+}
+
+PROCESS_THREAD(pbdrv_i2c_process, ev, data) {
+    PROCESS_POLLHANDLER(handle_poll());
+    PROCESS_EXITHANDLER(handle_exit());
+
+    PROCESS_BEGIN();
+
+    for (int i = 0; i < PBDRV_CONFIG_I2C_STM32_HAL_NUM_I2C; i++) {
+        const pbdrv_i2c_stm32_hal_platform_data_t *pdata = &pbdrv_i2c_stm32_hal_platform_data[i];
+        pbdrv_i2c_t *i2c = &pbdrv_i2c[i];
+
+        i2c->hi2c.Instance = pdata->i2c;
+        i2c->hi2c.Init.Timing = pdata->timing;
+        i2c->hi2c.Init.OwnAddress1 = 0;
+        i2c->hi2c.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+        i2c->hi2c.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+        i2c->hi2c.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+        i2c->hi2c.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+        if (HAL_I2C_Init(&i2c->hi2c) == HAL_OK) {
+            i2c->result = PBIO_SUCCESS;
+            i2c->initialized = true;
+        }
+    }
+
+    while (true) {
+        PROCESS_WAIT_EVENT();
+    }
+
+    PROCESS_END();
+}
+
+#endif // PBDRV_CONFIG_I2C_STM32_HAL
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#ifndef _I2C_STM32_HAL_H_
+#define _I2C_STM32_HAL_H_
+
+#include <stdint.h>
+
+#include STM32_HAL_H
+
+// Platform should override HAL_I2C_MspInit() to configure the pins and to
+// enable the event and error interrupts.
+typedef struct {
+    I2C_TypeDef *i2c;
+    uint32_t timing;
+} pbdrv_i2c_stm32_hal_platform_data_t;
+
+extern const pbdrv_i2c_stm32_hal_platform_data_t
+    pbdrv_i2c_stm32_hal_platform_data[PBDRV_CONFIG_I2C_STM32_HAL_NUM_I2C];
+
+void pbdrv_i2c_stm32_hal_handle_ev_irq(uint8_t id);
+void pbdrv_i2c_stm32_hal_handle_er_irq(uint8_t id);
+
+#endif // _I2C_STM32_HAL_H_
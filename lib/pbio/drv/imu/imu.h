@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#ifndef _PBDRV_IMU_IMU_H_
+#define _PBDRV_IMU_IMU_H_
+
+#include <pbdrv/config.h>
+#include <pbdrv/imu.h>
+
+// Functions for the IMU hardware driver. It must also implement
+// pbdrv_imu_process.
+
+// Called once the sensor is sampling
+void pbdrv_imu_init_done(const pbdrv_imu_info_t *info);
+
+// Called if the sensor could not be initialized
+void pbdrv_imu_init_failed(void);
+
+// Adds a new sample to the ring buffer and updates the filtered values
+void pbdrv_imu_add_sample(const pbdrv_imu_sample_t *sample);
+
+#endif // _PBDRV_IMU_IMU_H_
@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+// Common part of the IMU drivers
+//
+// This keeps the ring buffer of samples and updates the filtered values that
+// are derived from them as each sample arrives, so they are always up to date
+// without polling.
+
+#include <pbdrv/config.h>
+
+#if PBDRV_CONFIG_IMU
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pbdrv/imu.h>
+#include <pbio/error.h>
+
+#include "imu.h"
+
+#if (PBDRV_CONFIG_IMU_NUM_SAMPLES & (PBDRV_CONFIG_IMU_NUM_SAMPLES - 1)) != 0
+#error PBDRV_CONFIG_IMU_NUM_SAMPLES must be a power of 2
+#endif
+
+// Time constant of the low-pass filter for gravity, in microseconds
+#define GRAVITY_TIME_US 64000
+
+// Gravity must be at least this much along one axis to count as pointing up
+// or down, in micro g. This is a little under cos(30 degrees).
+#define TILT_THRESHOLD_UG 850000
+
+// Acceleration on top of gravity that counts as a shake, in micro g
+#define SHAKE_THRESHOLD_UG 1000000
+
+// A new shake is only counted once the acceleration has stayed below the
+// threshold for this long, so that one shake is not counted many times, in
+// microseconds
+#define SHAKE_HOLDOFF_US 50000
+
+typedef struct {
+    pbio_error_t status;
+    pbdrv_imu_info_t info;
+    pbdrv_imu_sample_t ring[PBDRV_CONFIG_IMU_NUM_SAMPLES];
+    uint32_t head;
+    // low-pass filtered acceleration, scaled up by 2^gravity_shift
+    int32_t gravity[3];
+    uint8_t gravity_shift;
+    int32_t tilt_threshold;
+    int32_t shake_threshold;
+    uint32_t shake_holdoff;
+    int8_t up;
+    uint32_t shake_count;
+    uint32_t shake_time;
+    // samples below the shake threshold since the last sample above it
+    uint32_t shake_quiet;
+} pbdrv_imu_core_t;
+
+static pbdrv_imu_core_t pbdrv_imu_core = {
+    .status = PBIO_ERROR_AGAIN,
+};
+
+void pbdrv_imu_init_done(const pbdrv_imu_info_t *info) {
+    pbdrv_imu_core_t *imu = &pbdrv_imu_core;
+
+    imu->info = *info;
+
+    // each sample moves the filter output by 1 / 2^shift of the difference
+    imu->gravity_shift = 0;
+    while (((uint32_t)info->period << imu->gravity_shift) < GRAVITY_TIME_US) {
+        imu->gravity_shift++;
+    }
+
+    imu->tilt_threshold = TILT_THRESHOLD_UG / info->accel_scale;
+    imu->shake_threshold = SHAKE_THRESHOLD_UG / info->accel_scale;
+    imu->shake_holdoff = SHAKE_HOLDOFF_US / info->period;
+    imu->shake_quiet = imu->shake_holdoff;
+    imu->status = PBIO_SUCCESS;
+}
+
+void pbdrv_imu_init_failed(void) {
+    pbdrv_imu_core.status = PBIO_ERROR_NO_DEV;
+}
+
+static int32_t abs_i32(int32_t x) {
+    return x < 0 ? -x : x;
+}
+
+void pbdrv_imu_add_sample(const pbdrv_imu_sample_t *sample) {
+    pbdrv_imu_core_t *imu = &pbdrv_imu_core;
+    int32_t gravity[3];
+
+    imu->ring[imu->head & (PBDRV_CONFIG_IMU_NUM_SAMPLES - 1)] = *sample;
+
+    for (int i = 0; i < 3; i++) {
+        if (imu->head == 0) {
+            imu->gravity[i] = sample->accel[i] * (1 << imu->gravity_shift);
+        } else {
+            imu->gravity[i] += sample->accel[i] - (imu->gravity[i] >> imu->gravity_shift);
+        }
+        gravity[i] = imu->gravity[i] >> imu->gravity_shift;
+    }
+
+    imu->head++;
+
+    // Shaking is a sudden change of acceleration, which the low-pass filter
+    // can't follow
+    bool shaking = false;
+    for (int i = 0; i < 3; i++) {
+        if (abs_i32(sample->accel[i] - gravity[i]) > imu->shake_threshold) {
+            shaking = true;
+        }
+    }
+    if (!shaking) {
+        if (imu->shake_quiet < imu->shake_holdoff) {
+            imu->shake_quiet++;
+        }
+    } else {
+        if (imu->shake_quiet >= imu->shake_holdoff) {
+            imu->shake_count++;
+            imu->shake_time = sample->time;
+        }
+        imu->shake_quiet = 0;
+    }
+
+    // At rest, the accelerometer measures 1 g upwards
+    imu->up = 0;
+    for (int i = 0; i < 3; i++) {
+        if (gravity[i] > imu->tilt_threshold) {
+            imu->up = i + 1;
+        } else if (gravity[i] < -imu->tilt_threshold) {
+            imu->up = -(i + 1);
+        }
+    }
+}
+
+pbio_error_t pbdrv_imu_get_info(pbdrv_imu_info_t *info) {
+    if (pbdrv_imu_core.status != PBIO_SUCCESS) {
+        return pbdrv_imu_core.status;
+    }
+
+    *info = pbdrv_imu_core.info;
+
+    return PBIO_SUCCESS;
+}
+
+// Checks that there is at least one sample
+static pbio_error_t pbdrv_imu_check_samples(void) {
+    if (pbdrv_imu_core.status == PBIO_ERROR_NO_DEV) {
+        return PBIO_ERROR_NO_DEV;
+    }
+
+    if (pbdrv_imu_core.head == 0) {
+        return PBIO_ERROR_AGAIN;
+    }
+
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbdrv_imu_get_latest(pbdrv_imu_sample_t *sample) {
+    pbio_error_t err = pbdrv_imu_check_samples();
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    *sample = pbdrv_imu_core.ring[(pbdrv_imu_core.head - 1) & (PBDRV_CONFIG_IMU_NUM_SAMPLES - 1)];
+
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbdrv_imu_read(uint32_t *index, pbdrv_imu_sample_t *samples, uint32_t size, uint32_t *count) {
+    pbdrv_imu_core_t *imu = &pbdrv_imu_core;
+
+    if (imu->status == PBIO_ERROR_NO_DEV) {
+        *count = 0;
+        return PBIO_ERROR_NO_DEV;
+    }
+
+    // skip samples that have already been overwritten
+    if (imu->head - *index > PBDRV_CONFIG_IMU_NUM_SAMPLES) {
+        *index = imu->head - PBDRV_CONFIG_IMU_NUM_SAMPLES;
+    }
+
+    uint32_t i = 0;
+    while (i < size && *index != imu->head) {
+        samples[i++] = imu->ring[*index & (PBDRV_CONFIG_IMU_NUM_SAMPLES - 1)];
+        (*index)++;
+    }
+
+    *count = i;
+
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbdrv_imu_get_gravity(int16_t *gravity) {
+    pbio_error_t err = pbdrv_imu_check_samples();
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        gravity[i] = pbdrv_imu_core.gravity[i] >> pbdrv_imu_core.gravity_shift;
+    }
+
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbdrv_imu_get_up(int8_t *up) {
+    pbio_error_t err = pbdrv_imu_check_samples();
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    *up = pbdrv_imu_core.up;
+
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbdrv_imu_get_shakes(uint32_t *count, uint32_t *time) {
+    pbio_error_t err = pbdrv_imu_check_samples();
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    *count = pbdrv_imu_core.shake_count;
+    *time = pbdrv_imu_core.shake_time;
+
+    return PBIO_SUCCESS;
+}
+
+#endif // PBDRV_CONFIG_IMU
@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+// IMU driver for the ST LSM6DS3TR-C on an I2C bus
+//
+// The gyro and accelerometer run at the same rate and write to the hardware
+// FIFO of the sensor. The FIFO is drained on a timer, so no samples are lost
+// between reads and the interrupt pins of the sensor are not needed. All I2C
+// transfers are non-blocking.
+//
+// The sensor does not timestamp the samples in the FIFO, so the newest sample
+// gets the time when the FIFO status is read and older ones are spaced one
+// sample period apart before it.
+
+#include <pbdrv/config.h>
+
+#if PBDRV_CONFIG_IMU_LSM6DS3TR_C
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <contiki.h>
+
+#include <pbdrv/i2c.h>
+#include <pbdrv/imu.h>
+#include <pbio/error.h>
+#include <pbio/util.h>
+
+#include "../../src/processes.h"
+#include "imu.h"
+
+// 7-bit I2C address with SA0 low
+#define I2C_ADDR 0x6A
+
+// registers
+#define FIFO_CTRL3      0x08
+#define FIFO_CTRL5      0x0A
+#define WHO_AM_I        0x0F
+#define CTRL1_XL        0x10
+#define CTRL2_G         0x11
+#define CTRL3_C         0x12
+#define CTRL8_XL        0x17
+#define FIFO_STATUS1    0x3A
+#define FIFO_DATA_OUT_L 0x3E
+
+#define WHO_AM_I_VALUE 0x6A
+
+#define CTRL3_C_BDU         0x40 // block data update
+#define CTRL3_C_IF_INC      0x04 // register address auto increment
+#define CTRL3_C_SW_RESET    0x01
+
+#define CTRL8_XL_LPF2_XL_EN         0x80 // low-pass filter 2 on the accelerometer output
+#define CTRL8_XL_HPCF_XL_DIV_9      0x40 // LPF2 cutoff at ODR/9
+#define CTRL8_XL_INPUT_COMPOSITE    0x08 // low noise instead of low latency
+
+#define FIFO_STATUS2_DIFF_MASK  0x07
+#define FIFO_STATUS2_OVER_RUN   0x40
+#define FIFO_STATUS4_PATTERN_MASK 0x03
+
+// 416 Hz, +/-4 g
+#define CTRL1_XL_VALUE 0x68
+// 416 Hz, +/-2000 dps
+#define CTRL2_G_VALUE 0x6C
+// Low-noise accelerometer low-pass filter at ODR/9, about 46 Hz. This only
+// takes away noise, so that short peaks still reach the shake detector.
+// Gravity and tilt are filtered further in software by imu_core.c. The gyro
+// is not high-pass filtered, since that would take away slow turns along with
+// the bias. The attitude filter measures the bias at rest instead.
+#define CTRL8_XL_VALUE (CTRL8_XL_LPF2_XL_EN | CTRL8_XL_HPCF_XL_DIV_9 | CTRL8_XL_INPUT_COMPOSITE)
+// gyro and accelerometer without decimation
+#define FIFO_CTRL3_VALUE 0x09
+// 416 Hz, continuous mode
+#define FIFO_CTRL5_VALUE 0x36
+
+#define SAMPLE_PERIOD_US 2404   // 1 / 416 Hz
+#define GYRO_SCALE 70           // mdps/LSB at +/-2000 dps
+#define ACCEL_SCALE 122         // ug/LSB at +/-4 g
+
+// Each sample is gyro x, y, z followed by accel x, y, z in the FIFO
+#define SAMPLE_WORDS 6
+#define SAMPLE_SIZE (SAMPLE_WORDS * 2)
+
+// How often the FIFO is drained
+#define POLL_PERIOD_MS 10
+
+// Samples read from the FIFO in one transfer
+#define BURST_SAMPLES 16
+
+// configuration that is written after a reset
+static const uint8_t pbdrv_imu_init_regs[][2] = {
+    { CTRL3_C, CTRL3_C_BDU | CTRL3_C_IF_INC },
+    { CTRL1_XL, CTRL1_XL_VALUE },
+    { CTRL2_G, CTRL2_G_VALUE },
+    { CTRL8_XL, CTRL8_XL_VALUE },
+    { FIFO_CTRL3, FIFO_CTRL3_VALUE },
+    { FIFO_CTRL5, FIFO_CTRL5_VALUE },
+};
+
+typedef struct {
+    pbdrv_i2c_dev_t *i2c;
+    struct etimer timer;
+    struct pt child;
+    // current transfer
+    bool xfer_write;
+    uint8_t xfer_reg;
+    uint8_t *xfer_buf;
+    uint16_t xfer_length;
+    pbio_error_t xfer_err;
+    uint8_t reg_value;
+    uint8_t fifo_status[4];
+    uint8_t fifo_data[BURST_SAMPLES * SAMPLE_SIZE];
+    // samples that are still in the FIFO
+    uint16_t fifo_samples;
+    uint32_t fifo_time;
+    uint32_t overruns;
+} pbdrv_imu_t;
+
+static pbdrv_imu_t pbdrv_imu;
+
+static const pbdrv_imu_info_t pbdrv_imu_info = {
+    .period = SAMPLE_PERIOD_US,
+    .gyro_scale = GYRO_SCALE,
+    .accel_scale = ACCEL_SCALE,
+};
+
+PROCESS(pbdrv_imu_process, "IMU");
+
+static int16_t get_i16(const uint8_t *buf) {
+    return (int16_t)(buf[0] | buf[1] << 8);
+}
+
+// Adds samples from fifo_data to the ring buffer
+static void add_samples(uint16_t count) {
+    pbdrv_imu_sample_t sample;
+
+    for (uint16_t i = 0; i < count; i++) {
+        const uint8_t *buf = &pbdrv_imu.fifo_data[i * SAMPLE_SIZE];
+
+        pbdrv_imu.fifo_samples--;
+        sample.time = pbdrv_imu.fifo_time - pbdrv_imu.fifo_samples * SAMPLE_PERIOD_US;
+        for (int j = 0; j < 3; j++) {
+            sample.gyro[j] = get_i16(&buf[j * 2]);
+            sample.accel[j] = get_i16(&buf[6 + j * 2]);
+        }
+
+        pbdrv_imu_add_sample(&sample);
+    }
+}
+
+// Does the transfer that is set up in the xfer_* fields
+static PT_THREAD(pbdrv_imu_transfer(struct pt *pt)) {
+    pbdrv_imu_t *imu = &pbdrv_imu;
+
+    PT_BEGIN(pt);
+
+    PT_WAIT_UNTIL(pt, (imu->xfer_err = imu->xfer_write ?
+        pbdrv_i2c_write_begin(imu->i2c, I2C_ADDR, imu->xfer_reg, imu->xfer_buf, imu->xfer_length) :
+        pbdrv_i2c_read_begin(imu->i2c, I2C_ADDR, imu->xfer_reg, imu->xfer_buf, imu->xfer_length)) != PBIO_ERROR_AGAIN);
+
+    if (imu->xfer_err == PBIO_SUCCESS) {
+        PT_WAIT_UNTIL(pt, (imu->xfer_err = pbdrv_i2c_end(imu->i2c)) != PBIO_ERROR_AGAIN);
+    }
+
+    PT_END(pt);
+}
+
+// These must each be on a line of their own, since they wait
+#define READ_REGS(reg, buf, length) do { \
+        pbdrv_imu.xfer_write = false; \
+        pbdrv_imu.xfer_reg = (reg); \
+        pbdrv_imu.xfer_buf = (buf); \
+        pbdrv_imu.xfer_length = (length); \
+        PROCESS_PT_SPAWN(&pbdrv_imu.child, pbdrv_imu_transfer(&pbdrv_imu.child)); \
+} while (0)
+
+#define WRITE_REG(reg, value) do { \
+        pbdrv_imu.xfer_write = true; \
+        pbdrv_imu.xfer_reg = (reg); \
+        pbdrv_imu.reg_value = (value); \
+        pbdrv_imu.xfer_buf = &pbdrv_imu.reg_value; \
+        pbdrv_imu.xfer_length = 1; \
+        PROCESS_PT_SPAWN(&pbdrv_imu.child, pbdrv_imu_transfer(&pbdrv_imu.child)); \
+} while (0)
+
+PROCESS_THREAD(pbdrv_imu_process, ev, data) {
+    static uint16_t count;
+    static uint16_t skip;
+    static size_t i;
+
+    PROCESS_BEGIN();
+
+    while (pbdrv_i2c_get(PBDRV_CONFIG_IMU_LSM6DS3TR_C_I2C_ID, &pbdrv_imu.i2c) != PBIO_SUCCESS) {
+        etimer_set(&pbdrv_imu.timer, clock_from_msec(1));
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER && data == &pbdrv_imu.timer);
+    }
+
+    READ_REGS(WHO_AM_I, &pbdrv_imu.reg_value, 1);
+    if (pbdrv_imu.xfer_err != PBIO_SUCCESS || pbdrv_imu.reg_value != WHO_AM_I_VALUE) {
+        goto error;
+    }
+
+    // restore default configuration
+    WRITE_REG(CTRL3_C, CTRL3_C_SW_RESET);
+    do {
+        READ_REGS(CTRL3_C, &pbdrv_imu.reg_value, 1);
+        if (pbdrv_imu.xfer_err != PBIO_SUCCESS) {
+            goto error;
+        }
+    } while (pbdrv_imu.reg_value & CTRL3_C_SW_RESET);
+
+    for (i = 0; i < PBIO_ARRAY_SIZE(pbdrv_imu_init_regs); i++) {
+        WRITE_REG(pbdrv_imu_init_regs[i][0], pbdrv_imu_init_regs[i][1]);
+        if (pbdrv_imu.xfer_err != PBIO_SUCCESS) {
+            goto error;
+        }
+    }
+
+    pbdrv_imu_init_done(&pbdrv_imu_info);
+
+    etimer_set(&pbdrv_imu.timer, clock_from_msec(POLL_PERIOD_MS));
+
+    while (true) {
+        PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER && data == &pbdrv_imu.timer);
+        etimer_reset(&pbdrv_imu.timer);
+
+        READ_REGS(FIFO_STATUS1, pbdrv_imu.fifo_status, PBIO_ARRAY_SIZE(pbdrv_imu.fifo_status));
+        if (pbdrv_imu.xfer_err != PBIO_SUCCESS) {
+            continue;
+        }
+
+        pbdrv_imu.fifo_time = clock_usecs();
+        if (pbdrv_imu.fifo_status[1] & FIFO_STATUS2_OVER_RUN) {
+            pbdrv_imu.overruns++;
+        }
+
+        // Unread words in the FIFO. The pattern is the position of the next
+        // word in a sample. After an overrun, it may not be the first one.
+        count = (pbdrv_imu.fifo_status[1] & FIFO_STATUS2_DIFF_MASK) << 8 | pbdrv_imu.fifo_status[0];
+        skip = (pbdrv_imu.fifo_status[3] & FIFO_STATUS4_PATTERN_MASK) << 8 | pbdrv_imu.fifo_status[2];
+        if (skip != 0) {
+            skip = MIN(SAMPLE_WORDS - skip, count);
+            count -= skip;
+            READ_REGS(FIFO_DATA_OUT_L, pbdrv_imu.fifo_data, skip * 2);
+        }
+
+        // The register address wraps around from FIFO_DATA_OUT_H to
+        // FIFO_DATA_OUT_L, so many samples can be read at once.
+        pbdrv_imu.fifo_samples = count = count / SAMPLE_WORDS;
+        while (count > 0) {
+            READ_REGS(FIFO_DATA_OUT_L, pbdrv_imu.fifo_data, MIN(count, BURST_SAMPLES) * SAMPLE_SIZE);
+            if (pbdrv_imu.xfer_err != PBIO_SUCCESS) {
+                break;
+            }
+            add_samples(MIN(count, BURST_SAMPLES));
+            count -= MIN(count, BURST_SAMPLES);
+        }
+    }
+
+error:
+    pbdrv_imu_init_failed();
+
+    PROCESS_END();
+}
+
+#endif // PBDRV_CONFIG_IMU_LSM6DS3TR_C
@@ -496,6 +496,7 @@ PROCESS_THREAD(pbdrv_ioport_lpf2_process, ev, data) {
                 if (ioport->connected_type_id == PBIO_IODEV_TYPE_ID_LPF2_UNKNOWN_UART) {
                     ioport_enable_uart(ioport);
                     pbio_uartdev_get(i, &ioport->iodev);
+                    ioport->iodev->port = PBDRV_CONFIG_IOPORT_LPF2_FIRST_PORT + i;
                 } else if (ioport->connected_type_id == PBIO_IODEV_TYPE_ID_NONE) {
                     ioport->iodev = NULL;
                 } else {
@@ -15,6 +15,8 @@
 #include "pbio/config.h"
 #include "pbio/error.h"
 #include "pbio/event.h"
+#include "pbio/trace.h"
+#include "pbio/txbuf.h"
 #include "pbsys/sys.h"
 #include "../../src/processes.h"
 
@@ -73,12 +75,12 @@ static uint16_t pybricks_service_handle, pybricks_char_handle;
 
 // nRF UART GATT service handles
 static uint16_t uart_service_handle, uart_rx_char_handle, uart_tx_char_handle;
-// nRF UART tx is in progress
-static bool uart_tx_busy;
-// buffer to queue UART tx data
-static uint8_t uart_tx_buf[NRF_CHAR_SIZE];
-// bytes used in uart_tx_buf
-static uint8_t uart_tx_buf_size;
+// double buffer to queue UART tx data - one is filled while the other is sent
+static uint8_t uart_tx_data[2 * NRF_CHAR_SIZE];
+static pbio_txbuf_t uart_tx_buf;
+// notification that is being sent
+static const uint8_t *uart_tx_packet;
+static uint16_t uart_tx_packet_size;
 
 
 PROCESS(pbdrv_bluetooth_hci_process, "Bluetooth HCI");
@@ -91,6 +93,8 @@ static void bluetooth_init() {
     // set PB6 output low
     GPIOB->MODER = (GPIOB->MODER & ~GPIO_MODER_MODER6_Msk) | (1 << GPIO_MODER_MODER6_Pos);
     GPIOB->BRR = GPIO_BRR_BR_6;
+
+    pbio_txbuf_init(&uart_tx_buf, uart_tx_data, NRF_CHAR_SIZE);
 }
 
 static void spi_init() {
@@ -300,7 +304,9 @@ static void handle_event(hci_event_pckt *event) {
         case EVT_DISCONN_COMPLETE: {
             evt_disconn_complete *evt = (evt_disconn_complete *)event->data;
             if (conn_handle == evt->handle) {
+                pbio_trace(PBIO_TRACE_BLE_DISCONNECT, PBIO_PORT_NONE, conn_handle);
                 conn_handle = 0;
+                pbio_txbuf_clear(&uart_tx_buf);
             }
         }
         break;
@@ -313,6 +319,7 @@ static void handle_event(hci_event_pckt *event) {
                 case EVT_LE_CONN_COMPLETE: {
                     evt_le_connection_complete *subevt = (evt_le_connection_complete *)evt->data;
                     conn_handle = subevt->handle;
+                    pbio_trace(PBIO_TRACE_BLE_CONNECT, PBIO_PORT_NONE, conn_handle);
                 }
                 break;
             }
@@ -612,30 +619,31 @@ static PT_THREAD(set_discoverable(struct pt *pt)) {
     PT_END(pt);
 }
 
-pbio_error_t pbdrv_bluetooth_tx(uint8_t c) {
+pbio_error_t pbdrv_bluetooth_tx_buf(const uint8_t *data, uint32_t size, uint32_t *count) {
     // make sure we have a Bluetooth connection
     if (!conn_handle) {
         return PBIO_ERROR_INVALID_OP;
     }
 
-    // can't add the the buffer if tx is in progress or buffer is full
-    if (uart_tx_busy || uart_tx_buf_size == NRF_CHAR_SIZE) {
+    // data is added to the buffer that is not currently being sent
+    *count = pbio_txbuf_write(&uart_tx_buf, data, size);
+    if (*count == 0) {
         return PBIO_ERROR_AGAIN;
     }
 
-    // append the char
-    uart_tx_buf[uart_tx_buf_size] = c;
-    uart_tx_buf_size++;
-
-    // poke the process to start tx soon-ish. This way, we can accumulate up to
-    // NRF_CHAR_SIZE bytes before actually transmitting
-    // TODO: it probably would be better to poll here instead of using events
-    // so that we don't fill up the event queue with 20 events
-    process_post(&pbdrv_bluetooth_hci_process, PROCESS_EVENT_MSG, NULL);
+    // poke the process to start tx soon-ish. This way, we can accumulate more
+    // data while the previous notification is still being sent.
+    process_poll(&pbdrv_bluetooth_hci_process);
 
     return PBIO_SUCCESS;
 }
 
+pbio_error_t pbdrv_bluetooth_tx(uint8_t c) {
+    uint32_t count;
+
+    return pbdrv_bluetooth_tx_buf(&c, 1, &count);
+}
+
 static PT_THREAD(uart_service_send_data(struct pt *pt))
 {
     tBleStatus ret;
@@ -645,7 +653,7 @@ static PT_THREAD(uart_service_send_data(struct pt *pt))
 retry:
     PT_WAIT_WHILE(pt, write_xfer_size);
     aci_gatt_update_char_value_begin(uart_service_handle, uart_tx_char_handle,
-        0, uart_tx_buf_size, uart_tx_buf);
+        0, uart_tx_packet_size, uart_tx_packet);
     PT_WAIT_UNTIL(pt, hci_command_complete);
     ret = aci_gatt_update_char_value_end();
 
@@ -697,11 +705,10 @@ PROCESS_THREAD(pbdrv_bluetooth_hci_process, ev, data) {
                 // just occasionally checking to see if we are still connected
                 continue;
             }
-            if (ev == PROCESS_EVENT_MSG && uart_tx_buf_size) {
-                uart_tx_busy = true;
+            // swap buffers so that new data can be queued while sending
+            while (pbio_txbuf_send_begin(&uart_tx_buf, &uart_tx_packet, &uart_tx_packet_size)) {
                 PROCESS_PT_SPAWN(&child_pt, uart_service_send_data(&child_pt));
-                uart_tx_busy = false;
-                uart_tx_buf_size = 0;
+                pbio_txbuf_send_end(&uart_tx_buf);
             }
         }
 
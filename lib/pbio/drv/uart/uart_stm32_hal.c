@@ -20,9 +20,32 @@
 #include STM32_HAL_H
 #include "uart_stm32_hal.h"
 
+// The HAL is only used for transmitting. Received bytes are queued in a ring
+// buffer so that nothing is lost between reads. If the platform gives a DMA
+// stream, it fills the ring buffer in circular mode and the UART process is
+// polled when the line goes idle and when the DMA is at the middle or the end
+// of the buffer. Otherwise, the interrupt handler queues each byte and the
+// process is polled when the line goes idle, when a pending read can be
+// completed or when the ring buffer is half full.
+
+#define UART_RING_BUF_SIZE 64   // must be a power of 2!
+
+#ifdef USART_SR_RXNE
+#define UART_RX_DATA(huart) ((huart)->Instance->DR)
+#else
+#define UART_RX_DATA(huart) ((huart)->Instance->RDR)
+#endif
+
 typedef struct {
     pbdrv_uart_dev_t uart_dev;
     UART_HandleTypeDef huart;
+    DMA_Stream_TypeDef *rx_dma;
+    volatile uint8_t rx_ring_buf[UART_RING_BUF_SIZE];
+    volatile uint8_t rx_ring_buf_head;
+    uint8_t rx_ring_buf_tail;
+    uint8_t *rx_buf;
+    uint8_t rx_buf_size;
+    uint8_t rx_buf_index;
     struct etimer rx_timer;
     struct etimer tx_timer;
     volatile pbio_error_t rx_result;
@@ -34,6 +57,14 @@ static pbdrv_uart_t pbdrv_uart[PBDRV_CONFIG_UART_STM32_HAL_NUM_UART];
 
 PROCESS(pbdrv_uart_process, "UART");
 
+// Position in the ring buffer where the next received byte will go
+static uint8_t pbdrv_uart_rx_head(pbdrv_uart_t *uart) {
+    if (uart->rx_dma) {
+        return (UART_RING_BUF_SIZE - uart->rx_dma->NDTR) & (UART_RING_BUF_SIZE - 1);
+    }
+    return uart->rx_ring_buf_head;
+}
+
 pbio_error_t pbdrv_uart_get(uint8_t id, pbdrv_uart_dev_t **uart_dev) {
     if (id >= PBDRV_CONFIG_UART_STM32_HAL_NUM_UART) {
         return PBIO_ERROR_INVALID_ARG;
@@ -50,40 +81,51 @@ pbio_error_t pbdrv_uart_get(uint8_t id, pbdrv_uart_dev_t **uart_dev) {
 
 pbio_error_t pbdrv_uart_read_begin(pbdrv_uart_dev_t *uart_dev, uint8_t *msg, uint8_t length, uint32_t timeout) {
     pbdrv_uart_t *uart = PBIO_CONTAINER_OF(uart_dev, pbdrv_uart_t, uart_dev);
-    HAL_StatusTypeDef ret;
-
-    if (uart->huart.RxState != HAL_UART_STATE_READY) {
-        return PBIO_ERROR_AGAIN;
-    }
-
-    // can't receive if overrun flag is set
-    __HAL_UART_CLEAR_OREFLAG(&uart->huart);
 
-    ret = HAL_UART_Receive_IT(&uart->huart, msg, length);
-    if (ret == HAL_ERROR) {
+    if (!msg || !length) {
         return PBIO_ERROR_INVALID_ARG;
     }
-    if (ret == HAL_BUSY) {
+
+    if (uart->rx_buf) {
         return PBIO_ERROR_AGAIN;
     }
 
-    etimer_set(&uart->rx_timer, clock_from_msec(timeout));
+    uart->rx_buf = msg;
+    uart->rx_buf_size = length;
+    uart->rx_buf_index = 0;
     uart->rx_result = PBIO_ERROR_AGAIN;
 
+    etimer_set(&uart->rx_timer, clock_from_msec(timeout));
+
     return PBIO_SUCCESS;
 }
 
 pbio_error_t pbdrv_uart_read_end(pbdrv_uart_dev_t *uart_dev) {
     pbdrv_uart_t *uart = PBIO_CONTAINER_OF(uart_dev, pbdrv_uart_t, uart_dev);
-    pbio_error_t err = uart->rx_result; // read once since interrupt can modify it
+
+    if (uart->rx_buf == NULL) {
+        // begin was not called first
+        return PBIO_ERROR_INVALID_OP;
+    }
+
+    // copy all available bytes to rx_buf
+    uint8_t head = pbdrv_uart_rx_head(uart);
+    while (uart->rx_result == PBIO_ERROR_AGAIN && head != uart->rx_ring_buf_tail) {
+        uart->rx_buf[uart->rx_buf_index++] = uart->rx_ring_buf[uart->rx_ring_buf_tail];
+        uart->rx_ring_buf_tail = (uart->rx_ring_buf_tail + 1) & (UART_RING_BUF_SIZE - 1);
+        if (uart->rx_buf_index == uart->rx_buf_size) {
+            uart->rx_result = PBIO_SUCCESS;
+        }
+    }
+
+    pbio_error_t err = uart->rx_result;
 
     if (err != PBIO_ERROR_AGAIN) {
         etimer_stop(&uart->rx_timer);
+        uart->rx_buf = NULL;
     } else if (etimer_expired(&uart->rx_timer)) {
-        // NB: This function can be blocking when using DMA - if we switch to
-        // DMA, the timout will need to be reworked.
-        HAL_UART_AbortReceive(&uart->huart);
         err = PBIO_ERROR_TIMEDOUT;
+        uart->rx_buf = NULL;
     }
 
     return err;
@@ -92,7 +134,28 @@ pbio_error_t pbdrv_uart_read_end(pbdrv_uart_dev_t *uart_dev) {
 void pbdrv_uart_read_cancel(pbdrv_uart_dev_t *uart_dev) {
     pbdrv_uart_t *uart = PBIO_CONTAINER_OF(uart_dev, pbdrv_uart_t, uart_dev);
 
-    HAL_UART_AbortReceive_IT(&uart->huart);
+    uart->rx_result = PBIO_ERROR_CANCELED;
+    process_poll(&pbdrv_uart_process);
+}
+
+pbio_error_t pbdrv_uart_read_available(pbdrv_uart_dev_t *uart_dev, uint8_t *buf, uint8_t size, uint8_t *count) {
+    pbdrv_uart_t *uart = PBIO_CONTAINER_OF(uart_dev, pbdrv_uart_t, uart_dev);
+    uint8_t i = 0;
+
+    if (uart->rx_buf) {
+        // bytes belong to the pending read
+        return PBIO_ERROR_AGAIN;
+    }
+
+    uint8_t head = pbdrv_uart_rx_head(uart);
+    while (i < size && head != uart->rx_ring_buf_tail) {
+        buf[i++] = uart->rx_ring_buf[uart->rx_ring_buf_tail];
+        uart->rx_ring_buf_tail = (uart->rx_ring_buf_tail + 1) & (UART_RING_BUF_SIZE - 1);
+    }
+
+    *count = i;
+
+    return PBIO_SUCCESS;
 }
 
 pbio_error_t pbdrv_uart_write_begin(pbdrv_uart_dev_t *uart_dev, uint8_t *msg, uint8_t length, uint32_t timeout) {
@@ -135,43 +198,49 @@ void pbdrv_uart_write_cancel(pbdrv_uart_dev_t *uart_dev) {
     HAL_UART_AbortTransmit_IT(&uart->huart);
 }
 
+// Clears all interrupt flags of a DMA stream. The flags of streams 0 to 3 are
+// in LIFCR and those of streams 4 to 7 in HIFCR, at the same offsets.
+static void pbdrv_uart_rx_dma_clear_flags(DMA_Stream_TypeDef *stream) {
+    static const uint8_t shift[] = { 0, 6, 16, 22 };
+    DMA_TypeDef *dma = (DMA_TypeDef *)((uint32_t)stream & ~0xFFU);
+    uint32_t num = (((uint32_t)stream & 0xFFU) - 0x10U) / 0x18U;
+    uint32_t flags = (DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 |
+        DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0) << shift[num & 3];
+
+    if (num < 4) {
+        dma->LIFCR = flags;
+    } else {
+        dma->HIFCR = flags;
+    }
+}
+
+// Enables reception after the UART has been (re)initialized
+static void pbdrv_uart_rx_start(pbdrv_uart_t *uart) {
+    if (uart->rx_dma) {
+        SET_BIT(uart->huart.Instance->CR3, USART_CR3_DMAR);
+    } else {
+        __HAL_UART_ENABLE_IT(&uart->huart, UART_IT_RXNE);
+    }
+    __HAL_UART_ENABLE_IT(&uart->huart, UART_IT_IDLE);
+}
+
 pbio_error_t pbdrv_uart_set_baud_rate(pbdrv_uart_dev_t *uart_dev, uint32_t baud) {
     pbdrv_uart_t *uart = PBIO_CONTAINER_OF(uart_dev, pbdrv_uart_t, uart_dev);
 
-    if (HAL_UART_GetState(&uart->huart) != HAL_UART_STATE_READY) {
+    if (HAL_UART_GetState(&uart->huart) != HAL_UART_STATE_READY || uart->rx_buf) {
         return PBIO_ERROR_AGAIN;
     }
 
     uart->huart.Init.BaudRate = baud;
     // REVISIT: This is a potentially blocking function
     HAL_UART_Init(&uart->huart);
+    pbdrv_uart_rx_start(uart);
 
     return PBIO_SUCCESS;
 }
 
 // overrides weak function in stm32f4xx_hal_uart.c
 void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
-    pbdrv_uart_t *uart = PBIO_CONTAINER_OF(huart, pbdrv_uart_t, huart);
-
-    if (uart->huart.ErrorCode & HAL_UART_ERROR_ORE) {
-        uart->rx_result = PBIO_ERROR_IO;
-    }
-    process_poll(&pbdrv_uart_process);
-}
-
-// overrides weak function in stm32f4xx_hal_uart.c
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
-    pbdrv_uart_t *uart = PBIO_CONTAINER_OF(huart, pbdrv_uart_t, huart);
-
-    uart->rx_result = PBIO_SUCCESS;
-    process_poll(&pbdrv_uart_process);
-}
-
-// overrides weak function in stm32f4xx_hal_uart.c
-void HAL_UART_AbortReceiveCpltCallback(UART_HandleTypeDef *huart) {
-    pbdrv_uart_t *uart = PBIO_CONTAINER_OF(huart, pbdrv_uart_t, huart);
-
-    uart->rx_result = PBIO_ERROR_CANCELED;
     process_poll(&pbdrv_uart_process);
 }
 
@@ -192,7 +261,41 @@ void HAL_UART_AbortTransmitCpltCallback(UART_HandleTypeDef *huart) {
 }
 
 void pbdrv_uart_stm32_hal_handle_irq(uint8_t id) {
-    HAL_UART_IRQHandler(&pbdrv_uart[id].huart);
+    pbdrv_uart_t *uart = &pbdrv_uart[id];
+    UART_HandleTypeDef *huart = &uart->huart;
+
+    // receive next byte - this also clears the overrun flag, so the HAL
+    // handler below does not abort reception. With DMA, the byte is left for
+    // the DMA to take.
+    if (!uart->rx_dma && __HAL_UART_GET_FLAG(huart, UART_FLAG_RXNE)) {
+        // REVISIT: Do we need to have an overrun error when the ring buffer gets full?
+        uart->rx_ring_buf[uart->rx_ring_buf_head] = UART_RX_DATA(huart);
+        uart->rx_ring_buf_head = (uart->rx_ring_buf_head + 1) & (UART_RING_BUF_SIZE - 1);
+
+        uint8_t count = (uart->rx_ring_buf_head - uart->rx_ring_buf_tail) & (UART_RING_BUF_SIZE - 1);
+        if (count >= UART_RING_BUF_SIZE / 2 || (uart->rx_buf && count >= uart->rx_buf_size - uart->rx_buf_index)) {
+            process_poll(&pbdrv_uart_process);
+        }
+    }
+
+    // End of a burst of data. On STM32F4, the flag is cleared by reading SR
+    // and then DR, so this must wait until the received byte has been taken
+    // out of DR, or it would be lost. The interrupt stays pending until then.
+    if (__HAL_UART_GET_FLAG(huart, UART_FLAG_IDLE) && !__HAL_UART_GET_FLAG(huart, UART_FLAG_RXNE)) {
+        __HAL_UART_CLEAR_IDLEFLAG(huart);
+        process_poll(&pbdrv_uart_process);
+    }
+
+    // transmit
+    HAL_UART_IRQHandler(huart);
+}
+
+void pbdrv_uart_stm32_hal_handle_rx_dma_irq(uint8_t id) {
+    pbdrv_uart_t *uart = &pbdrv_uart[id];
+
+    // half or whole ring buffer was filled
+    pbdrv_uart_rx_dma_clear_flags(uart->rx_dma);
+    process_poll(&pbdrv_uart_process);
 }
 
 static void handle_poll() {
@@ -204,6 +307,10 @@ static void handle_exit() {
         pbdrv_uart_t *uart = &pbdrv_uart[i];
         HAL_NVIC_DisableIRQ(uart->irq);
         HAL_UART_DeInit(&uart->huart);
+        if (uart->rx_dma) {
+            HAL_NVIC_DisableIRQ(pbdrv_uart_stm32_hal_platform_data[i].rx_dma_irq);
+            CLEAR_BIT(uart->rx_dma->CR, DMA_SxCR_EN);
+        }
     }
 }
 
@@ -230,6 +337,25 @@ PROCESS_THREAD(pbdrv_uart_process, ev, data) {
         uart->huart.Init.OverSampling = UART_OVERSAMPLING_16,
         uart->irq = pdata->irq,
         HAL_UART_Init(&pbdrv_uart[i].huart);
+
+        if (pdata->rx_dma) {
+            // peripheral to memory, bytes, circular, interrupt at half and end
+            uart->rx_dma = pdata->rx_dma;
+            CLEAR_BIT(uart->rx_dma->CR, DMA_SxCR_EN);
+            while (READ_BIT(uart->rx_dma->CR, DMA_SxCR_EN)) {
+            }
+            pbdrv_uart_rx_dma_clear_flags(uart->rx_dma);
+            uart->rx_dma->PAR = (uint32_t)&UART_RX_DATA(&uart->huart);
+            uart->rx_dma->M0AR = (uint32_t)uart->rx_ring_buf;
+            uart->rx_dma->NDTR = UART_RING_BUF_SIZE;
+            uart->rx_dma->FCR = 0;
+            uart->rx_dma->CR = pdata->rx_dma_ch | DMA_SxCR_MINC | DMA_SxCR_CIRC |
+                DMA_SxCR_HTIE | DMA_SxCR_TCIE | DMA_SxCR_EN;
+            HAL_NVIC_SetPriority(pdata->rx_dma_irq, 1, 1);
+            HAL_NVIC_EnableIRQ(pdata->rx_dma_irq);
+        }
+
+        pbdrv_uart_rx_start(uart);
         HAL_NVIC_SetPriority(uart->irq, 1, 0);
         HAL_NVIC_EnableIRQ(uart->irq);
     }
@@ -11,11 +11,17 @@
 typedef struct {
     USART_TypeDef *uart;
     uint8_t irq;
+    // DMA stream that receives in circular mode or NULL to receive each byte
+    // in the UART interrupt instead
+    DMA_Stream_TypeDef *rx_dma;
+    uint32_t rx_dma_ch;
+    uint8_t rx_dma_irq;
 } pbdrv_uart_stm32_hal_platform_data_t;
 
 extern const pbdrv_uart_stm32_hal_platform_data_t
     pbdrv_uart_stm32_hal_platform_data[PBDRV_CONFIG_UART_STM32_HAL_NUM_UART];
 
 void pbdrv_uart_stm32_hal_handle_irq(uint8_t id);
+void pbdrv_uart_stm32_hal_handle_rx_dma_irq(uint8_t id);
 
 #endif // _UART_STM32_HAL_H_
@@ -5,7 +5,9 @@
 // functions for sending and receive data and allows changing the baud rate.
 // There are no hardware buffers on the UARTs, so we implement a ring buffer
 // to queue received data until it is read. No extra buffering is needed for
-// transmitting.
+// transmitting. To avoid waking up the UART process on every byte, it is only
+// polled when the line goes idle, when a pending read can be completed or when
+// the ring buffer is half full.
 
 #include "pbdrv/config.h"
 
@@ -26,7 +28,7 @@
 #include "stm32f0xx.h"
 #include "uart_stm32f0.h"
 
-#define UART_RING_BUF_SIZE 32   // must be a power of 2!
+#define UART_RING_BUF_SIZE 64   // must be a power of 2!
 
 typedef struct {
     pbdrv_uart_dev_t uart_dev;
@@ -115,6 +117,25 @@ void pbdrv_uart_read_cancel(pbdrv_uart_dev_t *uart_dev) {
     uart->rx_result = PBIO_ERROR_CANCELED;
 }
 
+pbio_error_t pbdrv_uart_read_available(pbdrv_uart_dev_t *uart_dev, uint8_t *buf, uint8_t size, uint8_t *count) {
+    pbdrv_uart_t *uart = PBIO_CONTAINER_OF(uart_dev, pbdrv_uart_t, uart_dev);
+    uint8_t i = 0;
+
+    if (uart->rx_buf) {
+        // bytes belong to the pending read
+        return PBIO_ERROR_AGAIN;
+    }
+
+    while (i < size && uart->rx_ring_buf_head != uart->rx_ring_buf_tail) {
+        buf[i++] = uart->rx_ring_buf[uart->rx_ring_buf_tail];
+        uart->rx_ring_buf_tail = (uart->rx_ring_buf_tail + 1) & (UART_RING_BUF_SIZE - 1);
+    }
+
+    *count = i;
+
+    return PBIO_SUCCESS;
+}
+
 pbio_error_t pbdrv_uart_write_begin(pbdrv_uart_dev_t *uart_dev, uint8_t *msg, uint8_t length, uint32_t timeout) {
     pbdrv_uart_t *uart = PBIO_CONTAINER_OF(uart_dev, pbdrv_uart_t, uart_dev);
 
@@ -186,6 +207,16 @@ void pbdrv_uart_stm32f0_handle_irq(uint8_t id) {
         // REVISIT: Do we need to have an overrun error when the ring buffer gets full?
         uart->rx_ring_buf[uart->rx_ring_buf_head] = uart->USART->RDR;
         uart->rx_ring_buf_head = (uart->rx_ring_buf_head + 1) & (UART_RING_BUF_SIZE - 1);
+
+        uint8_t count = (uart->rx_ring_buf_head - uart->rx_ring_buf_tail) & (UART_RING_BUF_SIZE - 1);
+        if (count >= UART_RING_BUF_SIZE / 2 || (uart->rx_buf && count >= uart->rx_buf_size - uart->rx_buf_index)) {
+            process_poll(&pbdrv_uart_process);
+        }
+    }
+
+    // end of a burst of data
+    if (uart->USART->ISR & USART_ISR_IDLE) {
+        uart->USART->ICR = USART_ICR_IDLECF;
         process_poll(&pbdrv_uart_process);
     }
 
@@ -224,6 +255,9 @@ static void handle_poll() {
                     break;
                 }
             }
+        } else if (!uart->rx_buf && uart->rx_ring_buf_head != uart->rx_ring_buf_tail) {
+            // let users of pbdrv_uart_read_available() know there is new data
+            process_post(PROCESS_BROADCAST, PROCESS_EVENT_COM, NULL);
         }
 
         if (uart->tx_buf && uart->tx_buf_index == uart->tx_buf_size) {
@@ -254,7 +288,7 @@ PROCESS_THREAD(pbdrv_uart_process, ev, data) {
         uart->irq = pdata->irq,
 
         uart->USART->CR3 |= USART_CR3_OVRDIS;
-        uart->USART->CR1 |= USART_CR1_RXNEIE | USART_CR1_TE | USART_CR1_RE | USART_CR1_UE;
+        uart->USART->CR1 |= USART_CR1_RXNEIE | USART_CR1_IDLEIE | USART_CR1_TE | USART_CR1_RE | USART_CR1_UE;
         NVIC_SetPriority(uart->irq, 0);
         NVIC_EnableIRQ(uart->irq);
 
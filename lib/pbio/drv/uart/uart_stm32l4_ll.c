@@ -78,16 +78,34 @@ static void volatile_copy(volatile uint8_t *src, uint8_t *dst, uint8_t size) {
     }
 }
 
-pbio_error_t pbdrv_uart_read_end(pbdrv_uart_dev_t *uart_dev) {
-    pbdrv_uart_t *uart = PBIO_CONTAINER_OF(uart_dev, pbdrv_uart_t, uart_dev);
+// returns the number of bytes that DMA has written to the ring buffer but that
+// have not been read yet
+static uint32_t rx_available(pbdrv_uart_t *uart) {
     const pbdrv_uart_stm32l4_ll_platform_data_t *pdata = uart->pdata;
-    uint32_t rx_head;
 
     // head is the last position that DMA wrote to
-    rx_head = RX_DATA_SIZE - LL_DMA_GetDataLength(pdata->rx_dma, pdata->rx_dma_ch);
+    uint32_t rx_head = RX_DATA_SIZE - LL_DMA_GetDataLength(pdata->rx_dma, pdata->rx_dma_ch);
+
+    return (rx_head - uart->rx_tail) & (RX_DATA_SIZE - 1);
+}
+
+// copies bytes from the ring buffer, caller must ensure that size <= rx_available()
+static void rx_copy(pbdrv_uart_t *uart, uint8_t *buf, uint8_t size) {
+    if (uart->rx_tail + size > RX_DATA_SIZE) {
+        uint32_t partial_size = RX_DATA_SIZE - uart->rx_tail;
+        volatile_copy(&uart->rx_data[uart->rx_tail], &buf[0], partial_size);
+        volatile_copy(&uart->rx_data[0], &buf[partial_size], size - partial_size);
+    } else {
+        volatile_copy(&uart->rx_data[uart->rx_tail], &buf[0], size);
+    }
+
+    uart->rx_tail = (uart->rx_tail + size) & (RX_DATA_SIZE - 1);
+}
 
-    uint32_t available = (rx_head - uart->rx_tail) & (RX_DATA_SIZE - 1);
-    if (available < uart->read_length) {
+pbio_error_t pbdrv_uart_read_end(pbdrv_uart_dev_t *uart_dev) {
+    pbdrv_uart_t *uart = PBIO_CONTAINER_OF(uart_dev, pbdrv_uart_t, uart_dev);
+
+    if (rx_available(uart) < uart->read_length) {
         if (etimer_expired(&uart->rx_timer)) {
             uart->read_buf = NULL;
             uart->read_length = 0;
@@ -96,15 +114,7 @@ pbio_error_t pbdrv_uart_read_end(pbdrv_uart_dev_t *uart_dev) {
         return PBIO_ERROR_AGAIN;
     }
 
-    if (uart->rx_tail + uart->read_length > RX_DATA_SIZE) {
-        uint32_t partial_size = RX_DATA_SIZE - uart->rx_tail;
-        volatile_copy(&uart->rx_data[uart->rx_tail], &uart->read_buf[0], partial_size);
-        volatile_copy(&uart->rx_data[0], &uart->read_buf[partial_size], uart->read_length - partial_size);
-    } else {
-        volatile_copy(&uart->rx_data[uart->rx_tail], &uart->read_buf[0], uart->read_length);
-    }
-
-    uart->rx_tail = (uart->rx_tail + uart->read_length) & (RX_DATA_SIZE - 1);
+    rx_copy(uart, uart->read_buf, uart->read_length);
     uart->read_buf = NULL;
     uart->read_length = 0;
 
@@ -113,6 +123,21 @@ pbio_error_t pbdrv_uart_read_end(pbdrv_uart_dev_t *uart_dev) {
     return PBIO_SUCCESS;
 }
 
+pbio_error_t pbdrv_uart_read_available(pbdrv_uart_dev_t *uart_dev, uint8_t *buf, uint8_t size, uint8_t *count) {
+    pbdrv_uart_t *uart = PBIO_CONTAINER_OF(uart_dev, pbdrv_uart_t, uart_dev);
+
+    if (uart->read_buf) {
+        // bytes belong to the pending read
+        return PBIO_ERROR_AGAIN;
+    }
+
+    uint32_t available = rx_available(uart);
+    *count = available < size ? available : size;
+    rx_copy(uart, buf, *count);
+
+    return PBIO_SUCCESS;
+}
+
 void pbdrv_uart_read_cancel(pbdrv_uart_dev_t *uart_dev) {
     // TODO
 }
@@ -27,12 +27,33 @@
  */
 pbio_error_t pbdrv_bluetooth_tx(uint8_t c);
 
+/**
+ * Queues data to be transmitted via Bluetooth serial port. Data is sent in
+ * notifications as large as the negotiated MTU allows. More data can be
+ * queued while the previous notification is still being sent.
+ * @param data [in]     the data to be sent.
+ * @param size [in]     the size of *data* in bytes.
+ * @param count [out]   the number of bytes that were queued.
+ * @return              ::PBIO_SUCCESS if one or more bytes were queued,
+ *                      ::PBIO_ERROR_AGAIN if no bytes could be queued at this
+ *                      time (e.g. buffer is full), ::PBIO_ERROR_INVALID_OP if
+ *                      there is not an active Bluetooth connection or
+ *                      ::PBIO_ERROR_NOT_SUPPORTED if this platform does not
+ *                      support Bluetooth.
+ */
+pbio_error_t pbdrv_bluetooth_tx_buf(const uint8_t *data, uint32_t size, uint32_t *count);
+
 #else // PBDRV_CONFIG_BLUETOOTH
 
 static inline pbio_error_t pbdrv_bluetooth_tx(uint8_t c) {
     return PBIO_ERROR_NOT_SUPPORTED;
 }
 
+static inline pbio_error_t pbdrv_bluetooth_tx_buf(const uint8_t *data, uint32_t size, uint32_t *count) {
+    *count = 0;
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+
 #endif // PBDRV_CONFIG_BLUETOOTH
 
 #endif // _PBDRV_BLUETOOTH_H_
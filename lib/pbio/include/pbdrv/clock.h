@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+/**
+ * \addtogroup ClockDriver Clock driver
+ * @{
+ */
+
+#ifndef _PBDRV_CLOCK_H_
+#define _PBDRV_CLOCK_H_
+
+#include <stdint.h>
+
+#include <pbdrv/config.h>
+
+#if PBDRV_CONFIG_CLOCK_TICKLESS
+
+/**
+ * Waits for an interrupt, but for no longer than *ticks* clock ticks. The
+ * clock stops interrupting every tick in the meantime, so the CPU can sleep
+ * the whole time. Returns right away if a Contiki event is already pending.
+ * @param [in]  ticks   The maximum number of clock ticks to wait
+ */
+void pbdrv_clock_idle(uint32_t ticks);
+
+#else
+
+static inline void pbdrv_clock_idle(uint32_t ticks) {
+}
+
+#endif
+
+#endif // _PBDRV_CLOCK_H_
+
+/** @}*/
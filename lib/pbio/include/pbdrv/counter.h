@@ -23,6 +23,7 @@ pbio_error_t pbdrv_counter_get(uint8_t id, pbdrv_counter_dev_t **dev);
 pbio_error_t pbdrv_counter_get_count(pbdrv_counter_dev_t *dev, int32_t *count);
 pbio_error_t pbdrv_counter_get_abs_count(pbdrv_counter_dev_t *dev, int32_t *count);
 pbio_error_t pbdrv_counter_get_rate(pbdrv_counter_dev_t *dev, int32_t *rate);
+pbio_error_t pbdrv_counter_get_state(pbdrv_counter_dev_t *dev, int32_t *count, int32_t *rate);
 
 #if !PBDRV_CONFIG_COUNTER_NUM_DEV
 #error Must define PBDRV_CONFIG_COUNTER_NUM_DEV
@@ -46,6 +47,11 @@ static inline pbio_error_t pbdrv_counter_get_rate(pbdrv_counter_dev_t *dev, int3
     *rate = 0;
     return PBIO_ERROR_NOT_SUPPORTED;
 }
+static inline pbio_error_t pbdrv_counter_get_state(pbdrv_counter_dev_t *dev, int32_t *count, int32_t *rate) {
+    *count = 0;
+    *rate = 0;
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
 
 #endif // PBDRV_CONFIG_COUNTER
 
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+/**
+ * \addtogroup I2CDriver I2C I/O driver
+ *
+ * Non-blocking register access to devices on an I2C bus. A transfer is
+ * started with one of the *_begin() functions and then pbdrv_i2c_end() is
+ * called until it no longer returns ::PBIO_ERROR_AGAIN. A ::PROCESS_EVENT_COM
+ * event is broadcast when a transfer completes.
+ * @{
+ */
+
+#ifndef _PBDRV_I2C_H_
+#define _PBDRV_I2C_H_
+
+#include <stdint.h>
+
+#include <pbdrv/config.h>
+#include <pbio/error.h>
+
+typedef struct {
+
+} pbdrv_i2c_dev_t;
+
+#if PBDRV_CONFIG_I2C
+
+pbio_error_t pbdrv_i2c_get(uint8_t id, pbdrv_i2c_dev_t **i2c_dev);
+
+/**
+ * Starts reading consecutive registers.
+ * @param [in]  i2c     The I2C device
+ * @param [in]  addr    The 7-bit address of the peripheral
+ * @param [in]  reg     The first register to read
+ * @param [out] buf     Buffer for the data, must remain valid until the
+ *                      transfer is complete
+ * @param [in]  length  The number of bytes to read
+ * @return              ::PBIO_SUCCESS if the transfer was started or
+ *                      ::PBIO_ERROR_AGAIN if another transfer is in progress.
+ */
+pbio_error_t pbdrv_i2c_read_begin(pbdrv_i2c_dev_t *i2c, uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t length);
+
+/**
+ * Starts writing consecutive registers.
+ * @param [in]  i2c     The I2C device
+ * @param [in]  addr    The 7-bit address of the peripheral
+ * @param [in]  reg     The first register to write
+ * @param [in]  buf     The data, must remain valid until the transfer is
+ *                      complete
+ * @param [in]  length  The number of bytes to write
+ * @return              ::PBIO_SUCCESS if the transfer was started or
+ *                      ::PBIO_ERROR_AGAIN if another transfer is in progress.
+ */
+pbio_error_t pbdrv_i2c_write_begin(pbdrv_i2c_dev_t *i2c, uint8_t addr, uint8_t reg, const uint8_t *buf, uint16_t length);
+
+/**
+ * Gets the result of the transfer that was started last.
+ * @param [in]  i2c     The I2C device
+ * @return              ::PBIO_ERROR_AGAIN while the transfer is in progress,
+ *                      ::PBIO_SUCCESS when it is done, ::PBIO_ERROR_IO if
+ *                      the peripheral did not respond or
+ *                      ::PBIO_ERROR_TIMEDOUT if the bus is stuck.
+ */
+pbio_error_t pbdrv_i2c_end(pbdrv_i2c_dev_t *i2c);
+
+#else // PBDRV_CONFIG_I2C
+
+static inline pbio_error_t pbdrv_i2c_get(uint8_t id, pbdrv_i2c_dev_t **i2c_dev) {
+    *i2c_dev = NULL;
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+static inline pbio_error_t pbdrv_i2c_read_begin(pbdrv_i2c_dev_t *i2c, uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t length) {
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+static inline pbio_error_t pbdrv_i2c_write_begin(pbdrv_i2c_dev_t *i2c, uint8_t addr, uint8_t reg, const uint8_t *buf, uint16_t length) {
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+static inline pbio_error_t pbdrv_i2c_end(pbdrv_i2c_dev_t *i2c) {
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+
+#endif // PBDRV_CONFIG_I2C
+
+#endif // _PBDRV_I2C_H_
+
+/** @}*/
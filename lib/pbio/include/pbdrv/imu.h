@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+/**
+ * \addtogroup IMUDriver Inertial measurement unit driver
+ *
+ * The IMU driver samples the gyro and accelerometer in the background at a
+ * fixed rate and keeps the most recent samples in a ring buffer, so that
+ * consumers can process every sample even if they run less often. Gravity,
+ * tilt and shaking are derived from each sample as it arrives.
+ * @{
+ */
+
+#ifndef _PBDRV_IMU_H_
+#define _PBDRV_IMU_H_
+
+#include <stdint.h>
+
+#include <pbdrv/config.h>
+#include <pbio/error.h>
+
+/** One sample of all axes. */
+typedef struct {
+    /** Time when the sample was taken, in microseconds (same as clock_usecs()). */
+    uint32_t time;
+    /** Raw angular rate around the x, y and z axes. */
+    int16_t gyro[3];
+    /** Raw acceleration along the x, y and z axes. */
+    int16_t accel[3];
+} pbdrv_imu_sample_t;
+
+/** Properties of the samples. */
+typedef struct {
+    /** Time between samples, in microseconds. */
+    uint32_t period;
+    /** Angular rate per unit of pbdrv_imu_sample_t::gyro, in millidegrees per
+     * second, or 0 if there is no gyro. */
+    uint32_t gyro_scale;
+    /** Acceleration per unit of pbdrv_imu_sample_t::accel, in micro g. */
+    uint32_t accel_scale;
+} pbdrv_imu_info_t;
+
+#if PBDRV_CONFIG_IMU
+
+/**
+ * Gets the properties of the samples.
+ * @param [out] info    The properties
+ * @return              ::PBIO_SUCCESS on success, ::PBIO_ERROR_AGAIN if the
+ *                      IMU is still being initialized or ::PBIO_ERROR_NO_DEV
+ *                      if the IMU could not be initialized.
+ */
+pbio_error_t pbdrv_imu_get_info(pbdrv_imu_info_t *info);
+
+/**
+ * Gets the most recent sample.
+ * @param [out] sample  The sample
+ * @return              ::PBIO_SUCCESS on success, ::PBIO_ERROR_AGAIN if there
+ *                      are no samples yet or ::PBIO_ERROR_NO_DEV if the IMU
+ *                      could not be initialized.
+ */
+pbio_error_t pbdrv_imu_get_latest(pbdrv_imu_sample_t *sample);
+
+/**
+ * Copies samples that were taken since the last call, oldest first. If the
+ * caller fell behind by more than the size of the ring buffer, the oldest
+ * samples are skipped, which shows as a gap in pbdrv_imu_sample_t::time.
+ * @param [in,out] index    The number of the next sample to copy. Set this to
+ *                          0 before the first call and keep it between calls.
+ * @param [out]    samples  Buffer for the samples
+ * @param [in]     size     Number of samples that fit in @p samples
+ * @param [out]    count    The number of samples that were copied
+ * @return                  ::PBIO_SUCCESS on success or ::PBIO_ERROR_NO_DEV if
+ *                          the IMU could not be initialized.
+ */
+pbio_error_t pbdrv_imu_read(uint32_t *index, pbdrv_imu_sample_t *samples, uint32_t size, uint32_t *count);
+
+/**
+ * Gets the acceleration through a low-pass filter. At rest, this is gravity.
+ * @param [out] gravity     The x, y and z values in the same units as
+ *                          pbdrv_imu_sample_t::accel
+ * @return                  Same as pbdrv_imu_get_latest().
+ */
+pbio_error_t pbdrv_imu_get_gravity(int16_t *gravity);
+
+/**
+ * Gets the axis that points up.
+ * @param [out] up      1, 2 or 3 if the x, y or z axis points up, the negated
+ *                      value if that axis points down, or 0 if the IMU is
+ *                      tilted in between.
+ * @return              Same as pbdrv_imu_get_latest().
+ */
+pbio_error_t pbdrv_imu_get_up(int8_t *up);
+
+/**
+ * Gets how often the IMU was shaken. A shake that lasts several samples is
+ * counted once.
+ * @param [out] count   Number of shakes
+ * @param [out] time    Time when the last one started, in microseconds
+ * @return              Same as pbdrv_imu_get_latest().
+ */
+pbio_error_t pbdrv_imu_get_shakes(uint32_t *count, uint32_t *time);
+
+#if !PBDRV_CONFIG_IMU_NUM_SAMPLES
+#error Must define PBDRV_CONFIG_IMU_NUM_SAMPLES
+#endif
+
+#else // PBDRV_CONFIG_IMU
+
+static inline pbio_error_t pbdrv_imu_get_info(pbdrv_imu_info_t *info) {
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+static inline pbio_error_t pbdrv_imu_get_latest(pbdrv_imu_sample_t *sample) {
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+static inline pbio_error_t pbdrv_imu_read(uint32_t *index, pbdrv_imu_sample_t *samples, uint32_t size, uint32_t *count) {
+    *count = 0;
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+static inline pbio_error_t pbdrv_imu_get_gravity(int16_t *gravity) {
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+static inline pbio_error_t pbdrv_imu_get_up(int8_t *up) {
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+static inline pbio_error_t pbdrv_imu_get_shakes(uint32_t *count, uint32_t *time) {
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+
+#endif // PBDRV_CONFIG_IMU
+
+#endif // _PBDRV_IMU_H_
+
+/** @}*/
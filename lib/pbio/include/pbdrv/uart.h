@@ -36,6 +36,19 @@ pbio_error_t pbdrv_uart_set_baud_rate(pbdrv_uart_dev_t *uart, uint32_t baud);
 pbio_error_t pbdrv_uart_read_begin(pbdrv_uart_dev_t *uart, uint8_t *msg, uint8_t length, uint32_t timeout);
 pbio_error_t pbdrv_uart_read_end(pbdrv_uart_dev_t *uart);
 void pbdrv_uart_read_cancel(pbdrv_uart_dev_t *uart);
+
+/**
+ * Copies bytes that have already been received without waiting for more.
+ * @param [in]  uart    The UART device
+ * @param [out] buf     Buffer to hold the bytes
+ * @param [in]  size    Size of @p buf
+ * @param [out] count   The number of bytes copied to @p buf
+ * @return              ::PBIO_SUCCESS if zero or more bytes were copied or
+ *                      ::PBIO_ERROR_AGAIN if a read started with
+ *                      pbdrv_uart_read_begin() is still pending.
+ */
+pbio_error_t pbdrv_uart_read_available(pbdrv_uart_dev_t *uart, uint8_t *buf, uint8_t size, uint8_t *count);
+
 pbio_error_t pbdrv_uart_write_begin(pbdrv_uart_dev_t *uart, uint8_t *msg, uint8_t length, uint32_t timeout);
 pbio_error_t pbdrv_uart_write_end(pbdrv_uart_dev_t *uart);
 void pbdrv_uart_write_cancel(pbdrv_uart_dev_t *uart);
@@ -57,6 +70,10 @@ static inline pbio_error_t pbdrv_uart_read_end(pbdrv_uart_dev_t *uart) {
 }
 static inline void pbdrv_uart_read_cancel(pbdrv_uart_dev_t *uart) {
 }
+static inline pbio_error_t pbdrv_uart_read_available(pbdrv_uart_dev_t *uart, uint8_t *buf, uint8_t size, uint8_t *count) {
+    *count = 0;
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
 static inline pbio_error_t pbdrv_uart_write_begin(pbdrv_uart_dev_t *uart, uint8_t *msg, uint8_t length, uint32_t timeout) {
     return PBIO_ERROR_NOT_SUPPORTED;
 }
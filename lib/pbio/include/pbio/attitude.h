@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+/**
+ * \addtogroup Attitude Attitude estimation
+ *
+ * Estimates the tilt and heading of the hub from the IMU. Every sample is fed
+ * to a complementary filter, so the result does not depend on how often it is
+ * read. The gyro is integrated to follow fast motion and the accelerometer
+ * slowly pulls roll and pitch towards the direction of gravity to cancel
+ * drift. The gyro bias is measured whenever the hub is at rest.
+ *
+ * Heading is the integrated rotation around the z axis of the hub, so it is
+ * only exact while the hub is level, as on a driving robot.
+ * @{
+ */
+
+#ifndef _PBIO_ATTITUDE_H_
+#define _PBIO_ATTITUDE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <fixmath.h>
+
+#include <pbdrv/imu.h>
+#include <pbio/config.h>
+#include <pbio/error.h>
+
+/** Estimated attitude, in the axes of the IMU. */
+typedef struct {
+    /** Rotation around the x axis, in degrees from -180 to 180. */
+    fix16_t roll;
+    /** Rotation around the y axis, in degrees from -90 to 90. */
+    fix16_t pitch;
+    /** Rotation around the z axis, in degrees from -180 to 180. */
+    fix16_t heading;
+    /** Angular rate around the x, y and z axes without gyro bias, in degrees per second. */
+    fix16_t rate[3];
+    /** Whether the gyro bias has been measured since the filter was started. */
+    bool calibrated;
+} pbio_attitude_t;
+
+/** State of the attitude filter. */
+typedef struct {
+    pbio_attitude_t attitude;
+    /** Degrees per second per gyro unit. */
+    fix16_t gyro_gain;
+    /** Weight of the accelerometer in each update. */
+    fix16_t accel_gain;
+    /** Squared range of the acceleration, in raw units, that counts as gravity alone. */
+    uint32_t gravity_min_sq;
+    uint32_t gravity_max_sq;
+    /** Gyro bias in raw units. */
+    fix16_t bias[3];
+    uint32_t prev_time;
+    bool started;
+    /** Raw gyro range that counts as being at rest. */
+    int32_t rest_range;
+    /** Largest raw gyro value that can be bias. */
+    int32_t max_bias;
+    /** Largest change of the bias between two rests, in raw units. */
+    fix16_t max_bias_change;
+    /** Number of samples at rest that are averaged to get the bias. */
+    uint32_t rest_samples;
+    uint32_t rest_count;
+    int32_t rest_sum[3];
+    int16_t rest_min[3];
+    int16_t rest_max[3];
+    /** Bias of the last rest that differed too much from the current bias. */
+    fix16_t new_bias[3];
+    /** Number of rests in a row that agreed with new_bias. */
+    uint32_t new_bias_count;
+    /** Number of rests in a row needed before new_bias is taken. */
+    uint32_t new_bias_rests;
+} pbio_attitude_filter_t;
+
+#if PBIO_CONFIG_ATTITUDE
+
+/**
+ * Starts the filter over.
+ * @param [out] filter  The filter
+ * @param [in]  info    Properties of the samples that will be fed to it
+ */
+void pbio_attitude_filter_init(pbio_attitude_filter_t *filter, const pbdrv_imu_info_t *info);
+
+/**
+ * Updates the filter with the next sample.
+ * @param [in]  filter  The filter
+ * @param [in]  sample  The sample
+ */
+void pbio_attitude_filter_update(pbio_attitude_filter_t *filter, const pbdrv_imu_sample_t *sample);
+
+/**
+ * Gets the attitude of the hub.
+ * @param [out] attitude    The attitude
+ * @return                  ::PBIO_SUCCESS on success, ::PBIO_ERROR_AGAIN if
+ *                          there are no samples yet or ::PBIO_ERROR_NO_DEV if
+ *                          the IMU could not be initialized.
+ */
+pbio_error_t pbio_attitude_get(pbio_attitude_t *attitude);
+
+/**
+ * Sets the heading to a new value, for example to make the current direction
+ * zero.
+ * @param [in]  heading     The new heading, in degrees
+ * @return                  Same as pbio_attitude_get().
+ */
+pbio_error_t pbio_attitude_reset_heading(fix16_t heading);
+
+void _pbio_attitude_poll(void);
+
+#else // PBIO_CONFIG_ATTITUDE
+
+static inline pbio_error_t pbio_attitude_get(pbio_attitude_t *attitude) {
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+static inline pbio_error_t pbio_attitude_reset_heading(fix16_t heading) {
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+static inline void _pbio_attitude_poll(void) {
+}
+
+#endif // PBIO_CONFIG_ATTITUDE
+
+#endif // _PBIO_ATTITUDE_H_
+
+/** @}*/
@@ -24,4 +24,24 @@
 #define PBIO_CONFIG_UARTDEV (0)
 #endif
 
+// collect run time statistics of background tasks, see pbio/stats.h
+#ifndef PBIO_CONFIG_STATS
+#define PBIO_CONFIG_STATS (0)
+#endif
+
+// estimate tilt and heading from the IMU, see pbio/attitude.h
+#ifndef PBIO_CONFIG_ATTITUDE
+#define PBIO_CONFIG_ATTITUDE (0)
+#endif
+
+// keep a trace of recent events, see pbio/trace.h
+#ifndef PBIO_CONFIG_TRACE
+#define PBIO_CONFIG_TRACE (0)
+#endif
+
+// number of entries in the trace
+#ifndef PBIO_CONFIG_TRACE_SIZE
+#define PBIO_CONFIG_TRACE_SIZE (32)
+#endif
+
 #endif // _PBIO_CONFIG_H_
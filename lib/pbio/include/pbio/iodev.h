@@ -183,6 +183,11 @@ typedef enum {
  */
 #define PBIO_IODEV_MAX_NUM_MODES    (LUMP_MAX_EXT_MODE + 1)
 
+/**
+ * The maximum number of mode combinations a I/O device can advertise.
+ */
+#define PBIO_IODEV_MAX_NUM_MODE_COMBOS  (8)
+
 /**
  * Max size of mode name (not including null terminator)
  */
@@ -346,10 +351,14 @@ typedef struct {
      */
     uint8_t num_view_modes;
     /**
-     * Bit flags indicating which combination of modes can be used at the same
+     * Number of valid entries in *mode_combos*.
+     */
+    uint8_t num_mode_combos;
+    /**
+     * Bit flags indicating which combinations of modes can be used at the same
      * time. Each bit cooresponds to the mode of the same number (0 to 15).
      */
-    uint16_t mode_combos;
+    uint16_t mode_combos[PBIO_IODEV_MAX_NUM_MODE_COMBOS];
     /**
      * Array of mode info for all modes. Array size depends on the device.
      */
@@ -368,6 +377,7 @@ typedef struct _pbio_iodev_t pbio_iodev_t;
  */
 typedef struct {
     pbio_error_t (*set_mode_begin)(pbio_iodev_t *iodev, uint8_t mode);
+    pbio_error_t (*set_mode_combo_begin)(pbio_iodev_t *iodev, const uint8_t *modes, uint8_t num_modes);
     pbio_error_t (*set_mode_end)(pbio_iodev_t *iodev);
     void (*set_mode_cancel)(pbio_iodev_t *iodev);
     pbio_error_t (*set_data_begin)(pbio_iodev_t *iodev, const uint8_t *data);
@@ -406,6 +416,15 @@ struct _pbio_iodev_t {
      * the values could be foreign-endian.
      */
     uint8_t bin_data[PBIO_IODEV_MAX_DATA_SIZE]  __attribute__((aligned(32)));
+    /**
+     * Bit flags for the modes that are streamed together in *bin_data* by a
+     * combined mode. Zero when only the current *mode* is streamed.
+     */
+    uint16_t combo_modes;
+    /**
+     * Offset in *bin_data* of the data of each mode in *combo_modes*.
+     */
+    uint8_t combo_offset[PBIO_IODEV_MAX_NUM_MODES];
 };
 
 /** @endcond */
@@ -413,9 +432,11 @@ struct _pbio_iodev_t {
 size_t pbio_iodev_size_of(pbio_iodev_data_type_t type);
 pbio_error_t pbio_iodev_get_data_format(pbio_iodev_t *iodev, uint8_t mode, uint8_t *len, pbio_iodev_data_type_t *type);
 pbio_error_t pbio_iodev_get_data(pbio_iodev_t *iodev, uint8_t **data);
+pbio_error_t pbio_iodev_get_mode_data(pbio_iodev_t *iodev, uint8_t mode, uint8_t **data);
 pbio_error_t pbio_iodev_set_mode_begin(pbio_iodev_t *iodev, uint8_t mode);
 pbio_error_t pbio_iodev_set_mode_end(pbio_iodev_t *iodev);
 void pbio_iodev_set_mode_cancel(pbio_iodev_t *iodev);
+pbio_error_t pbio_iodev_set_mode_combo_begin(pbio_iodev_t *iodev, const uint8_t *modes, uint8_t num_modes);
 pbio_error_t pbio_iodev_set_data_begin(pbio_iodev_t *iodev, uint8_t mode, const uint8_t *data);
 pbio_error_t pbio_iodev_set_data_end(pbio_iodev_t *iodev);
 void pbio_iodev_set_data_cancel(pbio_iodev_t *iodev);
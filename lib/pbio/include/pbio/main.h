@@ -4,10 +4,13 @@
 #ifndef _PBIO_MAIN_H_
 #define _PBIO_MAIN_H_
 
+#include <stdint.h>
+
 #include "pbio/config.h"
 
 void pbio_init(void);
 int pbio_do_one_event(void);
+void pbio_idle(uint32_t timeout);
 
 #if PBIO_CONFIG_ENABLE_DEINIT
 void pbio_deinit(void);
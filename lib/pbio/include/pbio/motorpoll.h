@@ -4,6 +4,8 @@
 #ifndef _PBIO_MOTORPOLL_H_
 #define _PBIO_MOTORPOLL_H_
 
+#include <stdbool.h>
+
 #include <pbio/drivebase.h>
 #include <pbio/error.h>
 #include <pbio/servo.h>
@@ -20,6 +22,7 @@ pbio_error_t pbio_motorpoll_set_drivebase_status(pbio_drivebase_t *db, pbio_erro
 
 void _pbio_motorpoll_reset_all(void);
 void _pbio_motorpoll_poll(void);
+bool _pbio_motorpoll_needs_poll(void);
 
 #else
 
@@ -27,6 +30,9 @@ static inline void _pbio_motorpoll_reset_all(void) {
 }
 static inline void _pbio_motorpoll_poll(void) {
 }
+static inline bool _pbio_motorpoll_needs_poll(void) {
+    return false;
+}
 
 #endif // PBDRV_CONFIG_NUM_MOTOR_CONTROLLER
 
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+/**
+ * \addtogroup RingBuf Ring buffer
+ *
+ * Byte ring buffer for one producer and one consumer, e.g. an interrupt
+ * handler and the main loop. The producer only writes the head and the
+ * consumer only writes the tail, so no locking is needed.
+ * @{
+ */
+
+#ifndef _PBIO_RINGBUF_H_
+#define _PBIO_RINGBUF_H_
+
+#include <stdint.h>
+
+/**
+ * Ring buffer state. Treat as opaque.
+ */
+typedef struct {
+    /** The buffer memory. */
+    uint8_t *data;
+    /** The size of *data*. Must be a power of 2. */
+    uint32_t size;
+    /** Total number of bytes written. Only changed by the producer. */
+    volatile uint32_t head;
+    /** Total number of bytes read. Only changed by the consumer. */
+    volatile uint32_t tail;
+} pbio_ringbuf_t;
+
+/**
+ * Initializes a ring buffer.
+ * @param [in]  rb      The ring buffer
+ * @param [in]  data    The buffer memory
+ * @param [in]  size    The size of *data*, must be a power of 2
+ */
+void pbio_ringbuf_init(pbio_ringbuf_t *rb, uint8_t *data, uint32_t size);
+
+/**
+ * Gets the number of bytes that can be read.
+ * @param [in]  rb      The ring buffer
+ * @return              The number of bytes
+ */
+static inline uint32_t pbio_ringbuf_count(const pbio_ringbuf_t *rb) {
+    return rb->head - rb->tail;
+}
+
+/**
+ * Gets the number of bytes that can be written.
+ * @param [in]  rb      The ring buffer
+ * @return              The number of bytes
+ */
+static inline uint32_t pbio_ringbuf_free(const pbio_ringbuf_t *rb) {
+    return rb->size - pbio_ringbuf_count(rb);
+}
+
+/**
+ * Writes as many bytes as fit in the ring buffer. Must only be called by
+ * the producer.
+ * @param [in]  rb      The ring buffer
+ * @param [in]  data    The bytes to write
+ * @param [in]  size    The number of bytes in *data*
+ * @return              The number of bytes that were written
+ */
+uint32_t pbio_ringbuf_write(pbio_ringbuf_t *rb, const uint8_t *data, uint32_t size);
+
+/**
+ * Reads as many bytes as are available from the ring buffer. Must only be
+ * called by the consumer.
+ * @param [in]  rb      The ring buffer
+ * @param [out] data    Buffer to hold the bytes
+ * @param [in]  size    The size of *data*
+ * @return              The number of bytes that were read
+ */
+uint32_t pbio_ringbuf_read(pbio_ringbuf_t *rb, uint8_t *data, uint32_t size);
+
+#endif // _PBIO_RINGBUF_H_
+
+/** @}*/
@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+/**
+ * \addtogroup Stats Run time statistics
+ *
+ * Keeps track of how long the background tasks in ::pbio_do_one_event() take
+ * and how regularly the servo controllers are updated. This is meant for
+ * finding out if new features fit in the time budget of the servo loop.
+ * When ::PBIO_CONFIG_STATS is disabled, none of this costs any time or
+ * memory.
+ * @{
+ */
+
+#ifndef _PBIO_STATS_H_
+#define _PBIO_STATS_H_
+
+#include <stdint.h>
+
+#include <pbio/config.h>
+
+/**
+ * Things that are measured.
+ */
+typedef enum {
+    /** Run time of one servo and drivebase update. */
+    PBIO_STATS_MOTORPOLL,
+    /** Run time of one light update. */
+    PBIO_STATS_LIGHTPOLL,
+    /** Time between two servo updates while motors are being controlled. */
+    PBIO_STATS_SERVO_PERIOD,
+    /** How much the servo update period differs from ::PBIO_CONFIG_SERVO_PERIOD_MS. */
+    PBIO_STATS_SERVO_JITTER,
+    /** The number of things that are measured. */
+    PBIO_STATS_NUM,
+} pbio_stats_id_t;
+
+/**
+ * The number of histogram bins. Bin 0 counts times below
+ * ::PBIO_STATS_HISTOGRAM_MIN_US, each following bin is twice as wide as the
+ * one before it and the last one counts everything else.
+ */
+#define PBIO_STATS_HISTOGRAM_SIZE 10
+
+/**
+ * The upper limit of histogram bin 0 in microseconds.
+ */
+#define PBIO_STATS_HISTOGRAM_MIN_US 32
+
+/**
+ * Statistics for a duration, in microseconds.
+ */
+typedef struct {
+    /** The number of measurements. */
+    uint32_t count;
+    /** The sum of all measurements. This is 64 bits wide because a 32 bit
+     * sum of the servo loop period would wrap after about 71 minutes. */
+    uint64_t total;
+    /** The shortest measurement. */
+    uint32_t min;
+    /** The longest measurement. */
+    uint32_t max;
+    /** The number of measurements in each bin. */
+    uint32_t histogram[PBIO_STATS_HISTOGRAM_SIZE];
+} pbio_stats_t;
+
+#if PBIO_CONFIG_STATS
+
+/**
+ * Adds a measurement.
+ * @param [in]  id      What was measured
+ * @param [in]  usecs   The measured time in microseconds
+ */
+void pbio_stats_add(pbio_stats_id_t id, uint32_t usecs);
+
+/**
+ * Gets the statistics of one measurement.
+ * @param [in]  id      What was measured
+ * @return              The statistics
+ */
+const pbio_stats_t *pbio_stats_get(pbio_stats_id_t id);
+
+/**
+ * Clears all statistics, including those of the Contiki processes.
+ */
+void pbio_stats_reset(void);
+
+#else // PBIO_CONFIG_STATS
+
+static inline void pbio_stats_add(pbio_stats_id_t id, uint32_t usecs) {
+}
+static inline void pbio_stats_reset(void) {
+}
+
+#endif // PBIO_CONFIG_STATS
+
+#endif // _PBIO_STATS_H_
+
+/** @}*/
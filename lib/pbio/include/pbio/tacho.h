@@ -23,6 +23,8 @@ pbio_error_t pbio_tacho_get_angle(pbio_tacho_t *tacho, int32_t *angle);
 pbio_error_t pbio_tacho_reset_angle(pbio_tacho_t *tacho, int32_t reset_angle, bool reset_to_abs);
 pbio_error_t pbio_tacho_get_rate(pbio_tacho_t *tacho, int32_t *encoder_rate);
 pbio_error_t pbio_tacho_get_angular_rate(pbio_tacho_t *tacho, int32_t *angular_rate);
+pbio_error_t pbio_tacho_get_state(pbio_tacho_t *tacho, int32_t *count, int32_t *encoder_rate);
+pbio_error_t pbio_tacho_get_angular_state(pbio_tacho_t *tacho, int32_t *angle, int32_t *angular_rate);
 
 #else
 
@@ -45,6 +47,12 @@ static inline pbio_error_t pbio_tacho_get_rate(pbio_tacho_t *tacho, int32_t *enc
 static inline pbio_error_t pbio_tacho_get_angular_rate(pbio_tacho_t *tacho, int32_t *angular_rate) {
     return PBIO_ERROR_NOT_SUPPORTED;
 }
+static inline pbio_error_t pbio_tacho_get_state(pbio_tacho_t *tacho, int32_t *count, int32_t *encoder_rate) {
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+static inline pbio_error_t pbio_tacho_get_angular_state(pbio_tacho_t *tacho, int32_t *angle, int32_t *angular_rate) {
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
 
 #endif // PBIO_CONFIG_TACHO
 
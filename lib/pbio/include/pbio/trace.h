@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+/**
+ * \addtogroup Trace Event trace
+ *
+ * Keeps a record of the most recent things that went wrong or changed state,
+ * such as devices connecting and disconnecting, mode changes and motor
+ * errors. The oldest entries are overwritten when the buffer is full. The
+ * buffer can be read as raw bytes and decoded on the host with
+ * tools/pbtrace.py.
+ *
+ * Entries may only be added from the main loop, not from interrupts.
+ * @{
+ */
+
+#ifndef _PBIO_TRACE_H_
+#define _PBIO_TRACE_H_
+
+#include <stdint.h>
+
+#include <pbio/config.h>
+#include <pbio/port.h>
+
+/**
+ * Things that are traced. The meaning of the data of each entry is given
+ * for each event. Keep tools/pbtrace.py in sync when changing this.
+ */
+typedef enum {
+    /** UART device sent its type, reading device info. Data is the type id. */
+    PBIO_TRACE_UARTDEV_SYNC = 1,
+    /** UART device is ready. Data is the baud rate divided by 100. */
+    PBIO_TRACE_UARTDEV_DATA = 2,
+    /** UART device error. Data is the line in uartdev.c where it happened. */
+    PBIO_TRACE_UARTDEV_ERR = 3,
+    /** Requested a new mode. Data is the mode or ::PBIO_TRACE_MODE_COMBO. */
+    PBIO_TRACE_MODE_BEGIN = 4,
+    /** Device is sending data in the new mode. Data is as above. */
+    PBIO_TRACE_MODE_END = 5,
+    /** Servo controller stopped with an error. Data is the ::pbio_error_t. */
+    PBIO_TRACE_SERVO_ERR = 6,
+    /** Drive base controller stopped with an error. Data is the ::pbio_error_t. */
+    PBIO_TRACE_DRIVEBASE_ERR = 7,
+    /** Bluetooth connected. Data is the connection handle. */
+    PBIO_TRACE_BLE_CONNECT = 8,
+    /** Bluetooth disconnected. Data is the connection handle. */
+    PBIO_TRACE_BLE_DISCONNECT = 9,
+} pbio_trace_event_t;
+
+/**
+ * Mode of ::PBIO_TRACE_MODE_BEGIN and ::PBIO_TRACE_MODE_END when selecting a
+ * combination of modes.
+ */
+#define PBIO_TRACE_MODE_COMBO (0xFFFF)
+
+/**
+ * One trace entry. This is also the format of the raw trace data, in
+ * little endian byte order.
+ */
+typedef struct {
+    /** Time in milliseconds. */
+    uint32_t time;
+    /** ::pbio_trace_event_t */
+    uint8_t event;
+    /** ::pbio_port_t of the device, or ::PBIO_PORT_NONE. */
+    uint8_t port;
+    /** Event specific data. */
+    uint16_t data;
+} pbio_trace_entry_t;
+
+#if PBIO_CONFIG_TRACE
+
+/**
+ * Adds an entry to the trace.
+ * @param [in]  event   What happened
+ * @param [in]  port    Port of the device, or ::PBIO_PORT_NONE
+ * @param [in]  data    Event specific data
+ */
+void pbio_trace(pbio_trace_event_t event, pbio_port_t port, uint16_t data);
+
+/**
+ * Copies the trace, oldest entry first.
+ * @param [out] entries Buffer of ::PBIO_CONFIG_TRACE_SIZE entries
+ * @return              The number of entries copied
+ */
+uint32_t pbio_trace_read(pbio_trace_entry_t *entries);
+
+/**
+ * Removes all entries.
+ */
+void pbio_trace_clear(void);
+
+#else // PBIO_CONFIG_TRACE
+
+static inline void pbio_trace(pbio_trace_event_t event, pbio_port_t port, uint16_t data) {
+}
+static inline uint32_t pbio_trace_read(pbio_trace_entry_t *entries) {
+    return 0;
+}
+static inline void pbio_trace_clear(void) {
+}
+
+#endif // PBIO_CONFIG_TRACE
+
+#endif // _PBIO_TRACE_H_
+
+/** @}*/
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+/**
+ * \addtogroup TxBuf Transmit double buffer
+ *
+ * Collects bytes into packets, e.g. Bluetooth notifications. One packet is
+ * filled while the other one is being sent, so writers only have to wait
+ * when both are in use.
+ * @{
+ */
+
+#ifndef _PBIO_TXBUF_H_
+#define _PBIO_TXBUF_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Transmit double buffer state. Treat as opaque.
+ */
+typedef struct {
+    /** The buffer memory, holding two packets of *capacity* bytes. */
+    uint8_t *data;
+    /** The size of each packet in *data*. */
+    uint16_t capacity;
+    /** The packet size currently in use. At most *capacity*. */
+    uint16_t packet_size;
+    /** Number of bytes in each packet. */
+    uint16_t size[2];
+    /** Packet that new bytes are added to. */
+    uint8_t fill;
+    /** Whether the other packet is being sent. */
+    bool sending;
+} pbio_txbuf_t;
+
+/**
+ * Initializes a transmit double buffer.
+ * @param [in]  txbuf       The buffer
+ * @param [in]  data        The buffer memory, 2 * *capacity* bytes
+ * @param [in]  capacity    The largest packet size
+ */
+void pbio_txbuf_init(pbio_txbuf_t *txbuf, uint8_t *data, uint16_t capacity);
+
+/**
+ * Sets the packet size, e.g. after an MTU exchange. Bytes that were already
+ * added are kept.
+ * @param [in]  txbuf       The buffer
+ * @param [in]  size        The packet size, limited to the capacity
+ */
+void pbio_txbuf_set_packet_size(pbio_txbuf_t *txbuf, uint16_t size);
+
+/**
+ * Drops all bytes, including the packet that is being sent.
+ * @param [in]  txbuf       The buffer
+ */
+void pbio_txbuf_clear(pbio_txbuf_t *txbuf);
+
+/**
+ * Adds as many bytes as fit in the packet that is being filled.
+ * @param [in]  txbuf       The buffer
+ * @param [in]  data        The bytes to add
+ * @param [in]  size        The number of bytes in *data*
+ * @return                  The number of bytes that were added
+ */
+uint32_t pbio_txbuf_write(pbio_txbuf_t *txbuf, const uint8_t *data, uint32_t size);
+
+/**
+ * Starts sending the packet that was being filled, if it has any bytes and
+ * no other packet is being sent. New bytes go to the other packet from now
+ * on.
+ * @param [in]  txbuf       The buffer
+ * @param [out] data        The packet to send
+ * @param [out] size        The number of bytes in the packet
+ * @return                  True if there is a packet to send
+ */
+bool pbio_txbuf_send_begin(pbio_txbuf_t *txbuf, const uint8_t **data, uint16_t *size);
+
+/**
+ * Frees the packet that was being sent.
+ * @param [in]  txbuf       The buffer
+ */
+void pbio_txbuf_send_end(pbio_txbuf_t *txbuf);
+
+#endif // _PBIO_TXBUF_H_
+
+/** @}*/
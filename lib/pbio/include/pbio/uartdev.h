@@ -11,9 +11,20 @@
 #include <pbio/error.h>
 #include <pbio/iodev.h>
 
+/**
+ * Link statistics of a UART device port.
+ */
+typedef struct {
+    uint32_t baud_rate;     /**< The baud rate in use, or 0 if no device is synced */
+    uint32_t bytes_per_sec; /**< Bytes received per second, averaged over about one second */
+    uint32_t msgs_per_sec;  /**< Messages received per second, averaged over about one second */
+    uint32_t err_count;     /**< Total number of errors since the port was initialized */
+} pbio_uartdev_stats_t;
+
 #if PBIO_CONFIG_UARTDEV
 
 pbio_error_t pbio_uartdev_get(uint8_t id, pbio_iodev_t **iodev);
+pbio_error_t pbio_uartdev_get_stats(uint8_t id, pbio_uartdev_stats_t *stats);
 
 #if !PBIO_CONFIG_UARTDEV_NUM_DEV
 #error Must define PBIO_CONFIG_UARTDEV_NUM_DEV
@@ -33,6 +44,10 @@ static inline pbio_error_t pbio_uartdev_get(uint8_t id, pbio_iodev_t **iodev) {
     return PBIO_ERROR_NOT_SUPPORTED;
 }
 
+static inline pbio_error_t pbio_uartdev_get_stats(uint8_t id, pbio_uartdev_stats_t *stats) {
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
+
 #endif // PBIO_CONFIG_UARTDEV
 
 #endif // _PBIO_UARTDEV_H_
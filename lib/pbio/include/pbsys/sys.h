@@ -77,6 +77,18 @@ void pbsys_unprepare_user_program(void);
  */
 pbio_error_t pbsys_stdin_get_char(uint8_t *c);
 
+/**
+ * Reads all characters that are available on stdin, up to *size*.
+ * @param [out] buf     Buffer to hold the characters
+ * @param [in]  size    Size of *buf*
+ * @param [out] count   The number of characters read
+ * @return              ::PBIO_SUCCESS if one or more characters were read,
+ *                      ::PBIO_ERROR_AGAIN if no character was available to be
+ *                      read at this time or ::PBIO_ERROR_NOT_SUPPORTED if the
+ *                      platform does not have a stdin.
+ */
+pbio_error_t pbsys_stdin_read(uint8_t *buf, uint32_t size, uint32_t *count);
+
 /**
  * Write one character to stdout.
  * @param [in] c        The character to write
@@ -87,6 +99,18 @@ pbio_error_t pbsys_stdin_get_char(uint8_t *c);
  */
 pbio_error_t pbsys_stdout_put_char(uint8_t c);
 
+/**
+ * Writes as many characters to stdout as can be queued at this time.
+ * @param [in]  data    The characters to write
+ * @param [in]  size    The number of characters in *data*
+ * @param [out] count   The number of characters written
+ * @return              ::PBIO_SUCCESS if one or more characters were written,
+ *                      ::PBIO_ERROR_AGAIN if no character could be written
+ *                      at this time or ::PBIO_ERROR_NOT_SUPPORTED if the
+ *                      platform does not have a stdout.
+ */
+pbio_error_t pbsys_stdout_write(const uint8_t *data, uint32_t size, uint32_t *count);
+
 /**
  * Reboots the brick. This could also be considered a "hard" reset. This
  * function never returns.
@@ -110,9 +134,17 @@ static inline pbio_error_t pbsys_stdin_get_char(uint8_t *c) {
     *c = 0;
     return PBIO_ERROR_NOT_SUPPORTED;
 }
+static inline pbio_error_t pbsys_stdin_read(uint8_t *buf, uint32_t size, uint32_t *count) {
+    *count = 0;
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
 static inline pbio_error_t pbsys_stdout_put_char(uint8_t c) {
     return PBIO_ERROR_NOT_SUPPORTED;
 }
+static inline pbio_error_t pbsys_stdout_write(const uint8_t *data, uint32_t size, uint32_t *count) {
+    *count = 0;
+    return PBIO_ERROR_NOT_SUPPORTED;
+}
 static inline void pbsys_reset(void) {
 }
 static inline void pbsys_reboot(bool fw_update) {
@@ -29,12 +29,24 @@
 #define PBDRV_CONFIG_BUTTON_GPIO                    (1)
 #define PBDRV_CONFIG_BUTTON_GPIO_NUM_BUTTON         (1)
 
+#define PBDRV_CONFIG_CLOCK_TICKLESS                 (1)
+#define PBDRV_CONFIG_CLOCK_TICKLESS_STM32           (1)
+
 #define PBDRV_CONFIG_COUNTER                        (1)
 #define PBDRV_CONFIG_COUNTER_NUM_DEV                (4)
 
 #define PBDRV_CONFIG_GPIO                           (1)
 #define PBDRV_CONFIG_GPIO_STM32L4                   (1)
 
+#define PBDRV_CONFIG_I2C                            (1)
+#define PBDRV_CONFIG_I2C_STM32_HAL                  (1)
+#define PBDRV_CONFIG_I2C_STM32_HAL_NUM_I2C          (1)
+
+#define PBDRV_CONFIG_IMU                            (1)
+#define PBDRV_CONFIG_IMU_NUM_SAMPLES                (64)
+#define PBDRV_CONFIG_IMU_LSM6DS3TR_C                (1)
+#define PBDRV_CONFIG_IMU_LSM6DS3TR_C_I2C_ID         (0)
+
 #define PBDRV_CONFIG_IOPORT                         (1)
 #define PBDRV_CONFIG_IOPORT_LPF2                    (1)
 #define PBDRV_CONFIG_IOPORT_LPF2_NUM_PORTS          (4)
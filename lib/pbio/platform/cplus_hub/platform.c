@@ -7,11 +7,13 @@
 
 #include "../../drv/adc/adc_stm32_hal.h"
 #include "../../drv/button/button_gpio.h"
+#include "../../drv/i2c/i2c_stm32_hal.h"
 #include "../../drv/ioport/ioport_lpf2.h"
 #include "../../drv/uart/uart_stm32l4_ll.h"
 
 #include "stm32l4xx_hal.h"
 #include "stm32l4xx_ll_dma.h"
+#include "stm32l4xx_ll_i2c.h"
 #include "stm32l4xx_ll_rcc.h"
 
 // PBIO driver data
@@ -291,6 +293,16 @@ void DMA1_Channel1_IRQHandler() {
     pbdrv_adc_stm32_hal_handle_irq();
 }
 
+const pbdrv_i2c_stm32_hal_platform_data_t
+    pbdrv_i2c_stm32_hal_platform_data[PBDRV_CONFIG_I2C_STM32_HAL_NUM_I2C] = {
+    [0] = {
+        .i2c = I2C1,
+        // Clock is 5MHz, so these timing come out to 1 usec. When combined with
+        // internal delays, this is slightly slower than 400kHz
+        .timing = __LL_I2C_CONVERT_TIMINGS(0, 0, 0, 4, 4),
+    },
+};
+
 void HAL_I2C_MspInit(I2C_HandleTypeDef *hi2c) {
     GPIO_InitTypeDef gpio_init = { 0 };
 
@@ -311,13 +323,11 @@ void HAL_I2C_MspInit(I2C_HandleTypeDef *hi2c) {
 }
 
 void I2C1_ER_IRQHandler(void) {
-    extern void mod_experimental_IMU_handle_i2c_er_irq();
-    mod_experimental_IMU_handle_i2c_er_irq();
+    pbdrv_i2c_stm32_hal_handle_er_irq(0);
 }
 
 void I2C1_EV_IRQHandler(void) {
-    extern void mod_experimental_IMU_handle_i2c_ev_irq();
-    mod_experimental_IMU_handle_i2c_ev_irq();
+    pbdrv_i2c_stm32_hal_handle_ev_irq(0);
 }
 
 // Early initialization
@@ -20,6 +20,9 @@
 #define PBDRV_CONFIG_BUTTON_GPIO                    (1)
 #define PBDRV_CONFIG_BUTTON_GPIO_NUM_BUTTON         (1)
 
+#define PBDRV_CONFIG_CLOCK_TICKLESS                 (1)
+#define PBDRV_CONFIG_CLOCK_TICKLESS_STM32           (1)
+
 #define PBDRV_CONFIG_GPIO                           (1)
 #define PBDRV_CONFIG_GPIO_STM32F4                   (1)
 
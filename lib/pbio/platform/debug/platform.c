@@ -134,6 +134,9 @@ const pbdrv_uart_stm32_hal_platform_data_t
     [UART_ID_0] = {
         .uart = USART2,
         .irq = USART2_IRQn,
+        .rx_dma = DMA1_Stream5,
+        .rx_dma_ch = DMA_CHANNEL_4,
+        .rx_dma_irq = DMA1_Stream5_IRQn,
     },
 };
 
@@ -166,6 +169,11 @@ void USART2_IRQHandler(void) {
     pbdrv_uart_stm32_hal_handle_irq(UART_ID_0);
 }
 
+// overrides weak function in setup.m
+void DMA1_Stream5_IRQHandler(void) {
+    pbdrv_uart_stm32_hal_handle_rx_dma_irq(UART_ID_0);
+}
+
 // HACK: we don't have a generic ioport interface yet so defining this function
 // in platform.c
 pbio_error_t pbdrv_ioport_get_iodev(pbio_port_t port, pbio_iodev_t **iodev) {
@@ -217,7 +225,7 @@ void SystemInit(void) {
     // enable GPIO clocks
     RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_GPIOBEN | RCC_AHB1ENR_GPIOCEN |
         RCC_AHB1ENR_GPIODEN | RCC_AHB1ENR_GPIOEEN | RCC_AHB1ENR_GPIOFEN |
-        RCC_AHB1ENR_GPIOGEN | RCC_AHB1ENR_DMA2EN;
+        RCC_AHB1ENR_GPIOGEN | RCC_AHB1ENR_DMA1EN | RCC_AHB1ENR_DMA2EN;
     RCC->APB1ENR |= RCC_APB1ENR_TIM2EN | RCC_APB1ENR_USART2EN;
     RCC->APB2ENR |= RCC_APB2ENR_ADC3EN | RCC_APB2ENR_USART6EN;
 
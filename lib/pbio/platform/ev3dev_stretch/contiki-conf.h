@@ -14,4 +14,6 @@
 typedef uint32_t clock_time_t;
 #define CLOCK_CONF_SECOND 1000
 
+#define PROCESS_CONF_STATS 1
+
 #endif /* _PBIO_CONF_H_ */
@@ -12,6 +12,7 @@
 #include "pbio/event.h"
 #include "pbio/light.h"
 #include "pbio/motorpoll.h"
+#include "pbio/ringbuf.h"
 
 #include "pbsys/sys.h"
 
@@ -59,7 +60,7 @@ static pbsys_stdin_event_callback_t user_stdin_event_func;
 
 // stdin ring buffer
 static uint8_t stdin_buf[STDIN_BUF_SIZE];
-static uint8_t stdin_buf_head, stdin_buf_tail;
+static pbio_ringbuf_t stdin_ring = { .data = stdin_buf, .size = STDIN_BUF_SIZE };
 
 PROCESS(pbsys_process, "System");
 
@@ -87,20 +88,28 @@ void pbsys_unprepare_user_program(void) {
 }
 
 pbio_error_t pbsys_stdin_get_char(uint8_t *c) {
-    if (stdin_buf_head == stdin_buf_tail) {
+    if (!pbio_ringbuf_read(&stdin_ring, c, 1)) {
         return PBIO_ERROR_AGAIN;
     }
 
-    *c = stdin_buf[stdin_buf_tail];
-    stdin_buf_tail = (stdin_buf_tail + 1) & (STDIN_BUF_SIZE - 1);
-
     return PBIO_SUCCESS;
 }
 
+pbio_error_t pbsys_stdin_read(uint8_t *buf, uint32_t size, uint32_t *count) {
+    *count = pbio_ringbuf_read(&stdin_ring, buf, size);
+
+    return *count ? PBIO_SUCCESS : PBIO_ERROR_AGAIN;
+}
+
 pbio_error_t pbsys_stdout_put_char(uint8_t c) {
     return pbdrv_bluetooth_tx(c);
 }
 
+pbio_error_t pbsys_stdout_write(const uint8_t *data, uint32_t size, uint32_t *count) {
+    *count = 0;
+    return pbdrv_bluetooth_tx_buf(data, size, count);
+}
+
 void pbsys_reboot(bool fw_update) {
     if (fw_update) {
         bootloader_magic_addr = BOOTLOADER_MAGIC_VALUE;
@@ -199,21 +208,14 @@ static void update_battery(clock_time_t now) {
 }
 
 static void handle_stdin_char(uint8_t c) {
-    uint8_t new_head = (stdin_buf_head + 1) & (STDIN_BUF_SIZE - 1);
-
     // optional hook function can steal the character
     if (user_stdin_event_func && user_stdin_event_func(c)) {
         return;
     }
 
-    // otherwise write character to ring buffer
-
-    if (new_head == stdin_buf_tail) {
-        // overflow. drop the data :-(
-        return;
-    }
-    stdin_buf[stdin_buf_head] = c;
-    stdin_buf_head = new_head;
+    // otherwise write character to ring buffer. If it is full, the data is
+    // dropped :-(
+    pbio_ringbuf_write(&stdin_ring, &c, 1);
 }
 
 PROCESS_THREAD(pbsys_process, ev, data) {
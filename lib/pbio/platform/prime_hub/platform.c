@@ -105,19 +105,32 @@ const pbdrv_uart_stm32_hal_platform_data_t
     [UART_PORT_A] = {
         .uart = UART7,
         .irq = UART7_IRQn,
+        .rx_dma = DMA1_Stream3,
+        .rx_dma_ch = DMA_CHANNEL_5,
+        .rx_dma_irq = DMA1_Stream3_IRQn,
     },
     [UART_PORT_B] = {
         .uart = UART4,
         .irq = UART4_IRQn,
+        .rx_dma = DMA1_Stream2,
+        .rx_dma_ch = DMA_CHANNEL_4,
+        .rx_dma_irq = DMA1_Stream2_IRQn,
     },
     [UART_PORT_C] = {
         .uart = UART8,
         .irq = UART8_IRQn,
+        .rx_dma = DMA1_Stream6,
+        .rx_dma_ch = DMA_CHANNEL_5,
+        .rx_dma_irq = DMA1_Stream6_IRQn,
     },
     [UART_PORT_D] = {
         .uart = UART5,
         .irq = UART5_IRQn,
+        .rx_dma = DMA1_Stream0,
+        .rx_dma_ch = DMA_CHANNEL_4,
+        .rx_dma_irq = DMA1_Stream0_IRQn,
     },
+    // REVISIT: UART10 has no RX DMA stream yet, so it receives in the interrupt
     [UART_PORT_E] = {
         .uart = UART10,
         .irq = UART10_IRQn,
@@ -158,6 +171,26 @@ void UART10_IRQHandler(void) {
     pbdrv_uart_stm32_hal_handle_irq(UART_PORT_E);
 }
 
+// overrides weak function in setup.m
+void DMA1_Stream0_IRQHandler(void) {
+    pbdrv_uart_stm32_hal_handle_rx_dma_irq(UART_PORT_D);
+}
+
+// overrides weak function in setup.m
+void DMA1_Stream2_IRQHandler(void) {
+    pbdrv_uart_stm32_hal_handle_rx_dma_irq(UART_PORT_B);
+}
+
+// overrides weak function in setup.m
+void DMA1_Stream3_IRQHandler(void) {
+    pbdrv_uart_stm32_hal_handle_rx_dma_irq(UART_PORT_A);
+}
+
+// overrides weak function in setup.m
+void DMA1_Stream6_IRQHandler(void) {
+    pbdrv_uart_stm32_hal_handle_rx_dma_irq(UART_PORT_C);
+}
+
 enum {
     COUNTER_PORT_A,
     COUNTER_PORT_B,
@@ -334,7 +367,8 @@ void SystemInit(void) {
 
     // enable clocks
     RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_GPIOBEN | RCC_AHB1ENR_GPIOCEN |
-        RCC_AHB1ENR_GPIODEN | RCC_AHB1ENR_GPIOEEN | RCC_AHB1ENR_DMA2EN;
+        RCC_AHB1ENR_GPIODEN | RCC_AHB1ENR_GPIOEEN | RCC_AHB1ENR_DMA1EN |
+        RCC_AHB1ENR_DMA2EN;
     RCC->APB1ENR |= RCC_APB1ENR_UART4EN | RCC_APB1ENR_UART5EN | RCC_APB1ENR_UART7EN |
         RCC_APB1ENR_UART8EN | RCC_APB1ENR_TIM2EN | RCC_APB1ENR_TIM3EN |
         RCC_APB1ENR_TIM4EN;
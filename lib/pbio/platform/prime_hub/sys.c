@@ -74,6 +74,18 @@ pbio_error_t pbsys_stdin_get_char(uint8_t *c) {
     return PBIO_SUCCESS;
 }
 
+pbio_error_t pbsys_stdin_read(uint8_t *buf, uint32_t size, uint32_t *count) {
+    uint32_t i = 0;
+
+    while (i < size && pbsys_stdin_get_char(&buf[i]) == PBIO_SUCCESS) {
+        i++;
+    }
+
+    *count = i;
+
+    return i ? PBIO_SUCCESS : PBIO_ERROR_AGAIN;
+}
+
 pbio_error_t pbsys_stdout_put_char(uint8_t c) {
     if (!(UART9->SR & USART_SR_TXE)) {
         return PBIO_ERROR_AGAIN;
@@ -83,6 +95,18 @@ pbio_error_t pbsys_stdout_put_char(uint8_t c) {
     return PBIO_SUCCESS;
 }
 
+pbio_error_t pbsys_stdout_write(const uint8_t *data, uint32_t size, uint32_t *count) {
+    uint32_t i = 0;
+
+    while (i < size && pbsys_stdout_put_char(data[i]) == PBIO_SUCCESS) {
+        i++;
+    }
+
+    *count = i;
+
+    return i ? PBIO_SUCCESS : PBIO_ERROR_AGAIN;
+}
+
 void pbsys_reboot(bool fw_update) {
     // this function never returns
     NVIC_SystemReset();
@@ -0,0 +1,283 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <pbio/config.h>
+
+#if PBIO_CONFIG_ATTITUDE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <fixmath.h>
+
+#include <pbdrv/imu.h>
+#include <pbio/attitude.h>
+#include <pbio/error.h>
+#include <pbio/math.h>
+#include <pbio/util.h>
+
+// Time constant of the accelerometer correction, in microseconds. The gyro is
+// trusted for changes faster than this and the accelerometer for slower ones.
+#define ACCEL_TIME_US 1000000
+
+// Same, for an IMU without gyro, where the accelerometer is all there is
+#define ACCEL_ONLY_TIME_US 100000
+
+// Acceleration in this range counts as gravity alone, in micro g. Outside of
+// it, the hub is being moved and the accelerometer is ignored.
+#define GRAVITY_MIN_UG 800000
+#define GRAVITY_MAX_UG 1200000
+
+// Roll can't be measured when the x axis points almost straight up or down
+#define ROLL_MAX_PITCH F16(60)
+
+// The hub is at rest if the gyro does not vary more than this for
+// REST_TIME_US, in millidegrees per second
+#define REST_RANGE_MDPS 3000
+#define REST_TIME_US 500000
+
+// Largest gyro bias that is expected, in millidegrees per second. Slow
+// turns faster than this are never mistaken for bias.
+#define MAX_BIAS_MDPS 10000
+
+// Once calibrated, the bias may only drift this much from one rest to the
+// next, in millidegrees per second.
+#define MAX_BIAS_CHANGE_MDPS 1000
+
+// A bias that changed by more than that is still taken if the hub stays at
+// rest with the same new bias for this long, in microseconds. This is longer
+// than a user would normally keep up a very slow steady turn.
+#define NEW_BIAS_TIME_US 3000000
+
+#define RAD_TO_DEG F16(57.29578)
+
+static fix16_t wrap_180(fix16_t angle) {
+    if (angle > F16(180)) {
+        return angle - F16(360);
+    }
+    if (angle <= F16(-180)) {
+        return angle + F16(360);
+    }
+    return angle;
+}
+
+// Angle in degrees travelled at rate in degrees per second in usecs
+static fix16_t integrate(fix16_t rate, uint32_t usecs) {
+    return (int64_t)rate * usecs / 1000000;
+}
+
+void pbio_attitude_filter_init(pbio_attitude_filter_t *filter, const pbdrv_imu_info_t *info) {
+    memset(filter, 0, sizeof(*filter));
+
+    filter->gyro_gain = fix16_div(fix16_from_int(info->gyro_scale), fix16_from_int(1000));
+
+    // weight of each sample in an exponential moving average
+    uint32_t accel_time = info->gyro_scale ? ACCEL_TIME_US : ACCEL_ONLY_TIME_US;
+    filter->accel_gain = (info->period << 16) / (accel_time + info->period);
+
+    int32_t gravity_min = GRAVITY_MIN_UG / info->accel_scale;
+    int32_t gravity_max = GRAVITY_MAX_UG / info->accel_scale;
+    filter->gravity_min_sq = gravity_min * gravity_min;
+    filter->gravity_max_sq = gravity_max * gravity_max;
+
+    if (info->gyro_scale) {
+        filter->rest_range = REST_RANGE_MDPS / info->gyro_scale;
+        filter->rest_samples = REST_TIME_US / info->period;
+        filter->max_bias = MAX_BIAS_MDPS / info->gyro_scale;
+        filter->max_bias_change = fix16_from_int(MAX_BIAS_CHANGE_MDPS / info->gyro_scale);
+        filter->new_bias_rests = NEW_BIAS_TIME_US / REST_TIME_US;
+    }
+}
+
+// Starts a new period of rest with this sample
+static void restart_rest(pbio_attitude_filter_t *filter, const int16_t *gyro) {
+    for (int i = 0; i < 3; i++) {
+        filter->rest_min[i] = filter->rest_max[i] = gyro[i];
+        filter->rest_sum[i] = 0;
+    }
+    filter->rest_count = 0;
+}
+
+// Whether two bias measurements are the same within the allowed drift
+static bool bias_agrees(pbio_attitude_filter_t *filter, const fix16_t *a, const fix16_t *b) {
+    for (int i = 0; i < 3; i++) {
+        if (fix16_abs(a[i] - b[i]) > filter->max_bias_change) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Measures the gyro bias when the hub has been at rest for long enough
+static void update_bias(pbio_attitude_filter_t *filter, const int16_t *gyro) {
+    if (filter->rest_samples == 0) {
+        // no gyro
+        return;
+    }
+
+    if (filter->rest_count == 0) {
+        restart_rest(filter, gyro);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        if (gyro[i] < filter->rest_min[i]) {
+            filter->rest_min[i] = gyro[i];
+        }
+        if (gyro[i] > filter->rest_max[i]) {
+            filter->rest_max[i] = gyro[i];
+        }
+        if (filter->rest_max[i] - filter->rest_min[i] > filter->rest_range ||
+            gyro[i] > filter->max_bias || gyro[i] < -filter->max_bias) {
+            restart_rest(filter, gyro);
+            // the hub moved, so the next rest can't confirm a new bias
+            filter->new_bias_count = 0;
+            break;
+        }
+    }
+
+    for (int i = 0; i < 3; i++) {
+        filter->rest_sum[i] += gyro[i];
+    }
+
+    if (++filter->rest_count < filter->rest_samples) {
+        return;
+    }
+
+    fix16_t bias[3];
+    for (int i = 0; i < 3; i++) {
+        bias[i] = ((int64_t)filter->rest_sum[i] << 16) / filter->rest_count;
+    }
+    filter->rest_count = 0;
+
+    // A very slow steady turn looks like rest too, but unlike the bias, it
+    // does not stay the same from one rest to the next. A bias that jumped,
+    // for example because the temperature changed, is taken once it has been
+    // the same for several rests in a row.
+    if (filter->attitude.calibrated && !bias_agrees(filter, bias, filter->bias)) {
+        if (filter->new_bias_count > 0 && bias_agrees(filter, bias, filter->new_bias)) {
+            filter->new_bias_count++;
+        } else {
+            filter->new_bias_count = 1;
+        }
+        memcpy(filter->new_bias, bias, sizeof(bias));
+        if (filter->new_bias_count < filter->new_bias_rests) {
+            return;
+        }
+    }
+
+    filter->new_bias_count = 0;
+
+    memcpy(filter->bias, bias, sizeof(bias));
+    filter->attitude.calibrated = true;
+}
+
+void pbio_attitude_filter_update(pbio_attitude_filter_t *filter, const pbdrv_imu_sample_t *sample) {
+    pbio_attitude_t *attitude = &filter->attitude;
+    int32_t x = sample->accel[0];
+    int32_t y = sample->accel[1];
+    int32_t z = sample->accel[2];
+    fix16_t accel_roll = 0;
+    fix16_t accel_pitch = 0;
+
+    update_bias(filter, sample->gyro);
+
+    // Tilt according to gravity. The raw values are used as fix16 arguments,
+    // since only their ratio matters.
+    uint32_t yz_sq = (uint32_t)(y * y) + (uint32_t)(z * z);
+    uint32_t xyz_sq = yz_sq + (uint32_t)(x * x);
+    bool gravity_only = xyz_sq >= filter->gravity_min_sq && xyz_sq <= filter->gravity_max_sq;
+    if (gravity_only) {
+        accel_roll = fix16_mul(fix16_atan2(y, z), RAD_TO_DEG);
+        accel_pitch = fix16_mul(fix16_atan2(-x, pbio_math_sqrt(yz_sq)), RAD_TO_DEG);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        attitude->rate[i] = fix16_mul(fix16_from_int(sample->gyro[i]) - filter->bias[i], filter->gyro_gain);
+    }
+
+    if (!filter->started) {
+        attitude->roll = accel_roll;
+        attitude->pitch = accel_pitch;
+        filter->prev_time = sample->time;
+        filter->started = true;
+        return;
+    }
+
+    uint32_t dt = sample->time - filter->prev_time;
+    filter->prev_time = sample->time;
+
+    attitude->roll = wrap_180(attitude->roll + integrate(attitude->rate[0], dt));
+    attitude->pitch += integrate(attitude->rate[1], dt);
+    attitude->heading = wrap_180(attitude->heading + integrate(attitude->rate[2], dt));
+
+    if (gravity_only) {
+        attitude->pitch += fix16_mul(accel_pitch - attitude->pitch, filter->accel_gain);
+        if (fix16_abs(accel_pitch) < ROLL_MAX_PITCH) {
+            attitude->roll = wrap_180(attitude->roll +
+                fix16_mul(wrap_180(accel_roll - attitude->roll), filter->accel_gain));
+        }
+    }
+
+    if (attitude->pitch > F16(90)) {
+        attitude->pitch = F16(90);
+    } else if (attitude->pitch < F16(-90)) {
+        attitude->pitch = F16(-90);
+    }
+}
+
+static pbio_attitude_filter_t attitude_filter;
+static bool attitude_initialized;
+static uint32_t attitude_index;
+
+void _pbio_attitude_poll(void) {
+    pbdrv_imu_sample_t samples[8];
+    uint32_t count;
+
+    if (!attitude_initialized) {
+        pbdrv_imu_info_t info;
+        if (pbdrv_imu_get_info(&info) != PBIO_SUCCESS) {
+            return;
+        }
+        pbio_attitude_filter_init(&attitude_filter, &info);
+        attitude_initialized = true;
+    }
+
+    while (pbdrv_imu_read(&attitude_index, samples, PBIO_ARRAY_SIZE(samples), &count) == PBIO_SUCCESS && count > 0) {
+        for (uint32_t i = 0; i < count; i++) {
+            pbio_attitude_filter_update(&attitude_filter, &samples[i]);
+        }
+    }
+}
+
+pbio_error_t pbio_attitude_get(pbio_attitude_t *attitude) {
+    pbdrv_imu_info_t info;
+
+    pbio_error_t err = pbdrv_imu_get_info(&info);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    if (!attitude_filter.started) {
+        return PBIO_ERROR_AGAIN;
+    }
+
+    *attitude = attitude_filter.attitude;
+
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbio_attitude_reset_heading(fix16_t heading) {
+    pbio_attitude_t attitude;
+
+    pbio_error_t err = pbio_attitude_get(&attitude);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    attitude_filter.attitude.heading = wrap_180(heading);
+
+    return PBIO_SUCCESS;
+}
+
+#endif // PBIO_CONFIG_ATTITUDE
@@ -72,6 +72,38 @@ pbio_error_t pbio_iodev_get_data(pbio_iodev_t *iodev, uint8_t **data) {
     return PBIO_SUCCESS;
 }
 
+/**
+ * Gets the raw data of one mode from an I/O device.
+ * @param [in]  iodev       The I/O device
+ * @param [in]  mode        The mode
+ * @param [out] data        Pointer to hold array of data values
+ * @return                  ::PBIO_SUCCESS on success
+ *                          ::PBIO_ERROR_NO_DEV if the port does not have a device attached
+ *                          ::PBIO_ERROR_INVALID_OP if the device is not streaming this mode
+ *
+ * This works for the current mode and for any mode that is part of an active
+ * combined mode. The binary format and size of *data* is determined by
+ * ::pbio_iodev_get_data_format().
+ */
+pbio_error_t pbio_iodev_get_mode_data(pbio_iodev_t *iodev, uint8_t mode, uint8_t **data) {
+    if (iodev->info->type_id == PBIO_IODEV_TYPE_ID_NONE) {
+        return PBIO_ERROR_NO_DEV;
+    }
+
+    if (mode < PBIO_IODEV_MAX_NUM_MODES && (iodev->combo_modes & (1 << mode))) {
+        *data = iodev->bin_data + iodev->combo_offset[mode];
+        return PBIO_SUCCESS;
+    }
+
+    if (iodev->combo_modes || iodev->mode != mode) {
+        return PBIO_ERROR_INVALID_OP;
+    }
+
+    *data = iodev->bin_data;
+
+    return PBIO_SUCCESS;
+}
+
 /**
  * Sets the mode of an I/O device.
  * @param [in]  iodev       The I/O device
@@ -108,6 +140,38 @@ void pbio_iodev_set_mode_cancel(pbio_iodev_t *iodev) {
     iodev->ops->set_mode_cancel(iodev);
 }
 
+/**
+ * Sets a combined mode of an I/O device, so that it streams all datasets of
+ * several modes at the same time.
+ * @param [in]  iodev       The I/O device
+ * @param [in]  modes       The modes to combine
+ * @param [in]  num_modes   The number of modes in *modes*
+ * @return                  ::PBIO_SUCCESS on success
+ *                          ::PBIO_ERROR_INVALID_ARG if the modes can't be combined
+ *                          ::PBIO_ERROR_NOT_SUPPORTED if the device does not support combined modes
+ *
+ * Completion is awaited with ::pbio_iodev_set_mode_end(). Afterwards, the data
+ * of each mode is available through ::pbio_iodev_get_mode_data(). Setting a
+ * single mode ends the combined mode.
+ */
+pbio_error_t pbio_iodev_set_mode_combo_begin(pbio_iodev_t *iodev, const uint8_t *modes, uint8_t num_modes) {
+    if (!iodev->ops->set_mode_combo_begin) {
+        return PBIO_ERROR_NOT_SUPPORTED;
+    }
+
+    if (num_modes == 0) {
+        return PBIO_ERROR_INVALID_ARG;
+    }
+
+    for (uint8_t i = 0; i < num_modes; i++) {
+        if (modes[i] >= iodev->info->num_modes) {
+            return PBIO_ERROR_INVALID_ARG;
+        }
+    }
+
+    return iodev->ops->set_mode_combo_begin(iodev, modes, num_modes);
+}
+
 /**
  * Sets the raw data of an I/O device.
  * @param [in]  iodev       The I/O device
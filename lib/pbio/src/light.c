@@ -22,6 +22,9 @@ static user_data_t user_light_data;
 
 static bool user_mode_active = true;
 
+// user light data has not been applied to the light yet
+static bool user_light_changed = true;
+
 static const uint8_t flash_pattern_data[8] = {
     0, 0, 0, 0, 1, 0, 1, 0
 };
@@ -56,6 +59,7 @@ pbio_error_t _pbio_light_on(pbio_port_t port, pbio_light_color_t color, pbio_lig
     data.pattern = pattern;
 
     user_light_data = data;
+    user_light_changed = true;
 
     return PBIO_SUCCESS;
 }
@@ -93,6 +97,16 @@ void _pbio_light_poll(uint32_t now) {
     }
 
     pbdrv_light_set_rgb(PBIO_PORT_SELF, data.r, data.g, data.b);
+    user_light_changed = false;
+}
+
+/**
+ * Checks if ::_pbio_light_poll() has anything to do, i.e. if the user light
+ * changed or if it shows a pattern.
+ * @return              *true* if the light needs to be polled
+ */
+bool _pbio_light_needs_poll(void) {
+    return user_mode_active && (user_light_changed || user_light_data.pattern != PBIO_LIGHT_PATTERN_NONE);
 }
 
 /**
@@ -103,6 +117,7 @@ void _pbio_light_poll(uint32_t now) {
  */
 void _pbio_light_set_user_mode(bool user_mode) {
     user_mode_active = user_mode;
+    user_light_changed = true;
 }
 
 #endif // PBDRV_CONFIG_LIGHT
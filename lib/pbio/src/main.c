@@ -11,16 +11,22 @@
 #include <contiki.h>
 
 #include "pbdrv/button.h"
+#include "pbdrv/clock.h"
 #include "pbdrv/config.h"
 #include "pbdrv/light.h"
 #include "pbdrv/motor.h"
 #include "pbsys/sys.h"
+#include "pbio/attitude.h"
 #include "pbio/config.h"
+#include "pbio/light.h"
 #include "pbio/motorpoll.h"
+#include "pbio/stats.h"
 #include "pbio/uartdev.h"
 
 #include "processes.h"
 
+#define SLOW_POLL_PERIOD_MS 32
+
 static clock_time_t prev_fast_poll_time;
 static clock_time_t prev_slow_poll_time;
 
@@ -39,6 +45,12 @@ AUTOSTART_PROCESSES(
 #if PBDRV_CONFIG_COUNTER
     ,&pbdrv_counter_process
 #endif
+#if PBDRV_CONFIG_I2C
+    ,&pbdrv_i2c_process
+#endif
+#if PBDRV_CONFIG_IMU
+    ,&pbdrv_imu_process
+#endif
 #if PBDRV_CONFIG_IOPORT_EV3DEV_STRETCH
     ,&pbdrv_ioport_ev3dev_stretch_process
 #endif
@@ -71,6 +83,49 @@ void pbio_init(void) {
     _pbio_motorpoll_reset_all();
 }
 
+#if PBIO_CONFIG_STATS
+
+static bool prev_servo_active;
+static uint32_t prev_servo_usecs;
+
+static void motorpoll_poll(void) {
+    bool active = _pbio_motorpoll_needs_poll();
+    uint32_t start = clock_usecs();
+    _pbio_motorpoll_poll();
+    uint32_t end = clock_usecs();
+
+    // Only count updates where motors are actually being controlled
+    if (!active) {
+        prev_servo_active = false;
+        return;
+    }
+
+    pbio_stats_add(PBIO_STATS_MOTORPOLL, end - start);
+
+    if (prev_servo_active) {
+        uint32_t period = start - prev_servo_usecs;
+        int32_t jitter = period - PBIO_CONFIG_SERVO_PERIOD_MS * 1000;
+        pbio_stats_add(PBIO_STATS_SERVO_PERIOD, period);
+        pbio_stats_add(PBIO_STATS_SERVO_JITTER, jitter < 0 ? -jitter : jitter);
+    }
+
+    prev_servo_active = true;
+    prev_servo_usecs = start;
+}
+
+static void light_poll(clock_time_t now) {
+    uint32_t start = clock_usecs();
+    _pbio_light_poll(now);
+    pbio_stats_add(PBIO_STATS_LIGHTPOLL, clock_usecs() - start);
+}
+
+#else // PBIO_CONFIG_STATS
+
+#define motorpoll_poll _pbio_motorpoll_poll
+#define light_poll _pbio_light_poll
+
+#endif // PBIO_CONFIG_STATS
+
 /**
  * Checks for and performs pending background tasks. This function is meant to
  * be called as frequently as possible. To conserve power, you an wait for an
@@ -84,16 +139,58 @@ int pbio_do_one_event(void) {
     // don't want to call all of the subroutines unless enough time has
     // actually elapsed to do something useful.
     if (now - prev_fast_poll_time >= clock_from_msec(PBIO_CONFIG_SERVO_PERIOD_MS)) {
-        _pbio_motorpoll_poll();
+        motorpoll_poll();
+        _pbio_attitude_poll();
         prev_fast_poll_time = clock_time();
     }
-    if (now - prev_slow_poll_time >= clock_from_msec(32)) {
-        _pbio_light_poll(now);
+    if (now - prev_slow_poll_time >= clock_from_msec(SLOW_POLL_PERIOD_MS)) {
+        light_poll(now);
         prev_slow_poll_time = now;
     }
     return process_run();
 }
 
+// Shortens *idle* if *deadline* comes before the end of it. Returns false if
+// the deadline has already passed.
+static bool update_idle_time(clock_time_t now, clock_time_t deadline, clock_time_t *idle) {
+    int32_t remaining = deadline - now;
+
+    if (remaining <= 0) {
+        return false;
+    }
+    if ((clock_time_t)remaining < *idle) {
+        *idle = remaining;
+    }
+    return true;
+}
+
+/**
+ * Waits until an interrupt occurs or until the next background task is due,
+ * whichever comes first. Background tasks are only considered if there is
+ * something for them to do, e.g. motors that are being controlled, so the
+ * CPU does not have to wake up on every clock tick when everything is idle.
+ * Call this when ::pbio_do_one_event() returns 0.
+ * @param [in]  timeout     The maximum time to wait in milliseconds.
+ */
+void pbio_idle(uint32_t timeout) {
+    clock_time_t now = clock_time();
+    clock_time_t idle = clock_from_msec(timeout);
+
+    if (_pbio_motorpoll_needs_poll() && !update_idle_time(now,
+        prev_fast_poll_time + clock_from_msec(PBIO_CONFIG_SERVO_PERIOD_MS), &idle)) {
+        return;
+    }
+    if (_pbio_light_needs_poll() && !update_idle_time(now,
+        prev_slow_poll_time + clock_from_msec(SLOW_POLL_PERIOD_MS), &idle)) {
+        return;
+    }
+    if (etimer_pending() && !update_idle_time(now, etimer_next_expiration_time(), &idle)) {
+        return;
+    }
+
+    pbdrv_clock_idle(idle);
+}
+
 #if PBIO_CONFIG_ENABLE_DEINIT
 /**
  * Releases all resources used by the library. Calling this function is
@@ -5,6 +5,7 @@
 #include <pbio/drivebase.h>
 #include <pbio/motorpoll.h>
 #include <pbio/servo.h>
+#include <pbio/trace.h>
 
 #if PBDRV_CONFIG_NUM_MOTOR_CONTROLLER != 0
 
@@ -107,6 +108,7 @@ void _pbio_motorpoll_poll(void) {
             err = pbio_servo_control_update(&servo[i]);
             if (err != PBIO_SUCCESS) {
                 servo_err[i] = err;
+                pbio_trace(PBIO_TRACE_SERVO_ERR, servo[i].port, err);
             }
         }
     }
@@ -116,8 +118,19 @@ void _pbio_motorpoll_poll(void) {
         err = pbio_drivebase_update(&drivebase);
         if (err != PBIO_SUCCESS) {
             drivebase_err = err;
+            pbio_trace(PBIO_TRACE_DRIVEBASE_ERR, PBIO_PORT_NONE, err);
         }
     }
 }
 
+// Checks if any servo or the drivebase is still being controlled
+bool _pbio_motorpoll_needs_poll(void) {
+    for (int i = 0; i < PBDRV_CONFIG_NUM_MOTOR_CONTROLLER; i++) {
+        if (servo_err[i] == PBIO_ERROR_AGAIN) {
+            return true;
+        }
+    }
+    return drivebase_err == PBIO_ERROR_AGAIN;
+}
+
 #endif // PBDRV_CONFIG_NUM_MOTOR_CONTROLLER
@@ -27,6 +27,14 @@ PROCESS_NAME(pbdrv_bluetooth_spi_process);
 PROCESS_NAME(pbdrv_counter_process);
 #endif
 
+#if PBDRV_CONFIG_I2C
+PROCESS_NAME(pbdrv_i2c_process);
+#endif
+
+#if PBDRV_CONFIG_IMU
+PROCESS_NAME(pbdrv_imu_process);
+#endif
+
 #if PBDRV_CONFIG_IOPORT_EV3DEV_STRETCH
 PROCESS_NAME(pbdrv_ioport_ev3dev_stretch_process);
 #endif
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <stdint.h>
+#include <string.h>
+
+#include <pbio/ringbuf.h>
+
+// Keeps the compiler from moving buffer accesses past the head/tail update
+#define COMPILER_BARRIER() __asm__ volatile ("" ::: "memory")
+
+void pbio_ringbuf_init(pbio_ringbuf_t *rb, uint8_t *data, uint32_t size) {
+    rb->data = data;
+    rb->size = size;
+    rb->head = 0;
+    rb->tail = 0;
+}
+
+uint32_t pbio_ringbuf_write(pbio_ringbuf_t *rb, const uint8_t *data, uint32_t size) {
+    uint32_t head = rb->head;
+    uint32_t space = rb->size - (head - rb->tail);
+
+    if (size > space) {
+        size = space;
+    }
+
+    // Copy up to the end of the buffer, then wrap around
+    uint32_t start = head & (rb->size - 1);
+    uint32_t first = rb->size - start;
+    if (first > size) {
+        first = size;
+    }
+    memcpy(&rb->data[start], data, first);
+    memcpy(rb->data, &data[first], size - first);
+
+    // Only publish the new head once the data is in place
+    COMPILER_BARRIER();
+    rb->head = head + size;
+
+    return size;
+}
+
+uint32_t pbio_ringbuf_read(pbio_ringbuf_t *rb, uint8_t *data, uint32_t size) {
+    uint32_t tail = rb->tail;
+    uint32_t count = rb->head - tail;
+
+    if (size > count) {
+        size = count;
+    }
+
+    // Don't read data that the producer might not have finished writing
+    COMPILER_BARRIER();
+
+    uint32_t start = tail & (rb->size - 1);
+    uint32_t first = rb->size - start;
+    if (first > size) {
+        first = size;
+    }
+    memcpy(data, &rb->data[start], first);
+    memcpy(&data[first], rb->data, size - first);
+
+    // Only free the space once the data has been copied out
+    COMPILER_BARRIER();
+    rb->tail = tail + size;
+
+    return size;
+}
@@ -231,24 +231,32 @@ pbio_error_t pbio_servo_reset_angle(pbio_servo_t *srv, int32_t reset_angle, bool
     return pbio_servo_track_target(srv, new_target);
 }
 
-// Get the physical state of a single motor
-static pbio_error_t servo_get_state(pbio_servo_t *srv, int32_t *time_now, int32_t *count_now, int32_t *rate_now) {
-
-    pbio_error_t err;
+// Get angle, speed and duty cycle in user units, all from the same sample
+pbio_error_t pbio_servo_get_state_user(pbio_servo_t *srv, int32_t *angle, int32_t *speed, int32_t *duty) {
 
-    // Read current state of this motor: current time, speed, and position
-    *time_now = clock_usecs();
-    err = pbio_tacho_get_count(srv->tacho, count_now);
+    pbio_error_t err = pbio_tacho_get_angular_state(srv->tacho, angle, speed);
     if (err != PBIO_SUCCESS) {
         return err;
     }
-    err = pbio_tacho_get_rate(srv->tacho, rate_now);
+
+    // Duty cycle that is currently applied, which is 0 when coasting or braking
+    pbio_passivity_t state;
+    err = pbio_dcmotor_get_state(srv->dcmotor, &state, duty);
     if (err != PBIO_SUCCESS) {
         return err;
     }
+    *duty = *duty * PBIO_DUTY_USER_STEPS / PBDRV_MAX_DUTY;
     return PBIO_SUCCESS;
 }
 
+// Get the physical state of a single motor
+static pbio_error_t servo_get_state(pbio_servo_t *srv, int32_t *time_now, int32_t *count_now, int32_t *rate_now) {
+
+    // Read current state of this motor: current time, speed, and position
+    *time_now = clock_usecs();
+    return pbio_tacho_get_state(srv->tacho, count_now, rate_now);
+}
+
 // Actuate a single motor
 static pbio_error_t pbio_servo_actuate(pbio_servo_t *srv, pbio_actuation_t actuation_type, int32_t control) {
 
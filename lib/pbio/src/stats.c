@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <pbio/config.h>
+
+#if PBIO_CONFIG_STATS
+
+#include <stdint.h>
+#include <string.h>
+
+#include <contiki.h>
+
+#include <pbio/stats.h>
+
+static pbio_stats_t stats[PBIO_STATS_NUM];
+
+void pbio_stats_add(pbio_stats_id_t id, uint32_t usecs) {
+    pbio_stats_t *s = &stats[id];
+
+    if (s->count == 0 || usecs < s->min) {
+        s->min = usecs;
+    }
+    if (usecs > s->max) {
+        s->max = usecs;
+    }
+    s->count++;
+    s->total += usecs;
+
+    // Each bin is twice as wide as the one before it
+    uint32_t bin = 0;
+    for (uint32_t v = usecs / PBIO_STATS_HISTOGRAM_MIN_US; v && bin < PBIO_STATS_HISTOGRAM_SIZE - 1; v >>= 1) {
+        bin++;
+    }
+    s->histogram[bin]++;
+}
+
+const pbio_stats_t *pbio_stats_get(pbio_stats_id_t id) {
+    return &stats[id];
+}
+
+void pbio_stats_reset(void) {
+    memset(stats, 0, sizeof(stats));
+
+    #if PROCESS_CONF_STATS
+    for (struct process *p = PROCESS_LIST(); p; p = p->next) {
+        p->stats_calls = 0;
+        p->stats_usecs = 0;
+        p->stats_max_usecs = 0;
+    }
+    #endif
+}
+
+#endif // PBIO_CONFIG_STATS
@@ -164,4 +164,37 @@ pbio_error_t pbio_tacho_get_angular_rate(pbio_tacho_t *tacho, int32_t *angular_r
     return PBIO_SUCCESS;
 }
 
+// Gets count and rate from the same counter sample
+pbio_error_t pbio_tacho_get_state(pbio_tacho_t *tacho, int32_t *count, int32_t *encoder_rate) {
+    pbio_error_t err;
+
+    err = pbdrv_counter_get_state(tacho->counter, count, encoder_rate);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    if (tacho->direction == PBIO_DIRECTION_COUNTERCLOCKWISE) {
+        *count = -*count;
+        *encoder_rate = -*encoder_rate;
+    }
+    *count -= tacho->offset;
+
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbio_tacho_get_angular_state(pbio_tacho_t *tacho, int32_t *angle, int32_t *angular_rate) {
+    int32_t encoder_count, encoder_rate;
+    pbio_error_t err;
+
+    err = pbio_tacho_get_state(tacho, &encoder_count, &encoder_rate);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    *angle = pbio_math_div_i32_fix16(encoder_count, tacho->counts_per_degree);
+    *angular_rate = pbio_math_div_i32_fix16(encoder_rate, tacho->counts_per_degree);
+
+    return PBIO_SUCCESS;
+}
+
 #endif // PBIO_CONFIG_TACHO
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <pbio/config.h>
+
+#if PBIO_CONFIG_TRACE
+
+#include <stdint.h>
+
+#include <contiki.h>
+
+#include <pbio/trace.h>
+
+static pbio_trace_entry_t trace[PBIO_CONFIG_TRACE_SIZE];
+
+// Free-running count of entries ever added. The oldest entry is overwritten
+// when the buffer is full.
+static uint32_t trace_count;
+
+void pbio_trace(pbio_trace_event_t event, pbio_port_t port, uint16_t data) {
+    pbio_trace_entry_t *entry = &trace[trace_count % PBIO_CONFIG_TRACE_SIZE];
+    entry->time = clock_to_msec(clock_time());
+    entry->event = event;
+    entry->port = port;
+    entry->data = data;
+    trace_count++;
+}
+
+uint32_t pbio_trace_read(pbio_trace_entry_t *entries) {
+    uint32_t n = trace_count < PBIO_CONFIG_TRACE_SIZE ? trace_count : PBIO_CONFIG_TRACE_SIZE;
+    for (uint32_t i = 0; i < n; i++) {
+        entries[i] = trace[(trace_count - n + i) % PBIO_CONFIG_TRACE_SIZE];
+    }
+    return n;
+}
+
+void pbio_trace_clear(void) {
+    trace_count = 0;
+}
+
+#endif // PBIO_CONFIG_TRACE
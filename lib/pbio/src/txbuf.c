@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <pbio/txbuf.h>
+
+void pbio_txbuf_init(pbio_txbuf_t *txbuf, uint8_t *data, uint16_t capacity) {
+    txbuf->data = data;
+    txbuf->capacity = capacity;
+    txbuf->packet_size = capacity;
+    pbio_txbuf_clear(txbuf);
+}
+
+void pbio_txbuf_set_packet_size(pbio_txbuf_t *txbuf, uint16_t size) {
+    txbuf->packet_size = size < txbuf->capacity ? size : txbuf->capacity;
+}
+
+void pbio_txbuf_clear(pbio_txbuf_t *txbuf) {
+    txbuf->size[0] = txbuf->size[1] = 0;
+    txbuf->fill = 0;
+    txbuf->sending = false;
+}
+
+uint32_t pbio_txbuf_write(pbio_txbuf_t *txbuf, const uint8_t *data, uint32_t size) {
+    uint16_t *used = &txbuf->size[txbuf->fill];
+
+    // The packet size may have been made smaller after bytes were added
+    if (*used >= txbuf->packet_size) {
+        return 0;
+    }
+
+    uint32_t free = txbuf->packet_size - *used;
+    if (size > free) {
+        size = free;
+    }
+
+    memcpy(&txbuf->data[txbuf->fill * txbuf->capacity + *used], data, size);
+    *used += size;
+
+    return size;
+}
+
+bool pbio_txbuf_send_begin(pbio_txbuf_t *txbuf, const uint8_t **data, uint16_t *size) {
+    if (txbuf->sending || !txbuf->size[txbuf->fill]) {
+        return false;
+    }
+
+    // Send the filled packet and fill the other one in the mean time
+    *data = &txbuf->data[txbuf->fill * txbuf->capacity];
+    *size = txbuf->size[txbuf->fill];
+    txbuf->fill ^= 1;
+    txbuf->sending = true;
+
+    return true;
+}
+
+void pbio_txbuf_send_end(pbio_txbuf_t *txbuf) {
+    txbuf->size[txbuf->fill ^ 1] = 0;
+    txbuf->sending = false;
+}
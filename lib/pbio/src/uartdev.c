@@ -23,14 +23,16 @@
 
 #if PBIO_CONFIG_UARTDEV
 
+// Errors are always added to the trace, with the line number where they
+// happened. The error message is only kept when debugging.
 #define DEBUG 0
 #if DEBUG
 #include <inttypes.h>
 #define debug_pr(fmt, ...)   printf((fmt), __VA_ARGS__)
-#define DBG_ERR(expr) expr
+#define DBG_ERR(expr) do { expr; pbio_trace(PBIO_TRACE_UARTDEV_ERR, data->iodev.port, __LINE__); } while (0)
 #else
 #define debug_pr(...)
-#define DBG_ERR(expr)
+#define DBG_ERR(expr) pbio_trace(PBIO_TRACE_UARTDEV_ERR, data->iodev.port, __LINE__)
 #endif
 
 #include <stdint.h>
@@ -47,6 +49,7 @@
 #include "pbio/event.h"
 #include "pbio/iodev.h"
 #include "pbio/port.h"
+#include "pbio/trace.h"
 #include "pbio/uartdev.h"
 #include "pbio/util.h"
 #include "../drv/counter/counter.h"
@@ -59,7 +62,14 @@
 #define EV3_UART_TYPE_MAX           101
 #define EV3_UART_SPEED_MIN          2400
 #define EV3_UART_SPEED_LPF2         115200  // standard baud rate for Powered Up
-#define EV3_UART_SPEED_MAX          460800  // in practice 115200 is max
+#define EV3_UART_SPEED_MAX          460800
+
+// Fastest baud rate that the UART driver of the platform can do
+#ifndef PBIO_CONFIG_UARTDEV_MAX_BAUD_RATE
+#define PBIO_CONFIG_UARTDEV_MAX_BAUD_RATE   EV3_UART_SPEED_LPF2
+#endif
+
+#define EV3_UART_MAX_COMBO_ENTRIES  8       // datasets per combined mode
 
 #define EV3_UART_DATA_KEEP_ALIVE_TIMEOUT    100 /* msec */
 #define EV3_UART_IO_TIMEOUT                 250 /* msec */
@@ -132,7 +142,6 @@ typedef enum {
  * @iodev: The I/O device state information struct
  * @counter_dev: A counter device to provide access to tacho counts
  * @pt: Protothread for main communication protocol
- * @data_pt: Protothread for receiving sensor data
  * @speed_pt: Protothread for setting the baud rate
  * @timer: Timer for sending keepalive messages and other delays.
  * @uart: Pointer to the UART device to use for communications
@@ -144,6 +153,12 @@ typedef enum {
  * @new_mode: The mode requested by set_mode. Also used to keep track of mode
  *  in INFO messages while syncing.
  * @new_baud_rate: New baud rate that will be set with ev3_uart_change_bitrate
+ * @baud_rate: The baud rate currently used for DATA messages
+ * @max_baud_rate: Fastest baud rate to use on this port. Lowered when a rate
+ *      did not work for the device of type @max_baud_rate_type_id.
+ * @max_baud_rate_type_id: The type of device that @max_baud_rate applies to
+ * @speed_cmd_ok: Flag that indicates that the device acknowledged the SPEED
+ *      command during sync, so it can be asked for a different rate.
  * @info_flags: Flags indicating what information has already been read
  *      from the data.
  * @tacho_count: The tacho count received from an LPF2 motor
@@ -151,27 +166,36 @@ typedef enum {
  * @tx_msg: Buffer to hold messages transmitted to the device
  * @rx_msg: Buffer to hold messages received from the device
  * @rx_msg_size: Size of the current message being received
+ * @rx_msg_index: Number of bytes of the current DATA message received so far
  * @ext_mode: Extra mode adder for Powered Up devices (for modes > LUMP_MAX_MODE)
  * @write_cmd_size: The size parameter received from a WRITE command
  * @tacho_rate: The tacho rate received from an LPF2 motor
  * @max_tacho_rate: The "100%" rate received from an LPF2 motor
  * @last_err: data->msg to be printed in case of an error.
  * @err_count: Total number of errors that have occurred
+ * @num_data_msgs: Number of good DATA messages since the last sync
+ * @rx_bytes: Number of bytes received since @stats_time
+ * @rx_msgs: Number of messages received since @stats_time
+ * @stats_time: Time at which the link statistics were last updated
+ * @stats: The link statistics
  * @num_data_err: Number of bad reads when receiving DATA data->msgs.
  * @data_rec: Flag that indicates that good DATA data->msg has been received
  *      since last watchdog timeout.
  * @tx_busy: mutex that protects tx_msg
  * @mode_change_tx_done: Flag to keep ev3_uart_set_mode_end() blocked until
  * mode has actually changed
+ * @num_stale_data: Number of DATA messages in the new mode that may still
+ *      contain data measured before the mode change
  * @speed_payload: Buffer for holding baud rate change message data
  * @mode_combo_payload: Buffer for holding mode combo message data
  * @mode_combo_size: Actual size of mode combo message
+ * @new_combo_modes: Modes requested by set_mode_combo, or 0 if a single mode
+ *      was requested.
  */
 typedef struct {
     pbio_iodev_t iodev;
     pbdrv_counter_dev_t counter_dev;
     struct pt pt;
-    struct pt data_pt;
     struct pt speed_pt;
     struct etimer timer;
     pbdrv_uart_dev_t *uart;
@@ -181,25 +205,39 @@ typedef struct {
     uint8_t requested_mode;
     uint8_t new_mode;
     uint32_t new_baud_rate;
+    uint32_t baud_rate;
+    uint32_t max_baud_rate;
+    pbio_iodev_type_id_t max_baud_rate_type_id;
+    bool speed_cmd_ok;
     uint32_t info_flags;
     int32_t tacho_count;
     int16_t abs_pos;
     uint8_t *tx_msg;
     uint8_t *rx_msg;
     uint8_t rx_msg_size;
+    uint8_t rx_msg_index;
     uint8_t ext_mode;
     uint8_t write_cmd_size;
     int8_t tacho_rate;
     int32_t max_tacho_rate;
-    DBG_ERR(const char *last_err);
+    #if DEBUG
+    const char *last_err;
+    #endif
     uint32_t err_count;
+    uint32_t num_data_msgs;
+    uint32_t rx_bytes;
+    uint32_t rx_msgs;
+    clock_time_t stats_time;
+    pbio_uartdev_stats_t stats;
     uint32_t num_data_err;
     bool data_rec;
     bool tx_busy;
     bool mode_change_tx_done;
+    uint8_t num_stale_data;
     uint8_t speed_payload[4];
-    uint8_t mode_combo_payload[5];
+    uint8_t mode_combo_payload[EV3_UART_MAX_COMBO_ENTRIES + 2];
     uint8_t mode_combo_size;
+    uint16_t new_combo_modes;
 } uartdev_port_data_t;
 
 enum {
@@ -228,6 +266,27 @@ static const pbio_iodev_mode_t ev3_uart_default_mode_info = {
 
 #define PBIO_PT_WAIT_READY(pt, expr) PT_WAIT_UNTIL((pt), (expr) != PBIO_ERROR_AGAIN)
 
+/**
+ * Gets the link statistics of a UART device port.
+ * @param [in]  id          The uartdev ID
+ * @param [out] stats       The statistics
+ * @return                  ::PBIO_SUCCESS on success
+ *                          ::PBIO_ERROR_INVALID_ARG if the ID is not valid
+ */
+pbio_error_t pbio_uartdev_get_stats(uint8_t id, pbio_uartdev_stats_t *stats) {
+    if (id >= PBIO_CONFIG_UARTDEV_NUM_DEV) {
+        return PBIO_ERROR_INVALID_ARG;
+    }
+
+    uartdev_port_data_t *data = &dev_data[id];
+
+    *stats = data->stats;
+    stats->baud_rate = data->status == PBIO_UARTDEV_STATUS_DATA ? data->baud_rate : 0;
+    stats->err_count = data->err_count;
+
+    return PBIO_SUCCESS;
+}
+
 pbio_error_t pbio_uartdev_get(uint8_t id, pbio_iodev_t **iodev) {
     if (id >= PBIO_CONFIG_UARTDEV_NUM_DEV) {
         return PBIO_ERROR_INVALID_ARG;
@@ -304,6 +363,21 @@ static void pbio_uartdev_set_mode_flags(pbio_iodev_type_id_t type_id, uint8_t mo
     }
 }
 
+// Some sensors send one or more DATA messages in the new mode that were still
+// measured with the settings of the previous mode (e.g. with the light set for
+// the previous mode). This gets the number of such messages to skip before the
+// data is considered to be fresh.
+static uint8_t pbio_uartdev_get_num_stale_data(pbio_iodev_type_id_t type_id, uint8_t mode) {
+    switch (type_id) {
+        case PBIO_IODEV_TYPE_ID_SPIKE_COLOR_SENSOR:
+            return 2;
+        case PBIO_IODEV_TYPE_ID_SPIKE_ULTRASONIC_SENSOR:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
 static void pbio_uartdev_parse_msg(uartdev_port_data_t *data) {
     uint32_t speed;
     uint8_t msg_type, cmd, msg_size, mode, cmd2;
@@ -331,7 +405,6 @@ static void pbio_uartdev_parse_msg(uartdev_port_data_t *data) {
             checksum ^= data->rx_msg[i];
         }
         if (checksum != data->rx_msg[msg_size - 1]) {
-            DBG_ERR(data->last_err = "Bad checksum");
             // if INFO messages are done and we are now receiving data, it is
             // OK to occasionally have a bad checksum
             if (data->status == PBIO_UARTDEV_STATUS_DATA) {
@@ -344,6 +417,7 @@ static void pbio_uartdev_parse_msg(uartdev_port_data_t *data) {
                     return;
                 }
             } else {
+                DBG_ERR(data->last_err = "Bad checksum");
                 goto err;
             }
         }
@@ -594,10 +668,17 @@ static void pbio_uartdev_parse_msg(uartdev_port_data_t *data) {
                         goto err;
                     }
 
-                    // REVISIT: this is potentially an array of combos
-                    data->info->mode_combos = data->rx_msg[3] << 8 | data->rx_msg[2];
-
-                    debug_pr("mode combos: %04x\n", data->info->mode_combos);
+                    // The payload is an array of combos, terminated early
+                    // by a zero entry if it does not fill the message.
+                    data->info->num_mode_combos = 0;
+                    for (int i = 2; i + 1 < msg_size - 1 && data->info->num_mode_combos < PBIO_IODEV_MAX_NUM_MODE_COMBOS; i += 2) {
+                        uint16_t combo = data->rx_msg[i + 1] << 8 | data->rx_msg[i];
+                        if (!combo) {
+                            break;
+                        }
+                        data->info->mode_combos[data->info->num_mode_combos++] = combo;
+                        debug_pr("mode combos: %04x\n", combo);
+                    }
 
                     break;
                 case LUMP_INFO_UNK9:
@@ -667,6 +748,11 @@ static void pbio_uartdev_parse_msg(uartdev_port_data_t *data) {
                 if (data->iodev.motor_flags & PBIO_IODEV_MOTOR_FLAG_HAS_ABS_POS) {
                     data->abs_pos = data->rx_msg[7] << 8 | data->rx_msg[6];
                 }
+            } else if (data->new_combo_modes && data->write_cmd_size > 0) {
+                // All datasets of a combined mode arrive in one message. The
+                // data of each mode is found at its offset in bin_data.
+                memcpy(data->iodev.bin_data, data->rx_msg + 1, msg_size - 2);
+                data->iodev.combo_modes = data->new_combo_modes;
             } else {
                 if (mode >= data->info->num_modes) {
                     DBG_ERR(data->last_err = "Invalid mode received");
@@ -675,10 +761,14 @@ static void pbio_uartdev_parse_msg(uartdev_port_data_t *data) {
                 data->iodev.mode = mode;
                 if (mode == data->new_mode) {
                     memcpy(data->iodev.bin_data, data->rx_msg + 1, msg_size - 2);
+                    if (data->num_stale_data) {
+                        data->num_stale_data--;
+                    }
                 }
             }
 
             data->data_rec = true;
+            data->num_data_msgs++;
             if (data->num_data_err) {
                 data->num_data_err--;
             }
@@ -767,6 +857,59 @@ static pbio_error_t ev3_uart_begin_tx_msg(uartdev_port_data_t *port_data, lump_m
     return err;
 }
 
+// Prepares mode_combo_payload for a WRITE command that selects a combined mode
+// with all datasets of the given modes, and sets the offset of the data of
+// each mode in the combined DATA message.
+static pbio_error_t pbio_uartdev_prepare_mode_combo(uartdev_port_data_t *data, const uint8_t *modes, uint8_t num_modes, uint16_t *combo_modes) {
+    uint16_t mask = 0;
+    uint8_t index;
+    uint8_t num_entries = 0;
+    uint8_t offset = 0;
+
+    for (uint8_t i = 0; i < num_modes; i++) {
+        if (mask & (1 << modes[i])) {
+            return PBIO_ERROR_INVALID_ARG;
+        }
+        mask |= 1 << modes[i];
+    }
+
+    // find a combination advertised by the device that has all of the modes
+    for (index = 0; index < data->info->num_mode_combos; index++) {
+        if (!(mask & ~data->info->mode_combos[index])) {
+            break;
+        }
+    }
+    if (index == data->info->num_mode_combos) {
+        return PBIO_ERROR_INVALID_ARG;
+    }
+
+    data->iodev.combo_modes = 0;
+
+    for (uint8_t i = 0; i < num_modes; i++) {
+        pbio_iodev_mode_t *mode_info = &data->info->mode_info[modes[i]];
+        uint8_t size = mode_info->num_values * pbio_iodev_size_of(mode_info->data_type);
+
+        if (num_entries + mode_info->num_values > EV3_UART_MAX_COMBO_ENTRIES ||
+            offset + size > PBIO_IODEV_MAX_DATA_SIZE) {
+            return PBIO_ERROR_INVALID_ARG;
+        }
+
+        data->iodev.combo_offset[modes[i]] = offset;
+        offset += size;
+
+        for (uint8_t j = 0; j < mode_info->num_values; j++) {
+            data->mode_combo_payload[2 + num_entries++] = modes[i] << 4 | j; // mode, dataset
+        }
+    }
+
+    data->mode_combo_payload[0] = 0x20 | num_entries; // mode combo command, x datasets
+    data->mode_combo_payload[1] = index; // combo index
+    data->mode_combo_size = num_entries + 2;
+    *combo_modes = mask;
+
+    return PBIO_SUCCESS;
+}
+
 static PT_THREAD(pbio_uartdev_send_speed_msg(uartdev_port_data_t * data, uint32_t speed)) {
     pbio_error_t err;
 
@@ -811,6 +954,11 @@ static PT_THREAD(pbio_uartdev_update(uartdev_port_data_t * data)) {
     data->info->type_id = PBIO_IODEV_TYPE_ID_NONE;
     data->iodev.motor_flags = PBIO_IODEV_MOTOR_FLAG_NONE;
     data->ext_mode = 0;
+    data->num_stale_data = 0;
+    data->write_cmd_size = 0;
+    data->new_combo_modes = 0;
+    data->iodev.combo_modes = 0;
+    data->num_data_msgs = 0;
     data->status = PBIO_UARTDEV_STATUS_SYNCING;
     // default max tacho rate for BOOST external motor since it is the only
     // motor that does not send this info
@@ -830,6 +978,7 @@ static PT_THREAD(pbio_uartdev_update(uartdev_port_data_t * data)) {
     }
 
     PBIO_PT_WAIT_READY(&data->pt, err = pbdrv_uart_read_end(data->uart));
+    data->speed_cmd_ok = err == PBIO_SUCCESS && data->rx_msg[0] == LUMP_SYS_ACK;
     if ((err == PBIO_SUCCESS && data->rx_msg[0] != LUMP_SYS_ACK) || err == PBIO_ERROR_TIMEDOUT) {
         // if we did not get ACK within 100ms, then switch to slow baud rate for sync
         PBIO_PT_WAIT_READY(&data->pt, pbdrv_uart_set_baud_rate(data->uart, EV3_UART_SPEED_MIN));
@@ -887,6 +1036,7 @@ static PT_THREAD(pbio_uartdev_update(uartdev_port_data_t * data)) {
 
     data->info->num_modes = 1;
     data->info->num_view_modes = 1;
+    data->info->num_mode_combos = 0;
 
     for (int i = 0; i < PBIO_IODEV_MAX_NUM_MODES; i++) {
         data->info->mode_info[i] = ev3_uart_default_mode_info;
@@ -898,6 +1048,7 @@ static PT_THREAD(pbio_uartdev_update(uartdev_port_data_t * data)) {
     data->num_data_err = 0;
     data->status = PBIO_UARTDEV_STATUS_INFO;
     debug_pr("type id: %d\n", data->type_id);
+    pbio_trace(PBIO_TRACE_UARTDEV_SYNC, data->iodev.port, data->type_id);
 
     while (data->status == PBIO_UARTDEV_STATUS_INFO) {
         // read the message header
@@ -966,23 +1117,58 @@ static PT_THREAD(pbio_uartdev_update(uartdev_port_data_t * data)) {
 
     // change the baud rate
     PBIO_PT_WAIT_READY(&data->pt, pbdrv_uart_set_baud_rate(data->uart, data->new_baud_rate));
+    data->baud_rate = data->new_baud_rate;
+
+    // What was learned about the previous device does not apply to a new one
+    if (data->type_id != data->max_baud_rate_type_id) {
+        data->max_baud_rate = PBIO_CONFIG_UARTDEV_MAX_BAUD_RATE;
+        data->max_baud_rate_type_id = data->type_id;
+    }
+
+    // Devices are never asked to go faster than the rate they advertise. If
+    // the advertised rate did not work on this port before, devices that
+    // accepted the SPEED command during sync are asked for a slower one. If
+    // the device does not acknowledge, we stay at the advertised rate.
+    if (data->speed_cmd_ok && data->max_baud_rate < data->baud_rate) {
+        PT_SPAWN(&data->pt, &data->speed_pt, pbio_uartdev_send_speed_msg(data, data->max_baud_rate));
+
+        PBIO_PT_WAIT_READY(&data->pt, err = pbdrv_uart_read_begin(data->uart, data->rx_msg, 1, 100));
+        if (err != PBIO_SUCCESS) {
+            DBG_ERR(data->last_err = "UART Rx error during speed negotiation");
+            goto err;
+        }
+        PBIO_PT_WAIT_READY(&data->pt, err = pbdrv_uart_read_end(data->uart));
+        if (err == PBIO_SUCCESS && data->rx_msg[0] == LUMP_SYS_ACK) {
+            PBIO_PT_WAIT_READY(&data->pt, pbdrv_uart_set_baud_rate(data->uart, data->max_baud_rate));
+            data->baud_rate = data->max_baud_rate;
+        } else if (err != PBIO_SUCCESS && err != PBIO_ERROR_TIMEDOUT) {
+            DBG_ERR(data->last_err = "UART Rx error during speed negotiation");
+            goto err;
+        }
+    }
 
     // setting type_id in info struct lets external modules know a device is connected
     data->info->type_id = data->type_id;
     data->status = PBIO_UARTDEV_STATUS_DATA;
-    // reset data rx thread
-    PT_INIT(&data->data_pt);
-
-    if (PBIO_IODEV_IS_FEEDBACK_MOTOR(&data->iodev)) {
-        data->mode_combo_size = __builtin_popcount(data->info->mode_combos) + 2;
-        data->mode_combo_payload[0] = 0x20 | (data->mode_combo_size - 2); // mode combo command, x modes
-        data->mode_combo_payload[1] = 0; // combo index
-        data->mode_combo_payload[2] = 1 << 4 | 0; // mode 1, dataset 0
-        data->mode_combo_payload[3] = 2 << 4 | 0; // mode 2, dataset 0
-        data->mode_combo_payload[4] = 3 << 4 | 0; // mode 3, dataset 0
-        // HACK: we are cheating here and assuming that all mode combinations
-        // are consecutive, starting with mode 1 and data->mode_combo_size
-        // chops off any unused mode (i.e. APOS)
+    pbio_trace(PBIO_TRACE_UARTDEV_DATA, data->iodev.port, data->baud_rate / 100);
+    data->num_data_msgs = 0;
+    data->rx_bytes = 0;
+    data->rx_msgs = 0;
+    data->stats_time = clock_time();
+    // start looking for a new message
+    data->rx_msg_index = 0;
+
+    if (PBIO_IODEV_IS_FEEDBACK_MOTOR(&data->iodev) && data->info->num_mode_combos) {
+        // Motors advertise speed, position and (if they have it) absolute
+        // position as their first combination. These are modes 1, 2 and 3.
+        static const uint8_t motor_modes[] = { 1, 2, 3 };
+        uint16_t combo_modes;
+        err = pbio_uartdev_prepare_mode_combo(data, motor_modes,
+            __builtin_popcount(data->info->mode_combos[0] & 0x000E), &combo_modes);
+        if (err != PBIO_SUCCESS) {
+            DBG_ERR(data->last_err = "Bad mode combos for motor");
+            goto err;
+        }
 
         // setup motor to send position and speed data
         PBIO_PT_WAIT_READY(&data->pt,
@@ -1016,6 +1202,16 @@ static PT_THREAD(pbio_uartdev_update(uartdev_port_data_t * data)) {
         }
         data->data_rec = false;
 
+        // update link statistics about once per second
+        if (clock_time() - data->stats_time >= clock_from_msec(1000)) {
+            uint32_t elapsed = clock_to_msec(clock_time() - data->stats_time);
+            data->stats.bytes_per_sec = data->rx_bytes * 1000 / elapsed;
+            data->stats.msgs_per_sec = data->rx_msgs * 1000 / elapsed;
+            data->rx_bytes = 0;
+            data->rx_msgs = 0;
+            data->stats_time = clock_time();
+        }
+
         // send keepalive
         PT_WAIT_WHILE(&data->pt, data->tx_busy);
         data->tx_busy = true;
@@ -1043,6 +1239,18 @@ err:
     debug_pr("%s\n", data->last_err);
     data->err_count++;
 
+    // If no data came through at a fast baud rate, try a slower one next
+    // time, but not slower than the standard rate.
+    if (data->baud_rate > EV3_UART_SPEED_LPF2 && !data->num_data_msgs) {
+        data->max_baud_rate = data->baud_rate / 2;
+        if (data->max_baud_rate < EV3_UART_SPEED_LPF2) {
+            data->max_baud_rate = EV3_UART_SPEED_LPF2;
+        }
+    }
+    data->baud_rate = 0;
+    data->stats.bytes_per_sec = 0;
+    data->stats.msgs_per_sec = 0;
+
     process_post(PROCESS_BROADCAST, PROCESS_EVENT_SERVICE_REMOVED, NULL);
 
     PT_END(&data->pt);
@@ -1051,55 +1259,53 @@ err:
 // REVISIT: This is not the greatest. We can easily get a buffer overrun and
 // loose data. For now, the retry after bad message size helps get back into
 // sync with the data stream.
-static PT_THREAD(pbio_uartdev_receive_data(uartdev_port_data_t * data)) {
-    pbio_error_t err;
-
-    PT_BEGIN(&data->data_pt);
+// Parses all DATA messages that have been received so far. Bytes are taken
+// from the UART driver in bulk without waiting, so a message that is only
+// partially received is completed on the next call.
+static void pbio_uartdev_receive_data(uartdev_port_data_t *data) {
+    uint8_t count;
 
     while (true) {
-        PBIO_PT_WAIT_READY(&data->data_pt,
-            err = pbdrv_uart_read_begin(data->uart, data->rx_msg, 1, EV3_UART_IO_TIMEOUT));
-        if (err != PBIO_SUCCESS) {
-            DBG_ERR(data->last_err = "UART Rx data header begin error");
-            break;
-        }
-        PBIO_PT_WAIT_READY(&data->data_pt, err = pbdrv_uart_read_end(data->uart));
-        if (err != PBIO_SUCCESS) {
-            DBG_ERR(data->last_err = "UART Rx data header end error");
-            break;
-        }
+        if (data->rx_msg_index == 0) {
+            if (pbdrv_uart_read_available(data->uart, data->rx_msg, 1, &count) != PBIO_SUCCESS || count == 0) {
+                return;
+            }
 
-        data->rx_msg_size = ev3_uart_get_msg_size(data->rx_msg[0]);
-        if (data->rx_msg_size < 3 || data->rx_msg_size > EV3_UART_MAX_MESSAGE_SIZE) {
-            DBG_ERR(data->last_err = "Bad data message size");
-            continue;
-        }
+            data->rx_msg_size = ev3_uart_get_msg_size(data->rx_msg[0]);
+            if (data->rx_msg_size < 3 || data->rx_msg_size > EV3_UART_MAX_MESSAGE_SIZE) {
+                DBG_ERR(data->last_err = "Bad data message size");
+                continue;
+            }
 
-        uint8_t msg_type = data->rx_msg[0] & LUMP_MSG_TYPE_MASK;
-        uint8_t cmd = data->rx_msg[0] & LUMP_MSG_CMD_MASK;
-        if (msg_type != LUMP_MSG_TYPE_DATA && (msg_type != LUMP_MSG_TYPE_CMD ||
-                                               (cmd != LUMP_CMD_WRITE && cmd != LUMP_CMD_EXT_MODE))) {
-            DBG_ERR(data->last_err = "Bad msg type");
-            continue;
+            uint8_t msg_type = data->rx_msg[0] & LUMP_MSG_TYPE_MASK;
+            uint8_t cmd = data->rx_msg[0] & LUMP_MSG_CMD_MASK;
+            if (msg_type != LUMP_MSG_TYPE_DATA && (msg_type != LUMP_MSG_TYPE_CMD ||
+                                                   (cmd != LUMP_CMD_WRITE && cmd != LUMP_CMD_EXT_MODE))) {
+                DBG_ERR(data->last_err = "Bad msg type");
+                continue;
+            }
+
+            data->rx_msg_index = 1;
         }
 
-        PBIO_PT_WAIT_READY(&data->data_pt,
-            err = pbdrv_uart_read_begin(data->uart, data->rx_msg + 1, data->rx_msg_size - 1, EV3_UART_IO_TIMEOUT));
-        if (err != PBIO_SUCCESS) {
-            DBG_ERR(data->last_err = "UART Rx data begin error");
-            break;
+        if (pbdrv_uart_read_available(data->uart, data->rx_msg + data->rx_msg_index,
+            data->rx_msg_size - data->rx_msg_index, &count) != PBIO_SUCCESS) {
+            return;
         }
-        PBIO_PT_WAIT_READY(&data->data_pt, err = pbdrv_uart_read_end(data->uart));
-        if (err != PBIO_SUCCESS) {
-            DBG_ERR(data->last_err = "UART Rx data end error");
-            break;
+
+        data->rx_msg_index += count;
+        if (data->rx_msg_index < data->rx_msg_size) {
+            // rest of the message has not been received yet
+            return;
         }
 
+        data->rx_msg_index = 0;
+        data->rx_bytes += data->rx_msg_size;
+        data->rx_msgs++;
+
         // at this point, we have a full data->msg that can be parsed
         pbio_uartdev_parse_msg(data);
     }
-
-    PT_END(&data->data_pt);
 }
 
 static pbio_error_t ev3_uart_set_mode_begin(pbio_iodev_t *iodev, uint8_t mode) {
@@ -1112,7 +1318,47 @@ static pbio_error_t ev3_uart_set_mode_begin(pbio_iodev_t *iodev, uint8_t mode) {
     }
 
     port_data->new_mode = mode;
+    port_data->num_stale_data = pbio_uartdev_get_num_stale_data(port_data->type_id, mode);
+    port_data->mode_change_tx_done = false;
+    // selecting a single mode ends the combined mode
+    port_data->new_combo_modes = 0;
+    port_data->iodev.combo_modes = 0;
+    pbio_trace(PBIO_TRACE_MODE_BEGIN, iodev->port, mode);
+
+    return PBIO_SUCCESS;
+}
+
+static pbio_error_t ev3_uart_set_mode_combo_begin(pbio_iodev_t *iodev, const uint8_t *modes, uint8_t num_modes) {
+    uartdev_port_data_t *port_data = PBIO_CONTAINER_OF(iodev, uartdev_port_data_t, iodev);
+    uint16_t combo_modes;
+    pbio_error_t err;
+
+    // motors already use a combined mode for position and speed feedback
+    if (PBIO_IODEV_IS_FEEDBACK_MOTOR(iodev)) {
+        return PBIO_ERROR_NOT_SUPPORTED;
+    }
+
+    if (port_data->tx_busy || port_data->mode_change_tx_done) {
+        return PBIO_ERROR_AGAIN;
+    }
+
+    err = pbio_uartdev_prepare_mode_combo(port_data, modes, num_modes, &combo_modes);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    err = ev3_uart_begin_tx_msg(port_data, LUMP_MSG_TYPE_CMD, LUMP_CMD_WRITE,
+        port_data->mode_combo_payload, port_data->mode_combo_size);
+    if (err != PBIO_SUCCESS) {
+        return err;
+    }
+
+    // The device echoes the WRITE command before sending combined data
+    port_data->write_cmd_size = 0;
+    port_data->new_combo_modes = combo_modes;
+    port_data->num_stale_data = 0;
     port_data->mode_change_tx_done = false;
+    pbio_trace(PBIO_TRACE_MODE_BEGIN, iodev->port, PBIO_TRACE_MODE_COMBO);
 
     return PBIO_SUCCESS;
 }
@@ -1136,11 +1382,18 @@ static pbio_error_t ev3_uart_set_mode_end(pbio_iodev_t *iodev) {
         return err;
     }
 
-    if (!port_data->data_rec || port_data->iodev.mode != port_data->new_mode) {
+    // Wait for the first fresh DATA message in the new mode
+    if (port_data->new_combo_modes) {
+        if (port_data->iodev.combo_modes != port_data->new_combo_modes) {
+            return PBIO_ERROR_AGAIN;
+        }
+    } else if (!port_data->data_rec || port_data->iodev.mode != port_data->new_mode || port_data->num_stale_data) {
         return PBIO_ERROR_AGAIN;
     }
 
     port_data->mode_change_tx_done = false;
+    pbio_trace(PBIO_TRACE_MODE_END, iodev->port,
+        port_data->new_combo_modes ? PBIO_TRACE_MODE_COMBO : port_data->new_mode);
 
     return PBIO_SUCCESS;
 }
@@ -1186,6 +1439,7 @@ static void ev3_uart_write_cancel(pbio_iodev_t *iodev) {
 
 static const pbio_iodev_ops_t pbio_uartdev_ops = {
     .set_mode_begin = ev3_uart_set_mode_begin,
+    .set_mode_combo_begin = ev3_uart_set_mode_combo_begin,
     .set_mode_end = ev3_uart_set_mode_end,
     .set_mode_cancel = ev3_uart_write_cancel,
     .set_data_begin = ev3_uart_set_data_begin,
@@ -1251,6 +1505,7 @@ static PT_THREAD(pbio_uartdev_init(struct pt *pt, uint8_t id)) {
     port_data->counter_dev.get_rate = pbio_uartdev_get_rate;
     port_data->counter_dev.initalized = true;
     port_data->info = &infos[id].info;
+    port_data->max_baud_rate = PBIO_CONFIG_UARTDEV_MAX_BAUD_RATE;
     port_data->tx_msg = &bufs[id][BUF_TX_MSG][0];
     port_data->rx_msg = &bufs[id][BUF_RX_MSG][0];
 
@@ -0,0 +1,253 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fixmath.h>
+
+#include <pbdrv/imu.h>
+#include <pbio/attitude.h>
+
+#include <tinytest.h>
+#include <tinytest_macros.h>
+
+// Simulated LSM6DS3TR-C at 416 Hz, +/-2000 dps and +/-4 g
+static const pbdrv_imu_info_t info = {
+    .period = 2404,
+    .gyro_scale = 70,
+    .accel_scale = 122,
+};
+
+#define ONE_G (1000000.0 / 122)
+#define DEG_TO_RAD (M_PI / 180)
+
+// Generates IMU samples for a known motion, as they would be recorded from a
+// real sensor with gyro bias and noise on all axes.
+typedef struct {
+    pbio_attitude_filter_t filter;
+    // ground truth, in degrees
+    double roll;
+    double pitch;
+    double heading;
+    uint32_t time;
+    // raw gyro bias
+    int16_t bias[3];
+    // acceleration in g on top of gravity
+    double accel[3];
+    uint32_t seed;
+} sim_t;
+
+static void sim_init(sim_t *sim, int16_t bias_x, int16_t bias_y, int16_t bias_z) {
+    *sim = (sim_t) {
+        .bias = { bias_x, bias_y, bias_z },
+        .seed = 1,
+    };
+    pbio_attitude_filter_init(&sim->filter, &info);
+}
+
+// Uniform noise from -range to range
+static int16_t noise(sim_t *sim, int16_t range) {
+    sim->seed = sim->seed * 1103515245 + 12345;
+    return (int16_t)((sim->seed >> 16) % (2 * range + 1)) - range;
+}
+
+// Turns around one axis at a time at the given rates, in degrees per second
+static void sim_run(sim_t *sim, uint32_t usecs, double roll_rate, double pitch_rate, double heading_rate) {
+    for (uint32_t t = 0; t < usecs; t += info.period) {
+        pbdrv_imu_sample_t sample;
+        double rates[3] = { roll_rate, pitch_rate, heading_rate };
+
+        sim->time += info.period;
+        sim->roll += roll_rate * info.period / 1e6;
+        sim->pitch += pitch_rate * info.period / 1e6;
+        sim->heading += heading_rate * info.period / 1e6;
+
+        double r = sim->roll * DEG_TO_RAD;
+        double p = sim->pitch * DEG_TO_RAD;
+        double gravity[3] = { -sin(p), sin(r) * cos(p), cos(r) * cos(p) };
+
+        sample.time = sim->time;
+        for (int i = 0; i < 3; i++) {
+            sample.gyro[i] = lround(rates[i] * 1000 / info.gyro_scale) + sim->bias[i] + noise(sim, 3);
+            sample.accel[i] = lround((gravity[i] + sim->accel[i]) * ONE_G) + noise(sim, 20);
+        }
+
+        pbio_attitude_filter_update(&sim->filter, &sample);
+    }
+}
+
+// Stays at rest until the gyro bias is known. The heading drifts a little
+// until then, which is taken as the new zero, like a user would do.
+static void sim_calibrate(sim_t *sim) {
+    sim_run(sim, 1000000, 0, 0, 0);
+    sim->heading = fix16_to_float(sim->filter.attitude.heading);
+}
+
+// Difference between estimate and ground truth, in millidegrees
+static long error(fix16_t estimate, double truth) {
+    double diff = fmod(fix16_to_float(estimate) - truth, 360);
+    if (diff > 180) {
+        diff -= 360;
+    } else if (diff <= -180) {
+        diff += 360;
+    }
+    return lround(fabs(diff) * 1000);
+}
+
+// Rate in millidegrees per second
+static long rate(sim_t *sim, int axis) {
+    return lround(fix16_to_float(sim->filter.attitude.rate[axis]) * 1000);
+}
+
+static void check_attitude(sim_t *sim, long tolerance) {
+    pbio_attitude_t *attitude = &sim->filter.attitude;
+
+    tt_want_int_op(error(attitude->roll, sim->roll), <, tolerance);
+    tt_want_int_op(error(attitude->pitch, sim->pitch), <, tolerance);
+    tt_want_int_op(error(attitude->heading, sim->heading), <, tolerance);
+}
+
+void test_attitude_calibrate(void *env) {
+    static sim_t sim;
+    pbio_attitude_t attitude;
+
+    // no IMU samples in this test
+    tt_want_int_op(pbio_attitude_get(&attitude), ==, PBIO_ERROR_AGAIN);
+
+    // bias of about 2 dps, -1.4 dps and 1 dps
+    sim_init(&sim, 30, -20, 15);
+
+    // not calibrated before it has been at rest for long enough
+    sim_run(&sim, 400000, 0, 0, 0);
+    tt_want(!sim.filter.attitude.calibrated);
+
+    sim_run(&sim, 200000, 0, 0, 0);
+    tt_want(sim.filter.attitude.calibrated);
+    for (int i = 0; i < 3; i++) {
+        tt_want_int_op(labs(rate(&sim, i)), <, 300);
+    }
+
+    // the drift before calibration is small and stops after it
+    check_attitude(&sim, 1000);
+    fix16_t heading = sim.filter.attitude.heading;
+    sim_run(&sim, 10000000, 0, 0, 0);
+    tt_want_int_op(error(sim.filter.attitude.heading, fix16_to_float(heading)), <, 200);
+
+    // a slow steady turn is not mistaken for bias
+    sim_run(&sim, 2000000, 0, 0, 5);
+    check_attitude(&sim, 1000);
+    tt_want_int_op(labs(rate(&sim, 2) - 5000), <, 300);
+
+    // moving does not count as rest
+    sim_init(&sim, 30, -20, 15);
+    sim_run(&sim, 1000000, 0, 0, 45);
+    tt_want(!sim.filter.attitude.calibrated);
+}
+
+void test_attitude_turn(void *env) {
+    static sim_t sim;
+
+    sim_init(&sim, 30, -20, 15);
+    sim_calibrate(&sim);
+
+    sim_run(&sim, 1000000, 0, 0, 90);
+    check_attitude(&sim, 1000);
+    tt_want_int_op(labs(rate(&sim, 2) - 90000), <, 300);
+
+    sim_run(&sim, 500000, 0, 0, 0);
+    check_attitude(&sim, 1000);
+
+    // heading wraps around
+    sim_run(&sim, 2000000, 0, 0, -145);
+    check_attitude(&sim, 1000);
+    tt_want_int_op(sim.filter.attitude.heading, >, F16(150));
+
+    // fast turns
+    sim_run(&sim, 1000000, 0, 0, 720);
+    check_attitude(&sim, 1000);
+}
+
+void test_attitude_tilt(void *env) {
+    static sim_t sim;
+
+    // starts from the tilt of the first sample
+    sim_init(&sim, 30, -20, 15);
+    sim.roll = 10;
+    sim.pitch = -20;
+    sim_calibrate(&sim);
+    check_attitude(&sim, 1000);
+
+    sim_run(&sim, 500000, 60, 0, 0);
+    check_attitude(&sim, 1000);
+
+    sim_run(&sim, 500000, 0, 90, 0);
+    check_attitude(&sim, 1000);
+
+    sim_run(&sim, 2000000, 0, 0, 0);
+    check_attitude(&sim, 500);
+
+    // upside down
+    sim_run(&sim, 1000000, 140, 0, 0);
+    sim_run(&sim, 2000000, 0, 0, 0);
+    check_attitude(&sim, 1000);
+    tt_want_int_op(sim.filter.attitude.roll, <, F16(-170));
+}
+
+void test_attitude_drift(void *env) {
+    static sim_t sim;
+
+    sim_init(&sim, 30, -20, 15);
+    sim_calibrate(&sim);
+    tt_want(sim.filter.attitude.calibrated);
+
+    // The bias jumps by 1.5 dps, which is too much to be taken as the new
+    // bias right away. The gyro alone would drift 15 degrees, but the
+    // accelerometer keeps roll close until the new bias is taken.
+    sim.bias[0] += 21;
+    sim_run(&sim, 10000000, 0, 0, 0);
+    tt_want_int_op(error(sim.filter.attitude.roll, sim.roll), <, 2000);
+    tt_want_int_op(labs(rate(&sim, 0)), <, 300);
+
+    // There is no such help for the heading, so it only stops drifting once
+    // the new bias has been the same for several rests in a row.
+    sim_init(&sim, 30, -20, 15);
+    sim_calibrate(&sim);
+    sim.bias[2] += 21;
+    sim_run(&sim, 2000000, 0, 0, 0);
+    tt_want_int_op(labs(rate(&sim, 2)), >, 1000);
+    sim_run(&sim, 3000000, 0, 0, 0);
+    tt_want_int_op(labs(rate(&sim, 2)), <, 300);
+    sim.heading = fix16_to_float(sim.filter.attitude.heading);
+    sim_run(&sim, 10000000, 0, 0, 0);
+    tt_want_int_op(error(sim.filter.attitude.heading, sim.heading), <, 200);
+
+    // Small changes of the bias are measured at rest
+    sim_init(&sim, 30, -20, 15);
+    sim_calibrate(&sim);
+    sim.bias[2] += 7;
+    sim_run(&sim, 2000000, 0, 0, 0);
+    sim.heading = fix16_to_float(sim.filter.attitude.heading);
+    sim_run(&sim, 10000000, 0, 0, 0);
+    tt_want_int_op(error(sim.filter.attitude.heading, sim.heading), <, 200);
+}
+
+void test_attitude_acceleration(void *env) {
+    static sim_t sim;
+
+    sim_init(&sim, 30, -20, 15);
+    sim_calibrate(&sim);
+
+    // a bump is not mistaken for tilt
+    sim.accel[0] = 2;
+    sim_run(&sim, 200000, 0, 0, 0);
+    sim.accel[0] = 0;
+    check_attitude(&sim, 500);
+
+    // neither is free fall
+    sim.accel[2] = -1;
+    sim_run(&sim, 200000, 0, 0, 0);
+    sim.accel[2] = 0;
+    check_attitude(&sim, 500);
+}
@@ -0,0 +1,344 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <contiki.h>
+
+#include <tinytest.h>
+#include <tinytest_macros.h>
+
+#include <pbdrv/i2c.h>
+#include <pbdrv/imu.h>
+#include <pbio/util.h>
+
+#include "../src/processes.h"
+
+// registers of the simulated LSM6DS3TR-C
+#define CTRL1_XL        0x10
+#define CTRL2_G         0x11
+#define CTRL3_C         0x12
+#define CTRL8_XL        0x17
+#define FIFO_CTRL5      0x0A
+#define WHO_AM_I        0x0F
+#define FIFO_STATUS1    0x3A
+#define FIFO_DATA_OUT_L 0x3E
+
+#define FIFO_WORDS 2048 // must be power of 2!
+
+static struct {
+    pbdrv_i2c_dev_t dev;
+    uint8_t regs[128];
+    int16_t fifo[FIFO_WORDS];
+    uint16_t fifo_head;
+    uint16_t fifo_tail;
+    // position of the next word to read in a sample
+    uint16_t pattern;
+    bool done;
+} test_i2c_dev;
+
+static void push_word(int16_t word) {
+    test_i2c_dev.fifo[test_i2c_dev.fifo_head] = word;
+    test_i2c_dev.fifo_head = (test_i2c_dev.fifo_head + 1) & (FIFO_WORDS - 1);
+}
+
+// Sample n has gyro axis i set to 10 n + i and accel axis i set to -(10 n + i)
+static void push_sample(int16_t n) {
+    for (int i = 0; i < 3; i++) {
+        push_word(n * 10 + i);
+    }
+    for (int i = 0; i < 3; i++) {
+        push_word(-n * 10 - i);
+    }
+}
+
+// Sample n has gyro axis i set to 10 n + i and the given acceleration
+static void push_accel(int16_t n, int16_t x, int16_t y, int16_t z) {
+    for (int i = 0; i < 3; i++) {
+        push_word(n * 10 + i);
+    }
+    push_word(x);
+    push_word(y);
+    push_word(z);
+}
+
+static bool fifo_empty(void) {
+    return test_i2c_dev.fifo_head == test_i2c_dev.fifo_tail;
+}
+
+// Checks if sample n was added to the ring buffer
+static bool got_sample(int16_t n) {
+    pbdrv_imu_sample_t sample;
+    return pbdrv_imu_get_latest(&sample) == PBIO_SUCCESS && sample.gyro[0] == n * 10;
+}
+
+pbio_error_t pbdrv_i2c_get(uint8_t id, pbdrv_i2c_dev_t **i2c_dev) {
+    *i2c_dev = &test_i2c_dev.dev;
+    return PBIO_SUCCESS;
+}
+
+// The transfer completes on the next event, like it would in an interrupt
+static void begin(void) {
+    test_i2c_dev.done = false;
+    process_post(PROCESS_BROADCAST, PROCESS_EVENT_COM, NULL);
+}
+
+pbio_error_t pbdrv_i2c_read_begin(pbdrv_i2c_dev_t *i2c, uint8_t addr, uint8_t reg, uint8_t *buf, uint16_t length) {
+    if (addr != 0x6A) {
+        return PBIO_ERROR_INVALID_ARG;
+    }
+
+    if (reg == FIFO_STATUS1) {
+        uint16_t words = (test_i2c_dev.fifo_head - test_i2c_dev.fifo_tail) & (FIFO_WORDS - 1);
+        buf[0] = words;
+        buf[1] = words >> 8;
+        buf[2] = test_i2c_dev.pattern;
+        buf[3] = 0;
+    } else if (reg == FIFO_DATA_OUT_L) {
+        // address wraps around, so all reads come from the FIFO
+        for (int i = 0; i < length; i += 2) {
+            int16_t word = fifo_empty() ? 0 : test_i2c_dev.fifo[test_i2c_dev.fifo_tail];
+            test_i2c_dev.fifo_tail = (test_i2c_dev.fifo_tail + 1) & (FIFO_WORDS - 1);
+            test_i2c_dev.pattern = (test_i2c_dev.pattern + 1) % 6;
+            buf[i] = word;
+            buf[i + 1] = word >> 8;
+        }
+    } else {
+        memcpy(buf, &test_i2c_dev.regs[reg], length);
+        // reset takes until the next read
+        test_i2c_dev.regs[CTRL3_C] &= ~0x01;
+    }
+
+    begin();
+
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbdrv_i2c_write_begin(pbdrv_i2c_dev_t *i2c, uint8_t addr, uint8_t reg, const uint8_t *buf, uint16_t length) {
+    if (addr != 0x6A) {
+        return PBIO_ERROR_INVALID_ARG;
+    }
+
+    memcpy(&test_i2c_dev.regs[reg], buf, length);
+    begin();
+
+    return PBIO_SUCCESS;
+}
+
+pbio_error_t pbdrv_i2c_end(pbdrv_i2c_dev_t *i2c) {
+    if (!test_i2c_dev.done) {
+        test_i2c_dev.done = true;
+        return PBIO_ERROR_AGAIN;
+    }
+
+    return PBIO_SUCCESS;
+}
+
+static void check_sample(const pbdrv_imu_sample_t *sample, int16_t n) {
+    for (int i = 0; i < 3; i++) {
+        tt_want_int_op(sample->gyro[i], ==, n * 10 + i);
+        tt_want_int_op(sample->accel[i], ==, -n * 10 - i);
+    }
+}
+
+PT_THREAD(test_imu_lsm6ds3tr_c(struct pt *pt)) {
+    static pbdrv_imu_info_t info;
+    static pbdrv_imu_sample_t samples[100];
+    static uint32_t index;
+    static uint32_t count;
+    static uint32_t total;
+
+    PT_BEGIN(pt);
+
+    test_i2c_dev.regs[WHO_AM_I] = 0x6A;
+    process_start(&pbdrv_imu_process, NULL);
+
+    PT_WAIT_UNTIL(pt, pbdrv_imu_get_info(&info) != PBIO_ERROR_AGAIN);
+    tt_uint_op(pbdrv_imu_get_info(&info), ==, PBIO_SUCCESS);
+    tt_want_uint_op(info.period, ==, 2404);
+    tt_want_uint_op(info.gyro_scale, ==, 70);
+    tt_want_uint_op(info.accel_scale, ==, 122);
+
+    // 416 Hz and continuous FIFO mode
+    tt_want_uint_op(test_i2c_dev.regs[CTRL1_XL], ==, 0x68);
+    tt_want_uint_op(test_i2c_dev.regs[CTRL2_G], ==, 0x6C);
+    tt_want_uint_op(test_i2c_dev.regs[CTRL3_C], ==, 0x44);
+    tt_want_uint_op(test_i2c_dev.regs[CTRL8_XL], ==, 0xC8);
+    tt_want_uint_op(test_i2c_dev.regs[FIFO_CTRL5], ==, 0x36);
+
+    // no samples yet
+    tt_want_uint_op(pbdrv_imu_get_latest(&samples[0]), ==, PBIO_ERROR_AGAIN);
+    tt_want_uint_op(pbdrv_imu_read(&index, samples, PBIO_ARRAY_SIZE(samples), &count), ==, PBIO_SUCCESS);
+    tt_want_uint_op(count, ==, 0);
+
+    // more samples than fit in one burst
+    for (int i = 0; i < 20; i++) {
+        push_sample(i);
+    }
+    PT_WAIT_UNTIL(pt, got_sample(19));
+
+    tt_uint_op(pbdrv_imu_read(&index, samples, PBIO_ARRAY_SIZE(samples), &count), ==, PBIO_SUCCESS);
+    tt_uint_op(count, ==, 20);
+    tt_want_uint_op(index, ==, 20);
+    for (int i = 0; i < 20; i++) {
+        check_sample(&samples[i], i);
+        if (i > 0) {
+            tt_want_uint_op(samples[i].time - samples[i - 1].time, ==, 2404);
+        }
+    }
+    tt_want_int_op((int32_t)(clock_usecs() - samples[19].time), >=, 0);
+
+    tt_uint_op(pbdrv_imu_get_latest(&samples[0]), ==, PBIO_SUCCESS);
+    check_sample(&samples[0], 19);
+
+    // nothing new since the last read
+    tt_want_uint_op(pbdrv_imu_read(&index, samples, PBIO_ARRAY_SIZE(samples), &count), ==, PBIO_SUCCESS);
+    tt_want_uint_op(count, ==, 0);
+
+    // after an overrun, the FIFO starts in the middle of a sample
+    test_i2c_dev.pattern = 3;
+    push_word(-1);
+    push_word(-1);
+    push_word(-1);
+    push_sample(20);
+    push_sample(21);
+    PT_WAIT_UNTIL(pt, got_sample(21));
+
+    tt_uint_op(pbdrv_imu_read(&index, samples, PBIO_ARRAY_SIZE(samples), &count), ==, PBIO_SUCCESS);
+    tt_uint_op(count, ==, 2);
+    check_sample(&samples[0], 20);
+    check_sample(&samples[1], 21);
+
+    // a reader that falls behind gets the most recent samples, in pieces
+    for (int i = 22; i < 122; i++) {
+        push_sample(i);
+    }
+    PT_WAIT_UNTIL(pt, got_sample(121));
+
+    total = 0;
+    while (true) {
+        tt_uint_op(pbdrv_imu_read(&index, &samples[total], 10, &count), ==, PBIO_SUCCESS);
+        if (count == 0) {
+            break;
+        }
+        total += count;
+    }
+    tt_uint_op(total, ==, 64);
+    tt_want_uint_op(index, ==, 122);
+    for (int i = 0; i < 64; i++) {
+        check_sample(&samples[i], 122 - 64 + i);
+    }
+
+end:
+    process_exit(&pbdrv_imu_process);
+
+    PT_END(pt);
+}
+
+// 1 g at +/-4 g
+#define ONE_G 8197
+
+PT_THREAD(test_imu_tilt_shake(struct pt *pt)) {
+    static pbdrv_imu_sample_t sample;
+    static int16_t gravity[3];
+    static int8_t up;
+    static uint32_t shakes;
+    static uint32_t shake_time;
+    static int16_t n;
+
+    PT_BEGIN(pt);
+
+    test_i2c_dev.regs[WHO_AM_I] = 0x6A;
+    process_start(&pbdrv_imu_process, NULL);
+
+    // nothing to filter yet
+    PT_WAIT_UNTIL(pt, pbdrv_imu_get_info(&(pbdrv_imu_info_t) { }) != PBIO_ERROR_AGAIN);
+    tt_want_uint_op(pbdrv_imu_get_up(&up), ==, PBIO_ERROR_AGAIN);
+    tt_want_uint_op(pbdrv_imu_get_gravity(gravity), ==, PBIO_ERROR_AGAIN);
+    tt_want_uint_op(pbdrv_imu_get_shakes(&shakes, &shake_time), ==, PBIO_ERROR_AGAIN);
+
+    // lying flat and still
+    for (n = 0; n < 40; n++) {
+        push_accel(n, 10, -10, ONE_G);
+    }
+    PT_WAIT_UNTIL(pt, got_sample(n - 1));
+
+    tt_uint_op(pbdrv_imu_get_gravity(gravity), ==, PBIO_SUCCESS);
+    tt_want_int_op(gravity[0], ==, 10);
+    tt_want_int_op(gravity[1], ==, -10);
+    tt_want_int_op(gravity[2], ==, ONE_G);
+    tt_uint_op(pbdrv_imu_get_up(&up), ==, PBIO_SUCCESS);
+    tt_want_int_op(up, ==, 3);
+    tt_uint_op(pbdrv_imu_get_shakes(&shakes, &shake_time), ==, PBIO_SUCCESS);
+    tt_want_uint_op(shakes, ==, 0);
+
+    // a knock on the side counts as a shake but does not change the tilt
+    push_accel(n++, 0, 2 * ONE_G, ONE_G);
+    for (int i = 0; i < 10; i++) {
+        push_accel(n++, 0, 0, ONE_G);
+    }
+    PT_WAIT_UNTIL(pt, got_sample(n - 1));
+
+    tt_uint_op(pbdrv_imu_read(&(uint32_t) { 40 }, &sample, 1, &(uint32_t) { 0 }), ==, PBIO_SUCCESS);
+    tt_uint_op(pbdrv_imu_get_shakes(&shakes, &shake_time), ==, PBIO_SUCCESS);
+    tt_want_uint_op(shakes, ==, 1);
+    tt_want_uint_op(shake_time, ==, sample.time);
+    tt_uint_op(pbdrv_imu_get_up(&up), ==, PBIO_SUCCESS);
+    tt_want_int_op(up, ==, 3);
+
+    // a shake that lasts several samples counts once
+    for (int i = 0; i < 20; i++) {
+        push_accel(n++, 0, 0, ONE_G);
+    }
+    for (int i = 0; i < 8; i++) {
+        push_accel(n++, 0, i & 1 ? -ONE_G : 3 * ONE_G, ONE_G);
+    }
+    for (int i = 0; i < 30; i++) {
+        push_accel(n++, 0, 0, ONE_G);
+    }
+    PT_WAIT_UNTIL(pt, got_sample(n - 1));
+
+    tt_uint_op(pbdrv_imu_get_shakes(&shakes, &shake_time), ==, PBIO_SUCCESS);
+    tt_want_uint_op(shakes, ==, 2);
+
+    // so do two knocks that are closer together than the hold-off
+    push_accel(n++, 0, 2 * ONE_G, ONE_G);
+    for (int i = 0; i < 5; i++) {
+        push_accel(n++, 0, 0, ONE_G);
+    }
+    push_accel(n++, 0, 2 * ONE_G, ONE_G);
+    for (int i = 0; i < 30; i++) {
+        push_accel(n++, 0, 0, ONE_G);
+    }
+    PT_WAIT_UNTIL(pt, got_sample(n - 1));
+
+    tt_uint_op(pbdrv_imu_get_shakes(&shakes, &shake_time), ==, PBIO_SUCCESS);
+    tt_want_uint_op(shakes, ==, 3);
+
+    // turned upside down, gravity follows after a short time
+    for (int i = 0; i < 150; i++) {
+        push_accel(n++, 0, 0, -ONE_G);
+    }
+    PT_WAIT_UNTIL(pt, got_sample(n - 1));
+
+    tt_uint_op(pbdrv_imu_get_up(&up), ==, PBIO_SUCCESS);
+    tt_want_int_op(up, ==, -3);
+    tt_uint_op(pbdrv_imu_get_gravity(gravity), ==, PBIO_SUCCESS);
+    tt_want_int_op(gravity[2], <, -ONE_G * 95 / 100);
+
+    // standing on an edge, in between two axes
+    for (int i = 0; i < 150; i++) {
+        push_accel(n++, ONE_G * 7 / 10, 0, ONE_G * 7 / 10);
+    }
+    PT_WAIT_UNTIL(pt, got_sample(n - 1));
+
+    tt_uint_op(pbdrv_imu_get_up(&up), ==, PBIO_SUCCESS);
+    tt_want_int_op(up, ==, 0);
+
+end:
+    process_exit(&pbdrv_imu_process);
+
+    PT_END(pt);
+}
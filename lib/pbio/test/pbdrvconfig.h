@@ -3,3 +3,10 @@
 #define PBDRV_CONFIG_COUNTER_NUM_DEV                (1)
 
 #define PBDRV_CONFIG_UART                           (1)
+
+#define PBDRV_CONFIG_I2C                            (1)
+
+#define PBDRV_CONFIG_IMU                            (1)
+#define PBDRV_CONFIG_IMU_NUM_SAMPLES                (64)
+#define PBDRV_CONFIG_IMU_LSM6DS3TR_C                (1)
+#define PBDRV_CONFIG_IMU_LSM6DS3TR_C_I2C_ID         (0)
@@ -1,2 +1,9 @@
 #define PBIO_CONFIG_UARTDEV                 (1)
 #define PBIO_CONFIG_UARTDEV_NUM_DEV         (1)
+#define PBIO_CONFIG_UARTDEV_MAX_BAUD_RATE   (460800)
+
+#define PBIO_CONFIG_STATS                   (1)
+
+#define PBIO_CONFIG_ATTITUDE                (1)
+
+#define PBIO_CONFIG_TRACE                   (1)
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <stdint.h>
+#include <string.h>
+
+#include <pbio/ringbuf.h>
+#include <pbio/util.h>
+
+#include <tinytest.h>
+#include <tinytest_macros.h>
+
+void test_ringbuf_read_write(void *env) {
+    pbio_ringbuf_t rb;
+    uint8_t mem[8];
+    uint8_t buf[16];
+
+    pbio_ringbuf_init(&rb, mem, sizeof(mem));
+    tt_want_int_op(pbio_ringbuf_count(&rb), ==, 0);
+    tt_want_int_op(pbio_ringbuf_free(&rb), ==, 8);
+    tt_want_int_op(pbio_ringbuf_read(&rb, buf, sizeof(buf)), ==, 0);
+
+    // only as much as fits is written
+    tt_want_int_op(pbio_ringbuf_write(&rb, (const uint8_t *)"abcdefghij", 10), ==, 8);
+    tt_want_int_op(pbio_ringbuf_count(&rb), ==, 8);
+    tt_want_int_op(pbio_ringbuf_free(&rb), ==, 0);
+    tt_want_int_op(pbio_ringbuf_write(&rb, (const uint8_t *)"k", 1), ==, 0);
+
+    // partial read
+    tt_want_int_op(pbio_ringbuf_read(&rb, buf, 3), ==, 3);
+    tt_want(memcmp(buf, "abc", 3) == 0);
+
+    // this write wraps around the end of the buffer
+    tt_want_int_op(pbio_ringbuf_write(&rb, (const uint8_t *)"xyz", 3), ==, 3);
+    tt_want_int_op(pbio_ringbuf_count(&rb), ==, 8);
+
+    // and so does this read
+    tt_want_int_op(pbio_ringbuf_read(&rb, buf, sizeof(buf)), ==, 8);
+    tt_want(memcmp(buf, "defghxyz", 8) == 0);
+    tt_want_int_op(pbio_ringbuf_count(&rb), ==, 0);
+}
+
+void test_ringbuf_index_overflow(void *env) {
+    pbio_ringbuf_t rb;
+    uint8_t mem[4];
+    uint8_t buf[4];
+
+    // head and tail are free-running, so check that they can wrap around
+    pbio_ringbuf_init(&rb, mem, sizeof(mem));
+    rb.head = rb.tail = UINT32_MAX - 1;
+
+    tt_want_int_op(pbio_ringbuf_write(&rb, (const uint8_t *)"1234", 4), ==, 4);
+    tt_want_int_op(pbio_ringbuf_count(&rb), ==, 4);
+    tt_want_int_op(pbio_ringbuf_free(&rb), ==, 0);
+    tt_want_int_op(pbio_ringbuf_read(&rb, buf, 2), ==, 2);
+    tt_want(memcmp(buf, "12", 2) == 0);
+    tt_want_int_op(pbio_ringbuf_write(&rb, (const uint8_t *)"56", 2), ==, 2);
+    tt_want_int_op(pbio_ringbuf_read(&rb, buf, PBIO_ARRAY_SIZE(buf)), ==, 4);
+    tt_want(memcmp(buf, "3456", 4) == 0);
+}
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <stdint.h>
+
+#include <pbio/stats.h>
+
+#include <tinytest.h>
+#include <tinytest_macros.h>
+
+void test_stats_add(void *env) {
+    pbio_stats_reset();
+
+    pbio_stats_add(PBIO_STATS_MOTORPOLL, 10);
+    pbio_stats_add(PBIO_STATS_MOTORPOLL, 40);
+    pbio_stats_add(PBIO_STATS_MOTORPOLL, 1000);
+    pbio_stats_add(PBIO_STATS_MOTORPOLL, UINT32_MAX / 4);
+
+    const pbio_stats_t *s = pbio_stats_get(PBIO_STATS_MOTORPOLL);
+    tt_want_int_op(s->count, ==, 4);
+    tt_want_int_op(s->total, ==, 10 + 40 + 1000 + UINT32_MAX / 4);
+    tt_want_int_op(s->min, ==, 10);
+    tt_want_int_op(s->max, ==, UINT32_MAX / 4);
+
+    // below 32us, 32us to 64us, 512us to 1024us and the last bin for the rest
+    tt_want_int_op(s->histogram[0], ==, 1);
+    tt_want_int_op(s->histogram[1], ==, 1);
+    tt_want_int_op(s->histogram[5], ==, 1);
+    tt_want_int_op(s->histogram[PBIO_STATS_HISTOGRAM_SIZE - 1], ==, 1);
+
+    // other measurements are not affected
+    tt_want_int_op(pbio_stats_get(PBIO_STATS_LIGHTPOLL)->count, ==, 0);
+
+    pbio_stats_reset();
+    tt_want_int_op(s->count, ==, 0);
+    tt_want_int_op(s->histogram[0], ==, 0);
+}
+
+void test_stats_total_wrap(void *env) {
+    pbio_stats_reset();
+
+    // 5 ms servo periods for a bit more than the 71 minutes it takes for a
+    // 32 bit sum of microseconds to wrap
+    const uint32_t count = 72 * 60 * 1000 / 5;
+    for (uint32_t i = 0; i < count; i++) {
+        pbio_stats_add(PBIO_STATS_SERVO_PERIOD, 5000);
+    }
+
+    const pbio_stats_t *s = pbio_stats_get(PBIO_STATS_SERVO_PERIOD);
+    tt_want_int_op(s->count, ==, count);
+    tt_want(s->total == (uint64_t)count * 5000);
+    tt_want(s->total > UINT32_MAX);
+    tt_want_int_op(s->total / s->count, ==, 5000);
+}
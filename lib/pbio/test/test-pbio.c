@@ -75,6 +75,30 @@ static struct testcase_t example_tests[] = {
     END_OF_TESTCASES
 };
 
+PBIO_TEST_FUNC(test_attitude_calibrate);
+PBIO_TEST_FUNC(test_attitude_turn);
+PBIO_TEST_FUNC(test_attitude_tilt);
+PBIO_TEST_FUNC(test_attitude_drift);
+PBIO_TEST_FUNC(test_attitude_acceleration);
+
+static struct testcase_t pbio_attitude_tests[] = {
+    PBIO_TEST(test_attitude_calibrate),
+    PBIO_TEST(test_attitude_turn),
+    PBIO_TEST(test_attitude_tilt),
+    PBIO_TEST(test_attitude_drift),
+    PBIO_TEST(test_attitude_acceleration),
+    END_OF_TESTCASES
+};
+
+PBIO_TEST_FUNC(test_imu_lsm6ds3tr_c);
+PBIO_TEST_FUNC(test_imu_tilt_shake);
+
+static struct testcase_t pbdrv_imu_tests[] = {
+    PBIO_PT_THREAD_TEST(test_imu_lsm6ds3tr_c),
+    PBIO_PT_THREAD_TEST(test_imu_tilt_shake),
+    END_OF_TESTCASES
+};
+
 PBIO_TEST_FUNC(test_sqrt);
 PBIO_TEST_FUNC(test_mul_i32_fix16);
 PBIO_TEST_FUNC(test_div_i32_fix16);
@@ -86,22 +110,64 @@ static struct testcase_t pbio_math_tests[] = {
     END_OF_TESTCASES
 };
 
+PBIO_TEST_FUNC(test_ringbuf_read_write);
+PBIO_TEST_FUNC(test_ringbuf_index_overflow);
+
+static struct testcase_t pbio_ringbuf_tests[] = {
+    PBIO_TEST(test_ringbuf_read_write),
+    PBIO_TEST(test_ringbuf_index_overflow),
+    END_OF_TESTCASES
+};
+
+PBIO_TEST_FUNC(test_stats_add);
+PBIO_TEST_FUNC(test_stats_total_wrap);
+
+static struct testcase_t pbio_stats_tests[] = {
+    PBIO_TEST(test_stats_add),
+    PBIO_TEST(test_stats_total_wrap),
+    END_OF_TESTCASES
+};
+
+PBIO_TEST_FUNC(test_trace_wrap_around);
+
+static struct testcase_t pbio_trace_tests[] = {
+    PBIO_TEST(test_trace_wrap_around),
+    END_OF_TESTCASES
+};
+
 PBIO_TEST_FUNC(test_boost_color_distance_sensor);
 PBIO_TEST_FUNC(test_boost_interactive_motor);
 PBIO_TEST_FUNC(test_technic_large_motor);
 PBIO_TEST_FUNC(test_technic_xl_motor);
+PBIO_TEST_FUNC(test_baud_rate_fallback);
+
+PBIO_TEST_FUNC(test_txbuf_queue);
+PBIO_TEST_FUNC(test_txbuf_flush);
+
+static struct testcase_t pbio_txbuf_tests[] = {
+    PBIO_TEST(test_txbuf_queue),
+    PBIO_TEST(test_txbuf_flush),
+    END_OF_TESTCASES
+};
 
 static struct testcase_t pbio_uartdev_tests[] = {
     PBIO_PT_THREAD_TEST(test_boost_color_distance_sensor),
     PBIO_PT_THREAD_TEST(test_boost_interactive_motor),
     PBIO_PT_THREAD_TEST(test_technic_large_motor),
     PBIO_PT_THREAD_TEST(test_technic_xl_motor),
+    PBIO_PT_THREAD_TEST(test_baud_rate_fallback),
     END_OF_TESTCASES
 };
 
 static struct testgroup_t test_groups[] = {
+    { "attitude/", pbio_attitude_tests },
     { "example/", example_tests },
+    { "imu/", pbdrv_imu_tests },
     { "math/", pbio_math_tests },
+    { "ringbuf/", pbio_ringbuf_tests },
+    { "stats/", pbio_stats_tests },
+    { "trace/", pbio_trace_tests },
+    { "txbuf/", pbio_txbuf_tests },
     { "uartdev/", pbio_uartdev_tests, },
     END_OF_GROUPS
 };
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <stdint.h>
+
+#include <pbio/config.h>
+#include <pbio/trace.h>
+
+#include <tinytest.h>
+#include <tinytest_macros.h>
+
+void test_trace_wrap_around(void *env) {
+    pbio_trace_entry_t entries[PBIO_CONFIG_TRACE_SIZE];
+
+    pbio_trace_clear();
+    tt_want_int_op(pbio_trace_read(entries), ==, 0);
+
+    pbio_trace(PBIO_TRACE_MODE_BEGIN, PBIO_PORT_SELF, 3);
+    tt_want_int_op(pbio_trace_read(entries), ==, 1);
+    tt_want_int_op(entries[0].event, ==, PBIO_TRACE_MODE_BEGIN);
+    tt_want_int_op(entries[0].port, ==, PBIO_PORT_SELF);
+    tt_want_int_op(entries[0].data, ==, 3);
+
+    // the oldest entries are overwritten when full
+    for (uint16_t i = 0; i < PBIO_CONFIG_TRACE_SIZE + 5; i++) {
+        pbio_trace(PBIO_TRACE_UARTDEV_ERR, PBIO_PORT_NONE, i);
+    }
+    tt_want_int_op(pbio_trace_read(entries), ==, PBIO_CONFIG_TRACE_SIZE);
+    tt_want_int_op(entries[0].data, ==, 5);
+    tt_want_int_op(entries[PBIO_CONFIG_TRACE_SIZE - 1].data, ==, PBIO_CONFIG_TRACE_SIZE + 4);
+    tt_want_int_op(entries[PBIO_CONFIG_TRACE_SIZE - 1].event, ==, PBIO_TRACE_UARTDEV_ERR);
+
+    pbio_trace_clear();
+    tt_want_int_op(pbio_trace_read(entries), ==, 0);
+}
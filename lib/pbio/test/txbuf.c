@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <pbio/txbuf.h>
+
+#include <tinytest.h>
+#include <tinytest_macros.h>
+
+// stands in for the Bluetooth driver: sends one packet if there is one
+static bool send_packet(pbio_txbuf_t *txbuf, uint8_t *sent, uint16_t *sent_size) {
+    const uint8_t *data;
+    uint16_t size;
+
+    if (!pbio_txbuf_send_begin(txbuf, &data, &size)) {
+        return false;
+    }
+    memcpy(sent, data, size);
+    *sent_size = size;
+    pbio_txbuf_send_end(txbuf);
+    return true;
+}
+
+void test_txbuf_queue(void *env) {
+    pbio_txbuf_t txbuf;
+    uint8_t mem[2 * 8];
+    const uint8_t *data;
+    uint16_t size;
+
+    pbio_txbuf_init(&txbuf, mem, 8);
+
+    // nothing to send yet
+    tt_want(!pbio_txbuf_send_begin(&txbuf, &data, &size));
+
+    // only one packet worth is queued
+    tt_want_int_op(pbio_txbuf_write(&txbuf, (const uint8_t *)"abcdefghij", 10), ==, 8);
+    tt_want_int_op(pbio_txbuf_write(&txbuf, (const uint8_t *)"k", 1), ==, 0);
+
+    // while the full packet is being sent, the other one is filled
+    tt_want(pbio_txbuf_send_begin(&txbuf, &data, &size));
+    tt_want_int_op(size, ==, 8);
+    tt_want(memcmp(data, "abcdefgh", 8) == 0);
+    tt_want_int_op(pbio_txbuf_write(&txbuf, (const uint8_t *)"ijklmnopqr", 10), ==, 8);
+    tt_want_int_op(pbio_txbuf_write(&txbuf, (const uint8_t *)"q", 1), ==, 0);
+
+    // only one packet is sent at a time, and it is not overwritten
+    tt_want(!pbio_txbuf_send_begin(&txbuf, &data, &size));
+    tt_want(memcmp(data, "abcdefgh", 8) == 0);
+
+    // once it has been sent, the next one goes out and the first is free
+    pbio_txbuf_send_end(&txbuf);
+    tt_want(pbio_txbuf_send_begin(&txbuf, &data, &size));
+    tt_want_int_op(size, ==, 8);
+    tt_want(memcmp(data, "ijklmnop", 8) == 0);
+    tt_want_int_op(pbio_txbuf_write(&txbuf, (const uint8_t *)"qr", 2), ==, 2);
+    pbio_txbuf_send_end(&txbuf);
+
+    // partial packets are sent too
+    tt_want(pbio_txbuf_send_begin(&txbuf, &data, &size));
+    tt_want_int_op(size, ==, 2);
+    tt_want(memcmp(data, "qr", 2) == 0);
+    pbio_txbuf_send_end(&txbuf);
+    tt_want(!pbio_txbuf_send_begin(&txbuf, &data, &size));
+}
+
+void test_txbuf_flush(void *env) {
+    pbio_txbuf_t txbuf;
+    uint8_t mem[2 * 8];
+    uint8_t sent[8];
+    uint16_t sent_size;
+
+    pbio_txbuf_init(&txbuf, mem, 8);
+
+    // a smaller packet size (e.g. the default MTU) is respected
+    pbio_txbuf_set_packet_size(&txbuf, 4);
+    tt_want_int_op(pbio_txbuf_write(&txbuf, (const uint8_t *)"abcdef", 6), ==, 4);
+
+    // a larger one is limited to the capacity
+    pbio_txbuf_set_packet_size(&txbuf, 20);
+    tt_want_int_op(pbio_txbuf_write(&txbuf, (const uint8_t *)"efghijkl", 8), ==, 4);
+
+    // writing and sending in turns gets all bytes out in order
+    static const char msg[] = "the quick brown fox jumps over the lazy dog";
+    uint8_t out[64];
+    uint32_t out_size = 0;
+    uint32_t written = 0;
+    tt_want(send_packet(&txbuf, sent, &sent_size));
+    tt_want(memcmp(sent, "abcdefgh", 8) == 0);
+    while (written < sizeof(msg) - 1) {
+        written += pbio_txbuf_write(&txbuf, (const uint8_t *)&msg[written], sizeof(msg) - 1 - written);
+        tt_want(send_packet(&txbuf, sent, &sent_size));
+        memcpy(&out[out_size], sent, sent_size);
+        out_size += sent_size;
+    }
+    tt_want(!send_packet(&txbuf, sent, &sent_size));
+    tt_want_int_op(out_size, ==, sizeof(msg) - 1);
+    tt_want(memcmp(out, msg, sizeof(msg) - 1) == 0);
+
+    // bytes that were queued before the packet size was made smaller stay,
+    // but nothing more is added to that packet
+    pbio_txbuf_write(&txbuf, (const uint8_t *)"abcdef", 6);
+    pbio_txbuf_set_packet_size(&txbuf, 4);
+    tt_want_int_op(pbio_txbuf_write(&txbuf, (const uint8_t *)"g", 1), ==, 0);
+    tt_want(send_packet(&txbuf, sent, &sent_size));
+    tt_want_int_op(sent_size, ==, 6);
+
+    // disconnecting drops everything, also a packet in flight
+    const uint8_t *data;
+    uint16_t size;
+    pbio_txbuf_write(&txbuf, (const uint8_t *)"abcd", 4);
+    tt_want(pbio_txbuf_send_begin(&txbuf, &data, &size));
+    pbio_txbuf_write(&txbuf, (const uint8_t *)"efgh", 4);
+    pbio_txbuf_clear(&txbuf);
+    pbio_txbuf_send_end(&txbuf);
+    tt_want(!pbio_txbuf_send_begin(&txbuf, &data, &size));
+    tt_want_int_op(pbio_txbuf_write(&txbuf, (const uint8_t *)"abcd", 4), ==, 4);
+}
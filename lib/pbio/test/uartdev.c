@@ -31,34 +31,40 @@ static struct {
     uint8_t *rx_msg;
     uint8_t rx_msg_length;
     pbio_error_t rx_msg_result;
+    uint8_t rx_fifo[64];
+    uint8_t rx_fifo_size;
     uint8_t *tx_msg;
     struct etimer tx_timer;
     uint8_t tx_msg_length;
     pbio_error_t tx_msg_result;
 } test_uart_dev;
 
+// takes up to size bytes out of the simulated receive FIFO
+static uint8_t take_rx_fifo(uint8_t *buf, uint8_t size) {
+    if (size > test_uart_dev.rx_fifo_size) {
+        size = test_uart_dev.rx_fifo_size;
+    }
+
+    memcpy(buf, test_uart_dev.rx_fifo, size);
+    test_uart_dev.rx_fifo_size -= size;
+    memmove(test_uart_dev.rx_fifo, &test_uart_dev.rx_fifo[size], test_uart_dev.rx_fifo_size);
+
+    return size;
+}
+
 PT_THREAD(simulate_rx_msg(struct pt *pt, const uint8_t *msg, uint8_t length, bool *ok)) {
     PT_BEGIN(pt);
 
-    // First uartdev reads one byte header
-    PT_WAIT_UNTIL(pt, test_uart_dev.rx_msg_result == PBIO_ERROR_AGAIN);
-    tt_uint_op(test_uart_dev.rx_msg_length, ==, 1);
-    memcpy(test_uart_dev.rx_msg, msg, 1);
-    test_uart_dev.rx_msg_result = PBIO_SUCCESS;
-    process_poll(&pbio_uartdev_process);
-
-    if (length == 1) {
-        *ok = true;
-        PT_EXIT(pt);
-    }
+    tt_uint_op(test_uart_dev.rx_fifo_size + length, <=, sizeof(test_uart_dev.rx_fifo));
 
-    // then read rest of message
-    PT_WAIT_UNTIL(pt, test_uart_dev.rx_msg_result == PBIO_ERROR_AGAIN);
-    tt_uint_op(test_uart_dev.rx_msg_length, ==, length - 1);
-    memcpy(test_uart_dev.rx_msg, &msg[1], length - 1);
-    test_uart_dev.rx_msg_result = PBIO_SUCCESS;
+    // all bytes arrive at once, like they would be with a hardware FIFO
+    memcpy(&test_uart_dev.rx_fifo[test_uart_dev.rx_fifo_size], msg, length);
+    test_uart_dev.rx_fifo_size += length;
     process_poll(&pbio_uartdev_process);
 
+    // then uartdev has to read all of them, either in pieces or in bulk
+    PT_WAIT_UNTIL(pt, test_uart_dev.rx_fifo_size == 0);
+
     *ok = true;
     PT_END(pt);
 
@@ -202,6 +208,9 @@ PT_THREAD(test_boost_color_distance_sensor(struct pt *pt)) {
     static const uint8_t msg90[] = { 0x46, 0x08, 0xB1 }; // extened mode info
     static const uint8_t msg91[] = { 0xD0, 0x00, 0x00, 0x00, 0x00, 0x2F }; // mode 8 data
 
+    static const uint8_t msg92[] = { 0x5C, 0x23, 0x00, 0x00, 0x10, 0x30, 0x00, 0x00, 0x00, 0xA0 }; // WRITE mode combo
+    static const uint8_t msg93[] = { 0xD0, 0x05, 0x07, 0x2A, 0x00, 0x07 }; // DATA color, prox and reflect combo
+
     // used in SIMULATE_RX/TX_MSG macros
     static struct pt child;
     static bool ok;
@@ -316,6 +325,8 @@ PT_THREAD(test_boost_color_distance_sensor(struct pt *pt)) {
     tt_want_uint_op(pbdrv_counter_get_count(counter, &count), ==, PBIO_ERROR_NO_DEV);
     tt_want_uint_op(pbdrv_counter_get_abs_count(counter, &count), ==, PBIO_ERROR_NO_DEV);
     tt_want_uint_op(pbdrv_counter_get_rate(counter, &count), ==, PBIO_ERROR_NO_DEV);
+    int32_t rate;
+    tt_want_uint_op(pbdrv_counter_get_state(counter, &count, &rate), ==, PBIO_ERROR_NO_DEV);
 
     // should be synced now are receive regular pings
     static int i;
@@ -334,7 +345,8 @@ PT_THREAD(test_boost_color_distance_sensor(struct pt *pt)) {
     tt_want_uint_op(iodev->info->num_modes, ==, 11);
     tt_want_uint_op(iodev->info->num_view_modes, ==, 8);
     // TODO: verify fw/hw versions
-    tt_want_uint_op(iodev->info->mode_combos, ==, 1 << 6 | 1 << 3 | 1 << 2 | 1 << 1 | 1 << 0);
+    tt_want_uint_op(iodev->info->num_mode_combos, ==, 1);
+    tt_want_uint_op(iodev->info->mode_combos[0], ==, 1 << 6 | 1 << 3 | 1 << 2 | 1 << 1 | 1 << 0);
     tt_want_uint_op(iodev->motor_flags, ==, PBIO_IODEV_MOTOR_FLAG_NONE);
     tt_want_uint_op(iodev->mode, ==, 0);
 
@@ -593,6 +605,40 @@ PT_THREAD(test_boost_color_distance_sensor(struct pt *pt)) {
     tt_uint_op(err, ==, PBIO_SUCCESS);
     tt_uint_op(iodev->mode, ==, 8);
 
+
+    // test combined mode
+
+    static const uint8_t combo_modes[] = { 0, 1, 3 };
+    PT_WAIT_WHILE(pt, (err = pbio_iodev_set_mode_combo_begin(iodev, combo_modes, 3)) == PBIO_ERROR_AGAIN);
+    tt_uint_op(err, ==, PBIO_SUCCESS);
+
+    // wait for mode combo message to be sent
+    SIMULATE_TX_MSG(msg92);
+
+    // should be blocked since combined data has not been received yet
+    tt_uint_op(pbio_iodev_set_mode_end(iodev), ==, PBIO_ERROR_AGAIN);
+
+    // same message is received in respose along with data message
+    SIMULATE_RX_MSG(msg92);
+    SIMULATE_RX_MSG(msg85);
+    SIMULATE_RX_MSG(msg93);
+
+    PT_WAIT_WHILE(pt, (err = pbio_iodev_set_mode_end(iodev)) == PBIO_ERROR_AGAIN);
+    tt_uint_op(err, ==, PBIO_SUCCESS);
+
+    static uint8_t *data;
+    tt_uint_op(pbio_iodev_get_mode_data(iodev, 0, &data), ==, PBIO_SUCCESS);
+    tt_want_uint_op(data[0], ==, 0x05);
+    tt_uint_op(pbio_iodev_get_mode_data(iodev, 1, &data), ==, PBIO_SUCCESS);
+    tt_want_uint_op(data[0], ==, 0x07);
+    tt_uint_op(pbio_iodev_get_mode_data(iodev, 3, &data), ==, PBIO_SUCCESS);
+    tt_want_uint_op(data[0], ==, 0x2A);
+    tt_want_uint_op(pbio_iodev_get_mode_data(iodev, 2, &data), ==, PBIO_ERROR_INVALID_OP);
+
+    // modes that are not in any advertised combination are rejected
+    static const uint8_t bad_combo_modes[] = { 0, 8 };
+    tt_want_uint_op(pbio_iodev_set_mode_combo_begin(iodev, bad_combo_modes, 2), ==, PBIO_ERROR_INVALID_ARG);
+
     PT_YIELD(pt);
 
 end:
@@ -720,6 +766,10 @@ PT_THREAD(test_boost_interactive_motor(struct pt *pt)) {
     tt_want_uint_op(pbdrv_counter_get_abs_count(counter, &count), ==, PBIO_ERROR_NOT_SUPPORTED);
     tt_want_uint_op(pbdrv_counter_get_rate(counter, &count), ==, PBIO_SUCCESS);
     tt_want_int_op(count, ==, -1500);
+    int32_t rate;
+    tt_want_uint_op(pbdrv_counter_get_state(counter, &count, &rate), ==, PBIO_SUCCESS);
+    tt_want_int_op(count, ==, -1);
+    tt_want_int_op(rate, ==, -1500);
 
     // should be synced now are receive regular pings
     static int i;
@@ -737,7 +787,7 @@ PT_THREAD(test_boost_interactive_motor(struct pt *pt)) {
     tt_want_uint_op(iodev->info->num_modes, ==, 4);
     tt_want_uint_op(iodev->info->num_view_modes, ==, 3);
     // TODO: verify fw/hw versions
-    tt_want_uint_op(iodev->info->mode_combos, ==, 1 << 2 | 1 << 1);
+    tt_want_uint_op(iodev->info->mode_combos[0], ==, 1 << 2 | 1 << 1);
     tt_want_uint_op(iodev->motor_flags, ==, PBIO_IODEV_MOTOR_FLAG_IS_MOTOR |
         PBIO_IODEV_MOTOR_FLAG_HAS_SPEED | PBIO_IODEV_MOTOR_FLAG_HAS_REL_POS);
     tt_want_uint_op(iodev->mode, ==, 0);
@@ -1002,10 +1052,16 @@ PT_THREAD(test_technic_large_motor(struct pt *pt)) {
     static pbio_iodev_t *iodev;
     tt_uint_op(pbio_uartdev_get(0, &iodev), ==, PBIO_SUCCESS);
     tt_want_uint_op(iodev->info->type_id, ==, PBIO_IODEV_TYPE_ID_CPLUS_L_MOTOR);
+
+    static pbio_uartdev_stats_t stats;
+    tt_want_uint_op(pbio_uartdev_get_stats(0, &stats), ==, PBIO_SUCCESS);
+    // not asked to go faster than the advertised rate
+    tt_want_uint_op(stats.baud_rate, ==, 115200);
+    tt_want_uint_op(stats.err_count, ==, 0);
     tt_want_uint_op(iodev->info->num_modes, ==, 6);
     tt_want_uint_op(iodev->info->num_view_modes, ==, 4);
     // TODO: verify fw/hw versions
-    tt_want_uint_op(iodev->info->mode_combos, ==, 1 << 3 | 1 << 2 | 1 << 1);
+    tt_want_uint_op(iodev->info->mode_combos[0], ==, 1 << 3 | 1 << 2 | 1 << 1);
     tt_want_uint_op(iodev->motor_flags, ==, PBIO_IODEV_MOTOR_FLAG_IS_MOTOR | PBIO_IODEV_MOTOR_FLAG_HAS_SPEED
         | PBIO_IODEV_MOTOR_FLAG_HAS_REL_POS | PBIO_IODEV_MOTOR_FLAG_HAS_ABS_POS);
     tt_want_uint_op(iodev->mode, ==, 0);
@@ -1292,6 +1348,7 @@ PT_THREAD(test_technic_xl_motor(struct pt *pt)) {
 
     // motors get WRITE message to setup mode combos
     SIMULATE_TX_MSG(msg56);
+    tt_want_uint_op(test_uart_dev.baud, ==, 115200);
 
     // same message is received in respose along with data message
     SIMULATE_RX_MSG(msg56);
@@ -1325,7 +1382,7 @@ PT_THREAD(test_technic_xl_motor(struct pt *pt)) {
     tt_want_uint_op(iodev->info->num_modes, ==, 6);
     tt_want_uint_op(iodev->info->num_view_modes, ==, 4);
     // TODO: verify fw/hw versions
-    tt_want_uint_op(iodev->info->mode_combos, ==, 1 << 3 | 1 << 2 | 1 << 1);
+    tt_want_uint_op(iodev->info->mode_combos[0], ==, 1 << 3 | 1 << 2 | 1 << 1);
     tt_want_uint_op(iodev->motor_flags, ==, PBIO_IODEV_MOTOR_FLAG_IS_MOTOR | PBIO_IODEV_MOTOR_FLAG_HAS_SPEED
         | PBIO_IODEV_MOTOR_FLAG_HAS_REL_POS | PBIO_IODEV_MOTOR_FLAG_HAS_ABS_POS);
     tt_want_uint_op(iodev->mode, ==, 0);
@@ -1470,6 +1527,81 @@ end:
     PT_END(pt);
 }
 
+PT_THREAD(test_baud_rate_fallback(struct pt *pt)) {
+    // made up device that advertises a rate that turns out not to work
+    static const uint8_t msg_type[] = { 0x40, 0x3E, 0x81 }; // TYPE 62
+    static const uint8_t msg_modes[] = { 0x49, 0x00, 0x00, 0xB6 }; // MODES 1
+    static const uint8_t msg_speed[] = { 0x52, 0x00, 0x08, 0x07, 0x00, 0xA2 }; // SPEED 460800
+    static const uint8_t msg_name[] = { 0x90, 0x00, 0x44, 0x49, 0x53, 0x54, 0x65 }; // mode 0 NAME
+    static const uint8_t msg_format[] = { 0x90, 0x80, 0x01, 0x00, 0x03, 0x00, 0xED }; // mode 0 FORMAT
+    static const uint8_t msg_speed_230400[] = { 0x52, 0x00, 0x84, 0x03, 0x00, 0x2A }; // SPEED 230400
+    static const uint8_t msg_nack[] = { 0x02 }; // NACK
+    static const uint8_t msg_data[] = { 0xC0, 0x2A, 0x15 }; // mode 0 data
+
+    // used in SIMULATE_RX/TX_MSG macros
+    static struct pt child;
+    static bool ok;
+
+    static int i;
+
+    PT_BEGIN(pt);
+
+    process_start(&pbio_uartdev_process, NULL);
+
+    // sync at 115200 and switch to the advertised rate
+    PT_WAIT_UNTIL(pt, test_uart_dev.baud == 115200);
+    SIMULATE_TX_MSG(msg_speed_115200);
+    SIMULATE_RX_MSG(msg_ack);
+    SIMULATE_RX_MSG(msg_type);
+    SIMULATE_RX_MSG(msg_modes);
+    SIMULATE_RX_MSG(msg_speed);
+    SIMULATE_RX_MSG(msg_name);
+    SIMULATE_RX_MSG(msg_format);
+    SIMULATE_RX_MSG(msg_ack);
+    SIMULATE_TX_MSG(msg_ack);
+    PT_WAIT_UNTIL(pt, test_uart_dev.baud == 460800);
+
+    // no data comes through at this rate, so the hub gives up after the
+    // keepalive errors and starts over
+    for (i = 0; i < 7; i++) {
+        SIMULATE_TX_MSG(msg_nack);
+    }
+    PT_WAIT_UNTIL(pt, test_uart_dev.baud == 115200);
+
+    // on the next sync, the same device is asked for half the rate
+    SIMULATE_TX_MSG(msg_speed_115200);
+    SIMULATE_RX_MSG(msg_ack);
+    SIMULATE_RX_MSG(msg_type);
+    SIMULATE_RX_MSG(msg_modes);
+    SIMULATE_RX_MSG(msg_speed);
+    SIMULATE_RX_MSG(msg_name);
+    SIMULATE_RX_MSG(msg_format);
+    SIMULATE_RX_MSG(msg_ack);
+    SIMULATE_TX_MSG(msg_ack);
+    PT_WAIT_UNTIL(pt, test_uart_dev.baud == 460800);
+    SIMULATE_TX_MSG(msg_speed_230400);
+    SIMULATE_RX_MSG(msg_ack);
+    PT_WAIT_UNTIL(pt, test_uart_dev.baud == 230400);
+
+    // which works
+    for (i = 0; i < 10; i++) {
+        SIMULATE_TX_MSG(msg_nack);
+        SIMULATE_RX_MSG(msg_data);
+    }
+
+    static pbio_uartdev_stats_t stats;
+    tt_want_uint_op(pbio_uartdev_get_stats(0, &stats), ==, PBIO_SUCCESS);
+    tt_want_uint_op(stats.baud_rate, ==, 230400);
+    tt_want_uint_op(stats.err_count, ==, 1);
+
+    PT_YIELD(pt);
+
+end:
+    process_exit(&pbio_uartdev_process);
+
+    PT_END(pt);
+}
+
 const pbio_uartdev_platform_data_t pbio_uartdev_platform_data[] = {
     [0] = {
         .uart_id = 0,
@@ -1496,6 +1628,7 @@ pbio_error_t pbdrv_uart_read_begin(pbdrv_uart_dev_t *uart, uint8_t *msg, uint8_t
     test_uart_dev.rx_msg_length = length;
     test_uart_dev.rx_msg_result = PBIO_ERROR_AGAIN;
     etimer_set(&test_uart_dev.rx_timer, clock_from_msec(timeout));
+    process_poll(&pbio_uartdev_process);
 
     return PBIO_SUCCESS;
 }
@@ -1503,6 +1636,11 @@ pbio_error_t pbdrv_uart_read_begin(pbdrv_uart_dev_t *uart, uint8_t *msg, uint8_t
 pbio_error_t pbdrv_uart_read_end(pbdrv_uart_dev_t *uart) {
     assert(test_uart_dev.rx_msg);
 
+    if (test_uart_dev.rx_msg_result == PBIO_ERROR_AGAIN && test_uart_dev.rx_fifo_size >= test_uart_dev.rx_msg_length) {
+        take_rx_fifo(test_uart_dev.rx_msg, test_uart_dev.rx_msg_length);
+        test_uart_dev.rx_msg_result = PBIO_SUCCESS;
+    }
+
     if (test_uart_dev.rx_msg_result == PBIO_ERROR_AGAIN && etimer_expired(&test_uart_dev.rx_timer)) {
         test_uart_dev.rx_msg_result = PBIO_ERROR_TIMEDOUT;
     }
@@ -1518,6 +1656,16 @@ void pbdrv_uart_read_cancel(pbdrv_uart_dev_t *uart) {
 
 }
 
+pbio_error_t pbdrv_uart_read_available(pbdrv_uart_dev_t *uart, uint8_t *buf, uint8_t size, uint8_t *count) {
+    if (test_uart_dev.rx_msg) {
+        return PBIO_ERROR_AGAIN;
+    }
+
+    *count = take_rx_fifo(buf, size);
+
+    return PBIO_SUCCESS;
+}
+
 pbio_error_t pbdrv_uart_write_begin(pbdrv_uart_dev_t *uart, uint8_t *msg, uint8_t length, uint32_t timeout) {
     if (test_uart_dev.tx_msg) {
         return PBIO_ERROR_AGAIN;
@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 The Pybricks Authors
+
+#include "pbkwarg.h"
+
+#include "py/obj.h"
+#include "py/runtime.h"
+
+void pb_arg_parse_all(size_t n_pos, const mp_obj_t *pos, mp_map_t *kws, size_t n_allowed, const mp_arg_t *allowed, mp_arg_val_t *out_vals) {
+    // Calls without keyword arguments are the most common, especially in
+    // loops. All arguments generated by the PB_ARG macros are objects, so
+    // they can be copied without conversion.
+    if ((kws == NULL || kws->used == 0) && n_pos <= n_allowed) {
+        size_t i;
+        for (i = 0; i < n_pos; i++) {
+            out_vals[i].u_obj = pos[i];
+        }
+        for (; i < n_allowed; i++) {
+            if (allowed[i].flags & MP_ARG_REQUIRED) {
+                // Let MicroPython raise the error
+                goto slow_path;
+            }
+            out_vals[i] = allowed[i].defval;
+        }
+        return;
+    }
+
+slow_path:
+    mp_arg_parse_all(n_pos, pos, kws, n_allowed, allowed, out_vals);
+}
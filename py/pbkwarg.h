@@ -5,6 +5,7 @@
 #define PYBRICKS_INCLUDED_PBKWARG_H
 
 #include "py/obj.h"
+#include "py/runtime.h"
 
 // The following macro is a direct copy of https://stackoverflow.com/a/50371430/11744630
 #define EXPAND(x) x
@@ -29,11 +30,15 @@
 #define MAKE_QSTR_(name) MP_QSTR_##name
 #define MAKE_QSTR(name) MAKE_QSTR_(name)
 
+// Like mp_arg_parse_all, but faster when there are no keyword arguments. All
+// allowed arguments must be MP_ARG_OBJ, as generated by the PB_ARG macros below.
+void pb_arg_parse_all(size_t n_pos, const mp_obj_t *pos, mp_map_t *kws, size_t n_allowed, const mp_arg_t *allowed, mp_arg_val_t *out_vals);
+
 // Parse given positional and keyword arguments against a list of allowed arguments
 // First n_ignore arguments are required arguments for which no keyword can be given.
 #define PB_PARSE_ARGS(parsed_args, n_args, pos_args, kw_args, allowed_args, n_ignore) \
     mp_arg_val_t parsed_args[MP_ARRAY_SIZE(allowed_args)]; \
-    mp_arg_parse_all(n_args - n_ignore, pos_args + n_ignore, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, parsed_args)
+    pb_arg_parse_all(n_args - n_ignore, pos_args + n_ignore, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, parsed_args)
 
 // The following functions make use of the aforementioned PB_PARSE_ARGS macro, but they first
 // auto-generate the allowed_args table to simplify notation in the pybricks modules.
@@ -0,0 +1,112 @@
+# Time per call of the device methods that are typically used in fast loops.
+#
+# Connect a motor to port A and any of the sensors below to port B. Methods of
+# devices that are not connected are skipped. The time of an empty loop is
+# subtracted, so what remains is the cost of the call itself.
+#
+# Calls with keyword arguments are included too, since they take the slower
+# path through the argument parser.
+
+from pybricks.parameters import Port
+from pybricks.pupdevices import (
+    Motor,
+    ColorDistanceSensor,
+    ColorSensor,
+    UltrasonicSensor,
+    ForceSensor,
+)
+from pybricks.tools import StopWatch
+
+MOTOR_PORT = Port.A
+SENSOR_PORT = Port.B
+N = 1000
+
+watch = StopWatch()
+
+
+def loop_time(func, *args, **kwargs):
+    watch.reset()
+    for i in range(N):
+        func(*args, **kwargs)
+    return watch.time()
+
+
+def nothing(*args, **kwargs):
+    pass
+
+
+def bench(name, func, *args, **kwargs):
+    usec = (loop_time(func, *args, **kwargs) - loop_time(nothing, *args, **kwargs)) * 1000 // N
+    print("{:<40}{:>6} us".format(name, usec))
+
+
+def find(device_type, port):
+    try:
+        return device_type(port)
+    except OSError:
+        return None
+
+
+motor = find(Motor, MOTOR_PORT)
+if motor:
+    bench("Motor.angle()", motor.angle)
+    bench("Motor.speed()", motor.speed)
+    bench("Motor.state()", motor.state)
+    bench("Motor.read_into(buf)", motor.read_into, [0] * 5)
+    bench("Motor.dc(duty)", motor.dc, 0)
+    bench("Motor.run(speed)", motor.run, 0)
+    bench("Motor.track_target(target)", motor.track_target, 0)
+    bench("Motor.reset_angle(angle)", motor.reset_angle, 0)
+    bench("Motor.control.done()", motor.control.done)
+    motor.stop()
+
+    # keyword arguments
+    speed, acceleration, actuation = motor.control.limits()
+    bench(
+        "Motor.control.limits(speed=, ...)",
+        motor.control.limits,
+        speed=speed,
+        acceleration=acceleration,
+        actuation=actuation,
+    )
+    angle = motor.angle()
+    bench(
+        "Motor.run_target(speed=, target_angle=)",
+        motor.run_target,
+        speed=500,
+        target_angle=angle,
+        wait=False,
+    )
+    bench("Motor.run(speed=)", motor.run, speed=0)
+    bench("Motor.track_target(target_angle=)", motor.track_target, target_angle=angle)
+    motor.stop()
+
+sensor = find(ColorDistanceSensor, SENSOR_PORT)
+if sensor:
+    bench("ColorDistanceSensor.color()", sensor.color)
+    bench("ColorDistanceSensor.reflection()", sensor.reflection)
+    bench("ColorDistanceSensor.ambient()", sensor.ambient)
+    bench("ColorDistanceSensor.distance()", sensor.distance)
+    bench("ColorDistanceSensor.rgb()", sensor.rgb)
+
+sensor = find(ColorSensor, SENSOR_PORT)
+if sensor:
+    bench("ColorSensor.color()", sensor.color)
+    bench("ColorSensor.reflection()", sensor.reflection)
+    bench("ColorSensor.ambient()", sensor.ambient)
+    bench("ColorSensor.hsv()", sensor.hsv)
+    bench("ColorSensor.lights.on(brightness)", sensor.lights.on, 100)
+
+sensor = find(UltrasonicSensor, SENSOR_PORT)
+if sensor:
+    bench("UltrasonicSensor.distance()", sensor.distance)
+    bench("UltrasonicSensor.presence()", sensor.presence)
+    bench("UltrasonicSensor.lights.on(brightness)", sensor.lights.on, 100)
+
+sensor = find(ForceSensor, SENSOR_PORT)
+if sensor:
+    bench("ForceSensor.force()", sensor.force)
+    bench("ForceSensor.distance()", sensor.distance)
+    bench("ForceSensor.pressed(force)", sensor.pressed, 3)
+    bench("ForceSensor.pressed(force=)", sensor.pressed, force=3)
+    bench("ForceSensor.touched()", sensor.touched)
@@ -0,0 +1,34 @@
+# Lines per second printed to the EV3 screen with ev3.screen.print().
+#
+# Most of these lines scroll the screen, which is the common case when logging
+# status text in a loop.
+
+from pybricks.hubs import EV3Brick
+from pybricks.tools import StopWatch
+
+N = 200
+
+ev3 = EV3Brick()
+watch = StopWatch()
+
+
+def bench(name, *args):
+    ev3.screen.clear()
+    watch.reset()
+    for i in range(N):
+        ev3.screen.print(*args)
+    time = watch.time()
+    results.append("{:<30}{:>6} lines/s".format(name, N * 1000 // max(time, 1)))
+
+
+results = []
+bench("short line", "hello")
+bench("int", 12345)
+bench("several values", "angle", 90, "speed", 360)
+bench("long line", "x" * 100)
+bench("two lines", "first\nsecond")
+
+# Print the results after the benchmark, since printing to the terminal is
+# not free either.
+for result in results:
+    print(result)
@@ -1,6 +1,8 @@
+import uos
+
 from pybricks.hubs import EV3Brick
 from pybricks.parameters import Color
-from pybricks.media.ev3dev import Font
+from pybricks.media.ev3dev import Font, Image
 
 ev3 = EV3Brick()
 
@@ -135,3 +137,52 @@ ev3.screen.print("", end="\n")
 # keyword-only arg sep
 ev3.screen.print(sep=" ")
 ev3.screen.print("", sep=" ")
+
+
+# Test begin_frame() and end_frame()
+
+# drawing in between goes to the screen all at once
+ev3.screen.begin_frame()
+ev3.screen.draw_box(10, 10, 20, 20, fill=True)
+ev3.screen.draw_text(0, 0, "frame")
+ev3.screen.print("frame")
+ev3.screen.end_frame()
+
+# end_frame() without begin_frame() is OK
+ev3.screen.end_frame()
+
+# calling begin_frame() twice is OK
+ev3.screen.begin_frame()
+ev3.screen.begin_frame()
+ev3.screen.end_frame()
+
+# nothing drawn is OK
+ev3.screen.begin_frame()
+ev3.screen.end_frame()
+
+# Frames start from what is on the screen, including what was drawn on it
+# directly since the last frame. Compare with drawing without frames.
+
+
+def draw(direct, frames):
+    ev3.screen.clear()
+    if frames:
+        ev3.screen.begin_frame()
+    ev3.screen.draw_box(0, 0, 9, 9, fill=True)
+    if frames:
+        ev3.screen.end_frame()
+    direct.draw_box(20, 20, 29, 29, fill=True)
+    if frames:
+        ev3.screen.begin_frame()
+    ev3.screen.draw_box(15, 15, 24, 24)
+    if frames:
+        ev3.screen.end_frame()
+    ev3.screen.save("screen.png")
+    with open("screen.png", "rb") as f:
+        data = f.read()
+    uos.remove("screen.png")
+    return data
+
+
+for direct in ev3.screen, Image("_screen_"), Image(ev3.screen, sub=True, x1=0, y1=0, x2=40, y2=40):
+    print(draw(direct, True) == draw(direct, False))
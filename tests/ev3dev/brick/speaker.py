@@ -93,6 +93,17 @@ try:
 except RuntimeError as ex:
     print(ex)
 
+# wait=False plays in the background
+ev3.speaker.play_notes(["C4/4", "D4/4"], wait=False)
+print(ev3.speaker.busy())
+
+# stop ends the melody
+ev3.speaker.stop()
+print(ev3.speaker.busy())
+
+# stop is OK when nothing is playing
+ev3.speaker.stop()
+
 
 # play_file method
 
@@ -114,6 +125,31 @@ try:
 except RuntimeError as ex:
     print(ex)
 
+# wait=False returns right away and sounds can overlap
+ev3.speaker.play_file(SoundFile.HELLO, wait=False)
+ev3.speaker.play_file(SoundFile.HELLO, False)
+
+
+# preload method
+
+# Requires one argument
+try:
+    ev3.speaker.preload()
+except TypeError as ex:
+    print(ex)
+
+# one argument OK
+ev3.speaker.preload(SoundFile.HELLO)
+
+# keyword argument OK
+ev3.speaker.preload(file=SoundFile.HELLO)
+
+# file not found gives RuntimeError
+try:
+    ev3.speaker.preload("bad")
+except RuntimeError as ex:
+    print(ex)
+
 
 # say method
 
@@ -129,6 +165,28 @@ ev3.speaker.say("hi")
 # keyword argument OK
 ev3.speaker.say(text="hi")
 
+# wait=False returns right away
+ev3.speaker.say("hi", wait=False)
+ev3.speaker.stop()
+
+
+# prerender method
+
+# Requires one argument
+try:
+    ev3.speaker.prerender()
+except TypeError as ex:
+    print(ex)
+
+# one argument OK
+ev3.speaker.prerender("hello")
+
+# keyword argument OK
+ev3.speaker.prerender(text="hello")
+
+# say uses the prerendered text
+ev3.speaker.say("hello")
+
 
 # set_volume method
 
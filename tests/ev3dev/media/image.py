@@ -1,4 +1,5 @@
 import uos
+import ustruct
 
 from pybricks.parameters import Color
 from pybricks.media.ev3dev import Font, Image
@@ -161,6 +162,61 @@ except TypeError as ex:
     print(ex)
 
 
+# Test raw images
+
+# 4x2 raw image, see tools/ev3image.py
+with open("test.pbimg", "wb") as f:
+    f.write(ustruct.pack("<4sHHII", b"PBIM", 4, 2, 16, 0))
+    f.write(bytes(4 * 2 * 4))
+raw = Image("test.pbimg")
+print(raw.width, raw.height)
+img.draw_image(0, 0, "test.pbimg")
+img.load_image("test.pbimg")
+
+# decoded images are cached, but a file that is written again is reloaded
+with open("test.pbimg", "wb") as f:
+    f.write(ustruct.pack("<4sHHII", b"PBIM", 2, 1, 8, 0))
+    f.write(bytes(2 * 1 * 4))
+img.draw_image(0, 0, "test.pbimg")
+print(Image("test.pbimg").width, Image("test.pbimg").height)
+uos.remove("test.pbimg")
+
+# error if file is not a raw image
+with open("bad.pbimg", "wb") as f:
+    f.write(b"not an image file")
+try:
+    Image("bad.pbimg")
+except OSError as ex:
+    print(ex)
+uos.remove("bad.pbimg")
+
+
+# Test draw_sprite()
+
+# five required arguments
+img.draw_sprite(0, 0, raw, 0, 2)
+img.draw_sprite(x=0, y=0, source=raw, index=0, width=2)
+img.draw_sprite(0, 0, TEST_IMAGE, 1, 80)
+try:
+    img.draw_sprite(0, 0, raw, 0)
+except TypeError as ex:
+    print(ex)
+
+# 6th argument is kwarg, frames are numbered left to right, top to bottom
+img.draw_sprite(0, 0, raw, 3, 2, 1)
+img.draw_sprite(0, 0, raw, 3, 2, height=1)
+
+# 7th argument is kwarg
+img.draw_sprite(0, 0, raw, 0, 2, 1, Color.WHITE)
+img.draw_sprite(0, 0, raw, 0, 2, transparent=Color.WHITE)
+
+# index must be in range
+try:
+    img.draw_sprite(0, 0, raw, 2, 2)
+except ValueError as ex:
+    print(ex)
+
+
 # Test draw_text()
 
 # three required arguments
@@ -218,6 +274,11 @@ except TypeError as ex:
 # actually creates file on disk
 img.save("test.png")
 uos.stat("test.png")
+
+# saving over a file that was drawn from replaces it in the cache
+img.draw_image(0, 0, "test.png")
+Image.empty(10, 20).save("test.png")
+print(Image("test.png").width, Image("test.png").height)
 uos.remove("test.png")
 
 # automatically adds file extension if missing
@@ -0,0 +1,37 @@
+import ustruct
+
+from pybricks.ev3devices import UltrasonicSensor
+from pybricks.parameters import Port
+from pybricks.tools import wait
+
+SENSOR_BASE = (
+    "/sys/devices/platform/ev3-ports/ev3-ports:in1/lego-port"
+    "/port0/ev3-ports:in1:lego-ev3-us/lego-sensor/sensor0/"
+)
+
+
+def write_bin_data(value):
+    with open(SENSOR_BASE + "bin_data", "wb") as f:
+        f.write(ustruct.pack("<h", value) + bytes(30))
+
+
+us = UltrasonicSensor(Port.S1)
+
+
+# testing distance
+
+print(us.distance())  # expect 123
+
+write_bin_data(150)
+wait(50)
+print(us.distance())  # expect 150
+
+
+# testing scheduled mode alternated with a mode that is not scheduled
+
+for value in (200, 300, 400):
+    write_bin_data(value)
+    print(us.distance(silent=True))  # expect value
+    wait(50)
+    write_bin_data(value + 1)
+    print(us.distance())  # expect value + 1
@@ -4,6 +4,6 @@
 
 DIR=$(dirname "$(readlink -f $0)")
 
-export EV3DEV_MOCKS_UMOCKDEV_RUN_ARGS="-d $DIR/lego-ev3-large-motor-port-a.umockdev"
+export EV3DEV_MOCKS_UMOCKDEV_RUN_ARGS="-d $DIR/lego-ev3-large-motor-port-a.umockdev -d $DIR/lego-ev3-us-sensor-port-1.umockdev"
 
 exec ev3dev-mocks-run "$DIR/../../bricks/ev3dev/pybricks-micropython" "$@"
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+
+# SPDX-License-Identifier: MIT
+# Copyright (c) 2020 The Pybricks Authors
+
+"""Convert a .png file to a raw image for the EV3 screen.
+
+Raw images are loaded on the EV3 by mapping the file into memory, so they
+don't have to be decoded. Use them with ``Image()``, ``draw_image()``,
+``load_image()`` and ``draw_sprite()`` like .png files.
+
+The file starts with a header of 16 bytes in little endian byte order:
+
+    magic           b"PBIM"
+    width           uint16
+    height          uint16
+    line size       uint32, bytes per line of pixels
+    reserved        uint32, zero
+
+The header is followed by the lines of pixels, top to bottom. Each pixel is a
+uint32 with the value 0x00RRGGBB, which is the pixel format of the EV3 screen.
+Transparent pixels of the .png are made white.
+"""
+
+import argparse
+import struct
+import zlib
+
+PNG_SIGNATURE = b"\x89PNG\r\n\x1a\n"
+RAW_HEADER = struct.Struct("<4sHHII")
+RAW_MAGIC = b"PBIM"
+
+# Color type: samples per pixel
+PNG_SAMPLES = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}
+
+
+def _unfilter(data, width, height, bpp, line_size):
+    """Undoes the PNG filters of each line of the image data."""
+    lines = []
+    prev = bytearray(line_size)
+    pos = 0
+    for _ in range(height):
+        kind = data[pos]
+        line = bytearray(data[pos + 1 : pos + 1 + line_size])
+        pos += 1 + line_size
+        for i in range(line_size):
+            a = line[i - bpp] if i >= bpp else 0
+            b = prev[i]
+            c = prev[i - bpp] if i >= bpp else 0
+            if kind == 1:
+                line[i] = (line[i] + a) & 0xFF
+            elif kind == 2:
+                line[i] = (line[i] + b) & 0xFF
+            elif kind == 3:
+                line[i] = (line[i] + (a + b) // 2) & 0xFF
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                pred = a if pa <= pb and pa <= pc else b if pb <= pc else c
+                line[i] = (line[i] + pred) & 0xFF
+        lines.append(line)
+        prev = line
+    return lines
+
+
+def read_png(file):
+    """Reads a non-interlaced .png file.
+
+    Parameters
+    ----------
+    file : file
+        The .png file, opened in 'rb' mode.
+
+    Returns
+    -------
+    tuple
+        The width, height and a list of lines of (r, g, b) tuples.
+    """
+    data = file.read()
+    if data[:8] != PNG_SIGNATURE:
+        raise ValueError("not a .png file")
+
+    pos = 8
+    idat = b""
+    palette = None
+    transparent = None
+    while pos < len(data):
+        size, kind = struct.unpack_from(">I4s", data, pos)
+        chunk = data[pos + 8 : pos + 8 + size]
+        pos += 12 + size
+        if kind == b"IHDR":
+            width, height, depth, color, _, _, interlace = struct.unpack(">IIBBBBB", chunk)
+        elif kind == b"PLTE":
+            palette = [tuple(chunk[i : i + 3]) for i in range(0, size, 3)]
+        elif kind == b"tRNS" and color == 3:
+            transparent = chunk
+        elif kind == b"IDAT":
+            idat += chunk
+        elif kind == b"IEND":
+            break
+
+    if interlace or color not in PNG_SAMPLES or depth not in (1, 2, 4, 8, 16):
+        raise ValueError("unsupported .png format")
+
+    samples = PNG_SAMPLES[color]
+    bits = samples * depth
+    line_size = (width * bits + 7) // 8
+    lines = _unfilter(zlib.decompress(idat), width, height, max(1, bits // 8), line_size)
+
+    def sample(line, index):
+        if depth == 16:
+            return line[index * 2]
+        if depth == 8:
+            return line[index]
+        shift = 8 - depth - (index * depth) % 8
+        value = (line[index * depth // 8] >> shift) & ((1 << depth) - 1)
+        # scale to 8 bits, except for palette indexes
+        return value if color == 3 else value * 255 // ((1 << depth) - 1)
+
+    pixels = []
+    for line in lines:
+        row = []
+        for x in range(width):
+            s = [sample(line, x * samples + i) for i in range(samples)]
+            if color == 3:
+                alpha = transparent[s[0]] if transparent and s[0] < len(transparent) else 255
+                s = list(palette[s[0]]) + [alpha]
+            elif color == 0:
+                s = [s[0]] * 3 + [255]
+            elif color == 4:
+                s = [s[0]] * 3 + [s[1]]
+            elif color == 2:
+                s = s + [255]
+            # blend with a white background
+            r, g, b, a = s
+            row.append(tuple((v * a + 255 * (255 - a)) // 255 for v in (r, g, b)))
+        pixels.append(row)
+
+    return width, height, pixels
+
+
+def write_raw(file, width, height, pixels):
+    """Writes a raw image file.
+
+    Parameters
+    ----------
+    file : file
+        The output file, opened in 'wb' mode.
+    width : int
+        Width in pixels.
+    height : int
+        Height in pixels.
+    pixels : list
+        Lines of (r, g, b) tuples.
+    """
+    file.write(RAW_HEADER.pack(RAW_MAGIC, width, height, width * 4, 0))
+    for row in pixels:
+        file.write(b"".join(struct.pack("<I", r << 16 | g << 8 | b) for r, g, b in row))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("png", type=argparse.FileType("rb"), help="the .png file")
+    parser.add_argument("raw", type=argparse.FileType("wb"), help="the output file, usually .pbimg")
+    args = parser.parse_args()
+
+    width, height, pixels = read_png(args.png)
+    write_raw(args.raw, width, height, pixels)
+
+
+if __name__ == "__main__":
+    main()
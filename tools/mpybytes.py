@@ -13,6 +13,11 @@ BUILD_DIR = "build"
 TMP_PY_SCRIPT = "_tmp.py"
 TMP_MPY_SCRIPT = "_tmp.mpy"
 
+# Must match LZ4_WINDOW_SIZE in bricks/stm32/main.c
+LZ4_WINDOW_SIZE = 1024
+LZ4_MIN_MATCH = 4
+LZ4_LAST_LITERALS = 5
+
 
 def make_build_dir():
     # Create build folder if it does not exist
@@ -60,6 +65,65 @@ def mpy_bytes_from_str(mpy_cross, string):
     return mpy_bytes_from_file(mpy_cross, py_path)
 
 
+def _lz4_length(length):
+    """Encode the part of a length that does not fit in the 4-bit token."""
+    out = bytearray()
+    length -= 15
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+    return out
+
+
+def mpy_compress(data):
+    """Compress bytes in the LZ4 block format, with match offsets limited to
+    LZ4_WINDOW_SIZE so the hub can decompress while loading the program."""
+
+    out = bytearray()
+    last = {}
+    anchor = 0
+    i = 0
+    end = len(data) - LZ4_LAST_LITERALS
+
+    while i < end - LZ4_MIN_MATCH:
+        # Look up where these bytes were last seen
+        key = data[i : i + LZ4_MIN_MATCH]
+        ref = last.get(key)
+        last[key] = i
+        if ref is None or i - ref > LZ4_WINDOW_SIZE:
+            i += 1
+            continue
+
+        # Extend the match as far as possible
+        length = LZ4_MIN_MATCH
+        while i + length < end and data[ref + length] == data[i + length]:
+            length += 1
+
+        # Write the sequence: token, literals, offset, match length
+        literals = i - anchor
+        match = length - LZ4_MIN_MATCH
+        out.append(min(literals, 15) << 4 | min(match, 15))
+        if literals >= 15:
+            out += _lz4_length(literals)
+        out += data[anchor:i]
+        out += (i - ref).to_bytes(2, byteorder="little")
+        if match >= 15:
+            out += _lz4_length(match)
+
+        i += length
+        anchor = i
+
+    # The last sequence has only literals
+    literals = len(data) - anchor
+    out.append(min(literals, 15) << 4)
+    if literals >= 15:
+        out += _lz4_length(literals)
+    out += data[anchor:]
+
+    return bytes(out)
+
+
 if __name__ == "__main__":
     parser = argparse.ArgumentParser(
         description="Convert Python scripts or commands to .mpy bytes."
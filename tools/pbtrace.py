@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+
+# SPDX-License-Identifier: MIT
+# Copyright (c) 2020 The Pybricks Authors
+
+"""Decode the event trace of a hub.
+
+On the hub, run ``print(pybricks.tools.trace())`` and save the printed bytes
+literal to a file, or pipe it into this script."""
+
+import argparse
+import ast
+import struct
+import sys
+
+# Keep in sync with pbio_trace_event_t in lib/pbio/include/pbio/trace.h
+EVENTS = {
+    1: ("UARTDEV_SYNC", "type id"),
+    2: ("UARTDEV_DATA", "baud / 100"),
+    3: ("UARTDEV_ERR", "uartdev.c line"),
+    4: ("MODE_BEGIN", "mode"),
+    5: ("MODE_END", "mode"),
+    6: ("SERVO_ERR", "pbio_error_t"),
+    7: ("DRIVEBASE_ERR", "pbio_error_t"),
+    8: ("BLE_CONNECT", "handle"),
+    9: ("BLE_DISCONNECT", "handle"),
+}
+
+# Mode of MODE_BEGIN and MODE_END when selecting a combination of modes
+MODE_COMBO = 0xFFFF
+
+ENTRY = struct.Struct("<IBBH")
+
+
+def decode(data):
+    """Decodes raw trace data.
+
+    Parameters
+    ----------
+    data : bytes
+        The raw trace, as returned by ``pybricks.tools.trace()``.
+
+    Returns
+    -------
+    list
+        A list of (time, event, port, data) tuples, oldest first.
+    """
+    return [ENTRY.unpack_from(data, i) for i in range(0, len(data), ENTRY.size)]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument(
+        "file",
+        nargs="?",
+        type=argparse.FileType("r"),
+        default=sys.stdin,
+        help="file with the printed trace (default: stdin)",
+    )
+    args = parser.parse_args()
+
+    data = ast.literal_eval(args.file.read().strip())
+    entries = decode(data)
+    if not entries:
+        return
+
+    start = entries[0][0]
+    for time, event, port, value in entries:
+        name, meaning = EVENTS.get(event, ("EVENT_{}".format(event), "data"))
+        if event in (4, 5) and value == MODE_COMBO:
+            value = "combo"
+        print(
+            "{:>10} {:>+8} {:<16} {:<4} {} = {}".format(
+                time, time - start, name, chr(port) if port else "-", meaning, value
+            )
+        )
+
+
+if __name__ == "__main__":
+    main()
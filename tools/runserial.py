@@ -5,8 +5,10 @@
 
 import argparse
 import serial
+import struct
 import time
-from mpybytes import mpy_bytes_from_file, mpy_bytes_from_str
+import zlib
+from mpybytes import mpy_bytes_from_file, mpy_bytes_from_str, mpy_compress
 
 
 def send_message(ser, data):
@@ -33,14 +35,94 @@ def send_message(ser, data):
         raise ValueError("Did not receive expected checksum.")
 
 
-def download_and_run(device, mpy_bytes):
-    """Split bytes from an MPY file into chunks and send to the hub."""
+# Sent instead of the program size to select version 2 of the download protocol
+DOWNLOAD_V2 = b"PBv2"
+ACK = 0x06
+NAK = 0x15
+CACHED = 0x11
+DOWNLOAD_FLAG_COMPRESSED = 0x01
+DOWNLOAD_FLAG_HASH = 0x02
 
-    # Open serial port
-    ser = serial.Serial(device, baudrate=115200, timeout=0)
 
-    # Get the mpy file size as 4 bytes
-    send_message(ser, len(mpy_bytes).to_bytes(4, byteorder="big"))
+def read_reply(ser, size, timeout=1.0):
+    """Read exactly size bytes from the hub or return what we have on timeout."""
+    data = b""
+    deadline = time.time() + timeout
+    while len(data) < size and time.time() < deadline:
+        data += ser.read(size - len(data))
+    return data
+
+
+def send_chunk(ser, index, chunk):
+    """Send one chunk with its index and CRC32."""
+    frame = struct.pack("<H", index) + chunk
+    ser.write(frame + struct.pack("<I", zlib.crc32(frame)))
+
+
+def download_v2(ser, mpy_bytes, chunk_size=128, window=4, compress=False):
+    """Send the program in CRC-checked chunks with a window of several chunks
+    in flight. Returns False if the hub does not support this protocol."""
+
+    # Let the hub skip the download if it already has this program
+    flags = DOWNLOAD_FLAG_HASH
+    program_hash = zlib.crc32(mpy_bytes)
+
+    if compress:
+        compressed = mpy_compress(mpy_bytes)
+        print("Compressed {0} to {1} bytes".format(len(mpy_bytes), len(compressed)))
+        # Send the original if it does not get any smaller
+        if len(compressed) < len(mpy_bytes):
+            mpy_bytes = compressed
+            flags |= DOWNLOAD_FLAG_COMPRESSED
+
+    send_message(ser, DOWNLOAD_V2)
+
+    header = struct.pack("<IHBBI", len(mpy_bytes), chunk_size, window, flags, program_hash)
+    ser.write(header + struct.pack("<I", zlib.crc32(header)))
+
+    # Hubs without this protocol reply with an error message instead
+    reply = read_reply(ser, 4)
+    if len(reply) == 4 and reply[0] == CACHED:
+        print("Program is unchanged, running it without downloading")
+        return True
+    if len(reply) < 4 or reply[0] != ACK:
+        return False
+
+    chunk_size, window = struct.unpack("<HB", reply[1:])
+    chunks = [mpy_bytes[i : i + chunk_size] for i in range(0, len(mpy_bytes), chunk_size)]
+    acked = [False] * len(chunks)
+    base = 0
+    next_index = 0
+
+    while base < len(chunks):
+        # Keep the window full
+        while next_index < len(chunks) and next_index < base + window:
+            send_chunk(ser, next_index, chunks[next_index])
+            next_index += 1
+
+        reply = read_reply(ser, 3)
+        if len(reply) < 3:
+            # Reply got lost, so send the oldest chunk again
+            send_chunk(ser, base, chunks[base])
+            continue
+
+        code, index = struct.unpack("<BH", reply)
+        if code == ACK:
+            acked[index] = True
+            while base < len(chunks) and acked[base]:
+                base += 1
+        elif code == NAK and index < next_index and not acked[index]:
+            send_chunk(ser, index, chunks[index])
+
+    return True
+
+
+def download_v1(ser, mpy_bytes):
+    """Send the program 100 bytes at a time, waiting for a checksum for each."""
+
+    # Get the mpy file size as 4 bytes. The hub reads these straight into a
+    # uint32_t, so they must be in its native (little-endian) byte order.
+    send_message(ser, len(mpy_bytes).to_bytes(4, byteorder="little"))
 
     # Split binary up in digestable chunks
     n = 100
@@ -50,6 +132,22 @@ def download_and_run(device, mpy_bytes):
     for chunk in chunks:
         send_message(ser, chunk)
 
+
+def download_and_run(device, mpy_bytes, compress=False):
+    """Split bytes from an MPY file into chunks and send to the hub."""
+
+    # Open serial port
+    ser = serial.Serial(device, baudrate=115200, timeout=0)
+
+    # Use the faster protocol if the hub has it
+    if not download_v2(ser, mpy_bytes, compress=compress):
+        # Wait for the hub to be ready again
+        data = b""
+        while b">>>> IDLE" not in data:
+            data += ser.read_all()
+            time.sleep(0.1)
+        download_v1(ser, mpy_bytes)
+
     # Give hub time to start program
     time.sleep(0.2)
 
@@ -110,6 +208,7 @@ if __name__ == "__main__":
 
     parser.add_argument("--mpy_cross", dest="mpy_cross", nargs="?", type=str, required=True)
     parser.add_argument("--dev", dest="device", nargs="?", type=str, required=True)
+    parser.add_argument("--compress", dest="compress", action="store_true")
     group = parser.add_mutually_exclusive_group(required=True)
     group.add_argument("--file", dest="file", nargs="?", const=1, type=str)
     group.add_argument("--string", dest="string", nargs="?", const=1, type=str)
@@ -121,4 +220,4 @@ if __name__ == "__main__":
     if args.string:
         bytearr = mpy_bytes_from_str(args.mpy_cross, args.string)
 
-    download_and_run(args.device, bytearr)
+    download_and_run(args.device, bytearr, compress=args.compress)